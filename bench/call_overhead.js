@@ -0,0 +1,47 @@
+/*!
+ * Per-call overhead of async bindings: getJob against synthetic jobs,
+ * once for a label that exists and once for one that does not, with
+ * `window` calls kept in flight
+ *
+ *     node bench/call_overhead.js [calls] [window]
+ */
+var common = require('./common')
+  , ctl = common.binding
+  , calls = +process.argv[2] || 200000
+  , window = +process.argv[3] || 64
+  , jobs = 1024
+
+ctl._setSyntheticJobs(jobs)
+
+function run(name, label, cb) {
+  var started = 0
+    , done = 0
+    , start = process.hrtime()
+
+  function next() {
+    var i = started++
+    ctl.getJob(label(i), {}, function() {
+      if (++done === calls) {
+        var d = process.hrtime(start)
+        var us = (d[0] * 1e6 + d[1] / 1e3) / calls
+        console.log('%s: %s us/call, %s calls/s', name, us.toFixed(3),
+          Math.round(1e6 / us))
+        return cb()
+      }
+      if (started < calls) next()
+    })
+  }
+  for (var i = 0; i < window && i < calls; i++) next()
+}
+
+run('getJob', function(i) {
+  return 'com.synthetic.job.' + (i % jobs)
+}, function() {
+  run('getJob (missing)', function(i) {
+    return 'com.synthetic.missing.' + (i % jobs)
+  }, function() {
+    var stats = ctl.getBatonPoolStats()
+    console.log('getJob pool: %j', stats.getJob)
+    ctl._setSyntheticJobs(0)
+  })
+})
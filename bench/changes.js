@@ -0,0 +1,61 @@
+/*!
+ * Compares polling with a JavaScript diff of two full listings against
+ * getJobChanges, on an unchanged synthetic response
+ *
+ *     node bench/changes.js [count]
+ */
+var common = require('./common')
+  , launchctl = require('../')
+  , ctl = common.binding
+  , count = +process.argv[2] || 20000
+  , rounds = 10
+
+ctl._setSyntheticJobs(count)
+
+function jsDiff(prev, next) {
+  var byLabel = {}
+    , changed = 0
+  prev.forEach(function(job) { byLabel[job.Label] = JSON.stringify(job) })
+  next.forEach(function(job) {
+    if (byLabel[job.Label] !== JSON.stringify(job)) changed++
+  })
+  return changed
+}
+
+function pollJs(cb) {
+  var prev = null
+    , n = 0
+    , start = process.hrtime()
+  ;(function next() {
+    ctl.getAllJobs(function(err, jobs) {
+      if (err) throw err
+      if (prev) jsDiff(prev, jobs)
+      prev = jobs
+      if (++n < rounds) return next()
+      var d = process.hrtime(start)
+      common.report('list + JS diff   x' + count, (d[0] * 1e3 + d[1] / 1e6) / rounds)
+      cb()
+    })
+  })()
+}
+
+function pollNative(cb) {
+  var tracker = launchctl.createJobTracker()
+    , n = 0
+    , start = process.hrtime()
+  ;(function next() {
+    tracker.changes(function(err) {
+      if (err) throw err
+      if (++n < rounds) return next()
+      var d = process.hrtime(start)
+      common.report('getJobChanges    x' + count, (d[0] * 1e3 + d[1] / 1e6) / rounds)
+      cb()
+    })
+  })()
+}
+
+pollJs(function() {
+  pollNative(function() {
+    ctl._setSyntheticJobs(0)
+  })
+})
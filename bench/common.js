@@ -0,0 +1,77 @@
+/*!
+ * Shared helpers for the benchmarks in this directory
+ *
+ * The benchmarks talk to the native binding directly so they can swap in
+ * synthetic launchd responses with `_setSyntheticJobs(count)`
+ */
+var binding = require('bindings')('bindings')
+
+exports.binding = binding
+
+/**
+ * Runs `fn` `iterations` times and returns the mean time in milliseconds
+ *
+ * @param {Function} fn
+ * @param {Number} iterations
+ * @api private
+ */
+exports.time = function(fn, iterations) {
+  iterations = iterations || 1
+  fn() // warm up
+  var start = process.hrtime()
+  for (var i=0; i<iterations; i++) fn()
+  var diff = process.hrtime(start)
+  return (diff[0] * 1e3 + diff[1] / 1e6) / iterations
+}
+
+/**
+ * Prints a result line
+ *
+ * @param {String} name
+ * @param {Number} ms
+ * @api private
+ */
+exports.report = function(name, ms) {
+  console.log('%s: %s ms', name, ms.toFixed(3))
+}
+
+/**
+ * Starts sampling event loop delay by chaining `setImmediate`
+ *
+ * Returns an object whose `stop()` ends sampling and returns the gaps
+ * between consecutive ticks in milliseconds, sorted ascending
+ *
+ * @api private
+ */
+exports.lag = function() {
+  var samples = []
+    , running = true
+    , last = process.hrtime()
+
+  function tick() {
+    if (!running) return
+    var diff = process.hrtime(last)
+    samples.push(diff[0] * 1e3 + diff[1] / 1e6)
+    last = process.hrtime()
+    setImmediate(tick)
+  }
+  setImmediate(tick)
+
+  return {
+    stop: function() {
+      running = false
+      return samples.sort(function(a, b) { return a - b })
+    }
+  }
+}
+
+/**
+ * Returns the `p` percentile (0-100) of sorted `samples`
+ *
+ * @api private
+ */
+exports.percentile = function(samples, p) {
+  if (!samples.length) return 0
+  var i = Math.min(samples.length - 1, Math.ceil(p / 100 * samples.length) - 1)
+  return samples[Math.max(0, i)]
+}
@@ -0,0 +1,95 @@
+/*!
+ * Tail latency of the async bindings when launchd is slow or failing
+ *
+ * Installs the fake transport with `spec` (see launch_fake.h) and drives
+ * getJob, getAllJobs, startStopRemove and submitJob in turn at `qps`
+ * requests per second for `seconds` each. Requests are sent on schedule
+ * whether or not earlier ones have finished, and latency is measured from
+ * the scheduled time, so a backlog shows up in the percentiles instead of
+ * slowing the load down. getAllJobs runs at a hundredth of `qps`.
+ * submitJob's jobs are what startStopRemove then starts, stops and
+ * removes.
+ *
+ *     node bench/faults.js [qps] [seconds] [spec] [threads]
+ */
+var common = require('./common')
+  , ctl = common.binding
+  , qps = +process.argv[2] || 500
+  , seconds = +process.argv[3] || 3
+  , spec = process.argv[4] ||
+      'jobs=10000,latency=exp:5,error=GetJob:EAGAIN:0.01,error=StartJob:ESRCH:0.01,seed=1'
+  , threads = +process.argv[5] || 16
+  , jobs = +(/(?:^|,)jobs=(\d+)/.exec(spec) || [0, 1000])[1]
+  , prefix = 'com.node-launchctl.faults.'
+
+var ops = [
+  { name: 'getJob', qps: qps, send: function(i, cb) {
+      ctl.getJob('com.synthetic.job.' + Math.floor(Math.random() * jobs), {}, cb)
+    } }
+, { name: 'getAllJobs', qps: Math.max(1, qps / 100), send: function(i, cb) {
+      ctl.getAllJobs({}, cb)
+    } }
+, { name: 'submitJob', qps: qps, send: function(i, cb) {
+      ctl.submitJob({ label: prefix + i, program: '/usr/bin/true' }, cb)
+    } }
+  // Start, stop and remove each submitted job in turn
+, { name: 'startStopRemove', qps: qps, send: function(i, cb) {
+      ctl.startStopRemove(prefix + Math.floor(i / 3), i % 3 + 1, {}, cb)
+    } }
+]
+
+function ms(d) {
+  return d[0] * 1e3 + d[1] / 1e6
+}
+
+function run(op, cb) {
+  var total = Math.round(op.qps * seconds)
+    , interval = 1e3 / op.qps
+    , samples = []
+    , errors = {}
+    , sent = 0
+    , done = 0
+    , start = process.hrtime()
+    , lag = common.lag()
+
+  function send(i) {
+    var due = i * interval
+    op.send(i, function(err) {
+      samples.push(ms(process.hrtime(start)) - due)
+      if (err) {
+        var code = err.errno || err.message
+        errors[code] = (errors[code] || 0) + 1
+      }
+      if (++done === total) finish()
+    })
+  }
+
+  // Sends whatever is due, so a late tick catches up
+  var timer = setInterval(function() {
+    var due = Math.min(total, Math.floor(ms(process.hrtime(start)) / interval) + 1)
+    while (sent < due) send(sent++)
+    if (sent === total) clearInterval(timer)
+  }, 1)
+
+  function finish() {
+    var elapsed = ms(process.hrtime(start))
+      , gaps = lag.stop()
+    samples.sort(function(a, b) { return a - b })
+    console.log('%s: %d requests, %d req/s (target %d), errors %j',
+      op.name, total, Math.round(total / elapsed * 1e3), Math.round(op.qps), errors)
+    common.report('  p50', common.percentile(samples, 50))
+    common.report('  p99', common.percentile(samples, 99))
+    common.report('  p999', common.percentile(samples, 99.9))
+    common.report('  event loop lag p99', common.percentile(gaps, 99))
+    common.report('  event loop lag max', gaps.length ? gaps[gaps.length - 1] : 0)
+    cb()
+  }
+}
+
+ctl.setExecutorOptions({ threads: threads })
+ctl.setTransport({ fake: spec })
+console.log('%s, %d executor threads', spec, threads)
+;(function next() {
+  if (!ops.length) return ctl.setTransport({})
+  run(ops.shift(), next)
+})()
@@ -0,0 +1,27 @@
+/*!
+ * Compares converting whole jobs against converting only the keys most
+ * callers read, on synthetic jobs carrying a wide nested dictionary
+ *
+ *     node bench/fields.js [count] [width]
+ */
+var common = require('./common')
+  , ctl = common.binding
+  , count = +process.argv[2] || 20000
+  , width = +process.argv[3] || 64
+  , fields = ['Label', 'PID', 'LastExitStatus']
+
+ctl._setSyntheticJobs(count, { depth: 8, width: width })
+
+common.report('all keys          x' + count, common.time(function() {
+  ctl.getAllJobsSync()
+}, 5))
+
+common.report('3 fields          x' + count, common.time(function() {
+  ctl.getAllJobsSync({ fields: fields })
+}, 5))
+
+common.report('3 fields (shaped) x' + count, common.time(function() {
+  ctl.getAllJobsSync({ fields: fields, shaped: true })
+}, 5))
+
+ctl._setSyntheticJobs(0)
@@ -0,0 +1,28 @@
+/*!
+ * Compares filtering converted jobs in JavaScript against matching labels
+ * on the native side before conversion
+ *
+ *     node bench/filter.js [count]
+ */
+var common = require('./common')
+  , ctl = common.binding
+  , count = +process.argv[2] || 50000
+  , regex = /^com\.synthetic\.job\.1[0-9]*$/
+
+ctl._setSyntheticJobs(count)
+
+common.report('filter in JS      x' + count, common.time(function() {
+  ctl.getAllJobsSync().filter(function(job) {
+    return regex.test(job.Label)
+  })
+}, 5))
+
+common.report('native regex      x' + count, common.time(function() {
+  ctl.getAllJobsSync({ regex: '^com\\.synthetic\\.job\\.1[0-9]*$' })
+}, 5))
+
+common.report('native prefix     x' + count, common.time(function() {
+  ctl.getAllJobsSync({ prefix: 'com.synthetic.job.1' })
+}, 5))
+
+ctl._setSyntheticJobs(0)
@@ -0,0 +1,39 @@
+/*!
+ * Compares looking up 500 labels with 500 getJob calls against a single
+ * getJobs call
+ *
+ *     node bench/getjobs.js [count]
+ */
+var common = require('./common')
+  , ctl = common.binding
+  , count = +process.argv[2] || 500
+  , labels = ctl.getAllJobsSync({ fields: ['Label'] }).slice(0, count).map(function(job) {
+      return job.Label
+    })
+
+function oneByOne(cb) {
+  var start = process.hrtime()
+    , pending = labels.length
+  labels.forEach(function(label) {
+    ctl.getJob(label, function() {
+      if (--pending) return
+      var d = process.hrtime(start)
+      common.report('getJob x' + labels.length, d[0] * 1e3 + d[1] / 1e6)
+      cb()
+    })
+  })
+}
+
+function batched(cb) {
+  var start = process.hrtime()
+  ctl.getJobs(labels, function(err) {
+    if (err) throw err
+    var d = process.hrtime(start)
+    common.report('getJobs x' + labels.length, d[0] * 1e3 + d[1] / 1e6)
+    cb()
+  })
+}
+
+oneByOne(function() {
+  batched(function() {})
+})
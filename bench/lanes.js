@@ -0,0 +1,66 @@
+/*!
+ * Measures getJob latency while bursts of loads scan a directory of
+ * disabled plists, with and without a thread reserved for queries
+ *
+ *     node bench/lanes.js [plists] [loads]
+ */
+var common = require('./common')
+  , ctl = common.binding
+  , fs = require('fs')
+  , os = require('os')
+  , path = require('path')
+  , plists = +process.argv[2] || 2000
+  , loads = +process.argv[3] || 16
+  , dir = path.join(os.tmpdir(), 'launchctl-lanes-' + process.pid)
+  , label = ctl.getAllJobsSync({ fields: ['Label'] })[0].Label
+
+fs.mkdirSync(dir)
+for (var i = 0; i < plists; i++) {
+  var name = 'com.node-launchctl.bench.' + i
+  fs.writeFileSync(path.join(dir, name + '.plist'),
+    '<?xml version="1.0" encoding="UTF-8"?>\n' +
+    '<plist version="1.0"><dict>' +
+    '<key>Label</key><string>' + name + '</string>' +
+    '<key>Program</key><string>/usr/bin/true</string>' +
+    '<key>Disabled</key><true/>' +
+    '</dict></plist>\n')
+}
+
+function run(reserve, cb) {
+  ctl.setExecutorOptions({ threads: 4, reserved: { interactive: reserve } })
+  var samples = []
+    , pending = loads
+    , polling = true
+
+  function poll() {
+    if (!polling) return
+    var start = process.hrtime()
+    ctl.getJob(label, {}, function() {
+      var d = process.hrtime(start)
+      samples.push(d[0] * 1e3 + d[1] / 1e6)
+      setTimeout(poll, 5)
+    })
+  }
+  poll()
+
+  for (var i = 0; i < loads; i++) {
+    // Disabled jobs are parsed but never loaded without forceload
+    ctl.loadJob(dir, false, false, function() {
+      if (--pending) return
+      polling = false
+      samples.sort(function(a, b) { return a - b })
+      common.report('getJob p50 (reserved ' + reserve + ')', common.percentile(samples, 50))
+      common.report('getJob p99 (reserved ' + reserve + ')', common.percentile(samples, 99))
+      setTimeout(cb, 50)
+    })
+  }
+}
+
+run(0, function() {
+  run(1, function() {
+    fs.readdirSync(dir).forEach(function(f) {
+      fs.unlinkSync(path.join(dir, f))
+    })
+    fs.rmdirSync(dir)
+  })
+})
@@ -0,0 +1,131 @@
+/*
+ * launch_data_arena.c
+ * Cost of building, decoding and freeing a 10k-job launch_data tree with
+ * one malloc() per node versus a launch_data_arena
+ *
+ * Runs against the portable launch_data implementation, so it needs no
+ * launchd. Jobs are kept in an array: launch_data dictionaries look keys
+ * up linearly, and 10k labels in one would time strcmp(), not malloc().
+ *
+ *     cc -O2 -pthread -Ideps/liblaunchctl/compat -Ideps/liblaunchctl/liblaunchctl \
+ *       bench/launch_data_arena.c deps/liblaunchctl/liblaunchctl/launch_data_portable.c \
+ *       deps/liblaunchctl/liblaunchctl/launch_data_codec.c -o launch_data_arena
+ *     ./launch_data_arena [jobs] [rounds]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <launch.h>
+#include "launch_data_arena.h"
+#include "launch_data_codec.h"
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* A GetJobs-shaped entry: label, pid, status and a short argv */
+static launch_data_t new_job(unsigned long i) {
+  char label[64];
+  snprintf(label, sizeof(label), "com.example.bench.job%lu", i);
+  launch_data_t job = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+  launch_data_dict_insert(job, launch_data_new_string(label), LAUNCH_JOBKEY_LABEL);
+  launch_data_dict_insert(job, launch_data_new_integer((long long)(i + 100)), LAUNCH_JOBKEY_PID);
+  launch_data_dict_insert(job, launch_data_new_integer(0), LAUNCH_JOBKEY_LASTEXITSTATUS);
+  launch_data_dict_insert(job, launch_data_new_bool(true), LAUNCH_JOBKEY_ONDEMAND);
+  launch_data_dict_insert(job, launch_data_new_integer(10), LAUNCH_JOBKEY_TIMEOUT);
+  launch_data_t argv = launch_data_alloc(LAUNCH_DATA_ARRAY);
+  launch_data_array_set_index(argv, launch_data_new_string("/usr/libexec/bench"), 0);
+  launch_data_array_set_index(argv, launch_data_new_string("--job"), 1);
+  launch_data_array_set_index(argv, launch_data_new_string(label), 2);
+  launch_data_dict_insert(job, argv, LAUNCH_JOBKEY_PROGRAMARGUMENTS);
+  return job;
+}
+
+static launch_data_t new_tree(unsigned long jobs) {
+  launch_data_t tree = launch_data_alloc(LAUNCH_DATA_ARRAY);
+  for (unsigned long i = 0; i < jobs; i++) {
+    launch_data_array_set_index(tree, new_job(i), i);
+  }
+  return tree;
+}
+
+struct times {
+  uint64_t build, decode, free;
+};
+
+/* One round: build a request-like tree, decode a response-like one, drop both */
+static void round_trip(launch_data_arena_t arena, unsigned long jobs,
+    const struct launch_data_buf *encoded, struct times *t) {
+  launch_data_arena_t prev = launch_data_arena_use(arena);
+  uint64_t start = now_ns();
+  launch_data_t built = new_tree(jobs);
+  uint64_t mid = now_ns();
+  launch_data_t decoded = launch_data_decode(encoded->data, encoded->len, NULL);
+  uint64_t end = now_ns();
+  launch_data_arena_use(prev);
+  if (built == NULL || decoded == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  launch_data_free(built);
+  launch_data_free(decoded);
+  launch_data_arena_reset(arena);
+  t->build += mid - start;
+  t->decode += end - mid;
+  t->free += now_ns() - end;
+}
+
+static void measure(const char *name, launch_data_arena_t arena, unsigned long jobs,
+    int rounds, const struct launch_data_buf *encoded) {
+  struct times t = { 0, 0, 0 };
+  size_t peak = 0;
+  for (int r = 0; r < rounds; r++) {
+    launch_data_arena_t prev = launch_data_arena_use(arena);
+    launch_data_t probe = r == 0 && arena ? new_tree(jobs) : NULL;
+    launch_data_arena_use(prev);
+    if (probe) {
+      peak = launch_data_arena_size(arena);
+      launch_data_arena_reset(arena);
+    }
+    round_trip(arena, jobs, encoded, &t);
+  }
+  printf("%-6s build %8.2f ms  decode %8.2f ms  free %8.3f ms",
+    name, t.build / 1e6 / rounds, t.decode / 1e6 / rounds, t.free / 1e6 / rounds);
+  if (arena) {
+    printf("  %zu KB per tree", peak / 1024);
+  }
+  printf("\n");
+}
+
+int main(int argc, char **argv) {
+  unsigned long jobs = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+  int rounds = argc > 2 ? atoi(argv[2]) : 20;
+  if (rounds < 1) {
+    rounds = 1;
+  }
+
+  struct launch_data_buf encoded = { NULL, 0, 0 };
+  launch_data_t tree = new_tree(jobs);
+  if (launch_data_encode(tree, &encoded, 8) != 0) {
+    fprintf(stderr, "encode failed\n");
+    return 1;
+  }
+  launch_data_free(tree);
+
+  launch_data_arena_t arena = launch_data_arena_create(0);
+  if (arena == NULL) {
+    fprintf(stderr, "arenas need the portable launch_data implementation\n");
+    return 1;
+  }
+  printf("%lu jobs, %d rounds, %zu byte encoding\n", jobs, rounds, encoded.len);
+  measure("malloc", NULL, jobs, rounds, &encoded);
+  measure("arena", arena, jobs, rounds, &encoded);
+
+  launch_data_arena_destroy(arena);
+  launch_data_buf_free(&encoded);
+  return 0;
+}
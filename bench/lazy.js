@@ -0,0 +1,29 @@
+/*!
+ * Compares eager and lazy getAllJobs when callers only read Label and PID
+ *
+ *     node bench/lazy.js [count]
+ */
+var common = require('./common')
+  , ctl = common.binding
+  , count = +process.argv[2] || 5000
+
+ctl._setSyntheticJobs(count)
+
+function read(jobs) {
+  var sum = 0
+  for (var i=0; i<jobs.length; i++) {
+    sum += jobs[i].Label.length
+    if (jobs[i].PID) sum++
+  }
+  return sum
+}
+
+common.report('eager x' + count, common.time(function() {
+  read(ctl.getAllJobsSync())
+}, 10))
+
+common.report('lazy  x' + count, common.time(function() {
+  read(ctl.getAllJobsSync({ lazy: true }))
+}, 10))
+
+ctl._setSyntheticJobs(0)
@@ -0,0 +1,35 @@
+/*!
+ * Stresses the converter with deeply nested and very wide synthetic jobs,
+ * reporting conversion time and the peak number of live handles
+ *
+ *     node bench/nesting.js [count]
+ */
+var common = require('./common')
+  , ctl = common.binding
+  , count = +process.argv[2] || 2000
+
+var shapes = [
+  { name: 'flat', depth: 0, width: 0 },
+  { name: 'deep (depth 48)', depth: 48, width: 0 },
+  { name: 'wide (width 512)', depth: 0, width: 512 },
+  { name: 'deep + wide', depth: 48, width: 512 }
+]
+
+shapes.forEach(function(shape) {
+  ctl._setSyntheticJobs(count, shape)
+  var ms = common.time(function() {
+    ctl.getAllJobsSync({ _trackHandles: true })
+  }, 3)
+  common.report(shape.name + ' x' + count, ms)
+  console.log('  peak handles: %d', ctl._conversionStats().peakHandles)
+})
+
+ctl._setSyntheticJobs(1, { depth: 8 })
+try {
+  ctl.getAllJobsSync({ maxDepth: 4 })
+  console.log('maxDepth: not enforced')
+} catch (e) {
+  console.log('maxDepth: %s', e.message)
+}
+
+ctl._setSyntheticJobs(0)
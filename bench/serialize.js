@@ -0,0 +1,35 @@
+/*!
+ * Compares event loop blocking of getAllJobs when the tree is converted on
+ * the loop against encoding it on the threadpool and decoding one buffer
+ *
+ *     node bench/serialize.js [count]
+ */
+var common = require('./common')
+  , ctl = common.binding
+  , count = +process.argv[2] || 20000
+  , rounds = 20
+
+ctl._setSyntheticJobs(count)
+
+function run(name, opts, cb) {
+  var lag = common.lag()
+    , n = 0
+
+  ;(function next() {
+    ctl.getAllJobs(opts, function(err) {
+      if (err) throw err
+      if (++n < rounds) return next()
+      var samples = lag.stop()
+      console.log('%s x%d: max loop delay %s ms, p99 %s ms', name, count,
+        samples[samples.length - 1].toFixed(3),
+        common.percentile(samples, 99).toFixed(3))
+      cb()
+    })
+  })()
+}
+
+run('convert on loop', {}, function() {
+  run('serialized     ', { serialized: true }, function() {
+    ctl._setSyntheticJobs(0)
+  })
+})
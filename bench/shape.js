@@ -0,0 +1,54 @@
+/*!
+ * Compares default and shaped job conversion on a synthetic 50k job
+ * ALLJOBS response, and the cost of reading properties from the results
+ *
+ *     node bench/shape.js [count]
+ */
+var common = require('./common')
+  , ctl = common.binding
+  , count = +process.argv[2] || 50000
+
+ctl._setSyntheticJobs(count)
+
+// Two identical readers so each keeps its own inline caches
+function accessPlain(jobs) {
+  var sum = 0
+  for (var i=0; i<jobs.length; i++) {
+    var job = jobs[i]
+    sum += job.Label.length
+    if (job.PID) sum += job.PID
+    if (job.LastExitStatus) sum += job.LastExitStatus
+  }
+  return sum
+}
+
+function accessShaped(jobs) {
+  var sum = 0
+  for (var i=0; i<jobs.length; i++) {
+    var job = jobs[i]
+    sum += job.Label.length
+    if (job.PID) sum += job.PID
+    if (job.LastExitStatus) sum += job.LastExitStatus
+  }
+  return sum
+}
+
+var plain, shaped
+
+common.report('convert (default) x' + count, common.time(function() {
+  plain = ctl.getAllJobsSync()
+}, 5))
+
+common.report('convert (shaped)  x' + count, common.time(function() {
+  shaped = ctl.getAllJobsSync({ shaped: true })
+}, 5))
+
+common.report('access (default)  x' + count, common.time(function() {
+  accessPlain(plain)
+}, 20))
+
+common.report('access (shaped)   x' + count, common.time(function() {
+  accessShaped(shaped)
+}, 20))
+
+ctl._setSyntheticJobs(0)
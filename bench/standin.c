@@ -0,0 +1,136 @@
+/*
+ * standin.c
+ * Concurrent round trips against launchd-standin over the socket transport
+ *
+ * Each of `threads` threads sends GetJob for random synthetic labels
+ * through launch_transport_msg(), as the binding's executor threads would,
+ * for `seconds`. Reports requests per second with median and 99th
+ * percentile latency, then the time of one ALLJOBS listing. Start the
+ * server first, with as many jobs as `jobs`:
+ *
+ *     launchd-standin -n 100000 -s /tmp/launchd-standin.sock &
+ *     cc -O2 -pthread -Ideps/liblaunchctl/compat -Ideps/liblaunchctl/liblaunchctl \
+ *       bench/standin.c deps/liblaunchctl/liblaunchctl/launch_socket.c \
+ *       deps/liblaunchctl/liblaunchctl/launch_transport.c \
+ *       deps/liblaunchctl/liblaunchctl/launch_supervisor.c \
+ *       deps/liblaunchctl/liblaunchctl/launch_fake.c \
+ *       deps/liblaunchctl/liblaunchctl/launch_data_codec.c \
+ *       deps/liblaunchctl/liblaunchctl/launch_data_portable.c -lm -o standin
+ *     ./standin [jobs] [threads] [seconds] [path]
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <launch.h>
+#include "launch_transport.h"
+
+#define MAX_SAMPLES 1000000
+
+struct worker {
+  pthread_t thread;
+  unsigned int seed;
+  uint64_t *samples;
+  size_t count;
+  size_t failed;
+};
+
+static unsigned long jobs;
+static uint64_t deadline;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void *work(void *arg) {
+  struct worker *w = arg;
+  char label[64];
+  for (;;) {
+    uint64_t start = now_ns();
+    if (start >= deadline) {
+      break;
+    }
+    snprintf(label, sizeof(label), "com.synthetic.job.%lu", (unsigned long)rand_r(&w->seed) % jobs);
+    launch_data_t msg = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+    launch_data_dict_insert(msg, launch_data_new_string(label), LAUNCH_KEY_GETJOB);
+    launch_data_t resp = launch_transport_msg(msg);
+    launch_data_free(msg);
+    if (resp == NULL || launch_data_get_type(resp) != LAUNCH_DATA_DICTIONARY) {
+      w->failed++;
+    }
+    if (resp) {
+      launch_data_free(resp);
+    }
+    if (w->count < MAX_SAMPLES) {
+      w->samples[w->count++] = now_ns() - start;
+    }
+  }
+  return NULL;
+}
+
+static int cmp(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv) {
+  jobs = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+  int threads = argc > 2 ? atoi(argv[2]) : 8;
+  int seconds = argc > 3 ? atoi(argv[3]) : 3;
+  const char *path = argc > 4 ? argv[4] : "/tmp/launchd-standin.sock";
+  if (jobs == 0 || threads < 1 || seconds < 1) {
+    fprintf(stderr, "usage: %s [jobs] [threads] [seconds] [path]\n", argv[0]);
+    return 2;
+  }
+
+  int err = launch_transport_connect(path);
+  if (err) {
+    fprintf(stderr, "%s: %s\n", path, strerror(err));
+    return 1;
+  }
+
+  struct worker *w = calloc((size_t)threads, sizeof(*w));
+  deadline = now_ns() + (uint64_t)seconds * 1000000000ULL;
+  for (int i = 0; i < threads; i++) {
+    w[i].seed = (unsigned int)i + 1;
+    w[i].samples = malloc(MAX_SAMPLES * sizeof(uint64_t));
+    pthread_create(&w[i].thread, NULL, work, &w[i]);
+  }
+  size_t total = 0, failed = 0;
+  for (int i = 0; i < threads; i++) {
+    pthread_join(w[i].thread, NULL);
+    total += w[i].count;
+    failed += w[i].failed;
+  }
+
+  uint64_t *all = malloc(total * sizeof(uint64_t));
+  size_t n = 0;
+  for (int i = 0; i < threads; i++) {
+    memcpy(all + n, w[i].samples, w[i].count * sizeof(uint64_t));
+    n += w[i].count;
+    free(w[i].samples);
+  }
+  qsort(all, n, sizeof(uint64_t), cmp);
+  printf("%d threads: %.0f GetJob/s, p50 %.1f us, p99 %.1f us, %zu failed\n",
+    threads, (double)total / seconds, all[n / 2] / 1e3, all[n * 99 / 100] / 1e3, failed);
+
+  for (int i = 0; i < 3; i++) {
+    launch_data_t resp = NULL;
+    uint64_t start = now_ns();
+    if (launch_transport_swap_complex(NULL, VPROC_GSK_ALLJOBS, NULL, &resp) || resp == NULL) {
+      fprintf(stderr, "ALLJOBS: %s\n", strerror(errno));
+      return 1;
+    }
+    printf("ALLJOBS %zu jobs: %.1f ms\n", launch_data_dict_get_count(resp), (now_ns() - start) / 1e6);
+    launch_data_free(resp);
+  }
+  free(all);
+  free(w);
+  return 0;
+}
@@ -0,0 +1,71 @@
+/*!
+ * Load tests the async pipeline against launchd-standin, a separate
+ * server process holding `jobs` synthetic jobs
+ *
+ * Keeps `inflight` getJob calls outstanding per round, growing the
+ * executor with it, and reports requests per second with median and 99th
+ * percentile latency. Needs `build/Release/launchd-standin`, built with
+ * the binding
+ *
+ *     node bench/standin.js [jobs] [requests]
+ */
+var common = require('./common')
+  , ctl = common.binding
+  , spawn = require('child_process').spawn
+  , os = require('os')
+  , path = require('path')
+  , jobs = +process.argv[2] || 100000
+  , requests = +process.argv[3] || 20000
+  , sock = path.join(os.tmpdir(), 'launchd-standin-' + process.pid + '.sock')
+  , server = spawn(path.join(__dirname, '..', 'build', 'Release', 'launchd-standin'),
+      ['-n', String(jobs), '-s', sock], { stdio: ['ignore', 'pipe', 'inherit'] })
+
+function run(inflight, cb) {
+  ctl.setExecutorOptions({ threads: Math.min(inflight, 64) })
+  var samples = []
+    , sent = 0
+    , done = 0
+    , start = process.hrtime()
+
+  function send() {
+    var label = 'com.synthetic.job.' + Math.floor(Math.random() * jobs)
+      , t = process.hrtime()
+    sent++
+    ctl.getJob(label, {}, function(err) {
+      if (err) throw err
+      var d = process.hrtime(t)
+      samples.push(d[0] * 1e3 + d[1] / 1e6)
+      if (++done === requests) return finish()
+      if (sent < requests) send()
+    })
+  }
+
+  function finish() {
+    var d = process.hrtime(start)
+      , ms = d[0] * 1e3 + d[1] / 1e6
+    samples.sort(function(a, b) { return a - b })
+    console.log('inflight %d: %d req/s', inflight, Math.round(requests / ms * 1e3))
+    common.report('  p50', common.percentile(samples, 50))
+    common.report('  p99', common.percentile(samples, 99))
+    cb()
+  }
+
+  for (var i = 0; i < inflight && sent < requests; i++) send()
+}
+
+server.stdout.once('data', function() {
+  ctl.setTransport({ socket: sock })
+  var start = process.hrtime()
+  ctl.getAllJobsSync({ fields: ['Label'] })
+  var d = process.hrtime(start)
+  common.report('getAllJobs (' + jobs + ' jobs)', d[0] * 1e3 + d[1] / 1e6)
+
+  var levels = [1, 4, 16, 64]
+  ;(function next() {
+    if (!levels.length) {
+      ctl.setTransport({})
+      return server.kill()
+    }
+    run(levels.shift(), next)
+  })()
+})
@@ -0,0 +1,51 @@
+/*!
+ * Compares event loop delay of listing synthetic jobs in one getAllJobs
+ * callback against reading them from createListStream
+ *
+ *     node bench/stream.js [count]
+ */
+var common = require('./common')
+  , launchctl = require('../')
+  , ctl = common.binding
+  , count = +process.argv[2] || 10000
+
+ctl._setSyntheticJobs(count)
+
+function summary(name, samples, ms) {
+  console.log('%s x%d: %s ms total, max loop delay %s ms, p99 %s ms', name,
+    count, ms.toFixed(3), samples[samples.length - 1].toFixed(3),
+    common.percentile(samples, 99).toFixed(3))
+}
+
+function oneShot(cb) {
+  var lag = common.lag()
+    , start = process.hrtime()
+  ctl.getAllJobs(function(err, jobs) {
+    if (err) throw err
+    var d = process.hrtime(start)
+    // Let the sampler observe the turn spent converting
+    setImmediate(function() {
+      summary('one-shot ', lag.stop(), d[0] * 1e3 + d[1] / 1e6)
+      cb()
+    })
+  })
+}
+
+function streaming(cb) {
+  var lag = common.lag()
+    , start = process.hrtime()
+    , n = 0
+  launchctl.createListStream({ batchSize: 100, budget: 1000 })
+    .on('data', function() { n++ })
+    .on('end', function() {
+      var d = process.hrtime(start)
+      summary('streaming', lag.stop(), d[0] * 1e3 + d[1] / 1e6)
+      cb()
+    })
+}
+
+oneShot(function() {
+  streaming(function() {
+    ctl._setSyntheticJobs(0)
+  })
+})
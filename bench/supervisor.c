@@ -0,0 +1,116 @@
+/*
+ * supervisor.c
+ * Throughput of the Linux supervisor transport with thousands of jobs
+ *
+ * Submits `jobs` jobs running `sleep <seconds>` through launch_transport_msg(),
+ * as liblaunchctl would, then waits for the supervisor to notice every exit
+ * and reports submit, exit and ALLJOBS listing times. The supervisor only
+ * wakes for exits, so its thread should stay near idle while jobs run.
+ *
+ *     cc -O2 -pthread -Ideps/liblaunchctl/compat -Ideps/liblaunchctl/liblaunchctl \
+ *       bench/supervisor.c deps/liblaunchctl/liblaunchctl/launch_supervisor.c \
+ *       deps/liblaunchctl/liblaunchctl/launch_transport.c \
+ *       deps/liblaunchctl/liblaunchctl/launch_socket.c \
+ *       deps/liblaunchctl/liblaunchctl/launch_fake.c \
+ *       deps/liblaunchctl/liblaunchctl/launch_data_codec.c \
+ *       deps/liblaunchctl/liblaunchctl/launch_data_portable.c -lm -o supervisor
+ *     ./supervisor [jobs] [seconds]
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <launch.h>
+#include "launch_transport.h"
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int submit(unsigned long i, const char *seconds) {
+  char label[64];
+  snprintf(label, sizeof(label), "com.example.bench.sleep%lu", i);
+  launch_data_t job = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+  launch_data_dict_insert(job, launch_data_new_string(label), LAUNCH_JOBKEY_LABEL);
+  launch_data_dict_insert(job, launch_data_new_bool(true), LAUNCH_JOBKEY_RUNATLOAD);
+  launch_data_t argv = launch_data_alloc(LAUNCH_DATA_ARRAY);
+  launch_data_array_set_index(argv, launch_data_new_string("sleep"), 0);
+  launch_data_array_set_index(argv, launch_data_new_string(seconds), 1);
+  launch_data_dict_insert(job, argv, LAUNCH_JOBKEY_PROGRAMARGUMENTS);
+  launch_data_t msg = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+  launch_data_dict_insert(msg, job, LAUNCH_KEY_SUBMITJOB);
+  launch_data_t resp = launch_transport_msg(msg);
+  launch_data_free(msg);
+  int err = resp ? launch_data_get_errno(resp) : errno;
+  launch_data_free(resp);
+  return err;
+}
+
+// Jobs still running, from one ALLJOBS listing
+static unsigned long running(uint64_t *list_ns) {
+  launch_data_t jobs = NULL;
+  uint64_t start = now_ns();
+  if (launch_transport_swap_complex(NULL, VPROC_GSK_ALLJOBS, NULL, &jobs) || jobs == NULL) {
+    fprintf(stderr, "ALLJOBS: %s\n", strerror(errno));
+    exit(1);
+  }
+  *list_ns = now_ns() - start;
+  unsigned long n = 0;
+  for (size_t i=1; i<jobs->_array_cnt; i+=2) {
+    if (launch_data_dict_lookup(jobs->_array[i], LAUNCH_JOBKEY_PID)) {
+      n++;
+    }
+  }
+  launch_data_free(jobs);
+  return n;
+}
+
+static double cpu_ms(void) {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e3
+    + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e3;
+}
+
+int main(int argc, char **argv) {
+  unsigned long jobs = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000;
+  const char *seconds = argc > 2 ? argv[2] : "2";
+
+  int err = launch_transport_supervise();
+  if (err) {
+    fprintf(stderr, "supervisor: %s\n", strerror(err));
+    return 1;
+  }
+
+  uint64_t start = now_ns();
+  for (unsigned long i = 0; i < jobs; i++) {
+    if ((err = submit(i, seconds))) {
+      fprintf(stderr, "submit %lu: %s\n", i, strerror(err));
+      return 1;
+    }
+  }
+  uint64_t submitted = now_ns();
+  uint64_t list_ns;
+  unsigned long left = running(&list_ns);
+  printf("%lu jobs: submit %.1f us/job, ALLJOBS %.2f ms with %lu running\n",
+    jobs, (double)(submitted - start) / 1e3 / jobs,
+    list_ns / 1e6, left);
+
+  // Sleep through the jobs' lifetime and see what the process spent
+  double cpu = cpu_ms();
+  sleep((unsigned)atoi(seconds));
+  while ((left = running(&list_ns)) > 0) {
+    usleep(10000);
+  }
+  uint64_t done = now_ns();
+  printf("all exited %.1f ms after the last submit, %.1f ms CPU while waiting\n",
+    (done - submitted) / 1e6, cpu_ms() - cpu);
+  return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * system_context.c
+ * Per-call cost of setup_system_context(), before and after it became a
+ * once-per-process step
+ *
+ * Both variants mirror liblaunchctl.c against a stubbed bootstrap layer:
+ * every stubbed bootstrap_parent() or task_set_bootstrap_port() call
+ * burns `ipc` nanoseconds, standing in for a mach round trip, so this
+ * runs anywhere without launchd or root.
+ *
+ *     cc -O2 -pthread bench/system_context.c -o system_context
+ *     ./system_context [threads] [calls per thread] [ipc ns]
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef unsigned int mach_port_t;
+
+static uint64_t ipc_ns = 2000;
+static mach_port_t bootstrap_port = 1;
+static volatile unsigned long bootstrap_calls = 0;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void ipc(void) {
+  uint64_t end = now_ns() + ipc_ns;
+  __sync_fetch_and_add(&bootstrap_calls, 1);
+  while (now_ns() < end) {
+  }
+}
+
+/* Stubbed bootstrap layer: the root bootstrap is two levels up */
+static int bootstrap_parent(mach_port_t bp, mach_port_t *parent) {
+  ipc();
+  *parent = bp > 1 ? bp - 1 : 1;
+  return 0;
+}
+
+static void task_set_bootstrap_port(mach_port_t port) {
+  ipc();
+  bootstrap_port = port;
+}
+
+static mach_port_t str2bsport(const char *s) {
+  mach_port_t last, bport = bootstrap_port + 2;
+  (void)s;
+  do {
+    last = bport;
+    bootstrap_parent(last, &bport);
+  } while (bport != last);
+  return bport;
+}
+
+/* Before: the whole context is re-established on every call */
+static void setup_per_call(void) {
+  if (getenv("LAUNCHD_SOCKET")) {
+    return;
+  }
+  if (getenv("LaunchKeepContext")) {
+    return;
+  }
+  setenv("__USE_SYSTEM_LAUNCHD", "1", 0);
+  mach_port_t rootbs = str2bsport("/");
+  task_set_bootstrap_port(rootbs);
+}
+
+/* After: pthread_once around the same steps */
+static pthread_once_t context_once = PTHREAD_ONCE_INIT;
+
+static void setup_once(void) {
+  pthread_once(&context_once, setup_per_call);
+}
+
+struct run {
+  void (*setup)(void);
+  unsigned long calls;
+};
+
+static void *worker(void *arg) {
+  struct run *r = arg;
+  for (unsigned long i = 0; i < r->calls; i++) {
+    r->setup();
+  }
+  return NULL;
+}
+
+static void measure(const char *name, void (*setup)(void), int threads, unsigned long calls) {
+  pthread_t *tids = calloc((size_t)threads, sizeof(pthread_t));
+  struct run r = { setup, calls };
+  bootstrap_calls = 0;
+  uint64_t start = now_ns();
+  for (int i = 0; i < threads; i++) {
+    pthread_create(&tids[i], NULL, worker, &r);
+  }
+  for (int i = 0; i < threads; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  uint64_t elapsed = now_ns() - start;
+  double total = (double)threads * (double)calls;
+  printf("%-9s %10.1f ns/call %12lu bootstrap calls\n",
+    name, (double)elapsed * threads / total, bootstrap_calls);
+  free(tids);
+}
+
+int main(int argc, char **argv) {
+  int threads = argc > 1 ? atoi(argv[1]) : 4;
+  unsigned long calls = argc > 2 ? strtoul(argv[2], NULL, 10) : 20000;
+  if (argc > 3) {
+    ipc_ns = strtoull(argv[3], NULL, 10);
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+  unsetenv("__USE_SYSTEM_LAUNCHD");
+  printf("%d threads, %lu calls each, %llu ns per stubbed bootstrap call\n",
+    threads, calls, (unsigned long long)ipc_ns);
+  measure("per-call", setup_per_call, threads, calls);
+  measure("once", setup_once, threads, calls);
+  return 0;
+}
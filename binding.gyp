@@ -2,7 +2,7 @@
   "targets": [
     {
       "target_name": "bindings",
-      "sources": ['src/bindings.cc', "src/launchctl.cc"],
+      "sources": ['src/bindings.cc', "src/launchctl.cc", "src/lazy.cc", "src/synthetic.cc", "src/filter.cc", "src/cursor.cc", "src/changes.cc", "src/executor.cc", "src/coalesce.cc", "src/control.cc"],
       "conditions": [
         ['OS=="mac"', {
           "defines": [ '__MACOSX_CORE__' ],
@@ -25,8 +25,22 @@
               '-framework CoreFoundation'
             ]
           }
+        }, {
+          "dependencies": [
+            'deps/liblaunchctl/binding.gyp:launchctl'
+          ],
+          "include_dirs": [
+            "<!(node -e \"require('nan')\")"
+          ]
         }]
       ]
+    },
+    {
+      "target_name": "standin",
+      "type": "none",
+      "dependencies": [
+        'deps/liblaunchctl/binding.gyp:launchd-standin'
+      ]
     }
   ]
 }
@@ -3,7 +3,7 @@
     {
       "target_name": "launchctl",
           "product_prefix": "lib",
-      "sources": ["liblaunchctl/liblaunchctl.c"],
+      "sources": ["liblaunchctl/liblaunchctl.c", "liblaunchctl/launch_data_codec.c", "liblaunchctl/launch_transport.c", "liblaunchctl/launch_data_portable.c", "liblaunchctl/launch_supervisor.c", "liblaunchctl/launch_socket.c", "liblaunchctl/launch_fake.c"],
       'type': 'static_library',
       "conditions": [
         ['OS=="mac"', {
@@ -12,6 +12,30 @@
           'xcode_settings': {
             'MACOSX_DEPLOYMENT_TARGET': '10.7'
           }
+        }, {
+          # No liblaunch: compat/launch.h selects launch_data_portable.c
+          "include_dirs": [ 'compat', 'liblaunchctl' ],
+          "direct_dependent_settings": {
+            "include_dirs": [ 'compat', 'liblaunchctl' ]
+          },
+          'libraries': [ '-lpthread', '-lm' ]
+        }]
+      ]
+    },
+    {
+      # Serves the socket transport, see standin/launchd_standin.c
+      "target_name": "launchd-standin",
+      "type": "executable",
+      "sources": ["standin/launchd_standin.c"],
+      "dependencies": [ 'launchctl' ],
+      "include_dirs": [ 'liblaunchctl' ],
+      "conditions": [
+        ['OS=="mac"', {
+          'xcode_settings': {
+            'MACOSX_DEPLOYMENT_TARGET': '10.7'
+          }
+        }, {
+          'libraries': [ '-lpthread' ]
         }]
       ]
     }
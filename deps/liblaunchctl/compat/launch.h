@@ -0,0 +1,200 @@
+/*
+ * launch.h
+ * Stand-in for <launch.h> where Apple's liblaunch is not available
+ *
+ * Declares the same launch_data API, implemented by
+ * liblaunchctl/launch_data_portable.c, along with the public keys used by
+ * liblaunchctl. Only put on the include path for builds without launchd.
+ * LAUNCH_DATA_PORTABLE tells the sources which implementation they get.
+ */
+
+#ifndef __LAUNCH_H__
+#define __LAUNCH_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+#define LAUNCH_DATA_PORTABLE 1
+
+__BEGIN_DECLS
+
+#define LAUNCH_KEY_SUBMITJOB "SubmitJob"
+#define LAUNCH_KEY_REMOVEJOB "RemoveJob"
+#define LAUNCH_KEY_STARTJOB "StartJob"
+#define LAUNCH_KEY_STOPJOB "StopJob"
+#define LAUNCH_KEY_GETJOB "GetJob"
+#define LAUNCH_KEY_GETJOBS "GetJobs"
+#define LAUNCH_KEY_CHECKIN "CheckIn"
+
+#define LAUNCH_JOBKEY_LABEL "Label"
+#define LAUNCH_JOBKEY_DISABLED "Disabled"
+#define LAUNCH_JOBKEY_USERNAME "UserName"
+#define LAUNCH_JOBKEY_GROUPNAME "GroupName"
+#define LAUNCH_JOBKEY_TIMEOUT "TimeOut"
+#define LAUNCH_JOBKEY_EXITTIMEOUT "ExitTimeOut"
+#define LAUNCH_JOBKEY_INITGROUPS "InitGroups"
+#define LAUNCH_JOBKEY_SOCKETS "Sockets"
+#define LAUNCH_JOBKEY_MACHSERVICES "MachServices"
+#define LAUNCH_JOBKEY_MACHSERVICELOOKUPPOLICIES "MachServiceLookupPolicies"
+#define LAUNCH_JOBKEY_INETDCOMPATIBILITY "inetdCompatibility"
+#define LAUNCH_JOBKEY_ENABLEGLOBBING "EnableGlobbing"
+#define LAUNCH_JOBKEY_PROGRAMARGUMENTS "ProgramArguments"
+#define LAUNCH_JOBKEY_PROGRAM "Program"
+#define LAUNCH_JOBKEY_ONDEMAND "OnDemand"
+#define LAUNCH_JOBKEY_KEEPALIVE "KeepAlive"
+#define LAUNCH_JOBKEY_LIMITLOADTOHOSTS "LimitLoadToHosts"
+#define LAUNCH_JOBKEY_LIMITLOADFROMHOSTS "LimitLoadFromHosts"
+#define LAUNCH_JOBKEY_LIMITLOADTOSESSIONTYPE "LimitLoadToSessionType"
+#define LAUNCH_JOBKEY_LIMITLOADTOHARDWARE "LimitLoadToHardware"
+#define LAUNCH_JOBKEY_LIMITLOADFROMHARDWARE "LimitLoadFromHardware"
+#define LAUNCH_JOBKEY_RUNATLOAD "RunAtLoad"
+#define LAUNCH_JOBKEY_ROOTDIRECTORY "RootDirectory"
+#define LAUNCH_JOBKEY_WORKINGDIRECTORY "WorkingDirectory"
+#define LAUNCH_JOBKEY_ENVIRONMENTVARIABLES "EnvironmentVariables"
+#define LAUNCH_JOBKEY_USERENVIRONMENTVARIABLES "UserEnvironmentVariables"
+#define LAUNCH_JOBKEY_UMASK "Umask"
+#define LAUNCH_JOBKEY_NICE "Nice"
+#define LAUNCH_JOBKEY_HOPEFULLYEXITSFIRST "HopefullyExitsFirst"
+#define LAUNCH_JOBKEY_HOPEFULLYEXITSLAST "HopefullyExitsLast"
+#define LAUNCH_JOBKEY_LOWPRIORITYIO "LowPriorityIO"
+#define LAUNCH_JOBKEY_SESSIONCREATE "SessionCreate"
+#define LAUNCH_JOBKEY_STARTONMOUNT "StartOnMount"
+#define LAUNCH_JOBKEY_SOFTRESOURCELIMITS "SoftResourceLimits"
+#define LAUNCH_JOBKEY_HARDRESOURCELIMITS "HardResourceLimits"
+#define LAUNCH_JOBKEY_STANDARDINPATH "StandardInPath"
+#define LAUNCH_JOBKEY_STANDARDOUTPATH "StandardOutPath"
+#define LAUNCH_JOBKEY_STANDARDERRORPATH "StandardErrorPath"
+#define LAUNCH_JOBKEY_DEBUG "Debug"
+#define LAUNCH_JOBKEY_WAITFORDEBUGGER "WaitForDebugger"
+#define LAUNCH_JOBKEY_QUEUEDIRECTORIES "QueueDirectories"
+#define LAUNCH_JOBKEY_WATCHPATHS "WatchPaths"
+#define LAUNCH_JOBKEY_STARTINTERVAL "StartInterval"
+#define LAUNCH_JOBKEY_STARTCALENDARINTERVAL "StartCalendarInterval"
+#define LAUNCH_JOBKEY_BONJOURFDS "BonjourFDs"
+#define LAUNCH_JOBKEY_LASTEXITSTATUS "LastExitStatus"
+#define LAUNCH_JOBKEY_PID "PID"
+#define LAUNCH_JOBKEY_THROTTLEINTERVAL "ThrottleInterval"
+#define LAUNCH_JOBKEY_LAUNCHONLYONCE "LaunchOnlyOnce"
+#define LAUNCH_JOBKEY_ABANDONPROCESSGROUP "AbandonProcessGroup"
+#define LAUNCH_JOBKEY_IGNOREPROCESSGROUPATSHUTDOWN "IgnoreProcessGroupAtShutdown"
+#define LAUNCH_JOBKEY_POLICIES "Policies"
+#define LAUNCH_JOBKEY_ENABLETRANSACTIONS "EnableTransactions"
+#define LAUNCH_JOBKEY_LAUNCHEVENTS "LaunchEvents"
+
+#define LAUNCH_JOBKEY_DISABLED_MACHINETYPE "MachineType"
+#define LAUNCH_JOBKEY_DISABLED_MODELNAME "ModelName"
+
+#define LAUNCH_JOBKEY_KEEPALIVE_SUCCESSFULEXIT "SuccessfulExit"
+#define LAUNCH_JOBKEY_KEEPALIVE_NETWORKSTATE "NetworkState"
+#define LAUNCH_JOBKEY_KEEPALIVE_PATHSTATE "PathState"
+#define LAUNCH_JOBKEY_KEEPALIVE_OTHERJOBACTIVE "OtherJobActive"
+#define LAUNCH_JOBKEY_KEEPALIVE_OTHERJOBENABLED "OtherJobEnabled"
+
+#define LAUNCH_JOBSOCKETKEY_TYPE "SockType"
+#define LAUNCH_JOBSOCKETKEY_PASSIVE "SockPassive"
+#define LAUNCH_JOBSOCKETKEY_BONJOUR "Bonjour"
+#define LAUNCH_JOBSOCKETKEY_SECUREWITHKEY "SecureSocketWithKey"
+#define LAUNCH_JOBSOCKETKEY_PATHNAME "SockPathName"
+#define LAUNCH_JOBSOCKETKEY_PATHMODE "SockPathMode"
+#define LAUNCH_JOBSOCKETKEY_NODENAME "SockNodeName"
+#define LAUNCH_JOBSOCKETKEY_SERVICENAME "SockServiceName"
+#define LAUNCH_JOBSOCKETKEY_FAMILY "SockFamily"
+#define LAUNCH_JOBSOCKETKEY_PROTOCOL "SockProtocol"
+#define LAUNCH_JOBSOCKETKEY_MULTICASTGROUP "MulticastGroup"
+
+typedef unsigned int mach_port_t;
+#define MACH_PORT_NULL ((mach_port_t)0)
+
+typedef struct _launch_data *launch_data_t;
+
+typedef enum {
+  LAUNCH_DATA_DICTIONARY = 1,
+  LAUNCH_DATA_ARRAY,
+  LAUNCH_DATA_FD,
+  LAUNCH_DATA_INTEGER,
+  LAUNCH_DATA_REAL,
+  LAUNCH_DATA_BOOL,
+  LAUNCH_DATA_STRING,
+  LAUNCH_DATA_OPAQUE,
+  LAUNCH_DATA_ERRNO,
+  LAUNCH_DATA_MACHPORT
+} launch_data_type_t;
+
+// Same layout as liblaunch's, which liblaunchctl.h mirrors for Apple builds
+struct _launch_data {
+  uint64_t type;
+  union {
+    struct {
+      union {
+        launch_data_t *_array;
+        char *string;
+        void *opaque;
+        int64_t __junk;
+      };
+      union {
+        uint64_t _array_cnt;
+        uint64_t string_len;
+        uint64_t opaque_size;
+      };
+    };
+    int64_t fd;
+    uint64_t mp;
+    uint64_t err;
+    int64_t number;
+    uint64_t boolean;
+    double float_num;
+  };
+};
+
+launch_data_t launch_data_alloc(launch_data_type_t type);
+launch_data_t launch_data_copy(launch_data_t o);
+launch_data_type_t launch_data_get_type(launch_data_t o);
+void launch_data_free(launch_data_t o);
+
+bool launch_data_dict_insert(launch_data_t dict, launch_data_t what, const char *key);
+launch_data_t launch_data_dict_lookup(launch_data_t dict, const char *key);
+bool launch_data_dict_remove(launch_data_t dict, const char *key);
+void launch_data_dict_iterate(launch_data_t dict,
+  void (*iterator)(launch_data_t what, const char *key, void *context), void *context);
+size_t launch_data_dict_get_count(launch_data_t dict);
+
+bool launch_data_array_set_index(launch_data_t array, launch_data_t what, size_t index);
+launch_data_t launch_data_array_get_index(launch_data_t array, size_t index);
+size_t launch_data_array_get_count(launch_data_t array);
+
+launch_data_t launch_data_new_fd(int fd);
+launch_data_t launch_data_new_machport(mach_port_t val);
+launch_data_t launch_data_new_integer(long long val);
+launch_data_t launch_data_new_bool(bool val);
+launch_data_t launch_data_new_real(double val);
+launch_data_t launch_data_new_string(const char *val);
+launch_data_t launch_data_new_opaque(const void *bytes, size_t size);
+launch_data_t launch_data_new_errno(int e);
+
+bool launch_data_set_fd(launch_data_t o, int fd);
+bool launch_data_set_machport(launch_data_t o, mach_port_t mp);
+bool launch_data_set_integer(launch_data_t o, long long val);
+bool launch_data_set_bool(launch_data_t o, bool val);
+bool launch_data_set_real(launch_data_t o, double val);
+bool launch_data_set_string(launch_data_t o, const char *val);
+bool launch_data_set_opaque(launch_data_t o, const void *bytes, size_t size);
+bool launch_data_set_errno(launch_data_t o, int e);
+
+int launch_data_get_fd(launch_data_t o);
+mach_port_t launch_data_get_machport(launch_data_t o);
+long long launch_data_get_integer(launch_data_t o);
+bool launch_data_get_bool(launch_data_t o);
+double launch_data_get_real(launch_data_t o);
+const char *launch_data_get_string(launch_data_t o);
+void *launch_data_get_opaque(launch_data_t o);
+size_t launch_data_get_opaque_size(launch_data_t o);
+int launch_data_get_errno(launch_data_t o);
+
+// Without launchd this fails with ENOTSUP, see launch_transport.h
+launch_data_t launch_msg(launch_data_t request);
+
+__END_DECLS
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ * vproc.h
+ * Stand-in for <vproc.h> where Apple's liblaunch is not available
+ *
+ * The vproc_swap_*() calls declared in vproc_priv.h fail with ENOTSUP in
+ * builds without launchd, see launch_transport.h
+ */
+
+#ifndef __VPROC_H__
+#define __VPROC_H__
+
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+typedef void *vproc_err_t;
+typedef struct vproc_s *vproc_t;
+
+__END_DECLS
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * launch_data_arena.h
+ * Bump allocation of launch_data_t trees
+ *
+ * While an arena is in use on a thread, every launch_data_alloc(),
+ * launch_data_new_*(), launch_data_copy() and launch_data_decode() made
+ * there takes its node, child array and string from the arena's chunks
+ * instead of one malloc() each. launch_data_free() of an arena node does
+ * nothing; launch_data_arena_reset() or _destroy() drops every node at
+ * once, touching only the chunks.
+ *
+ * An arena tree must not own heap nodes: they would leak when the arena is
+ * reset. A heap tree may hold arena nodes, launch_data_free() skips them.
+ * Arena nodes must not be handed to anything that frees them behind
+ * liblaunch's back, such as Apple's launch_msg() replies.
+ *
+ * Arenas need the portable launch_data implementation (compat/launch.h).
+ * With Apple's liblaunch launch_data_arena_create() returns NULL and a
+ * NULL arena means plain heap allocation, so callers need no #ifdefs.
+ */
+
+#ifndef LAUNCH_DATA_ARENA_H
+#define LAUNCH_DATA_ARENA_H
+
+#include <stddef.h>
+#include <launch.h>
+
+typedef struct launch_data_arena *launch_data_arena_t;
+
+/*!
+ @function launch_data_arena_create
+ @param chunk_size
+  Bytes per chunk, 0 for 64KB. Larger requests get a chunk of their own
+ @return The arena, or NULL where arenas are unavailable or out of memory
+ */
+launch_data_arena_t launch_data_arena_create(size_t chunk_size);
+
+/*!
+ @function launch_data_arena_reset
+ @discussion Drops every node, keeping one chunk for reuse
+ */
+void launch_data_arena_reset(launch_data_arena_t arena);
+
+/*!
+ @function launch_data_arena_destroy
+ @discussion Drops every node and frees the chunks. If the arena is in use
+  on this thread, the thread goes back to heap allocation
+ */
+void launch_data_arena_destroy(launch_data_arena_t arena);
+
+/*!
+ @function launch_data_arena_use
+ @discussion Makes arena (NULL for the heap) the calling thread's allocator
+ @return The one it replaces, to restore afterwards
+ */
+launch_data_arena_t launch_data_arena_use(launch_data_arena_t arena);
+
+/*!
+ @function launch_data_arena_size
+ @return Bytes of chunks the arena holds
+ */
+size_t launch_data_arena_size(launch_data_arena_t arena);
+
+#endif
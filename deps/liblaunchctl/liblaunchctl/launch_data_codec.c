@@ -0,0 +1,267 @@
+//
+//  launch_data_codec.c
+//  liblaunchctl
+//
+//  See launch_data_codec.h for the encoding
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "liblaunchctl.h"
+#include "launch_data_codec.h"
+
+static int buf_reserve(struct launch_data_buf *buf, size_t n) {
+  if (buf->len + n <= buf->cap) {
+    return 0;
+  }
+  size_t cap = buf->cap ? buf->cap : 4096;
+  while (cap < buf->len + n) {
+    cap *= 2;
+  }
+  char *data = realloc(buf->data, cap);
+  if (data == NULL) {
+    return ENOMEM;
+  }
+  buf->data = data;
+  buf->cap = cap;
+  return 0;
+}
+
+static int buf_put(struct launch_data_buf *buf, const void *p, size_t n) {
+  if (buf_reserve(buf, n)) {
+    return ENOMEM;
+  }
+  memcpy(buf->data + buf->len, p, n);
+  buf->len += n;
+  return 0;
+}
+
+static int buf_tag(struct launch_data_buf *buf, char tag) {
+  return buf_put(buf, &tag, 1);
+}
+
+static int buf_u32(struct launch_data_buf *buf, uint32_t v) {
+  return buf_put(buf, &v, sizeof(v));
+}
+
+// Strings are written with their NUL so decoders can use them in place
+static int buf_string(struct launch_data_buf *buf, const char *s, size_t len) {
+  if (buf_u32(buf, (uint32_t)len)) {
+    return ENOMEM;
+  }
+  if (buf_reserve(buf, len + 1)) {
+    return ENOMEM;
+  }
+  memcpy(buf->data + buf->len, s, len);
+  buf->data[buf->len + len] = '\0';
+  buf->len += len + 1;
+  return 0;
+}
+
+static int encode(launch_data_t obj, struct launch_data_buf *buf, size_t depth, size_t max_depth) {
+  size_t i;
+  if (obj == NULL) {
+    return EMALFORM;
+  }
+  switch (launch_data_get_type(obj)) {
+    case LAUNCH_DATA_STRING: {
+      const char *s = launch_data_get_string(obj);
+      if (buf_tag(buf, LD_TAG_STRING)) return ENOMEM;
+      return buf_string(buf, s, strlen(s));
+    }
+    case LAUNCH_DATA_INTEGER: {
+      int64_t v = launch_data_get_integer(obj);
+      if (buf_tag(buf, LD_TAG_INTEGER)) return ENOMEM;
+      return buf_put(buf, &v, sizeof(v));
+    }
+    case LAUNCH_DATA_REAL: {
+      double v = launch_data_get_real(obj);
+      if (buf_tag(buf, LD_TAG_REAL)) return ENOMEM;
+      return buf_put(buf, &v, sizeof(v));
+    }
+    case LAUNCH_DATA_BOOL: {
+      uint8_t v = launch_data_get_bool(obj) ? 1 : 0;
+      if (buf_tag(buf, LD_TAG_BOOL)) return ENOMEM;
+      return buf_put(buf, &v, sizeof(v));
+    }
+    case LAUNCH_DATA_ERRNO: {
+      int32_t v = launch_data_get_errno(obj);
+      if (buf_tag(buf, LD_TAG_ERRNO)) return ENOMEM;
+      return buf_put(buf, &v, sizeof(v));
+    }
+    case LAUNCH_DATA_OPAQUE: {
+      size_t n = launch_data_get_opaque_size(obj);
+      if (buf_tag(buf, LD_TAG_OPAQUE) || buf_u32(buf, (uint32_t)n)) return ENOMEM;
+      return buf_put(buf, launch_data_get_opaque(obj), n);
+    }
+    case LAUNCH_DATA_FD:
+      return buf_tag(buf, LD_TAG_FD);
+    case LAUNCH_DATA_MACHPORT:
+      return buf_tag(buf, LD_TAG_MACHPORT);
+    case LAUNCH_DATA_ARRAY: {
+      if (depth >= max_depth) {
+        return EMAXDEPTH;
+      }
+      size_t count = obj->_array_cnt;
+      if (buf_tag(buf, LD_TAG_ARRAY) || buf_u32(buf, (uint32_t)count)) return ENOMEM;
+      for (i=0; i<count; i++) {
+        int r = encode(obj->_array[i], buf, depth + 1, max_depth);
+        if (r) return r;
+      }
+      return 0;
+    }
+    case LAUNCH_DATA_DICTIONARY: {
+      if (depth >= max_depth) {
+        return EMAXDEPTH;
+      }
+      size_t count = obj->_array_cnt;
+      if (count % 2) {
+        return EMALFORM;
+      }
+      if (buf_tag(buf, LD_TAG_DICTIONARY) || buf_u32(buf, (uint32_t)(count / 2))) return ENOMEM;
+      for (i=0; i<count; i+=2) {
+        launch_data_t k = obj->_array[i];
+        if (k == NULL || launch_data_get_type(k) != LAUNCH_DATA_STRING) {
+          return EMALFORM;
+        }
+        if (buf_string(buf, k->string, strlen(k->string))) return ENOMEM;
+        int r = encode(obj->_array[i+1], buf, depth + 1, max_depth);
+        if (r) return r;
+      }
+      return 0;
+    }
+    default:
+      return EMALFORM;
+  }
+}
+
+int launch_data_encode(launch_data_t obj, struct launch_data_buf *buf, size_t max_depth) {
+  return encode(obj, buf, 0, max_depth);
+}
+
+// Hard bound for decoding, so corrupt input cannot exhaust the stack
+#define DECODE_MAX_DEPTH 256
+
+struct reader {
+  const char *p;
+  const char *end;
+};
+
+static int rd(struct reader *r, void *out, size_t n) {
+  if ((size_t)(r->end - r->p) < n) {
+    return -1;
+  }
+  memcpy(out, r->p, n);
+  r->p += n;
+  return 0;
+}
+
+// Returns a pointer to a NUL terminated string inside the input
+static const char *rd_string(struct reader *r) {
+  uint32_t len;
+  if (rd(r, &len, sizeof(len)) || (size_t)(r->end - r->p) < (size_t)len + 1 || r->p[len] != '\0') {
+    return NULL;
+  }
+  const char *s = r->p;
+  r->p += len + 1;
+  return s;
+}
+
+static launch_data_t decode(struct reader *r, size_t depth) {
+  char tag;
+  uint32_t i, count;
+  if (depth >= DECODE_MAX_DEPTH || rd(r, &tag, 1)) {
+    return NULL;
+  }
+  switch (tag) {
+    case LD_TAG_STRING: {
+      const char *s = rd_string(r);
+      return s ? launch_data_new_string(s) : NULL;
+    }
+    case LD_TAG_INTEGER: {
+      int64_t v;
+      return rd(r, &v, sizeof(v)) ? NULL : launch_data_new_integer(v);
+    }
+    case LD_TAG_REAL: {
+      double v;
+      return rd(r, &v, sizeof(v)) ? NULL : launch_data_new_real(v);
+    }
+    case LD_TAG_BOOL: {
+      uint8_t v;
+      return rd(r, &v, sizeof(v)) ? NULL : launch_data_new_bool(v != 0);
+    }
+    case LD_TAG_ERRNO: {
+      int32_t v;
+      return rd(r, &v, sizeof(v)) ? NULL : launch_data_new_errno(v);
+    }
+    case LD_TAG_OPAQUE: {
+      uint32_t n;
+      if (rd(r, &n, sizeof(n)) || (size_t)(r->end - r->p) < n) {
+        return NULL;
+      }
+      launch_data_t o = launch_data_new_opaque(r->p, n);
+      r->p += n;
+      return o;
+    }
+    case LD_TAG_FD:
+      return launch_data_new_fd(-1);
+    case LD_TAG_MACHPORT:
+      return launch_data_new_machport(0);
+    case LD_TAG_ARRAY: {
+      if (rd(r, &count, sizeof(count))) {
+        return NULL;
+      }
+      launch_data_t a = launch_data_alloc(LAUNCH_DATA_ARRAY);
+      for (i=0; i<count; i++) {
+        launch_data_t v = decode(r, depth + 1);
+        if (v == NULL) {
+          launch_data_free(a);
+          return NULL;
+        }
+        launch_data_array_set_index(a, v, i);
+      }
+      return a;
+    }
+    case LD_TAG_DICTIONARY: {
+      if (rd(r, &count, sizeof(count))) {
+        return NULL;
+      }
+      launch_data_t d = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+      for (i=0; i<count; i++) {
+        const char *k = rd_string(r);
+        launch_data_t v = k ? decode(r, depth + 1) : NULL;
+        if (v == NULL) {
+          launch_data_free(d);
+          return NULL;
+        }
+        launch_data_dict_insert(d, v, k);
+      }
+      return d;
+    }
+    default:
+      return NULL;
+  }
+}
+
+launch_data_t launch_data_decode(const char *data, size_t len, size_t *used) {
+  struct reader r = { data, data + len };
+  launch_data_t obj = decode(&r, 0);
+  if (obj == NULL) {
+    errno = EMALFORM;
+    return NULL;
+  }
+  if (used) {
+    *used = (size_t)(r.p - data);
+  }
+  return obj;
+}
+
+void launch_data_buf_free(struct launch_data_buf *buf) {
+  if (buf->data) {
+    free(buf->data);
+  }
+  buf->data = NULL;
+  buf->len = 0;
+  buf->cap = 0;
+}
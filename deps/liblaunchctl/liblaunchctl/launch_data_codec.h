@@ -0,0 +1,74 @@
+/*
+ * launch_data_codec.h
+ * Compact binary encoding of launch_data_t trees
+ *
+ * Every value is a one byte tag followed by its payload. Integers are
+ * written in host byte order since the encoding never leaves the machine.
+ *
+ *   'S' string      u32 length, bytes, NUL
+ *   'I' integer     i64
+ *   'R' real        f64
+ *   'B' bool        u8
+ *   'E' errno       i32
+ *   'O' opaque      u32 length, bytes
+ *   'F' fd          (no payload)
+ *   'M' machport    (no payload)
+ *   'A' array       u32 count, count values
+ *   'D' dictionary  u32 count, count (u32 length, key bytes, NUL, value) pairs
+ *
+ * Strings and keys keep their NUL so a decoder can hand them out in place.
+ */
+
+#ifndef LAUNCH_DATA_CODEC_H
+#define LAUNCH_DATA_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <launch.h>
+
+#define LD_TAG_STRING 'S'
+#define LD_TAG_INTEGER 'I'
+#define LD_TAG_REAL 'R'
+#define LD_TAG_BOOL 'B'
+#define LD_TAG_ERRNO 'E'
+#define LD_TAG_OPAQUE 'O'
+#define LD_TAG_FD 'F'
+#define LD_TAG_MACHPORT 'M'
+#define LD_TAG_ARRAY 'A'
+#define LD_TAG_DICTIONARY 'D'
+
+struct launch_data_buf {
+  char *data;
+  size_t len;
+  size_t cap;
+};
+
+/*!
+ @function launch_data_encode
+ @discussion Appends the encoding of obj to buf, growing it as needed
+ @param obj
+  The tree to encode
+ @param buf
+  Destination buffer (zero it before first use, release with launch_data_buf_free)
+ @param max_depth
+  Deepest nesting of arrays and dictionaries accepted
+ @return 0, EMALFORM, EMAXDEPTH or ENOMEM
+ */
+int launch_data_encode(launch_data_t obj, struct launch_data_buf *buf, size_t max_depth);
+
+/*!
+ @function launch_data_decode
+ @discussion Rebuilds a launch_data_t tree from its encoding
+ @param data
+  Encoded bytes
+ @param len
+  Number of encoded bytes
+ @param used
+  Set to the number of bytes consumed (may be NULL)
+ @return launch_data_t (free with launch_data_free), or NULL with errno set
+ */
+launch_data_t launch_data_decode(const char *data, size_t len, size_t *used);
+
+void launch_data_buf_free(struct launch_data_buf *buf);
+
+#endif
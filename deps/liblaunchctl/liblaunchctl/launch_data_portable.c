@@ -0,0 +1,643 @@
+//
+//  launch_data_portable.c
+//  liblaunchctl
+//
+//  launch_data_t for builds without Apple's liblaunch (see compat/launch.h),
+//  and the arenas of launch_data_arena.h
+//
+//  Nodes keep liblaunch's layout, so code walking _array / _array_cnt works
+//  the same on both. Dictionaries are flat key, value arrays as in
+//  liblaunch, scanned when small and hash indexed once they hold
+//  DICT_INDEX_MIN pairs, so an ALLJOBS reply with thousands of labels is
+//  not built in quadratic time.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "liblaunchctl.h"
+#include "launch_data_arena.h"
+
+#ifdef LAUNCH_DATA_PORTABLE
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+// Dictionaries with this many pairs get a hash index, smaller ones are
+// scanned like liblaunch does
+#define DICT_INDEX_MIN 16
+#define ALIGN(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+struct arena_chunk {
+  struct arena_chunk *next;
+  size_t size;
+  size_t used;
+};
+
+// Chunk payloads start this far into their allocation
+#define CHUNK_HEADER ALIGN(sizeof(struct arena_chunk))
+
+struct launch_data_arena {
+  // Allocations come from the first chunk
+  struct arena_chunk *chunks;
+  size_t chunk_size;
+  size_t bytes;
+};
+
+// A node as allocated here: liblaunch's layout, then our bookkeeping
+struct ld_node {
+  struct _launch_data d;
+  // Owner of the node, its child array and its string; NULL for the heap
+  launch_data_arena_t arena;
+  // Slots allocated in _array
+  size_t cap;
+  // Hash index of a large dictionary's keys, slot to pair number + 1 (0
+  // for empty). Only trusted while _array and _array_cnt are what it was
+  // built for, so code compacting a dictionary in place stays correct
+  uint32_t *index;
+  size_t index_cap;
+  launch_data_t *index_array;
+  size_t index_cnt;
+};
+
+#define NODE(o) ((struct ld_node *)(o))
+
+static __thread launch_data_arena_t current_arena = NULL;
+
+static struct arena_chunk *arena_chunk(size_t size) {
+  struct arena_chunk *c = malloc(CHUNK_HEADER + size);
+  if (c) {
+    c->next = NULL;
+    c->size = size;
+    c->used = 0;
+  }
+  return c;
+}
+
+static void *arena_alloc(launch_data_arena_t a, size_t n) {
+  n = ALIGN(n);
+  struct arena_chunk *c = a->chunks;
+  if (c == NULL || c->size - c->used < n) {
+    // Oversized requests get a chunk of their own behind the current one,
+    // which keeps serving small ones
+    int own = c != NULL && n > a->chunk_size / 4;
+    c = arena_chunk(n > a->chunk_size ? n : a->chunk_size);
+    if (c == NULL) {
+      return NULL;
+    }
+    a->bytes += c->size;
+    if (own) {
+      c->next = a->chunks->next;
+      a->chunks->next = c;
+    } else {
+      c->next = a->chunks;
+      a->chunks = c;
+    }
+  }
+  void *p = (char *)c + CHUNK_HEADER + c->used;
+  c->used += n;
+  return p;
+}
+
+launch_data_arena_t launch_data_arena_create(size_t chunk_size) {
+  launch_data_arena_t a = malloc(sizeof(*a));
+  if (a == NULL) {
+    return NULL;
+  }
+  a->chunks = NULL;
+  a->chunk_size = chunk_size ? ALIGN(chunk_size) : ARENA_CHUNK_SIZE;
+  a->bytes = 0;
+  return a;
+}
+
+void launch_data_arena_reset(launch_data_arena_t a) {
+  if (a == NULL) {
+    return;
+  }
+  struct arena_chunk *keep = NULL, *c = a->chunks;
+  while (c) {
+    struct arena_chunk *next = c->next;
+    if (keep == NULL && c->size == a->chunk_size) {
+      keep = c;
+    } else {
+      free(c);
+    }
+    c = next;
+  }
+  if (keep) {
+    keep->next = NULL;
+    keep->used = 0;
+  }
+  a->chunks = keep;
+  a->bytes = keep ? keep->size : 0;
+}
+
+void launch_data_arena_destroy(launch_data_arena_t a) {
+  if (a == NULL) {
+    return;
+  }
+  if (current_arena == a) {
+    current_arena = NULL;
+  }
+  struct arena_chunk *c = a->chunks;
+  while (c) {
+    struct arena_chunk *next = c->next;
+    free(c);
+    c = next;
+  }
+  free(a);
+}
+
+launch_data_arena_t launch_data_arena_use(launch_data_arena_t a) {
+  launch_data_arena_t prev = current_arena;
+  current_arena = a;
+  return prev;
+}
+
+size_t launch_data_arena_size(launch_data_arena_t a) {
+  return a ? a->bytes : 0;
+}
+
+#pragma mark Nodes
+
+static void *mem_alloc(launch_data_arena_t a, size_t n) {
+  return a ? arena_alloc(a, n) : malloc(n);
+}
+
+static void mem_free(launch_data_arena_t a, void *p) {
+  if (a == NULL) {
+    free(p);
+  }
+}
+
+static launch_data_t node_alloc(launch_data_arena_t a, launch_data_type_t type) {
+  struct ld_node *n = mem_alloc(a, sizeof(*n));
+  if (n == NULL) {
+    return NULL;
+  }
+  memset(n, 0, sizeof(*n));
+  n->d.type = type;
+  n->arena = a;
+  return &n->d;
+}
+
+// Makes room for need children, growing geometrically
+static bool reserve(launch_data_t o, size_t need) {
+  struct ld_node *n = NODE(o);
+  if (need <= n->cap) {
+    return true;
+  }
+  size_t cap = n->cap ? n->cap * 2 : 8;
+  while (cap < need) {
+    cap *= 2;
+  }
+  launch_data_t *array;
+  if (n->arena) {
+    array = arena_alloc(n->arena, cap * sizeof(*array));
+    if (array && o->_array_cnt) {
+      memcpy(array, o->_array, o->_array_cnt * sizeof(*array));
+    }
+  } else {
+    array = realloc(o->_array, cap * sizeof(*array));
+  }
+  if (array == NULL) {
+    return false;
+  }
+  o->_array = array;
+  n->cap = cap;
+  return true;
+}
+
+launch_data_t launch_data_alloc(launch_data_type_t type) {
+  return node_alloc(current_arena, type);
+}
+
+launch_data_type_t launch_data_get_type(launch_data_t o) {
+  return (launch_data_type_t)o->type;
+}
+
+void launch_data_free(launch_data_t o) {
+  if (o == NULL || NODE(o)->arena) {
+    return;
+  }
+  switch (o->type) {
+    case LAUNCH_DATA_ARRAY:
+    case LAUNCH_DATA_DICTIONARY:
+      for (size_t i=0; i<o->_array_cnt; i++) {
+        launch_data_free(o->_array[i]);
+      }
+      free(o->_array);
+      free(NODE(o)->index);
+      break;
+    case LAUNCH_DATA_STRING:
+      free(o->string);
+      break;
+    case LAUNCH_DATA_OPAQUE:
+      free(o->opaque);
+      break;
+    default:
+      break;
+  }
+  free(o);
+}
+
+launch_data_t launch_data_copy(launch_data_t o) {
+  launch_data_t r;
+  switch (o->type) {
+    case LAUNCH_DATA_ARRAY:
+    case LAUNCH_DATA_DICTIONARY:
+      r = launch_data_alloc((launch_data_type_t)o->type);
+      if (r == NULL || !reserve(r, o->_array_cnt)) {
+        launch_data_free(r);
+        return NULL;
+      }
+      for (size_t i=0; i<o->_array_cnt; i++) {
+        r->_array[i] = o->_array[i] ? launch_data_copy(o->_array[i]) : NULL;
+        r->_array_cnt = i + 1;
+        if (o->_array[i] && r->_array[i] == NULL) {
+          launch_data_free(r);
+          return NULL;
+        }
+      }
+      return r;
+    case LAUNCH_DATA_STRING:
+      return launch_data_new_string(o->string);
+    case LAUNCH_DATA_OPAQUE:
+      return launch_data_new_opaque(o->opaque, o->opaque_size);
+    default:
+      r = launch_data_alloc((launch_data_type_t)o->type);
+      if (r) {
+        r->number = o->number;
+      }
+      return r;
+  }
+}
+
+#pragma mark Dictionaries
+
+static uint64_t hash_key(const char *s) {
+  uint64_t h = 14695981039346656037ULL;
+  for (; *s; s++) {
+    h ^= (unsigned char)*s;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static void index_drop(launch_data_t dict) {
+  struct ld_node *n = NODE(dict);
+  mem_free(n->arena, n->index);
+  n->index = NULL;
+  n->index_cap = 0;
+}
+
+static bool index_valid(launch_data_t dict) {
+  struct ld_node *n = NODE(dict);
+  return n->index && n->index_array == dict->_array && n->index_cnt == dict->_array_cnt;
+}
+
+static void index_put(launch_data_t dict, size_t pair) {
+  struct ld_node *n = NODE(dict);
+  launch_data_t k = dict->_array[pair * 2];
+  if (k == NULL || k->type != LAUNCH_DATA_STRING) {
+    return;
+  }
+  size_t mask = n->index_cap - 1;
+  size_t slot = hash_key(k->string) & mask;
+  while (n->index[slot]) {
+    slot = (slot + 1) & mask;
+  }
+  n->index[slot] = (uint32_t)(pair + 1);
+}
+
+// Indexes every pair of dict, with room for `pairs` at half load
+static bool index_build(launch_data_t dict, size_t pairs) {
+  struct ld_node *n = NODE(dict);
+  size_t cap = 64;
+  while (cap < pairs * 2) {
+    cap *= 2;
+  }
+  uint32_t *index = mem_alloc(n->arena, cap * sizeof(*index));
+  if (index == NULL) {
+    return false;
+  }
+  memset(index, 0, cap * sizeof(*index));
+  index_drop(dict);
+  n->index = index;
+  n->index_cap = cap;
+  for (size_t p=0; p<dict->_array_cnt/2; p++) {
+    index_put(dict, p);
+  }
+  n->index_array = dict->_array;
+  n->index_cnt = dict->_array_cnt;
+  return true;
+}
+
+static ssize_t dict_find(launch_data_t dict, const char *key) {
+  size_t pairs = dict->_array_cnt / 2;
+  if (pairs >= DICT_INDEX_MIN && (index_valid(dict) || index_build(dict, pairs))) {
+    struct ld_node *n = NODE(dict);
+    size_t mask = n->index_cap - 1;
+    for (size_t slot = hash_key(key) & mask; n->index[slot]; slot = (slot + 1) & mask) {
+      size_t i = (n->index[slot] - 1) * 2;
+      if (strcmp(dict->_array[i]->string, key) == 0) {
+        return (ssize_t)i;
+      }
+    }
+    return -1;
+  }
+  for (size_t i=0; i+1<dict->_array_cnt; i+=2) {
+    if (strcmp(dict->_array[i]->string, key) == 0) {
+      return (ssize_t)i;
+    }
+  }
+  return -1;
+}
+
+bool launch_data_dict_insert(launch_data_t dict, launch_data_t what, const char *key) {
+  ssize_t i = dict_find(dict, key);
+  if (i >= 0) {
+    launch_data_free(dict->_array[i+1]);
+    dict->_array[i+1] = what;
+    return true;
+  }
+  // dict_find() just brought the index of a large dictionary up to date
+  bool indexed = index_valid(dict);
+  launch_data_t k = node_alloc(NODE(dict)->arena, LAUNCH_DATA_STRING);
+  if (k == NULL || !launch_data_set_string(k, key) || !reserve(dict, dict->_array_cnt + 2)) {
+    launch_data_free(k);
+    return false;
+  }
+  dict->_array[dict->_array_cnt++] = k;
+  dict->_array[dict->_array_cnt++] = what;
+  size_t pairs = dict->_array_cnt / 2;
+  if (indexed && pairs * 2 <= NODE(dict)->index_cap) {
+    index_put(dict, pairs - 1);
+    NODE(dict)->index_array = dict->_array;
+    NODE(dict)->index_cnt = dict->_array_cnt;
+  } else if (pairs >= DICT_INDEX_MIN) {
+    // Rebuilt on the next lookup if this fails
+    index_build(dict, pairs);
+  }
+  return true;
+}
+
+launch_data_t launch_data_dict_lookup(launch_data_t dict, const char *key) {
+  if (dict->type != LAUNCH_DATA_DICTIONARY) {
+    return NULL;
+  }
+  ssize_t i = dict_find(dict, key);
+  return i >= 0 ? dict->_array[i+1] : NULL;
+}
+
+bool launch_data_dict_remove(launch_data_t dict, const char *key) {
+  ssize_t i = dict_find(dict, key);
+  if (i < 0) {
+    return false;
+  }
+  launch_data_free(dict->_array[i]);
+  launch_data_free(dict->_array[i+1]);
+  memmove(&dict->_array[i], &dict->_array[i+2],
+    (dict->_array_cnt - (size_t)i - 2) * sizeof(launch_data_t));
+  dict->_array_cnt -= 2;
+  // Later pairs moved, rebuilt on the next lookup
+  index_drop(dict);
+  return true;
+}
+
+void launch_data_dict_iterate(launch_data_t dict,
+    void (*iterator)(launch_data_t, const char *, void *), void *context) {
+  if (dict->type != LAUNCH_DATA_DICTIONARY) {
+    return;
+  }
+  for (size_t i=0; i+1<dict->_array_cnt; i+=2) {
+    iterator(dict->_array[i+1], dict->_array[i]->string, context);
+  }
+}
+
+size_t launch_data_dict_get_count(launch_data_t dict) {
+  return dict->_array_cnt / 2;
+}
+
+#pragma mark Arrays
+
+bool launch_data_array_set_index(launch_data_t array, launch_data_t what, size_t index) {
+  if (index < array->_array_cnt) {
+    launch_data_free(array->_array[index]);
+  } else {
+    if (!reserve(array, index + 1)) {
+      return false;
+    }
+    memset(&array->_array[array->_array_cnt], 0,
+      (index + 1 - array->_array_cnt) * sizeof(launch_data_t));
+    array->_array_cnt = index + 1;
+  }
+  array->_array[index] = what;
+  return true;
+}
+
+launch_data_t launch_data_array_get_index(launch_data_t array, size_t index) {
+  return index < array->_array_cnt ? array->_array[index] : NULL;
+}
+
+size_t launch_data_array_get_count(launch_data_t array) {
+  return array->_array_cnt;
+}
+
+#pragma mark Values
+
+launch_data_t launch_data_new_fd(int fd) {
+  launch_data_t o = launch_data_alloc(LAUNCH_DATA_FD);
+  if (o) o->fd = fd;
+  return o;
+}
+
+launch_data_t launch_data_new_machport(mach_port_t val) {
+  launch_data_t o = launch_data_alloc(LAUNCH_DATA_MACHPORT);
+  if (o) o->mp = val;
+  return o;
+}
+
+launch_data_t launch_data_new_integer(long long val) {
+  launch_data_t o = launch_data_alloc(LAUNCH_DATA_INTEGER);
+  if (o) o->number = val;
+  return o;
+}
+
+launch_data_t launch_data_new_bool(bool val) {
+  launch_data_t o = launch_data_alloc(LAUNCH_DATA_BOOL);
+  if (o) o->boolean = val;
+  return o;
+}
+
+launch_data_t launch_data_new_real(double val) {
+  launch_data_t o = launch_data_alloc(LAUNCH_DATA_REAL);
+  if (o) o->float_num = val;
+  return o;
+}
+
+launch_data_t launch_data_new_string(const char *val) {
+  launch_data_t o = launch_data_alloc(LAUNCH_DATA_STRING);
+  if (o && !launch_data_set_string(o, val)) {
+    launch_data_free(o);
+    return NULL;
+  }
+  return o;
+}
+
+launch_data_t launch_data_new_opaque(const void *bytes, size_t size) {
+  launch_data_t o = launch_data_alloc(LAUNCH_DATA_OPAQUE);
+  if (o && !launch_data_set_opaque(o, bytes, size)) {
+    launch_data_free(o);
+    return NULL;
+  }
+  return o;
+}
+
+launch_data_t launch_data_new_errno(int e) {
+  launch_data_t o = launch_data_alloc(LAUNCH_DATA_ERRNO);
+  if (o) o->err = (uint64_t)e;
+  return o;
+}
+
+bool launch_data_set_fd(launch_data_t o, int fd) {
+  o->fd = fd;
+  return true;
+}
+
+bool launch_data_set_machport(launch_data_t o, mach_port_t mp) {
+  o->mp = mp;
+  return true;
+}
+
+bool launch_data_set_integer(launch_data_t o, long long val) {
+  o->number = val;
+  return true;
+}
+
+bool launch_data_set_bool(launch_data_t o, bool val) {
+  o->boolean = val;
+  return true;
+}
+
+bool launch_data_set_real(launch_data_t o, double val) {
+  o->float_num = val;
+  return true;
+}
+
+bool launch_data_set_string(launch_data_t o, const char *val) {
+  size_t len = strlen(val);
+  char *s = mem_alloc(NODE(o)->arena, len + 1);
+  if (s == NULL) {
+    return false;
+  }
+  memcpy(s, val, len + 1);
+  mem_free(NODE(o)->arena, o->string);
+  o->string = s;
+  o->string_len = len;
+  return true;
+}
+
+bool launch_data_set_opaque(launch_data_t o, const void *bytes, size_t size) {
+  void *p = mem_alloc(NODE(o)->arena, size ? size : 1);
+  if (p == NULL) {
+    return false;
+  }
+  if (size) {
+    memcpy(p, bytes, size);
+  }
+  mem_free(NODE(o)->arena, o->opaque);
+  o->opaque = p;
+  o->opaque_size = size;
+  return true;
+}
+
+bool launch_data_set_errno(launch_data_t o, int e) {
+  o->err = (uint64_t)e;
+  return true;
+}
+
+int launch_data_get_fd(launch_data_t o) {
+  return (int)o->fd;
+}
+
+mach_port_t launch_data_get_machport(launch_data_t o) {
+  return (mach_port_t)o->mp;
+}
+
+long long launch_data_get_integer(launch_data_t o) {
+  return o->number;
+}
+
+bool launch_data_get_bool(launch_data_t o) {
+  return o->boolean != 0;
+}
+
+double launch_data_get_real(launch_data_t o) {
+  return o->float_num;
+}
+
+const char *launch_data_get_string(launch_data_t o) {
+  return o->type == LAUNCH_DATA_STRING ? o->string : NULL;
+}
+
+void *launch_data_get_opaque(launch_data_t o) {
+  return o->opaque;
+}
+
+size_t launch_data_get_opaque_size(launch_data_t o) {
+  return o->opaque_size;
+}
+
+int launch_data_get_errno(launch_data_t o) {
+  return (int)o->err;
+}
+
+#pragma mark launchd
+
+// Without launchd the native transport has nothing to talk to
+
+static char unsupported;
+
+launch_data_t launch_msg(launch_data_t request) {
+  errno = ENOTSUP;
+  return NULL;
+}
+
+vproc_err_t vproc_swap_integer(vproc_t vp, vproc_gsk_t key, int64_t *inval, int64_t *outval) {
+  errno = ENOTSUP;
+  return (vproc_err_t)&unsupported;
+}
+
+vproc_err_t vproc_swap_string(vproc_t vp, vproc_gsk_t key, const char *instr, char **outstr) {
+  errno = ENOTSUP;
+  return (vproc_err_t)&unsupported;
+}
+
+vproc_err_t vproc_swap_complex(vproc_t vp, vproc_gsk_t key, launch_data_t inval, launch_data_t *outval) {
+  errno = ENOTSUP;
+  return (vproc_err_t)&unsupported;
+}
+
+#else
+
+// Apple's liblaunch owns allocation, arenas are not available
+
+launch_data_arena_t launch_data_arena_create(size_t chunk_size) {
+  return NULL;
+}
+
+void launch_data_arena_reset(launch_data_arena_t a) {
+}
+
+void launch_data_arena_destroy(launch_data_arena_t a) {
+}
+
+launch_data_arena_t launch_data_arena_use(launch_data_arena_t a) {
+  return NULL;
+}
+
+size_t launch_data_arena_size(launch_data_arena_t a) {
+  return 0;
+}
+
+#endif
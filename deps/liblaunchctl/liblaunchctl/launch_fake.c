@@ -0,0 +1,975 @@
+//
+//  launch_fake.c
+//  liblaunchctl
+//
+//  See launch_fake.h
+//
+
+#include <pthread.h>
+#include <signal.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "liblaunchctl.h"
+#include "launch_data_arena.h"
+#include "launch_fake.h"
+
+#define FAKE_JOBS 1000
+#define FAKE_PARETO_SHAPE 1.5
+#define FAKE_MAX_RULES 32
+#define FAKE_MAX_DEPTH 256
+
+// Returned by the swaps on failure, vproc_err_t only has to be non-NULL
+static char fake_failed;
+
+struct job {
+  // Hash chain
+  struct job *next;
+  // Label, owned, or pointing into plist
+  const char *label;
+  // The submitted dictionary, a heap copy. NULL for synthetic jobs
+  launch_data_t plist;
+  unsigned long index;
+  bool ondemand;
+  pid_t pid;
+  int last_status;
+};
+
+typedef enum {
+  LATENCY_NONE = 0,
+  LATENCY_FIXED,
+  LATENCY_EXPONENTIAL,
+  LATENCY_PARETO
+} latency_t;
+
+struct rule {
+  char key[64];
+  int error;
+  double rate;
+  // fail= rather than error=: launch_msg itself fails
+  bool hard;
+};
+
+struct config {
+  unsigned long jobs;
+  latency_t latency;
+  double latency_ms;
+  double shape;
+  double max_ms;
+  uint64_t seed;
+  struct rule rules[FAKE_MAX_RULES];
+  size_t rule_cnt;
+};
+
+// The ALLJOBS encoding at one generation, shared by the requests using it
+struct snapshot {
+  size_t refs;
+  struct launch_data_buf encoded;
+};
+
+// Readers answer requests, writers change the table
+static pthread_rwlock_t jobs_lock = PTHREAD_RWLOCK_INITIALIZER;
+static struct job **buckets = NULL;
+static size_t bucket_cnt = 0;
+static size_t job_cnt = 0;
+static pid_t next_pid;
+// Bumped by every change, with jobs_lock held for writing
+static uint64_t generation = 1;
+
+// The last ALLJOBS snapshot and the generation it was built for
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct snapshot *cache = NULL;
+static uint64_t cache_generation = 0;
+
+static pthread_mutex_t state_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct rlimit limits[RLIM_NLIMITS];
+static launch_data_t environment = NULL;
+static int64_t global_umask = 022;
+
+// Guards config and the generator behind latency and errors
+static pthread_mutex_t config_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct config config;
+static uint64_t rng;
+static bool configured = false;
+
+#pragma mark Jobs
+
+static uint64_t hash_label(const char *s) {
+  uint64_t h = 14695981039346656037ULL;
+  for (; *s; s++) {
+    h ^= (unsigned char)*s;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static struct job **find_slot(const char *label) {
+  struct job **p = &buckets[hash_label(label) & (bucket_cnt - 1)];
+  while (*p && strcmp((*p)->label, label) != 0) {
+    p = &(*p)->next;
+  }
+  return p;
+}
+
+static struct job *find_job(const char *label) {
+  return bucket_cnt ? *find_slot(label) : NULL;
+}
+
+// Keeps chains about one job long
+static bool grow_buckets(void) {
+  if (job_cnt < bucket_cnt) {
+    return true;
+  }
+  size_t cnt = bucket_cnt ? bucket_cnt * 2 : 64;
+  struct job **b = calloc(cnt, sizeof(*b));
+  if (b == NULL) {
+    return false;
+  }
+  for (size_t i=0; i<bucket_cnt; i++) {
+    struct job *j = buckets[i];
+    while (j) {
+      struct job *next = j->next;
+      struct job **slot = &b[hash_label(j->label) & (cnt - 1)];
+      j->next = *slot;
+      *slot = j;
+      j = next;
+    }
+  }
+  free(buckets);
+  buckets = b;
+  bucket_cnt = cnt;
+  return true;
+}
+
+static void add_job(struct job *j) {
+  struct job **slot = find_slot(j->label);
+  j->next = *slot;
+  *slot = j;
+  job_cnt++;
+}
+
+static void free_job(struct job *j) {
+  if (j->plist) {
+    launch_data_free(j->plist);
+  } else {
+    free((char *)j->label);
+  }
+  free(j);
+}
+
+static void remove_job(struct job *j) {
+  struct job **p = find_slot(j->label);
+  *p = j->next;
+  job_cnt--;
+  free_job(j);
+}
+
+// Drops every job, with jobs_lock held for writing
+static void clear_jobs(void) {
+  for (size_t i=0; i<bucket_cnt; i++) {
+    while (buckets[i]) {
+      struct job *j = buckets[i];
+      buckets[i] = j->next;
+      free_job(j);
+    }
+  }
+  job_cnt = 0;
+}
+
+// One in three running, every other one on demand, as synthetic.cc
+static bool add_synthetic(unsigned long jobs) {
+  char label[64];
+  for (unsigned long i=0; i<jobs; i++) {
+    struct job *j = calloc(1, sizeof(*j));
+    snprintf(label, sizeof(label), "com.synthetic.job.%lu", i);
+    if (j == NULL || (j->label = strdup(label)) == NULL || !grow_buckets()) {
+      if (j) {
+        free((char *)j->label);
+      }
+      free(j);
+      return false;
+    }
+    j->index = i;
+    j->ondemand = i % 2 == 0;
+    if (i % 3 == 0) {
+      j->pid = (pid_t)(1000 + i);
+    } else {
+      j->last_status = (int)(i % 7) << 8;
+    }
+    add_job(j);
+  }
+  next_pid = (pid_t)(1000 + jobs);
+  return true;
+}
+
+// Builds the job as GetJob reports it, with jobs_lock held
+static launch_data_t job_info(struct job *j) {
+  launch_data_t info = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+  launch_data_dict_insert(info, launch_data_new_string(j->label), LAUNCH_JOBKEY_LABEL);
+  launch_data_dict_insert(info, launch_data_new_string("Aqua"), LAUNCH_JOBKEY_LIMITLOADTOSESSIONTYPE);
+  launch_data_dict_insert(info, launch_data_new_bool(j->ondemand), LAUNCH_JOBKEY_ONDEMAND);
+  launch_data_dict_insert(info, launch_data_new_integer(30), LAUNCH_JOBKEY_TIMEOUT);
+  if (j->pid) {
+    launch_data_dict_insert(info, launch_data_new_integer(j->pid), LAUNCH_JOBKEY_PID);
+  } else {
+    launch_data_dict_insert(info, launch_data_new_integer(j->last_status), LAUNCH_JOBKEY_LASTEXITSTATUS);
+  }
+
+  if (j->plist) {
+    static const char *copied[] = {
+      LAUNCH_JOBKEY_PROGRAM,
+      LAUNCH_JOBKEY_PROGRAMARGUMENTS,
+      LAUNCH_JOBKEY_STANDARDOUTPATH,
+      LAUNCH_JOBKEY_STANDARDERRORPATH
+    };
+    for (size_t i=0; i<sizeof(copied)/sizeof(copied[0]); i++) {
+      launch_data_t v = launch_data_dict_lookup(j->plist, copied[i]);
+      if (v) {
+        launch_data_dict_insert(info, launch_data_copy(v), copied[i]);
+      }
+    }
+    return info;
+  }
+
+  char buf[128];
+  snprintf(buf, sizeof(buf), "/usr/local/libexec/synthetic-%lu", j->index);
+  launch_data_dict_insert(info, launch_data_new_string(buf), LAUNCH_JOBKEY_PROGRAM);
+  launch_data_t argv = launch_data_alloc(LAUNCH_DATA_ARRAY);
+  launch_data_array_set_index(argv, launch_data_new_string(buf), 0);
+  launch_data_array_set_index(argv, launch_data_new_string("--verbose"), 1);
+  launch_data_array_set_index(argv, launch_data_new_string("--foreground"), 2);
+  launch_data_dict_insert(info, argv, LAUNCH_JOBKEY_PROGRAMARGUMENTS);
+  if (j->index % 4 == 0) {
+    launch_data_t mach = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+    snprintf(buf, sizeof(buf), "%s.xpc", j->label);
+    launch_data_dict_insert(mach, launch_data_new_machport(MACH_PORT_NULL), buf);
+    launch_data_dict_insert(info, mach, LAUNCH_JOBKEY_MACHSERVICES);
+  }
+  return info;
+}
+
+static void snapshot_release(struct snapshot *snap) {
+  pthread_mutex_lock(&cache_lock);
+  bool last = --snap->refs == 0;
+  pthread_mutex_unlock(&cache_lock);
+  if (last) {
+    launch_data_buf_free(&snap->encoded);
+    free(snap);
+  }
+}
+
+// The current ALLJOBS encoding, rebuilt after a change to the table.
+// Encoding 100k jobs takes far longer than copying or decoding the bytes,
+// which callers do without holding any lock. Release with
+// snapshot_release()
+static struct snapshot *all_jobs(int *err) {
+  pthread_rwlock_rdlock(&jobs_lock);
+  pthread_mutex_lock(&cache_lock);
+  struct snapshot *snap = cache;
+  if (snap == NULL || cache_generation != generation) {
+    snap = calloc(1, sizeof(*snap));
+    launch_data_arena_t arena = launch_data_arena_create(0);
+    launch_data_arena_t prev = launch_data_arena_use(arena);
+    launch_data_t jobs = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+    for (size_t i=0; i<bucket_cnt; i++) {
+      for (struct job *j = buckets[i]; j; j = j->next) {
+        launch_data_dict_insert(jobs, job_info(j), j->label);
+      }
+    }
+    *err = snap ? launch_data_encode(jobs, &snap->encoded, FAKE_MAX_DEPTH) : ENOMEM;
+    launch_data_free(jobs);
+    launch_data_arena_use(prev);
+    launch_data_arena_destroy(arena);
+    if (*err) {
+      if (snap) {
+        launch_data_buf_free(&snap->encoded);
+        free(snap);
+      }
+      snap = NULL;
+    } else {
+      if (cache && --cache->refs == 0) {
+        launch_data_buf_free(&cache->encoded);
+        free(cache);
+      }
+      // One reference is the cache's own
+      snap->refs = 1;
+      cache = snap;
+      cache_generation = generation;
+    }
+  }
+  if (snap) {
+    snap->refs++;
+  }
+  pthread_mutex_unlock(&cache_lock);
+  pthread_rwlock_unlock(&jobs_lock);
+  return snap;
+}
+
+// Appends the ALLJOBS encoding to out
+static int append_all_jobs(struct launch_data_buf *out) {
+  int err = 0;
+  struct snapshot *snap = all_jobs(&err);
+  if (snap == NULL) {
+    return err;
+  }
+  const struct launch_data_buf *encoded = &snap->encoded;
+  if (out->cap - out->len < encoded->len) {
+    char *data = realloc(out->data, out->len + encoded->len);
+    if (data == NULL) {
+      err = ENOMEM;
+    } else {
+      out->data = data;
+      out->cap = out->len + encoded->len;
+    }
+  }
+  if (!err) {
+    memcpy(out->data + out->len, encoded->data, encoded->len);
+    out->len += encoded->len;
+  }
+  snapshot_release(snap);
+  return err;
+}
+
+static int decode_all_jobs(launch_data_t *out) {
+  int err = 0;
+  struct snapshot *snap = all_jobs(&err);
+  if (snap == NULL) {
+    return err;
+  }
+  *out = launch_data_decode(snap->encoded.data, snap->encoded.len, NULL);
+  if (*out == NULL) {
+    err = errno ? errno : ENOMEM;
+  }
+  snapshot_release(snap);
+  return err;
+}
+
+static launch_data_t get_job(launch_data_t arg) {
+  if (launch_data_get_type(arg) != LAUNCH_DATA_STRING) {
+    return launch_data_new_errno(EINVAL);
+  }
+  pthread_rwlock_rdlock(&jobs_lock);
+  struct job *j = find_job(launch_data_get_string(arg));
+  launch_data_t resp = j ? job_info(j) : launch_data_new_errno(ESRCH);
+  pthread_rwlock_unlock(&jobs_lock);
+  return resp;
+}
+
+static int control(const char *cmd, launch_data_t arg) {
+  if (launch_data_get_type(arg) != LAUNCH_DATA_STRING) {
+    return EINVAL;
+  }
+  pthread_rwlock_wrlock(&jobs_lock);
+  struct job *j = find_job(launch_data_get_string(arg));
+  int err = 0;
+  if (j == NULL) {
+    err = ESRCH;
+  } else if (strcmp(cmd, LAUNCH_KEY_STARTJOB) == 0) {
+    if (j->pid == 0) {
+      j->pid = next_pid++;
+    }
+  } else if (strcmp(cmd, LAUNCH_KEY_STOPJOB) == 0) {
+    if (j->pid) {
+      j->pid = 0;
+      j->last_status = SIGTERM;
+    }
+  } else {
+    remove_job(j);
+  }
+  if (!err) {
+    generation++;
+  }
+  pthread_rwlock_unlock(&jobs_lock);
+  return err;
+}
+
+static const char *get_string(launch_data_t plist, const char *key) {
+  launch_data_t v = launch_data_dict_lookup(plist, key);
+  return v && launch_data_get_type(v) == LAUNCH_DATA_STRING ? launch_data_get_string(v) : NULL;
+}
+
+static bool get_bool(launch_data_t plist, const char *key, bool def) {
+  launch_data_t v = launch_data_dict_lookup(plist, key);
+  return v && launch_data_get_type(v) == LAUNCH_DATA_BOOL ? launch_data_get_bool(v) : def;
+}
+
+static int submit(launch_data_t plist) {
+  if (plist == NULL || launch_data_get_type(plist) != LAUNCH_DATA_DICTIONARY
+      || get_string(plist, LAUNCH_JOBKEY_LABEL) == NULL
+      || (get_string(plist, LAUNCH_JOBKEY_PROGRAM) == NULL
+        && launch_data_dict_lookup(plist, LAUNCH_JOBKEY_PROGRAMARGUMENTS) == NULL)) {
+    return EINVAL;
+  }
+  struct job *j = calloc(1, sizeof(*j));
+  // The job outlives the request, keep it off any arena the caller uses
+  launch_data_arena_t prev = launch_data_arena_use(NULL);
+  launch_data_t copy = j ? launch_data_copy(plist) : NULL;
+  launch_data_arena_use(prev);
+  if (copy == NULL) {
+    free(j);
+    return ENOMEM;
+  }
+  j->plist = copy;
+  j->label = get_string(copy, LAUNCH_JOBKEY_LABEL);
+  j->ondemand = !get_bool(copy, LAUNCH_JOBKEY_KEEPALIVE, !get_bool(copy, LAUNCH_JOBKEY_ONDEMAND, true));
+
+  int err = 0;
+  pthread_rwlock_wrlock(&jobs_lock);
+  if (find_job(j->label)) {
+    err = EEXIST;
+  } else if (!grow_buckets()) {
+    err = ENOMEM;
+  } else {
+    if (!j->ondemand || get_bool(copy, LAUNCH_JOBKEY_RUNATLOAD, false)) {
+      j->pid = next_pid++;
+    }
+    add_job(j);
+    generation++;
+  }
+  pthread_rwlock_unlock(&jobs_lock);
+  if (err) {
+    free_job(j);
+  }
+  return err;
+}
+
+static launch_data_t submit_jobs(launch_data_t jobs) {
+  if (launch_data_get_type(jobs) != LAUNCH_DATA_ARRAY) {
+    return launch_data_new_errno(submit(jobs));
+  }
+  // One errno per job, as launchd answers a batch
+  launch_data_t resp = launch_data_alloc(LAUNCH_DATA_ARRAY);
+  for (size_t i=0; i<launch_data_array_get_count(jobs); i++) {
+    launch_data_array_set_index(resp, launch_data_new_errno(submit(launch_data_array_get_index(jobs, i))), i);
+  }
+  return resp;
+}
+
+#pragma mark Manager state
+
+static launch_data_t get_limits(void) {
+  pthread_mutex_lock(&state_lock);
+  launch_data_t resp = launch_data_new_opaque(limits, sizeof(limits));
+  pthread_mutex_unlock(&state_lock);
+  return resp;
+}
+
+// Takes as many limits as the client sent, like launchd
+static launch_data_t set_limits(launch_data_t arg) {
+  if (launch_data_get_type(arg) != LAUNCH_DATA_OPAQUE) {
+    return launch_data_new_errno(EINVAL);
+  }
+  size_t n = launch_data_get_opaque_size(arg);
+  pthread_mutex_lock(&state_lock);
+  memcpy(limits, launch_data_get_opaque(arg), n < sizeof(limits) ? n : sizeof(limits));
+  pthread_mutex_unlock(&state_lock);
+  return get_limits();
+}
+
+static launch_data_t get_rusage(int who) {
+  struct rusage ru;
+  if (getrusage(who, &ru) != 0) {
+    return launch_data_new_errno(errno);
+  }
+  return launch_data_new_opaque(&ru, sizeof(ru));
+}
+
+static launch_data_t set_environment(launch_data_t arg) {
+  if (launch_data_get_type(arg) != LAUNCH_DATA_DICTIONARY) {
+    return launch_data_new_errno(EINVAL);
+  }
+  launch_data_arena_t prev = launch_data_arena_use(NULL);
+  pthread_mutex_lock(&state_lock);
+  for (size_t i=0; i+1<arg->_array_cnt; i+=2) {
+    const char *key = arg->_array[i]->string;
+    launch_data_dict_remove(environment, key);
+    launch_data_dict_insert(environment, launch_data_copy(arg->_array[i + 1]), key);
+  }
+  pthread_mutex_unlock(&state_lock);
+  launch_data_arena_use(prev);
+  return launch_data_new_errno(0);
+}
+
+static launch_data_t unset_environment(launch_data_t arg) {
+  if (launch_data_get_type(arg) != LAUNCH_DATA_STRING) {
+    return launch_data_new_errno(EINVAL);
+  }
+  pthread_mutex_lock(&state_lock);
+  launch_data_dict_remove(environment, launch_data_get_string(arg));
+  pthread_mutex_unlock(&state_lock);
+  return launch_data_new_errno(0);
+}
+
+#pragma mark Latency and errors
+
+static const struct { const char *name; int error; } errnos[] = {
+  { "EPERM", EPERM },
+  { "ENOENT", ENOENT },
+  { "ESRCH", ESRCH },
+  { "EINTR", EINTR },
+  { "EIO", EIO },
+  { "ENOMEM", ENOMEM },
+  { "EACCES", EACCES },
+  { "EBUSY", EBUSY },
+  { "EEXIST", EEXIST },
+  { "EINVAL", EINVAL },
+  { "EAGAIN", EAGAIN },
+  { "ENOTSUP", ENOTSUP },
+  { "ETIMEDOUT", ETIMEDOUT },
+  { "ECONNREFUSED", ECONNREFUSED }
+};
+
+static const struct { const char *name; vproc_gsk_t key; } swaps[] = {
+  { "ALLJOBS", VPROC_GSK_ALLJOBS },
+  { "ENVIRONMENT", VPROC_GSK_ENVIRONMENT },
+  { "MGR_NAME", VPROC_GSK_MGR_NAME },
+  { "MGR_PID", VPROC_GSK_MGR_PID },
+  { "MGR_UID", VPROC_GSK_MGR_UID },
+  { "GLOBAL_UMASK", VPROC_GSK_GLOBAL_UMASK }
+};
+
+// The name rules match a round trip by
+static const char *request_name(char kind, int32_t key, launch_data_t request) {
+  if (kind != LAUNCH_TRANSPORT_MSG) {
+    for (size_t i=0; i<sizeof(swaps)/sizeof(swaps[0]); i++) {
+      if ((int32_t)swaps[i].key == key) {
+        return swaps[i].name;
+      }
+    }
+    return "";
+  }
+  if (request && launch_data_get_type(request) == LAUNCH_DATA_STRING) {
+    return launch_data_get_string(request);
+  }
+  if (request && launch_data_get_type(request) == LAUNCH_DATA_DICTIONARY
+      && launch_data_dict_get_count(request) == 1) {
+    return request->_array[0]->string;
+  }
+  return "";
+}
+
+// splitmix64, one step per draw, with config_lock held
+static double uniform(void) {
+  uint64_t z = (rng += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+  return (double)(z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Draws this round trip's latency and error, with config_lock held
+static double draw_latency(void) {
+  double ms = 0;
+  switch (config.latency) {
+    case LATENCY_NONE:
+      return 0;
+    case LATENCY_FIXED:
+      ms = config.latency_ms;
+      break;
+    case LATENCY_EXPONENTIAL:
+      ms = -config.latency_ms * log(1.0 - uniform());
+      break;
+    case LATENCY_PARETO:
+      ms = config.latency_ms / pow(1.0 - uniform(), 1.0 / config.shape);
+      break;
+  }
+  return config.max_ms > 0 && ms > config.max_ms ? config.max_ms : ms;
+}
+
+static const struct rule *draw_error(const char *name) {
+  double u = -1, sum = 0;
+  for (size_t i=0; i<config.rule_cnt; i++) {
+    const struct rule *r = &config.rules[i];
+    if (strcmp(r->key, "*") != 0 && strcmp(r->key, name) != 0) {
+      continue;
+    }
+    if (u < 0) {
+      u = uniform();
+    }
+    sum += r->rate;
+    if (u < sum) {
+      return r;
+    }
+  }
+  return NULL;
+}
+
+static void sleep_ms(double ms) {
+  if (ms <= 0) {
+    return;
+  }
+  struct timespec ts;
+  ts.tv_sec = (time_t)(ms / 1e3);
+  ts.tv_nsec = (long)((ms - ts.tv_sec * 1e3) * 1e6);
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+  }
+}
+
+// Waits out the latency, then returns the rule failing this round trip
+static const struct rule *inject(char kind, int32_t key, launch_data_t request) {
+  const char *name = request_name(kind, key, request);
+  pthread_mutex_lock(&config_lock);
+  double ms = draw_latency();
+  const struct rule *r = draw_error(name);
+  pthread_mutex_unlock(&config_lock);
+  sleep_ms(ms);
+  return r;
+}
+
+static int parse_errno(const char *s, int *out) {
+  char *end;
+  long n = strtol(s, &end, 10);
+  if (end != s && *end == '\0' && n > 0) {
+    *out = (int)n;
+    return 0;
+  }
+  for (size_t i=0; i<sizeof(errnos)/sizeof(errnos[0]); i++) {
+    if (strcmp(errnos[i].name, s) == 0) {
+      *out = errnos[i].error;
+      return 0;
+    }
+  }
+  return EINVAL;
+}
+
+static int parse_ms(const char *s, double *out) {
+  char *end;
+  *out = strtod(s, &end);
+  return end != s && *end == '\0' && *out >= 0 ? 0 : EINVAL;
+}
+
+// Parses one name=value setting of a spec into c
+static int parse_setting(char *setting, struct config *c) {
+  char *value = strchr(setting, '=');
+  if (value == NULL) {
+    return EINVAL;
+  }
+  *value++ = '\0';
+  char *end;
+  if (strcmp(setting, "jobs") == 0) {
+    c->jobs = strtoul(value, &end, 10);
+    return end != value && *end == '\0' ? 0 : EINVAL;
+  }
+  if (strcmp(setting, "seed") == 0) {
+    c->seed = strtoull(value, &end, 10);
+    return end != value && *end == '\0' ? 0 : EINVAL;
+  }
+  if (strcmp(setting, "maxlatency") == 0) {
+    return parse_ms(value, &c->max_ms);
+  }
+  if (strcmp(setting, "latency") == 0) {
+    char *ms = strchr(value, ':');
+    if (strcmp(value, "none") == 0) {
+      c->latency = LATENCY_NONE;
+      return 0;
+    }
+    if (ms == NULL) {
+      return EINVAL;
+    }
+    *ms++ = '\0';
+    if (strcmp(value, "fixed") == 0) {
+      c->latency = LATENCY_FIXED;
+    } else if (strcmp(value, "exp") == 0) {
+      c->latency = LATENCY_EXPONENTIAL;
+    } else if (strcmp(value, "pareto") == 0) {
+      c->latency = LATENCY_PARETO;
+      char *shape = strchr(ms, ':');
+      if (shape) {
+        *shape++ = '\0';
+        c->shape = strtod(shape, &end);
+        if (end == shape || *end != '\0' || c->shape <= 0) {
+          return EINVAL;
+        }
+      }
+    } else {
+      return EINVAL;
+    }
+    return parse_ms(ms, &c->latency_ms);
+  }
+  if (strcmp(setting, "error") == 0 || strcmp(setting, "fail") == 0) {
+    // key:errno:rate, split from the right since keys hold no colons
+    char *rate = strrchr(value, ':');
+    if (rate == NULL || c->rule_cnt == FAKE_MAX_RULES) {
+      return EINVAL;
+    }
+    *rate++ = '\0';
+    char *err = strrchr(value, ':');
+    if (err == NULL || strlen(value) - strlen(err) >= sizeof(c->rules[0].key)) {
+      return EINVAL;
+    }
+    *err++ = '\0';
+    struct rule *r = &c->rules[c->rule_cnt];
+    r->rate = strtod(rate, &end);
+    if (end == rate || *end != '\0' || r->rate < 0 || r->rate > 1
+        || parse_errno(err, &r->error) != 0 || *value == '\0') {
+      return EINVAL;
+    }
+    strcpy(r->key, value);
+    r->hard = strcmp(setting, "fail") == 0;
+    c->rule_cnt++;
+    return 0;
+  }
+  return EINVAL;
+}
+
+static int parse_spec(const char *spec, struct config *c) {
+  memset(c, 0, sizeof(*c));
+  c->jobs = FAKE_JOBS;
+  c->shape = FAKE_PARETO_SHAPE;
+  c->seed = 1;
+  if (spec == NULL || *spec == '\0') {
+    return 0;
+  }
+  char *copy = strdup(spec);
+  if (copy == NULL) {
+    return ENOMEM;
+  }
+  int err = 0;
+  char *save = NULL;
+  for (char *s = strtok_r(copy, ",", &save); s && !err; s = strtok_r(NULL, ",", &save)) {
+    err = parse_setting(s, c);
+  }
+  free(copy);
+  return err;
+}
+
+int launch_fake_configure(const char *spec) {
+  struct config c;
+  int err = parse_spec(spec, &c);
+  if (err) {
+    return err;
+  }
+  pthread_rwlock_wrlock(&jobs_lock);
+  clear_jobs();
+  bool ok = grow_buckets() && add_synthetic(c.jobs);
+  generation++;
+  pthread_rwlock_unlock(&jobs_lock);
+  if (!ok) {
+    return ENOMEM;
+  }
+
+  pthread_mutex_lock(&state_lock);
+  if (environment == NULL) {
+    for (int i=0; i<RLIM_NLIMITS; i++) {
+      getrlimit(i, &limits[i]);
+    }
+    launch_data_arena_t prev = launch_data_arena_use(NULL);
+    environment = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+    launch_data_arena_use(prev);
+  }
+  pthread_mutex_unlock(&state_lock);
+
+  pthread_mutex_lock(&config_lock);
+  config = c;
+  rng = c.seed;
+  configured = true;
+  pthread_mutex_unlock(&config_lock);
+  return 0;
+}
+
+#pragma mark Requests
+
+// Answers a launch_msg request. GetJobs is left to the caller, which
+// decodes or copies the cached encoding
+static launch_data_t answer_msg(launch_data_t request) {
+  if (request && launch_data_get_type(request) == LAUNCH_DATA_STRING) {
+    const char *cmd = launch_data_get_string(request);
+    if (strcmp(cmd, LAUNCH_KEY_GETRESOURCELIMITS) == 0) {
+      return get_limits();
+    }
+    if (strcmp(cmd, LAUNCH_KEY_GETRUSAGESELF) == 0) {
+      return get_rusage(RUSAGE_SELF);
+    }
+    if (strcmp(cmd, LAUNCH_KEY_GETRUSAGECHILDREN) == 0) {
+      return get_rusage(RUSAGE_CHILDREN);
+    }
+    return launch_data_new_errno(ENOTSUP);
+  }
+  if (request == NULL || launch_data_get_type(request) != LAUNCH_DATA_DICTIONARY
+      || launch_data_dict_get_count(request) != 1) {
+    return launch_data_new_errno(EINVAL);
+  }
+  const char *cmd = request->_array[0]->string;
+  launch_data_t arg = request->_array[1];
+  if (strcmp(cmd, LAUNCH_KEY_GETJOB) == 0) {
+    return get_job(arg);
+  }
+  if (strcmp(cmd, LAUNCH_KEY_STARTJOB) == 0
+      || strcmp(cmd, LAUNCH_KEY_STOPJOB) == 0
+      || strcmp(cmd, LAUNCH_KEY_REMOVEJOB) == 0) {
+    return launch_data_new_errno(control(cmd, arg));
+  }
+  if (strcmp(cmd, LAUNCH_KEY_SUBMITJOB) == 0) {
+    return submit_jobs(arg);
+  }
+  if (strcmp(cmd, LAUNCH_KEY_SETRESOURCELIMITS) == 0) {
+    return set_limits(arg);
+  }
+  if (strcmp(cmd, LAUNCH_KEY_SETUSERENVIRONMENT) == 0) {
+    return set_environment(arg);
+  }
+  if (strcmp(cmd, LAUNCH_KEY_UNSETUSERENVIRONMENT) == 0) {
+    return unset_environment(arg);
+  }
+  return launch_data_new_errno(ENOTSUP);
+}
+
+// Answers a swap other than ALLJOBS, NULL with *err set on failure
+static launch_data_t answer_swap(char kind, int32_t key, launch_data_t in, int *err) {
+  if (kind == LAUNCH_TRANSPORT_STRING) {
+    if (key == VPROC_GSK_MGR_NAME && in == NULL) {
+      return launch_data_new_string(geteuid() == 0 ? "System" : "Aqua");
+    }
+  } else if (kind == LAUNCH_TRANSPORT_INTEGER) {
+    if (in && launch_data_get_type(in) != LAUNCH_DATA_INTEGER) {
+      *err = EINVAL;
+      return NULL;
+    }
+    switch (key) {
+      case VPROC_GSK_MGR_PID:
+        return launch_data_new_integer(getpid());
+      case VPROC_GSK_MGR_UID:
+        return launch_data_new_integer(getuid());
+      case VPROC_GSK_GLOBAL_UMASK: {
+        pthread_mutex_lock(&state_lock);
+        int64_t old = global_umask;
+        if (in) {
+          global_umask = launch_data_get_integer(in);
+        }
+        pthread_mutex_unlock(&state_lock);
+        return launch_data_new_integer(old);
+      }
+    }
+  } else if (kind == LAUNCH_TRANSPORT_COMPLEX && key == VPROC_GSK_ENVIRONMENT) {
+    pthread_mutex_lock(&state_lock);
+    launch_data_t env = launch_data_copy(environment);
+    pthread_mutex_unlock(&state_lock);
+    return env;
+  }
+  *err = ENOTSUP;
+  return NULL;
+}
+
+static bool is_all_jobs(char kind, int32_t key, launch_data_t request) {
+  if (kind == LAUNCH_TRANSPORT_COMPLEX) {
+    return key == VPROC_GSK_ALLJOBS;
+  }
+  return kind == LAUNCH_TRANSPORT_MSG && request
+    && launch_data_get_type(request) == LAUNCH_DATA_STRING
+    && strcmp(launch_data_get_string(request), LAUNCH_KEY_GETJOBS) == 0;
+}
+
+// One round trip against the table: *resp is the answer (NULL for none),
+// the return value the errno the call fails with. With encoded, ALLJOBS
+// is appended there as bytes instead of being decoded into *resp
+static int answer(char kind, int32_t key, launch_data_t request, launch_data_t *resp,
+    struct launch_data_buf *encoded) {
+  *resp = NULL;
+  if (!configured) {
+    return ENOTCONN;
+  }
+  const struct rule *r = inject(kind, key, request);
+  if (r && (r->hard || kind != LAUNCH_TRANSPORT_MSG)) {
+    return r->error;
+  }
+  if (r) {
+    *resp = launch_data_new_errno(r->error);
+    return 0;
+  }
+  if (is_all_jobs(kind, key, request)) {
+    return encoded ? append_all_jobs(encoded) : decode_all_jobs(resp);
+  }
+  if (kind == LAUNCH_TRANSPORT_MSG) {
+    *resp = answer_msg(request);
+    return 0;
+  }
+  int err = 0;
+  *resp = answer_swap(kind, key, request, &err);
+  return err;
+}
+
+int launch_fake_encode(char kind, int32_t key, launch_data_t request, struct launch_data_buf *out) {
+  size_t len = out->len;
+  launch_data_t resp;
+  int err = answer(kind, key, request, &resp, out);
+  if (!err && resp) {
+    err = launch_data_encode(resp, out, FAKE_MAX_DEPTH);
+  }
+  if (resp) {
+    launch_data_free(resp);
+  }
+  if (err) {
+    out->len = len;
+  }
+  return err;
+}
+
+#pragma mark Transport
+
+static launch_data_t fake_msg(launch_data_t request) {
+  launch_data_t resp;
+  int err = answer(LAUNCH_TRANSPORT_MSG, 0, request, &resp, NULL);
+  if (err) {
+    errno = err;
+    return NULL;
+  }
+  return resp;
+}
+
+// Shared by the swaps: the answer, or NULL with errno set on failure
+static vproc_err_t swap(char kind, vproc_gsk_t key, launch_data_t in, launch_data_t *out) {
+  int err = answer(kind, key, in, out, NULL);
+  if (err) {
+    errno = err;
+    return (vproc_err_t)&fake_failed;
+  }
+  return NULL;
+}
+
+static vproc_err_t fake_swap_integer(vproc_t vp, vproc_gsk_t key, int64_t *inval, int64_t *outval) {
+  launch_data_t in = inval ? launch_data_new_integer(*inval) : NULL;
+  launch_data_t out = NULL;
+  vproc_err_t r = swap(LAUNCH_TRANSPORT_INTEGER, key, in, &out);
+  if (in) launch_data_free(in);
+  if (r == NULL && outval) {
+    *outval = launch_data_get_integer(out);
+  }
+  if (out) launch_data_free(out);
+  return r;
+}
+
+static vproc_err_t fake_swap_string(vproc_t vp, vproc_gsk_t key, const char *inval, char **outval) {
+  launch_data_t in = inval ? launch_data_new_string(inval) : NULL;
+  launch_data_t out = NULL;
+  vproc_err_t r = swap(LAUNCH_TRANSPORT_STRING, key, in, &out);
+  if (in) launch_data_free(in);
+  if (r == NULL && outval) {
+    *outval = strdup(launch_data_get_string(out));
+  }
+  if (out) launch_data_free(out);
+  return r;
+}
+
+static vproc_err_t fake_swap_complex(vproc_t vp, vproc_gsk_t key, launch_data_t inval, launch_data_t *outval) {
+  launch_data_t out = NULL;
+  vproc_err_t r = swap(LAUNCH_TRANSPORT_COMPLEX, key, inval, &out);
+  if (r == NULL && outval) {
+    *outval = out;
+  } else if (out) {
+    launch_data_free(out);
+  }
+  return r;
+}
+
+const struct launch_transport launch_fake_transport = {
+  "fake",
+  fake_msg,
+  fake_swap_integer,
+  fake_swap_string,
+  fake_swap_complex
+};
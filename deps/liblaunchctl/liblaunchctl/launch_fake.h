@@ -0,0 +1,76 @@
+/*
+ * launch_fake.h
+ * A launchd that lives in this process, with injectable latency and errors
+ *
+ * The fake transport answers GetJob, GetJobs, StartJob, StopJob,
+ * RemoveJob, SubmitJob, the resource limit, resource usage and user
+ * environment requests, and the manager swaps (ALLJOBS, ENVIRONMENT,
+ * MGR_PID, MGR_UID, MGR_NAME and GLOBAL_UMASK) from a table of jobs that
+ * never run: StartJob hands out a PID, StopJob records a SIGTERM exit. The
+ * table starts with synthetic jobs labelled com.synthetic.job.<n>, shaped
+ * like the binding's synthetic responses. launchd-standin serves the same
+ * table over a socket.
+ *
+ * Before answering, each round trip waits for a latency drawn from the
+ * configured distribution and may be failed on purpose. The configuration
+ * is a comma separated spec:
+ *
+ *   jobs=<n>                   synthetic jobs (1000)
+ *   latency=fixed:<ms>         every round trip takes ms
+ *   latency=exp:<ms>           exponential with mean ms
+ *   latency=pareto:<ms>[:<a>]  Pareto with minimum ms and shape a (1.5),
+ *                              a heavy tail: one in 1000 waits 100x ms
+ *   maxlatency=<ms>            caps any drawn latency
+ *   error=<key>:<errno>:<rate> answers that fraction of key's requests with
+ *                              errno, as launchd reports a failed request
+ *   fail=<key>:<errno>:<rate>  fails that fraction of key's launch_msg
+ *                              calls outright, as an unreachable launchd
+ *   seed=<n>                   seeds the generator behind both (1)
+ *
+ * Milliseconds may be fractional. A key is a launch_msg command (GetJob,
+ * GetJobs, StartJob, SubmitJob...), a swap (ALLJOBS, ENVIRONMENT,
+ * MGR_NAME, MGR_PID, MGR_UID, GLOBAL_UMASK) or * for every request. An
+ * errno is a number or a name such as EAGAIN, ESRCH or ETIMEDOUT. A swap
+ * fails with the errno of either kind of rule. Rules for one key split a
+ * single draw, so "error=GetJob:EAGAIN:0.01,error=GetJob:ESRCH:0.01" fails
+ * 2% of GetJobs.
+ *
+ * One seed always produces the same sequence of draws. Which request gets
+ * which draw follows the order requests arrive in, so concurrent callers
+ * reproduce a run only statistically.
+ */
+
+#ifndef LAUNCH_FAKE_H
+#define LAUNCH_FAKE_H
+
+#include <stdint.h>
+#include "launch_data_codec.h"
+#include "launch_transport.h"
+
+extern const struct launch_transport launch_fake_transport;
+
+/*!
+ @function launch_fake_configure
+ @discussion Replaces the fake's jobs with those spec asks for and applies
+  its latency and error rules. Round trips must not be in flight
+ @param spec
+  See above. NULL or "" for 1000 jobs answered at once
+ @return 0, EINVAL for a spec that does not parse, or ENOMEM
+ */
+int launch_fake_configure(const char *spec);
+
+/*!
+ @function launch_fake_encode
+ @discussion Answers one round trip as launch_fake_transport would, with
+  its latency and errors, appending the encoded response (if any) to out.
+  Serving ALLJOBS this way copies bytes kept from the last change to the
+  table instead of encoding every job again
+ @param kind
+  LAUNCH_TRANSPORT_MSG or one of the swap kinds
+ @param request
+  The request, or the swap's input. May be NULL
+ @return 0, or the errno of the failed round trip with out as it was
+ */
+int launch_fake_encode(char kind, int32_t key, launch_data_t request, struct launch_data_buf *out);
+
+#endif
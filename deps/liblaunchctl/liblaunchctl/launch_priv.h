@@ -21,12 +21,16 @@
 #ifndef __LAUNCH_PRIVATE_H__
 #define __LAUNCH_PRIVATE_H__
 
+#ifdef __APPLE__
 #include <mach/mach.h>
+#endif
 #include <sys/types.h>
 #include <launch.h>
 #include <unistd.h>
 #include <paths.h>
+#ifdef __APPLE__
 #include <uuid/uuid.h>
+#endif
 
 #pragma GCC visibility push(default)
 
@@ -114,6 +118,7 @@ create_and_switch_to_per_session_launchd(const char *, int flags, ...);
 void
 load_launchd_jobs_at_loginwindow_prompt(int flags, ...);
 
+#ifdef __APPLE__
 /* For CoreProcesses */
 #define SPAWN_VIA_LAUNCHD_STOPPED 0x0001
 #define SPAWN_VIA_LAUNCHD_TALAPP 0x0002
@@ -149,6 +154,8 @@ mpm_wait(mach_port_t ajob, int *wstatus);
 kern_return_t
 mpm_uncork_fork(mach_port_t ajob);
 
+#endif
+
 launch_data_t
 launch_socket_service_check_in(void);
 
@@ -0,0 +1,324 @@
+//
+//  launch_socket.c
+//  liblaunchctl
+//
+//  See launch_socket.h for the frame format
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "liblaunchctl.h"
+#include "launch_socket.h"
+
+// Nesting accepted when encoding requests, as for captures
+#define SOCKET_MAX_DEPTH 256
+// Idle connections kept for reuse, more are closed when their call ends
+#define SOCKET_IDLE_MAX 256
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+// Returned by the swaps on failure, vproc_err_t only has to be non-NULL
+static char socket_failed;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct sockaddr_un server;
+static bool server_set = false;
+static int idle[SOCKET_IDLE_MAX];
+static size_t idle_cnt = 0;
+
+#pragma mark Frames
+
+int launch_socket_frame_start(struct launch_data_buf *frame, const void *head, size_t n) {
+  size_t need = sizeof(uint32_t) + n;
+  if (frame->cap < need) {
+    size_t cap = need < 256 ? 256 : need;
+    char *data = realloc(frame->data, cap);
+    if (data == NULL) {
+      return ENOMEM;
+    }
+    frame->data = data;
+    frame->cap = cap;
+  }
+  memset(frame->data, 0, sizeof(uint32_t));
+  memcpy(frame->data + sizeof(uint32_t), head, n);
+  frame->len = need;
+  return 0;
+}
+
+int launch_socket_send(int fd, struct launch_data_buf *frame) {
+  uint32_t len = (uint32_t)(frame->len - sizeof(uint32_t));
+  memcpy(frame->data, &len, sizeof(len));
+  size_t off = 0;
+  while (off < frame->len) {
+    ssize_t n = send(fd, frame->data + off, frame->len - off, SEND_FLAGS);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno;
+    }
+    off += (size_t)n;
+  }
+  return 0;
+}
+
+static int read_all(int fd, char *p, size_t len) {
+  while (len) {
+    ssize_t n = read(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno;
+    }
+    if (n == 0) {
+      return ECONNRESET;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+int launch_socket_recv(int fd, struct launch_data_buf *frame) {
+  uint32_t len;
+  int err = read_all(fd, (char *)&len, sizeof(len));
+  if (err) {
+    return err;
+  }
+  if (len > LAUNCH_SOCKET_MAX_FRAME) {
+    return EMSGSIZE;
+  }
+  if (frame->cap < len) {
+    char *data = realloc(frame->data, len);
+    if (data == NULL) {
+      return ENOMEM;
+    }
+    frame->data = data;
+    frame->cap = len;
+  }
+  frame->len = len;
+  return read_all(fd, frame->data, len);
+}
+
+void launch_socket_nosigpipe(int fd) {
+#ifdef SO_NOSIGPIPE
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+  (void)fd;
+#endif
+}
+
+#pragma mark Connections
+
+static int dial(const struct sockaddr_un *addr, int *out) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return errno;
+  }
+  if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) != 0) {
+    int err = errno;
+    close(fd);
+    return err;
+  }
+  launch_socket_nosigpipe(fd);
+  *out = fd;
+  return 0;
+}
+
+// An idle connection, or a new one
+static int acquire(int *fd) {
+  pthread_mutex_lock(&pool_lock);
+  if (!server_set) {
+    pthread_mutex_unlock(&pool_lock);
+    return ENOTCONN;
+  }
+  if (idle_cnt) {
+    *fd = idle[--idle_cnt];
+    pthread_mutex_unlock(&pool_lock);
+    return 0;
+  }
+  struct sockaddr_un addr = server;
+  pthread_mutex_unlock(&pool_lock);
+  return dial(&addr, fd);
+}
+
+static void release(int fd, bool broken) {
+  pthread_mutex_lock(&pool_lock);
+  if (!broken && server_set && idle_cnt < SOCKET_IDLE_MAX) {
+    idle[idle_cnt++] = fd;
+    fd = -1;
+  }
+  pthread_mutex_unlock(&pool_lock);
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+static void close_idle(void) {
+  while (idle_cnt) {
+    close(idle[--idle_cnt]);
+  }
+}
+
+int launch_socket_open(const char *path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    return ENAMETOOLONG;
+  }
+  strcpy(addr.sun_path, path);
+  int fd;
+  int err = dial(&addr, &fd);
+  if (err) {
+    return err;
+  }
+  pthread_mutex_lock(&pool_lock);
+  close_idle();
+  server = addr;
+  server_set = true;
+  idle[idle_cnt++] = fd;
+  pthread_mutex_unlock(&pool_lock);
+  return 0;
+}
+
+void launch_socket_close(void) {
+  pthread_mutex_lock(&pool_lock);
+  close_idle();
+  server_set = false;
+  pthread_mutex_unlock(&pool_lock);
+}
+
+#pragma mark Round trips
+
+// Sends one request and decodes its answer into *response (NULL for none),
+// setting *error to the server's. Returns 0 or the errno of the exchange
+static int round_trip(char kind, int32_t key, launch_data_t request,
+    launch_data_t *response, int32_t *error) {
+  char head[LAUNCH_SOCKET_REQUEST_HEAD];
+  memcpy(head, &kind, 1);
+  memcpy(head + 1, &key, sizeof(key));
+  struct launch_data_buf frame = { NULL, 0, 0 };
+  int err = launch_socket_frame_start(&frame, head, sizeof(head));
+  if (!err && request) {
+    err = launch_data_encode(request, &frame, SOCKET_MAX_DEPTH);
+  }
+  int fd = -1;
+  if (!err) {
+    err = acquire(&fd);
+  }
+  if (!err) {
+    err = launch_socket_send(fd, &frame);
+    if (!err) {
+      err = launch_socket_recv(fd, &frame);
+    }
+    if (!err && frame.len < LAUNCH_SOCKET_RESPONSE_HEAD) {
+      err = EBADMSG;
+    }
+    release(fd, err != 0);
+  }
+  if (!err) {
+    memcpy(error, frame.data, sizeof(*error));
+    size_t body = frame.len - LAUNCH_SOCKET_RESPONSE_HEAD;
+    *response = NULL;
+    if (body) {
+      *response = launch_data_decode(frame.data + LAUNCH_SOCKET_RESPONSE_HEAD, body, NULL);
+      if (*response == NULL) {
+        err = errno ? errno : EBADMSG;
+      }
+    }
+  }
+  launch_data_buf_free(&frame);
+  return err;
+}
+
+static launch_data_t socket_msg(launch_data_t request) {
+  launch_data_t resp;
+  int32_t error;
+  int err = round_trip(LAUNCH_TRANSPORT_MSG, 0, request, &resp, &error);
+  if (err || resp == NULL) {
+    errno = err ? err : (error ? error : EBADMSG);
+    return NULL;
+  }
+  return resp;
+}
+
+// Shared by the swaps: the answer, or NULL with errno set on failure
+static vproc_err_t swap(char kind, vproc_gsk_t key, launch_data_t in, launch_data_t *out) {
+  int32_t error;
+  int err = round_trip(kind, key, in, out, &error);
+  if (!err && error) {
+    if (*out) launch_data_free(*out);
+    *out = NULL;
+    err = error;
+  }
+  if (err) {
+    errno = err;
+    return (vproc_err_t)&socket_failed;
+  }
+  return NULL;
+}
+
+static vproc_err_t socket_swap_integer(vproc_t vp, vproc_gsk_t key, int64_t *inval, int64_t *outval) {
+  launch_data_t in = inval ? launch_data_new_integer(*inval) : NULL;
+  launch_data_t out = NULL;
+  vproc_err_t r = swap(LAUNCH_TRANSPORT_INTEGER, key, in, &out);
+  if (in) launch_data_free(in);
+  if (r == NULL && outval) {
+    if (out == NULL || launch_data_get_type(out) != LAUNCH_DATA_INTEGER) {
+      errno = EBADMSG;
+      r = (vproc_err_t)&socket_failed;
+    } else {
+      *outval = launch_data_get_integer(out);
+    }
+  }
+  if (out) launch_data_free(out);
+  return r;
+}
+
+static vproc_err_t socket_swap_string(vproc_t vp, vproc_gsk_t key, const char *inval, char **outval) {
+  launch_data_t in = inval ? launch_data_new_string(inval) : NULL;
+  launch_data_t out = NULL;
+  vproc_err_t r = swap(LAUNCH_TRANSPORT_STRING, key, in, &out);
+  if (in) launch_data_free(in);
+  if (r == NULL && outval) {
+    *outval = NULL;
+    if (out && launch_data_get_type(out) == LAUNCH_DATA_STRING) {
+      *outval = strdup(launch_data_get_string(out));
+    }
+  }
+  if (out) launch_data_free(out);
+  return r;
+}
+
+static vproc_err_t socket_swap_complex(vproc_t vp, vproc_gsk_t key, launch_data_t inval, launch_data_t *outval) {
+  launch_data_t out = NULL;
+  vproc_err_t r = swap(LAUNCH_TRANSPORT_COMPLEX, key, inval, &out);
+  if (r == NULL && outval) {
+    *outval = out;
+  } else if (out) {
+    launch_data_free(out);
+  }
+  return r;
+}
+
+const struct launch_transport launch_socket_transport = {
+  "socket",
+  socket_msg,
+  socket_swap_integer,
+  socket_swap_string,
+  socket_swap_complex
+};
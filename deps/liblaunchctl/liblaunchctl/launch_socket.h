@@ -0,0 +1,89 @@
+/*
+ * launch_socket.h
+ * launchd round trips over an AF_UNIX stream socket
+ *
+ * The socket transport sends every round trip to a server, such as
+ * launchd-standin (standin/launchd_standin.c), and waits for its answer.
+ * Both directions are frames: a u32 length followed by that many bytes.
+ *
+ *   request   u8 kind and i32 key as in a capture record (see
+ *             launch_transport.h), then the request encoded as in
+ *             launch_data_codec.h. Nothing follows the key for none
+ *   response  i32 error, the errno of a failed launch_msg or swap and 0
+ *             otherwise, then the encoded response. Nothing follows the
+ *             error for none
+ *
+ * Integers are in host byte order, client and server share the machine.
+ *
+ * Connections are pooled: a round trip takes an idle connection or opens a
+ * new one, so N concurrent calls use N connections and reach the server in
+ * parallel, as they would reach launchd. A round trip that fails on the
+ * socket drops its connection and fails with that errno. It is not retried,
+ * the server may already have acted on it.
+ *
+ * Setting LAUNCHCTL_TRANSPORT to "socket:<path>" connects before the first
+ * round trip.
+ */
+
+#ifndef LAUNCH_SOCKET_H
+#define LAUNCH_SOCKET_H
+
+#include <stdint.h>
+#include "launch_data_codec.h"
+#include "launch_transport.h"
+
+// Largest frame either end accepts, ALLJOBS for 100k jobs is about 33MB
+#define LAUNCH_SOCKET_MAX_FRAME (256u << 20)
+
+// Bytes before the encoded request and response
+#define LAUNCH_SOCKET_REQUEST_HEAD (1 + sizeof(int32_t))
+#define LAUNCH_SOCKET_RESPONSE_HEAD sizeof(int32_t)
+
+extern const struct launch_transport launch_socket_transport;
+
+/*!
+ @function launch_socket_open
+ @discussion Points the socket transport at path and checks that a server
+  accepts connections there. Idle connections to a previous path are closed
+ @return 0 or errno, ENAMETOOLONG for a path sockaddr_un cannot hold
+ */
+int launch_socket_open(const char *path);
+
+/*!
+ @function launch_socket_close
+ @discussion Closes idle connections. Calls must not be in flight
+ */
+void launch_socket_close(void);
+
+/*!
+ @function launch_socket_frame_start
+ @discussion Empties frame and writes room for its length followed by the
+  n bytes at head. Encode the body with launch_data_encode() after it
+ @return 0 or ENOMEM
+ */
+int launch_socket_frame_start(struct launch_data_buf *frame, const void *head, size_t n);
+
+/*!
+ @function launch_socket_send
+ @discussion Fills in the length of a frame from launch_socket_frame_start()
+  and writes all of it, without raising SIGPIPE
+ @return 0 or errno
+ */
+int launch_socket_send(int fd, struct launch_data_buf *frame);
+
+/*!
+ @function launch_socket_recv
+ @discussion Reads one frame, leaving its bytes (without the length) in frame
+ @return 0, errno, ECONNRESET when the peer closes or EMSGSIZE for a frame
+  over LAUNCH_SOCKET_MAX_FRAME
+ */
+int launch_socket_recv(int fd, struct launch_data_buf *frame);
+
+/*!
+ @function launch_socket_nosigpipe
+ @discussion Keeps writes to fd from raising SIGPIPE where send() cannot be
+  asked to (Darwin)
+ */
+void launch_socket_nosigpipe(int fd);
+
+#endif
@@ -0,0 +1,756 @@
+//
+//  launch_supervisor.c
+//  liblaunchctl
+//
+//  See launch_supervisor.h
+//
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "liblaunchctl.h"
+#include "launch_data_arena.h"
+#include "launch_supervisor.h"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal 424
+#endif
+
+#define SV_THROTTLE_INTERVAL 10
+#define SV_EXIT_TIMEOUT 20
+#define SV_EVENTS 64
+#define NSEC_PER_SEC 1000000000ULL
+
+extern char **environ;
+
+// Returned by the swaps on failure, vproc_err_t only has to be non-NULL
+static char supervisor_failed;
+
+typedef enum {
+  KEEPALIVE_NEVER = 0,
+  KEEPALIVE_ALWAYS,
+  KEEPALIVE_ON_SUCCESS,
+  KEEPALIVE_ON_FAILURE
+} keepalive_t;
+
+struct sv_job {
+  // Hash chain
+  struct sv_job *next;
+  // Label, pointing into plist
+  const char *label;
+  // The submitted dictionary, a heap copy
+  launch_data_t plist;
+  keepalive_t keepalive;
+  bool abandon_pgrp;
+  uint64_t throttle_ns;
+  uint64_t exit_timeout_ns;
+  // Running process, 0 and -1 otherwise
+  pid_t pid;
+  int pidfd;
+  uint64_t started_at;
+  // Wait status of the last exit, 0 before the first one
+  int last_status;
+  // RemoveJob came while the job ran, drop it once it exits
+  bool removed;
+  // Deadlines of a throttled restart and of SIGKILL after StopJob, 0 for
+  // none. A job with either is on the timers list
+  uint64_t respawn_at;
+  uint64_t kill_at;
+  bool timed;
+  struct sv_job *timer_next;
+};
+
+// Jobs by label, and everything the supervisor thread shares with callers
+static pthread_mutex_t sv_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct sv_job **buckets = NULL;
+static size_t bucket_cnt = 0;
+static size_t job_cnt = 0;
+static struct sv_job *timers = NULL;
+
+static pthread_once_t sv_once = PTHREAD_ONCE_INIT;
+static int sv_error = 0;
+static int epfd = -1;
+static int wakefd = -1;
+static pthread_t sv_thread;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+#pragma mark Jobs
+
+static uint64_t hash_label(const char *s) {
+  uint64_t h = 14695981039346656037ULL;
+  for (; *s; s++) {
+    h ^= (unsigned char)*s;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static struct sv_job **find_slot(const char *label) {
+  if (bucket_cnt == 0) {
+    return NULL;
+  }
+  struct sv_job **p = &buckets[hash_label(label) & (bucket_cnt - 1)];
+  while (*p && strcmp((*p)->label, label) != 0) {
+    p = &(*p)->next;
+  }
+  return p;
+}
+
+static struct sv_job *find_job(const char *label) {
+  struct sv_job **p = find_slot(label);
+  return p ? *p : NULL;
+}
+
+// Keeps chains about one job long
+static bool grow_buckets(void) {
+  if (job_cnt < bucket_cnt) {
+    return true;
+  }
+  size_t cnt = bucket_cnt ? bucket_cnt * 2 : 64;
+  struct sv_job **b = calloc(cnt, sizeof(*b));
+  if (b == NULL) {
+    return false;
+  }
+  for (size_t i=0; i<bucket_cnt; i++) {
+    struct sv_job *j = buckets[i];
+    while (j) {
+      struct sv_job *next = j->next;
+      struct sv_job **slot = &b[hash_label(j->label) & (cnt - 1)];
+      j->next = *slot;
+      *slot = j;
+      j = next;
+    }
+  }
+  free(buckets);
+  buckets = b;
+  bucket_cnt = cnt;
+  return true;
+}
+
+static void free_job(struct sv_job *j) {
+  struct sv_job **p = find_slot(j->label);
+  if (p && *p == j) {
+    *p = j->next;
+    job_cnt--;
+  }
+  for (struct sv_job **t = &timers; *t; t = &(*t)->timer_next) {
+    if (*t == j) {
+      *t = j->timer_next;
+      break;
+    }
+  }
+  launch_data_free(j->plist);
+  free(j);
+}
+
+// Puts j on the timers list and makes the supervisor thread look at it
+static void arm_timer(struct sv_job *j) {
+  if (!j->timed) {
+    j->timed = true;
+    j->timer_next = timers;
+    timers = j;
+  }
+  uint64_t one = 1;
+  if (write(wakefd, &one, sizeof(one)) < 0) {
+    // Already readable
+  }
+}
+
+static int64_t get_integer(launch_data_t plist, const char *key, int64_t def) {
+  launch_data_t v = launch_data_dict_lookup(plist, key);
+  return v && launch_data_get_type(v) == LAUNCH_DATA_INTEGER ? launch_data_get_integer(v) : def;
+}
+
+static bool get_bool(launch_data_t plist, const char *key, bool def) {
+  launch_data_t v = launch_data_dict_lookup(plist, key);
+  return v && launch_data_get_type(v) == LAUNCH_DATA_BOOL ? launch_data_get_bool(v) : def;
+}
+
+static const char *get_string(launch_data_t plist, const char *key) {
+  launch_data_t v = launch_data_dict_lookup(plist, key);
+  return v && launch_data_get_type(v) == LAUNCH_DATA_STRING ? launch_data_get_string(v) : NULL;
+}
+
+static keepalive_t parse_keepalive(launch_data_t plist) {
+  launch_data_t v = launch_data_dict_lookup(plist, LAUNCH_JOBKEY_KEEPALIVE);
+  if (v == NULL) {
+    return get_bool(plist, LAUNCH_JOBKEY_ONDEMAND, true) ? KEEPALIVE_NEVER : KEEPALIVE_ALWAYS;
+  }
+  if (launch_data_get_type(v) == LAUNCH_DATA_BOOL) {
+    return launch_data_get_bool(v) ? KEEPALIVE_ALWAYS : KEEPALIVE_NEVER;
+  }
+  if (launch_data_get_type(v) == LAUNCH_DATA_DICTIONARY) {
+    launch_data_t s = launch_data_dict_lookup(v, LAUNCH_JOBKEY_KEEPALIVE_SUCCESSFULEXIT);
+    if (s && launch_data_get_type(s) == LAUNCH_DATA_BOOL) {
+      return launch_data_get_bool(s) ? KEEPALIVE_ON_SUCCESS : KEEPALIVE_ON_FAILURE;
+    }
+  }
+  return KEEPALIVE_NEVER;
+}
+
+// Checks what spawn() needs: a Label, and a Program or ProgramArguments
+// made of strings
+static bool valid_job(launch_data_t plist) {
+  if (plist == NULL || launch_data_get_type(plist) != LAUNCH_DATA_DICTIONARY
+      || get_string(plist, LAUNCH_JOBKEY_LABEL) == NULL) {
+    return false;
+  }
+  launch_data_t args = launch_data_dict_lookup(plist, LAUNCH_JOBKEY_PROGRAMARGUMENTS);
+  if (args) {
+    if (launch_data_get_type(args) != LAUNCH_DATA_ARRAY || launch_data_array_get_count(args) == 0) {
+      return false;
+    }
+    for (size_t i=0; i<launch_data_array_get_count(args); i++) {
+      launch_data_t a = launch_data_array_get_index(args, i);
+      if (a == NULL || launch_data_get_type(a) != LAUNCH_DATA_STRING) {
+        return false;
+      }
+    }
+  }
+  return get_string(plist, LAUNCH_JOBKEY_PROGRAM) != NULL || args != NULL;
+}
+
+#pragma mark Processes
+
+static int open_output(posix_spawn_file_actions_t *fa, int fd, const char *path) {
+  if (path == NULL) {
+    return posix_spawn_file_actions_addopen(fa, fd, "/dev/null", O_WRONLY, 0);
+  }
+  return posix_spawn_file_actions_addopen(fa, fd, path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+}
+
+// Starts j, with sv_lock held. Returns errno
+static int spawn(struct sv_job *j) {
+  const char *program = get_string(j->plist, LAUNCH_JOBKEY_PROGRAM);
+  launch_data_t args = launch_data_dict_lookup(j->plist, LAUNCH_JOBKEY_PROGRAMARGUMENTS);
+  size_t argc = args ? launch_data_array_get_count(args) : 1;
+  char **argv = calloc(argc + 1, sizeof(char *));
+  if (argv == NULL) {
+    return ENOMEM;
+  }
+  for (size_t i=0; i<argc; i++) {
+    argv[i] = (char *)(args ? launch_data_get_string(launch_data_array_get_index(args, i)) : program);
+  }
+
+  posix_spawn_file_actions_t fa;
+  posix_spawnattr_t attr;
+  posix_spawn_file_actions_init(&fa);
+  posix_spawnattr_init(&attr);
+
+  // Node ignores SIGPIPE and may block signals, jobs should not inherit that
+  sigset_t all, none;
+  sigfillset(&all);
+  sigemptyset(&none);
+  short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+#ifdef POSIX_SPAWN_SETSID
+  flags |= POSIX_SPAWN_SETSID;
+#else
+  flags |= POSIX_SPAWN_SETPGROUP;
+#endif
+  posix_spawnattr_setflags(&attr, flags);
+  posix_spawnattr_setsigdefault(&attr, &all);
+  posix_spawnattr_setsigmask(&attr, &none);
+
+  int err = posix_spawn_file_actions_addopen(&fa, 0, "/dev/null", O_RDONLY, 0);
+  if (!err) {
+    err = open_output(&fa, 1, get_string(j->plist, LAUNCH_JOBKEY_STANDARDOUTPATH));
+  }
+  if (!err) {
+    err = open_output(&fa, 2, get_string(j->plist, LAUNCH_JOBKEY_STANDARDERRORPATH));
+  }
+
+  pid_t pid = 0;
+  if (!err) {
+    err = program
+      ? posix_spawn(&pid, program, &fa, &attr, argv, environ)
+      : posix_spawnp(&pid, argv[0], &fa, &attr, argv, environ);
+  }
+  posix_spawn_file_actions_destroy(&fa);
+  posix_spawnattr_destroy(&attr);
+  free(argv);
+  if (err) {
+    return err;
+  }
+
+  // A child that already exited is a zombie until reaped, its pidfd is
+  // simply readable at once. pidfds are close-on-exec
+  int fd = (int)syscall(SYS_pidfd_open, pid, 0);
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.ptr = j;
+  if (fd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    err = errno;
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return err;
+  }
+  j->pid = pid;
+  j->pidfd = fd;
+  j->started_at = now_ns();
+  j->respawn_at = 0;
+  return 0;
+}
+
+static bool wants_restart(struct sv_job *j) {
+  bool success = WIFEXITED(j->last_status) && WEXITSTATUS(j->last_status) == 0;
+  switch (j->keepalive) {
+    case KEEPALIVE_ALWAYS:
+      return true;
+    case KEEPALIVE_ON_SUCCESS:
+      return success;
+    case KEEPALIVE_ON_FAILURE:
+      return !success;
+    default:
+      return false;
+  }
+}
+
+// Reaps j after its pidfd turned readable, with sv_lock held
+static void reap(struct sv_job *j) {
+  siginfo_t info;
+  memset(&info, 0, sizeof(info));
+  int ours = waitid(P_PID, (id_t)j->pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0;
+  if (ours && info.si_pid == 0) {
+    // Spurious, still running
+    return;
+  }
+  // Like launchd, take down what the job left in its process group. The
+  // unreaped leader keeps the group's id from being reused meanwhile
+  if (ours && !j->abandon_pgrp) {
+    kill(-j->pid, SIGKILL);
+  }
+  // If someone else reaped it, the status is lost and reads as a clean exit
+  int status = 0;
+  waitpid(j->pid, &status, 0);
+  epoll_ctl(epfd, EPOLL_CTL_DEL, j->pidfd, NULL);
+  close(j->pidfd);
+  j->pidfd = -1;
+  j->pid = 0;
+  j->kill_at = 0;
+  j->last_status = status;
+
+  if (j->removed) {
+    free_job(j);
+    return;
+  }
+  if (wants_restart(j)) {
+    uint64_t earliest = j->started_at + j->throttle_ns;
+    if (now_ns() >= earliest) {
+      spawn(j);
+    } else {
+      j->respawn_at = earliest;
+      arm_timer(j);
+    }
+  }
+}
+
+// Sends signo to the running job j
+static int signal_job(struct sv_job *j, int signo) {
+  if (syscall(SYS_pidfd_send_signal, j->pidfd, signo, NULL, 0) < 0) {
+    return errno == ESRCH ? 0 : errno;
+  }
+  return 0;
+}
+
+// Fires due deadlines and returns the epoll_wait timeout for the next one,
+// with sv_lock held
+static int run_timers(void) {
+  uint64_t now = now_ns(), next = 0;
+  struct sv_job **p = &timers;
+  while (*p) {
+    struct sv_job *j = *p;
+    if (j->kill_at && j->kill_at <= now) {
+      j->kill_at = 0;
+      if (j->pidfd >= 0) {
+        signal_job(j, SIGKILL);
+      }
+    }
+    if (j->respawn_at && j->respawn_at <= now) {
+      j->respawn_at = 0;
+      if (j->pidfd < 0) {
+        spawn(j);
+      }
+    }
+    uint64_t due = j->kill_at;
+    if (j->respawn_at && (due == 0 || j->respawn_at < due)) {
+      due = j->respawn_at;
+    }
+    if (due == 0) {
+      j->timed = false;
+      *p = j->timer_next;
+      continue;
+    }
+    if (next == 0 || due < next) {
+      next = due;
+    }
+    p = &j->timer_next;
+  }
+  if (next == 0) {
+    return -1;
+  }
+  // Round up so a deadline is never woken for early
+  return (int)((next - now + 999999) / 1000000);
+}
+
+static void *supervise(void *arg) {
+  struct epoll_event events[SV_EVENTS];
+  int timeout = -1;
+  for (;;) {
+    int n = epoll_wait(epfd, events, SV_EVENTS, timeout);
+    if (n < 0 && errno != EINTR) {
+      break;
+    }
+    pthread_mutex_lock(&sv_lock);
+    for (int i=0; i<n; i++) {
+      if (events[i].data.ptr == NULL) {
+        uint64_t v;
+        if (read(wakefd, &v, sizeof(v)) < 0) {
+          // Drained by an earlier event
+        }
+        continue;
+      }
+      reap(events[i].data.ptr);
+    }
+    timeout = run_timers();
+    pthread_mutex_unlock(&sv_lock);
+  }
+  return NULL;
+}
+
+static void start_thread(void) {
+  int fd = (int)syscall(SYS_pidfd_open, getpid(), 0);
+  if (fd < 0) {
+    sv_error = errno;
+    return;
+  }
+  close(fd);
+  epfd = epoll_create1(EPOLL_CLOEXEC);
+  wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (epfd < 0 || wakefd < 0) {
+    sv_error = errno;
+    return;
+  }
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, wakefd, &ev) < 0) {
+    sv_error = errno;
+    return;
+  }
+  // The thread must not take signals meant for node
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  sv_error = pthread_create(&sv_thread, NULL, supervise, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (!sv_error) {
+    pthread_detach(sv_thread);
+  }
+}
+
+int launch_supervisor_start(void) {
+  pthread_once(&sv_once, start_thread);
+  return sv_error;
+}
+
+#pragma mark Requests
+
+// Builds the job as launchd's GetJob reports it, with sv_lock held
+static launch_data_t job_info(struct sv_job *j) {
+  static const char *copied[] = {
+    LAUNCH_JOBKEY_LABEL,
+    LAUNCH_JOBKEY_PROGRAM,
+    LAUNCH_JOBKEY_PROGRAMARGUMENTS,
+    LAUNCH_JOBKEY_STANDARDOUTPATH,
+    LAUNCH_JOBKEY_STANDARDERRORPATH
+  };
+  launch_data_t info = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+  for (size_t i=0; i<sizeof(copied)/sizeof(copied[0]); i++) {
+    launch_data_t v = launch_data_dict_lookup(j->plist, copied[i]);
+    if (v) {
+      launch_data_dict_insert(info, launch_data_copy(v), copied[i]);
+    }
+  }
+  launch_data_dict_insert(info, launch_data_new_string(geteuid() == 0 ? "System" : "Background"),
+    LAUNCH_JOBKEY_LIMITLOADTOSESSIONTYPE);
+  launch_data_dict_insert(info, launch_data_new_bool(j->keepalive == KEEPALIVE_NEVER), LAUNCH_JOBKEY_ONDEMAND);
+  launch_data_dict_insert(info, launch_data_new_integer(30), LAUNCH_JOBKEY_TIMEOUT);
+  if (j->pid) {
+    launch_data_dict_insert(info, launch_data_new_integer(j->pid), LAUNCH_JOBKEY_PID);
+  } else {
+    launch_data_dict_insert(info, launch_data_new_integer(j->last_status), LAUNCH_JOBKEY_LASTEXITSTATUS);
+  }
+  return info;
+}
+
+static launch_data_t all_jobs(void) {
+  launch_data_t jobs = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+  pthread_mutex_lock(&sv_lock);
+  for (size_t i=0; i<bucket_cnt; i++) {
+    for (struct sv_job *j = buckets[i]; j; j = j->next) {
+      if (!j->removed) {
+        launch_data_dict_insert(jobs, job_info(j), j->label);
+      }
+    }
+  }
+  pthread_mutex_unlock(&sv_lock);
+  return jobs;
+}
+
+static int submit(launch_data_t plist) {
+  if (!valid_job(plist)) {
+    return EINVAL;
+  }
+  const char *label = get_string(plist, LAUNCH_JOBKEY_LABEL);
+  pthread_mutex_lock(&sv_lock);
+  if (find_job(label)) {
+    pthread_mutex_unlock(&sv_lock);
+    return EEXIST;
+  }
+  struct sv_job *j = calloc(1, sizeof(*j));
+  // The job outlives the request, keep it off any arena the caller uses
+  launch_data_arena_t prev = launch_data_arena_use(NULL);
+  launch_data_t copy = j ? launch_data_copy(plist) : NULL;
+  launch_data_arena_use(prev);
+  if (copy == NULL || !grow_buckets()) {
+    pthread_mutex_unlock(&sv_lock);
+    launch_data_free(copy);
+    free(j);
+    return ENOMEM;
+  }
+  j->plist = copy;
+  j->label = get_string(copy, LAUNCH_JOBKEY_LABEL);
+  j->keepalive = parse_keepalive(copy);
+  j->abandon_pgrp = get_bool(copy, LAUNCH_JOBKEY_ABANDONPROCESSGROUP, false);
+  j->throttle_ns = (uint64_t)get_integer(copy, LAUNCH_JOBKEY_THROTTLEINTERVAL, SV_THROTTLE_INTERVAL) * NSEC_PER_SEC;
+  j->exit_timeout_ns = (uint64_t)get_integer(copy, LAUNCH_JOBKEY_EXITTIMEOUT, SV_EXIT_TIMEOUT) * NSEC_PER_SEC;
+  j->pid = 0;
+  j->pidfd = -1;
+  struct sv_job **slot = find_slot(j->label);
+  *slot = j;
+  job_cnt++;
+
+  int err = 0;
+  if (j->keepalive != KEEPALIVE_NEVER || get_bool(copy, LAUNCH_JOBKEY_RUNATLOAD, false)) {
+    err = spawn(j);
+    if (err) {
+      free_job(j);
+    }
+  }
+  pthread_mutex_unlock(&sv_lock);
+  return err;
+}
+
+static launch_data_t submit_jobs(launch_data_t jobs) {
+  if (launch_data_get_type(jobs) != LAUNCH_DATA_ARRAY) {
+    return launch_data_new_errno(submit(jobs));
+  }
+  // One errno per job, as launchd answers a batch
+  launch_data_t resp = launch_data_alloc(LAUNCH_DATA_ARRAY);
+  for (size_t i=0; i<launch_data_array_get_count(jobs); i++) {
+    launch_data_array_set_index(resp, launch_data_new_errno(submit(launch_data_array_get_index(jobs, i))), i);
+  }
+  return resp;
+}
+
+static int control(const char *cmd, launch_data_t arg) {
+  if (launch_data_get_type(arg) != LAUNCH_DATA_STRING) {
+    return EINVAL;
+  }
+  pthread_mutex_lock(&sv_lock);
+  struct sv_job *j = find_job(launch_data_get_string(arg));
+  int err = 0;
+  if (j == NULL || j->removed) {
+    err = ESRCH;
+  } else if (strcmp(cmd, LAUNCH_KEY_STARTJOB) == 0) {
+    if (j->pid == 0) {
+      err = spawn(j);
+    }
+  } else if (j->pid == 0) {
+    if (strcmp(cmd, LAUNCH_KEY_REMOVEJOB) == 0) {
+      free_job(j);
+    }
+  } else {
+    // StopJob or RemoveJob of a running job: SIGTERM now, SIGKILL after
+    // ExitTimeOut. A kept alive job that is only stopped comes back
+    j->removed = strcmp(cmd, LAUNCH_KEY_REMOVEJOB) == 0;
+    err = signal_job(j, SIGTERM);
+    if (!err && j->kill_at == 0) {
+      j->kill_at = now_ns() + j->exit_timeout_ns;
+      arm_timer(j);
+    }
+  }
+  pthread_mutex_unlock(&sv_lock);
+  return err;
+}
+
+static launch_data_t get_job(launch_data_t arg) {
+  if (launch_data_get_type(arg) != LAUNCH_DATA_STRING) {
+    return launch_data_new_errno(EINVAL);
+  }
+  pthread_mutex_lock(&sv_lock);
+  struct sv_job *j = find_job(launch_data_get_string(arg));
+  launch_data_t resp = j && !j->removed ? job_info(j) : launch_data_new_errno(ESRCH);
+  pthread_mutex_unlock(&sv_lock);
+  return resp;
+}
+
+static launch_data_t supervisor_msg(launch_data_t request) {
+  if (sv_error || epfd < 0) {
+    errno = sv_error ? sv_error : ESRCH;
+    return NULL;
+  }
+  if (launch_data_get_type(request) == LAUNCH_DATA_STRING) {
+    if (strcmp(launch_data_get_string(request), LAUNCH_KEY_GETJOBS) == 0) {
+      return all_jobs();
+    }
+    return launch_data_new_errno(ENOTSUP);
+  }
+  if (launch_data_get_type(request) != LAUNCH_DATA_DICTIONARY
+      || launch_data_dict_get_count(request) != 1) {
+    return launch_data_new_errno(EINVAL);
+  }
+  const char *cmd = request->_array[0]->string;
+  launch_data_t arg = request->_array[1];
+  if (strcmp(cmd, LAUNCH_KEY_SUBMITJOB) == 0) {
+    return submit_jobs(arg);
+  }
+  if (strcmp(cmd, LAUNCH_KEY_GETJOB) == 0) {
+    return get_job(arg);
+  }
+  if (strcmp(cmd, LAUNCH_KEY_STARTJOB) == 0
+      || strcmp(cmd, LAUNCH_KEY_STOPJOB) == 0
+      || strcmp(cmd, LAUNCH_KEY_REMOVEJOB) == 0) {
+    return launch_data_new_errno(control(cmd, arg));
+  }
+  return launch_data_new_errno(ENOTSUP);
+}
+
+// The supervisor is the manager: its process, user and umask
+static vproc_err_t supervisor_swap_integer(vproc_t vp, vproc_gsk_t key, int64_t *inval, int64_t *outval) {
+  int64_t out;
+  switch (key) {
+    case VPROC_GSK_MGR_PID:
+      out = getpid();
+      break;
+    case VPROC_GSK_MGR_UID:
+      out = getuid();
+      break;
+    case VPROC_GSK_GLOBAL_UMASK: {
+      mode_t old = umask(inval ? (mode_t)*inval : 0);
+      if (inval == NULL) {
+        umask(old);
+      }
+      out = old;
+      break;
+    }
+    default:
+      errno = ENOTSUP;
+      return (vproc_err_t)&supervisor_failed;
+  }
+  if (outval) {
+    *outval = out;
+  }
+  return NULL;
+}
+
+static vproc_err_t supervisor_swap_string(vproc_t vp, vproc_gsk_t key, const char *inval, char **outval) {
+  if (key != VPROC_GSK_MGR_NAME || inval) {
+    errno = ENOTSUP;
+    return (vproc_err_t)&supervisor_failed;
+  }
+  if (outval) {
+    *outval = strdup(geteuid() == 0 ? "System" : "Background");
+  }
+  return NULL;
+}
+
+static vproc_err_t supervisor_swap_complex(vproc_t vp, vproc_gsk_t key, launch_data_t inval, launch_data_t *outval) {
+  if (key != VPROC_GSK_ALLJOBS || sv_error || epfd < 0) {
+    errno = sv_error ? sv_error : ENOTSUP;
+    return (vproc_err_t)&supervisor_failed;
+  }
+  if (outval) {
+    *outval = all_jobs();
+  }
+  return NULL;
+}
+
+const struct launch_transport launch_supervisor_transport = {
+  "supervisor",
+  supervisor_msg,
+  supervisor_swap_integer,
+  supervisor_swap_string,
+  supervisor_swap_complex
+};
+
+#else
+
+// epoll and pidfds are Linux only
+
+static launch_data_t supervisor_msg(launch_data_t request) {
+  errno = ENOTSUP;
+  return NULL;
+}
+
+static char supervisor_failed;
+
+static vproc_err_t supervisor_swap_integer(vproc_t vp, vproc_gsk_t key, int64_t *inval, int64_t *outval) {
+  errno = ENOTSUP;
+  return (vproc_err_t)&supervisor_failed;
+}
+
+static vproc_err_t supervisor_swap_string(vproc_t vp, vproc_gsk_t key, const char *inval, char **outval) {
+  errno = ENOTSUP;
+  return (vproc_err_t)&supervisor_failed;
+}
+
+static vproc_err_t supervisor_swap_complex(vproc_t vp, vproc_gsk_t key, launch_data_t inval, launch_data_t *outval) {
+  errno = ENOTSUP;
+  return (vproc_err_t)&supervisor_failed;
+}
+
+const struct launch_transport launch_supervisor_transport = {
+  "supervisor",
+  supervisor_msg,
+  supervisor_swap_integer,
+  supervisor_swap_string,
+  supervisor_swap_complex
+};
+
+int launch_supervisor_start(void) {
+  return ENOTSUP;
+}
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * launch_supervisor.h
+ * An in-process stand-in for launchd's job management on Linux
+ *
+ * The supervisor transport answers SubmitJob, StartJob, StopJob,
+ * RemoveJob, GetJob, GetJobs and VPROC_GSK_ALLJOBS itself, running jobs
+ * as children of this process. It reads these keys of a job dictionary:
+ *
+ *   Label, Program, ProgramArguments    what to run. Without Program,
+ *                                       ProgramArguments[0] is looked up
+ *                                       in PATH
+ *   StandardOutPath, StandardErrorPath  appended to, /dev/null otherwise
+ *   RunAtLoad                           start on submit
+ *   KeepAlive                           true, or { SuccessfulExit: bool }
+ *                                       to restart only after a zero
+ *                                       (true) or non-zero (false) exit.
+ *                                       Other conditions are ignored
+ *   OnDemand                            false is KeepAlive true
+ *   ThrottleInterval                    least seconds between two starts
+ *                                       of a kept alive job (10)
+ *   ExitTimeOut                         seconds between StopJob's
+ *                                       SIGTERM and SIGKILL (20)
+ *   AbandonProcessGroup                 true leaves what the job started
+ *                                       running once it exits
+ *
+ * GetJob answers the way launchd does: Label, Program, ProgramArguments,
+ * the standard paths, OnDemand, TimeOut, LimitLoadToSessionType, PID
+ * while the job runs and LastExitStatus (a wait status) otherwise.
+ *
+ * One thread waits on an epoll set holding a pidfd per running job, so
+ * exits are noticed without SIGCHLD or polling however many jobs run.
+ * Jobs are spawned in their own session with default signal handling.
+ * They outlive the supervisor: nothing is stopped when another transport
+ * is installed or the process exits.
+ */
+
+#ifndef LAUNCH_SUPERVISOR_H
+#define LAUNCH_SUPERVISOR_H
+
+#include "launch_transport.h"
+
+extern const struct launch_transport launch_supervisor_transport;
+
+/*!
+ @function launch_supervisor_start
+ @discussion Starts the supervisor's thread, once per process. Until it
+  has, launch_supervisor_transport fails every call
+ @return 0, ENOSYS without pidfds (Linux before 5.3), ENOTSUP on other
+  systems, or errno
+ */
+int launch_supervisor_start(void);
+
+#endif
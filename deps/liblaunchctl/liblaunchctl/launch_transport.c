@@ -0,0 +1,633 @@
+//
+//  launch_transport.c
+//  liblaunchctl
+//
+//  See launch_transport.h for the capture format
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "liblaunchctl.h"
+#include "launch_data_codec.h"
+#include "launch_transport.h"
+#include "launch_supervisor.h"
+#include "launch_socket.h"
+#include "launch_fake.h"
+
+// Nesting accepted when encoding requests and responses. launchd's own
+// messages stay far below this
+#define CAPTURE_MAX_DEPTH 256
+
+// Returned by the replay swaps on failure, vproc_err_t only has to be non-NULL
+static char replay_failed;
+
+static const struct launch_transport native_transport = {
+  "native",
+  launch_msg,
+  vproc_swap_integer,
+  vproc_swap_string,
+  vproc_swap_complex
+};
+
+// Readers are round trips, writers swap the transport, so a transport is
+// never closed while one of its calls is running
+static pthread_rwlock_t transport_lock = PTHREAD_RWLOCK_INITIALIZER;
+static const struct launch_transport *transport = &native_transport;
+static pthread_once_t env_once = PTHREAD_ONCE_INIT;
+
+#pragma mark Record
+
+static pthread_mutex_t record_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *record_file = NULL;
+
+static char *put(char *p, const void *v, size_t n) {
+  if (n) {
+    memcpy(p, v, n);
+  }
+  return p + n;
+}
+
+// Appends one round trip to the capture. A record that cannot be encoded
+// is dropped, the caller still gets launchd's answer
+static void record(char kind, int32_t key, launch_data_t request, launch_data_t response, int32_t error) {
+  struct launch_data_buf req, resp;
+  memset(&req, 0, sizeof(req));
+  memset(&resp, 0, sizeof(resp));
+  int err = request ? launch_data_encode(request, &req, CAPTURE_MAX_DEPTH) : 0;
+  if (!err && response) {
+    err = launch_data_encode(response, &resp, CAPTURE_MAX_DEPTH);
+  }
+  size_t len = 1 + sizeof(key) + sizeof(uint32_t) + req.len + sizeof(uint32_t) + resp.len + sizeof(error);
+  char *rec = err ? NULL : malloc(len);
+  if (rec) {
+    uint32_t req_len = (uint32_t)req.len, resp_len = (uint32_t)resp.len;
+    char *p = put(rec, &kind, 1);
+    p = put(p, &key, sizeof(key));
+    p = put(p, &req_len, sizeof(req_len));
+    p = put(p, req.data, req.len);
+    p = put(p, &resp_len, sizeof(resp_len));
+    p = put(p, resp.data, resp.len);
+    put(p, &error, sizeof(error));
+
+    pthread_mutex_lock(&record_lock);
+    if (record_file) {
+      fwrite(rec, 1, len, record_file);
+      // Keep what was captured so far if the process dies
+      fflush(record_file);
+    }
+    pthread_mutex_unlock(&record_lock);
+    free(rec);
+  }
+  launch_data_buf_free(&req);
+  launch_data_buf_free(&resp);
+}
+
+static launch_data_t record_msg(launch_data_t request) {
+  launch_data_t resp = launch_msg(request);
+  int e = resp ? 0 : errno;
+  record(LAUNCH_TRANSPORT_MSG, 0, request, resp, e);
+  errno = e;
+  return resp;
+}
+
+static vproc_err_t record_swap_integer(vproc_t vp, vproc_gsk_t key, int64_t *inval, int64_t *outval) {
+  vproc_err_t r = vproc_swap_integer(vp, key, inval, outval);
+  int e = r ? (errno ? errno : EIO) : 0;
+  launch_data_t in = inval ? launch_data_new_integer(*inval) : NULL;
+  launch_data_t out = (r == NULL && outval) ? launch_data_new_integer(*outval) : NULL;
+  record(LAUNCH_TRANSPORT_INTEGER, key, in, out, e);
+  if (in) launch_data_free(in);
+  if (out) launch_data_free(out);
+  errno = e;
+  return r;
+}
+
+static vproc_err_t record_swap_string(vproc_t vp, vproc_gsk_t key, const char *inval, char **outval) {
+  vproc_err_t r = vproc_swap_string(vp, key, inval, outval);
+  int e = r ? (errno ? errno : EIO) : 0;
+  launch_data_t in = inval ? launch_data_new_string(inval) : NULL;
+  launch_data_t out = (r == NULL && outval && *outval) ? launch_data_new_string(*outval) : NULL;
+  record(LAUNCH_TRANSPORT_STRING, key, in, out, e);
+  if (in) launch_data_free(in);
+  if (out) launch_data_free(out);
+  errno = e;
+  return r;
+}
+
+static vproc_err_t record_swap_complex(vproc_t vp, vproc_gsk_t key, launch_data_t inval, launch_data_t *outval) {
+  vproc_err_t r = vproc_swap_complex(vp, key, inval, outval);
+  int e = r ? (errno ? errno : EIO) : 0;
+  record(LAUNCH_TRANSPORT_COMPLEX, key, inval, (r == NULL && outval) ? *outval : NULL, e);
+  errno = e;
+  return r;
+}
+
+static const struct launch_transport record_transport = {
+  "record",
+  record_msg,
+  record_swap_integer,
+  record_swap_string,
+  record_swap_complex
+};
+
+#pragma mark Replay
+
+struct replay_entry {
+  char kind;
+  int32_t key;
+  const char *request;
+  uint32_t request_len;
+  const char *response;
+  uint32_t response_len;
+  int32_t error;
+};
+
+// Every recorded response to one request, served round robin
+struct replay_slot {
+  uint64_t hash;
+  size_t *entries;
+  size_t count;
+  size_t next;
+};
+
+struct replay {
+  char *data;
+  struct replay_entry *entries;
+  size_t count;
+  // Open addressed, mask + 1 slots
+  struct replay_slot *slots;
+  size_t mask;
+  pthread_mutex_t lock;
+};
+
+static struct replay *replay = NULL;
+
+// 64 bit FNV-1a over kind, key and request bytes
+static uint64_t replay_hash(char kind, int32_t key, const char *p, size_t len) {
+  uint64_t h = 14695981039346656037ULL;
+  h = (h ^ (unsigned char)kind) * 1099511628211ULL;
+  for (size_t i=0; i<sizeof(key); i++) {
+    h = (h ^ ((const unsigned char *)&key)[i]) * 1099511628211ULL;
+  }
+  for (size_t i=0; i<len; i++) {
+    h = (h ^ (unsigned char)p[i]) * 1099511628211ULL;
+  }
+  return h;
+}
+
+static int replay_same(const struct replay_entry *e, char kind, int32_t key, const char *p, size_t len) {
+  return e->kind == kind && e->key == key && e->request_len == len
+    && memcmp(e->request, p, len) == 0;
+}
+
+// The slot answering this request, or the empty one it would go in
+static struct replay_slot *replay_slot(struct replay *r, uint64_t hash, char kind, int32_t key, const char *p, size_t len) {
+  for (size_t i=hash & r->mask;; i=(i + 1) & r->mask) {
+    struct replay_slot *s = &r->slots[i];
+    if (s->count == 0) {
+      return s;
+    }
+    if (s->hash == hash && replay_same(&r->entries[s->entries[0]], kind, key, p, len)) {
+      return s;
+    }
+  }
+}
+
+static void replay_free(struct replay *r) {
+  if (r == NULL) {
+    return;
+  }
+  if (r->slots) {
+    for (size_t i=0; i<=r->mask; i++) {
+      free(r->slots[i].entries);
+    }
+  }
+  free(r->slots);
+  free(r->entries);
+  free(r->data);
+  pthread_mutex_destroy(&r->lock);
+  free(r);
+}
+
+static int read_file(const char *path, char **data, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    return errno;
+  }
+  size_t cap = 65536;
+  char *buf = malloc(cap);
+  size_t n = 0;
+  while (buf) {
+    n += fread(buf + n, 1, cap - n, f);
+    if (n < cap) {
+      break;
+    }
+    char *grown = realloc(buf, cap * 2);
+    if (grown == NULL) {
+      free(buf);
+      buf = NULL;
+      break;
+    }
+    buf = grown;
+    cap *= 2;
+  }
+  int err = buf == NULL ? ENOMEM : (ferror(f) ? EIO : 0);
+  fclose(f);
+  if (err) {
+    free(buf);
+    return err;
+  }
+  *data = buf;
+  *len = n;
+  return 0;
+}
+
+// Reads n bytes at *p, failing past end
+#define TAKE(dst, n) do { \
+  if ((size_t)(end - p) < (n)) { err = EMALFORM; goto out; } \
+  memcpy((dst), p, (n)); \
+  p += (n); \
+} while (0)
+
+static int replay_load(const char *path, struct replay **out) {
+  struct replay *r = calloc(1, sizeof(*r));
+  if (r == NULL) {
+    return ENOMEM;
+  }
+  pthread_mutex_init(&r->lock, NULL);
+  size_t len = 0;
+  int err = read_file(path, &r->data, &len);
+  if (err) {
+    replay_free(r);
+    return err;
+  }
+
+  const char *p = r->data, *end = r->data + len;
+  char magic[4];
+  uint32_t version;
+  size_t cap = 0;
+  TAKE(magic, sizeof(magic));
+  TAKE(&version, sizeof(version));
+  if (memcmp(magic, LAUNCH_TRANSPORT_MAGIC, sizeof(magic)) || version != LAUNCH_TRANSPORT_VERSION) {
+    err = EMALFORM;
+    goto out;
+  }
+  while (p < end) {
+    if (r->count == cap) {
+      cap = cap ? cap * 2 : 256;
+      struct replay_entry *grown = realloc(r->entries, cap * sizeof(*grown));
+      if (grown == NULL) {
+        err = ENOMEM;
+        goto out;
+      }
+      r->entries = grown;
+    }
+    struct replay_entry *e = &r->entries[r->count];
+    TAKE(&e->kind, 1);
+    TAKE(&e->key, sizeof(e->key));
+    TAKE(&e->request_len, sizeof(e->request_len));
+    e->request = p;
+    if ((size_t)(end - p) < e->request_len) { err = EMALFORM; goto out; }
+    p += e->request_len;
+    TAKE(&e->response_len, sizeof(e->response_len));
+    e->response = p;
+    if ((size_t)(end - p) < e->response_len) { err = EMALFORM; goto out; }
+    p += e->response_len;
+    TAKE(&e->error, sizeof(e->error));
+    r->count++;
+  }
+
+  // Index requests, at most half full
+  size_t size = 16;
+  while (size < r->count * 2) {
+    size *= 2;
+  }
+  r->mask = size - 1;
+  r->slots = calloc(size, sizeof(*r->slots));
+  if (r->slots == NULL) {
+    err = ENOMEM;
+    goto out;
+  }
+  for (size_t i=0; i<r->count; i++) {
+    struct replay_entry *e = &r->entries[i];
+    uint64_t hash = replay_hash(e->kind, e->key, e->request, e->request_len);
+    struct replay_slot *s = replay_slot(r, hash, e->kind, e->key, e->request, e->request_len);
+    size_t *grown = realloc(s->entries, (s->count + 1) * sizeof(*grown));
+    if (grown == NULL) {
+      err = ENOMEM;
+      goto out;
+    }
+    s->hash = hash;
+    s->entries = grown;
+    s->entries[s->count++] = i;
+  }
+
+out:
+  if (err) {
+    replay_free(r);
+    return err;
+  }
+  *out = r;
+  return 0;
+}
+
+#undef TAKE
+
+// The next recorded answer to request, or NULL with errno ENOENT
+static const struct replay_entry *replay_next(char kind, int32_t key, launch_data_t request) {
+  struct launch_data_buf buf;
+  memset(&buf, 0, sizeof(buf));
+  if (request) {
+    int err = launch_data_encode(request, &buf, CAPTURE_MAX_DEPTH);
+    if (err) {
+      launch_data_buf_free(&buf);
+      errno = err;
+      return NULL;
+    }
+  }
+  const struct replay_entry *e = NULL;
+  uint64_t hash = replay_hash(kind, key, buf.data, buf.len);
+  pthread_mutex_lock(&replay->lock);
+  struct replay_slot *s = replay_slot(replay, hash, kind, key, buf.data, buf.len);
+  if (s->count) {
+    e = &replay->entries[s->entries[s->next]];
+    s->next = (s->next + 1) % s->count;
+  }
+  pthread_mutex_unlock(&replay->lock);
+  launch_data_buf_free(&buf);
+  if (e == NULL) {
+    errno = ENOENT;
+  }
+  return e;
+}
+
+static launch_data_t replay_response(const struct replay_entry *e) {
+  return e->response_len ? launch_data_decode(e->response, e->response_len, NULL) : NULL;
+}
+
+static launch_data_t replay_msg(launch_data_t request) {
+  const struct replay_entry *e = replay_next(LAUNCH_TRANSPORT_MSG, 0, request);
+  if (e == NULL) {
+    return NULL;
+  }
+  if (e->response_len == 0) {
+    errno = e->error;
+    return NULL;
+  }
+  return replay_response(e);
+}
+
+static vproc_err_t replay_swap_integer(vproc_t vp, vproc_gsk_t key, int64_t *inval, int64_t *outval) {
+  launch_data_t in = inval ? launch_data_new_integer(*inval) : NULL;
+  const struct replay_entry *e = replay_next(LAUNCH_TRANSPORT_INTEGER, key, in);
+  if (in) launch_data_free(in);
+  if (e == NULL) {
+    return (vproc_err_t)&replay_failed;
+  }
+  if (e->error) {
+    errno = e->error;
+    return (vproc_err_t)&replay_failed;
+  }
+  if (outval) {
+    launch_data_t out = replay_response(e);
+    if (out == NULL) {
+      return (vproc_err_t)&replay_failed;
+    }
+    *outval = launch_data_get_integer(out);
+    launch_data_free(out);
+  }
+  return NULL;
+}
+
+static vproc_err_t replay_swap_string(vproc_t vp, vproc_gsk_t key, const char *inval, char **outval) {
+  launch_data_t in = inval ? launch_data_new_string(inval) : NULL;
+  const struct replay_entry *e = replay_next(LAUNCH_TRANSPORT_STRING, key, in);
+  if (in) launch_data_free(in);
+  if (e == NULL) {
+    return (vproc_err_t)&replay_failed;
+  }
+  if (e->error) {
+    errno = e->error;
+    return (vproc_err_t)&replay_failed;
+  }
+  if (outval) {
+    *outval = NULL;
+    launch_data_t out = replay_response(e);
+    if (out) {
+      *outval = strdup(launch_data_get_string(out));
+      launch_data_free(out);
+    }
+  }
+  return NULL;
+}
+
+static vproc_err_t replay_swap_complex(vproc_t vp, vproc_gsk_t key, launch_data_t inval, launch_data_t *outval) {
+  const struct replay_entry *e = replay_next(LAUNCH_TRANSPORT_COMPLEX, key, inval);
+  if (e == NULL) {
+    return (vproc_err_t)&replay_failed;
+  }
+  if (e->error) {
+    errno = e->error;
+    return (vproc_err_t)&replay_failed;
+  }
+  if (outval) {
+    *outval = replay_response(e);
+  }
+  return NULL;
+}
+
+static const struct launch_transport replay_transport = {
+  "replay",
+  replay_msg,
+  replay_swap_integer,
+  replay_swap_string,
+  replay_swap_complex
+};
+
+#pragma mark Selection
+
+// Closes the record, replay or socket transport, with transport_lock held
+// for writing
+static void close_transport(void) {
+  if (record_file) {
+    pthread_mutex_lock(&record_lock);
+    fclose(record_file);
+    record_file = NULL;
+    pthread_mutex_unlock(&record_lock);
+  }
+  replay_free(replay);
+  replay = NULL;
+  if (transport == &launch_socket_transport) {
+    launch_socket_close();
+  }
+  transport = &native_transport;
+}
+
+static int start_record(const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    return errno;
+  }
+  uint32_t version = LAUNCH_TRANSPORT_VERSION;
+  if (fwrite(LAUNCH_TRANSPORT_MAGIC, 1, 4, f) != 4
+      || fwrite(&version, sizeof(version), 1, f) != 1
+      || fflush(f)) {
+    int err = errno ? errno : EIO;
+    fclose(f);
+    return err;
+  }
+  pthread_rwlock_wrlock(&transport_lock);
+  close_transport();
+  record_file = f;
+  transport = &record_transport;
+  pthread_rwlock_unlock(&transport_lock);
+  return 0;
+}
+
+static int start_replay(const char *path) {
+  struct replay *r;
+  int err = replay_load(path, &r);
+  if (err) {
+    return err;
+  }
+  pthread_rwlock_wrlock(&transport_lock);
+  close_transport();
+  replay = r;
+  transport = &replay_transport;
+  pthread_rwlock_unlock(&transport_lock);
+  return 0;
+}
+
+static int start_supervisor(void) {
+  int err = launch_supervisor_start();
+  if (err) {
+    return err;
+  }
+  pthread_rwlock_wrlock(&transport_lock);
+  close_transport();
+  transport = &launch_supervisor_transport;
+  pthread_rwlock_unlock(&transport_lock);
+  return 0;
+}
+
+static int start_socket(const char *path) {
+  pthread_rwlock_wrlock(&transport_lock);
+  close_transport();
+  int err = launch_socket_open(path);
+  if (!err) {
+    transport = &launch_socket_transport;
+  }
+  pthread_rwlock_unlock(&transport_lock);
+  return err;
+}
+
+static int start_fake(const char *spec) {
+  pthread_rwlock_wrlock(&transport_lock);
+  close_transport();
+  int err = launch_fake_configure(spec);
+  if (!err) {
+    transport = &launch_fake_transport;
+  }
+  pthread_rwlock_unlock(&transport_lock);
+  return err;
+}
+
+static void transport_from_env(void) {
+  const char *spec = getenv("LAUNCHCTL_TRANSPORT");
+  if (spec == NULL || *spec == '\0' || strcmp(spec, "native") == 0) {
+    return;
+  }
+  int err = EINVAL;
+  if (strncmp(spec, "record:", 7) == 0) {
+    err = start_record(spec + 7);
+  } else if (strncmp(spec, "replay:", 7) == 0) {
+    err = start_replay(spec + 7);
+  } else if (strcmp(spec, "supervisor") == 0) {
+    err = start_supervisor();
+  } else if (strncmp(spec, "socket:", 7) == 0) {
+    err = start_socket(spec + 7);
+  } else if (strcmp(spec, "fake") == 0) {
+    err = start_fake(NULL);
+  } else if (strncmp(spec, "fake:", 5) == 0) {
+    err = start_fake(spec + 5);
+  }
+  if (err) {
+    fprintf(stderr, "LAUNCHCTL_TRANSPORT=%s: %s\n", spec, strerror(err));
+  }
+}
+
+void launch_transport_set(const struct launch_transport *t) {
+  pthread_once(&env_once, transport_from_env);
+  pthread_rwlock_wrlock(&transport_lock);
+  close_transport();
+  if (t) {
+    transport = t;
+  }
+  pthread_rwlock_unlock(&transport_lock);
+}
+
+int launch_transport_record(const char *path) {
+  pthread_once(&env_once, transport_from_env);
+  return start_record(path);
+}
+
+int launch_transport_replay(const char *path) {
+  pthread_once(&env_once, transport_from_env);
+  return start_replay(path);
+}
+
+int launch_transport_supervise(void) {
+  pthread_once(&env_once, transport_from_env);
+  return start_supervisor();
+}
+
+int launch_transport_connect(const char *path) {
+  pthread_once(&env_once, transport_from_env);
+  return start_socket(path);
+}
+
+int launch_transport_fake(const char *spec) {
+  pthread_once(&env_once, transport_from_env);
+  return start_fake(spec);
+}
+
+const char *launch_transport_name(void) {
+  pthread_once(&env_once, transport_from_env);
+  pthread_rwlock_rdlock(&transport_lock);
+  const char *name = transport->name;
+  pthread_rwlock_unlock(&transport_lock);
+  return name;
+}
+
+#pragma mark Round trips
+
+// Runs call against the installed transport, keeping its errno
+#define DISPATCH(type, call) \
+  pthread_once(&env_once, transport_from_env); \
+  pthread_rwlock_rdlock(&transport_lock); \
+  type r = transport->call; \
+  int e = errno; \
+  pthread_rwlock_unlock(&transport_lock); \
+  errno = e; \
+  return r;
+
+launch_data_t launch_transport_msg(launch_data_t request) {
+  DISPATCH(launch_data_t, msg(request))
+}
+
+vproc_err_t launch_transport_swap_integer(vproc_t vp, vproc_gsk_t key, int64_t *inval, int64_t *outval) {
+  DISPATCH(vproc_err_t, swap_integer(vp, key, inval, outval))
+}
+
+vproc_err_t launch_transport_swap_string(vproc_t vp, vproc_gsk_t key, const char *inval, char **outval) {
+  DISPATCH(vproc_err_t, swap_string(vp, key, inval, outval))
+}
+
+vproc_err_t launch_transport_swap_complex(vproc_t vp, vproc_gsk_t key, launch_data_t inval, launch_data_t *outval) {
+  DISPATCH(vproc_err_t, swap_complex(vp, key, inval, outval))
+}
+
+#undef DISPATCH
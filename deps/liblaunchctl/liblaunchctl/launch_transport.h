@@ -0,0 +1,125 @@
+/*
+ * launch_transport.h
+ * Where launchd round trips go
+ *
+ * liblaunchctl and the node bindings never call launch_msg() or
+ * vproc_swap_*() directly. They call the launch_transport_* wrappers below,
+ * which forward to the installed transport:
+ *
+ *   native  launchd itself (the default)
+ *   record  launchd, appending each request and its response to a capture
+ *   replay  answers from a capture and never talks to launchd
+ *   supervisor
+ *           runs jobs in this process instead of launchd, on Linux. See
+ *           launch_supervisor.h
+ *   socket  sends each round trip to a server on an AF_UNIX socket, see
+ *           launch_socket.h
+ *   fake    answers from synthetic jobs in this process, with injected
+ *           latency and errors. See launch_fake.h
+ *
+ * A capture starts with the magic "LDTR" and a u32 version, followed by
+ * one record per round trip:
+ *
+ *   u8  kind       'M' launch_msg, 'I' / 'S' / 'C' vproc_swap_integer,
+ *                  _string and _complex
+ *   i32 key        vproc_gsk_t, 0 for launch_msg
+ *   u32 + bytes    request, encoded as in launch_data_codec.h (length 0
+ *                  for none)
+ *   u32 + bytes    response, encoded the same way (length 0 for none)
+ *   i32 error      errno of a failed launch_msg or swap, 0 otherwise
+ *
+ * Integers are in host byte order, like the codec. Replay looks requests
+ * up by kind, key and encoded bytes. Repeats of one request get its
+ * recorded responses in order, and start over after the last one, so a
+ * short capture can drive a long benchmark. A request the capture never
+ * saw fails with ENOENT.
+ *
+ * Setting LAUNCHCTL_TRANSPORT to "record:<path>", "replay:<path>",
+ * "supervisor", "socket:<path>", "fake" or "fake:<spec>" installs that
+ * transport before the first round trip.
+ */
+
+#ifndef LAUNCH_TRANSPORT_H
+#define LAUNCH_TRANSPORT_H
+
+#include <stdint.h>
+#include <launch.h>
+#include <vproc.h>
+#include "vproc_priv.h"
+
+#define LAUNCH_TRANSPORT_MAGIC "LDTR"
+#define LAUNCH_TRANSPORT_VERSION 1
+
+#define LAUNCH_TRANSPORT_MSG 'M'
+#define LAUNCH_TRANSPORT_INTEGER 'I'
+#define LAUNCH_TRANSPORT_STRING 'S'
+#define LAUNCH_TRANSPORT_COMPLEX 'C'
+
+// Same contracts as the launchd calls they stand in for
+struct launch_transport {
+  const char *name;
+  launch_data_t (*msg)(launch_data_t request);
+  vproc_err_t (*swap_integer)(vproc_t vp, vproc_gsk_t key, int64_t *inval, int64_t *outval);
+  vproc_err_t (*swap_string)(vproc_t vp, vproc_gsk_t key, const char *inval, char **outval);
+  vproc_err_t (*swap_complex)(vproc_t vp, vproc_gsk_t key, launch_data_t inval, launch_data_t *outval);
+};
+
+/*!
+ @function launch_transport_set
+ @discussion Installs t for every following round trip, waiting for those in
+  flight. A record or replay transport in use is closed
+ @param t
+  The transport, which must outlive its use. NULL for native
+ */
+void launch_transport_set(const struct launch_transport *t);
+
+/*!
+ @function launch_transport_record
+ @discussion Installs the record transport, truncating path
+ @return 0 or errno
+ */
+int launch_transport_record(const char *path);
+
+/*!
+ @function launch_transport_replay
+ @discussion Loads the capture at path and installs the replay transport
+ @return 0, errno, or EMALFORM for a file that is not a capture
+ */
+int launch_transport_replay(const char *path);
+
+/*!
+ @function launch_transport_supervise
+ @discussion Starts the supervisor and installs its transport
+ @return 0 or errno, see launch_supervisor_start()
+ */
+int launch_transport_supervise(void);
+
+/*!
+ @function launch_transport_connect
+ @discussion Installs the socket transport, talking to the server listening
+  at path. On failure the native transport is left installed
+ @return 0 or errno, see launch_socket_open()
+ */
+int launch_transport_connect(const char *path);
+
+/*!
+ @function launch_transport_fake
+ @discussion Configures the fake transport from spec and installs it. On
+  failure the native transport is left installed
+ @return 0 or errno, see launch_fake_configure()
+ */
+int launch_transport_fake(const char *spec);
+
+/*!
+ @function launch_transport_name
+ @return "native", "record", "replay", "supervisor", "socket", "fake" or
+  the name of a custom transport
+ */
+const char *launch_transport_name(void);
+
+launch_data_t launch_transport_msg(launch_data_t request);
+vproc_err_t launch_transport_swap_integer(vproc_t vp, vproc_gsk_t key, int64_t *inval, int64_t *outval);
+vproc_err_t launch_transport_swap_string(vproc_t vp, vproc_gsk_t key, const char *inval, char **outval);
+vproc_err_t launch_transport_swap_complex(vproc_t vp, vproc_gsk_t key, launch_data_t inval, launch_data_t *outval);
+
+#endif
@@ -7,9 +7,13 @@
 //
 
 #include <launch.h>
+#include <pthread.h>
 #include "liblaunchctl.h"
+#include "launch_transport.h"
+#ifdef __APPLE__
 #include <CoreFoundation/CoreFoundation.h>
 #include <NSSystemDirectories.h>
+#endif
 #ifdef __MAC_10_7
 #include <fcntl.h>
 #endif
@@ -31,6 +35,7 @@
 #define BOOTSTRAP_STATUS_ACTIVE			1
 #define BOOTSTRAP_STATUS_ON_DEMAND		2
 
+#ifdef __APPLE__
 static bool _launchctl_system_bootstrap;
 static bool _launchctl_peruser_bootstrap;
 static bool _launchctl_overrides_db_changed = false;
@@ -52,7 +57,6 @@ static mach_port_t str2bsport(const char *s);
 CFTypeRef CFTypeCreateFromLaunchData(launch_data_t obj);
 CFArrayRef CFArrayCreateFromLaunchArray(launch_data_t arr);
 CFDictionaryRef CFDictionaryCreateFromLaunchDictionary(launch_data_t dict);
-bool launch_data_array_append(launch_data_t a, launch_data_t o);
 void insert_event(launch_data_t, const char *, const char *, launch_data_t);
 void distill_jobs(launch_data_t);
 void distill_config_file(launch_data_t);
@@ -70,7 +74,10 @@ bool path_check(const char *path);
 
 
 kern_return_t bootstrap_parent(mach_port_t bp, mach_port_t *parent_port);
+#endif
+bool launch_data_array_append(launch_data_t a, launch_data_t o);
 
+#ifdef __APPLE__
 static inline Boolean _is_launch_data_t(launch_data_t obj) {
 	Boolean result = true;
   
@@ -100,6 +107,7 @@ static void _launch_data_iterate(launch_data_t obj, const char *key, CFMutableDi
 		CFRelease(cfKey);
 	}
 }
+#endif
 
 
 launch_data_t launchctl_list_job(const char *job) {
@@ -110,7 +118,7 @@ launch_data_t launchctl_list_job(const char *job) {
   }
 	msg = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
 	launch_data_dict_insert(msg, launch_data_new_string(job), LAUNCH_KEY_GETJOB);
-	resp = launch_msg(msg);
+	resp = launch_transport_msg(msg);
 	launch_data_free(msg);
   
 	if (resp == NULL) {
@@ -119,6 +127,11 @@ launch_data_t launchctl_list_job(const char *job) {
 	} else if (launch_data_get_type(resp) == LAUNCH_DATA_DICTIONARY) {
 		r = 0;
 	} else {
+    // Report launchd's errno (ESRCH for unknown labels) instead of leaking it
+    int e = launch_data_get_type(resp) == LAUNCH_DATA_ERRNO
+      ? launch_data_get_errno(resp) : EMALFORM;
+    launch_data_free(resp);
+    errno = e ? e : ESRCH;
     r = 1;
   }
 	
@@ -130,34 +143,33 @@ launch_data_t launchctl_list_job(const char *job) {
 }
 
 launch_data_status_t getjob(launch_data_t job) {
+  launch_data_t lo = launch_data_dict_lookup(job, LAUNCH_JOBKEY_LABEL);
+  if (lo == NULL || launch_data_get_type(lo) != LAUNCH_DATA_STRING) {
+    return NULL;
+  }
   launch_data_status_t result = calloc(1, sizeof(struct ldtstatus));
   if (result == NULL) {
     fprintf(stderr, "Unable to allocate memory: %s\n", "launch_data_status_t getjob()");
     return NULL;
   }
-  launch_data_t lo = launch_data_dict_lookup(job, LAUNCH_JOBKEY_LABEL);
   launch_data_t pido = launch_data_dict_lookup(job, LAUNCH_JOBKEY_PID);
   launch_data_t stato = launch_data_dict_lookup(job, LAUNCH_JOBKEY_LASTEXITSTATUS);
   result->label = strdup(launch_data_get_string(lo));
+  // -1 for a job that is not running or has no exit status
+  result->pid = -1;
+  result->status = -1;
+  result->signal = -1;
   if (pido) {
     // Running -> Has a PID
     result->pid = (int)launch_data_get_integer(pido);
-    result->status = -1;
   } else if (stato) {
     // Has a last exit status
     int wstatus = (int)launch_data_get_integer(stato);
-    result->pid = -1;
     if (WIFEXITED(wstatus)) {
       result->status = WEXITSTATUS(wstatus);
     } else if (WIFSIGNALED(wstatus)) {
-      result->status = WTERMSIG(wstatus);
-    } else {
-      result->status = -1;
+      result->signal = WTERMSIG(wstatus);
     }
-  } else {
-    // Does not have a PID or Last Exit Status
-    result->pid = -1;
-    result->status = -1;
   }
   
   return result;
@@ -170,6 +182,7 @@ void launch_data_status_free(launch_data_status_t j) {
   if (j->label) {
     free(j->label);
   }
+  free(j);
 }
 
 int launchctl_start_job(const char *job) {
@@ -182,7 +195,7 @@ int launchctl_start_job(const char *job) {
   int e, r = 0;
   msg = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
   launch_data_dict_insert(msg, launch_data_new_string(job), LAUNCH_KEY_STARTJOB);
-  resp = launch_msg(msg);
+  resp = launch_transport_msg(msg);
   launch_data_free(msg);
   
   if (resp == NULL) {
@@ -208,7 +221,7 @@ int launchctl_stop_job(const char *job) {
   int e, r = 0;
   msg = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
   launch_data_dict_insert(msg, launch_data_new_string(job), LAUNCH_KEY_STOPJOB);
-  resp = launch_msg(msg);
+  resp = launch_transport_msg(msg);
   launch_data_free(msg);
   
   if (resp == NULL) {
@@ -234,7 +247,7 @@ int launchctl_remove_job(const char *job) {
   int e, r = 0;
   msg = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
   launch_data_dict_insert(msg, launch_data_new_string(job), LAUNCH_KEY_REMOVEJOB);
-  resp = launch_msg(msg);
+  resp = launch_transport_msg(msg);
   launch_data_free(msg);
   
   if (resp == NULL) {
@@ -251,6 +264,7 @@ int launchctl_remove_job(const char *job) {
   return r;
 }
 
+#ifdef __APPLE__
 int launchctl_load_job(const char *job, bool editondisk, bool forceload, const char *session_type, const char *domain) {
   if (geteuid() == 0) {
 		setup_system_context();
@@ -286,7 +300,7 @@ int launchctl_load_job(const char *job, bool editondisk, bool forceload, const c
   }
   int dbfd = -1;
   
-  vproc_err_t verr = vproc_swap_string(NULL, VPROC_GSK_JOB_OVERRIDES_DB, NULL, &_launchctl_job_overrides_db_path);
+  vproc_err_t verr = launch_transport_swap_string(NULL, VPROC_GSK_JOB_OVERRIDES_DB, NULL, &_launchctl_job_overrides_db_path);
   if (verr) {
     if (bootstrap_port) {
       fprintf(stderr, "Could not get location of job overrides database: ppid/bootstrap: %d/0x%x\n", getppid(), bootstrap_port);
@@ -380,7 +394,7 @@ int launchctl_unload_job(const char *job, bool editondisk, bool forceload, const
   
   int dbfd = -1;
   
-  vproc_err_t verr = vproc_swap_string(NULL, VPROC_GSK_JOB_OVERRIDES_DB, NULL, &_launchctl_job_overrides_db_path);
+  vproc_err_t verr = launch_transport_swap_string(NULL, VPROC_GSK_JOB_OVERRIDES_DB, NULL, &_launchctl_job_overrides_db_path);
   if (verr) {
     if (bootstrap_port) {
       fprintf(stderr, "Could not get location of job overrides database: ppid/bootstrap: %d/0x%x\n", getppid(), bootstrap_port);
@@ -447,13 +461,25 @@ int launchctl_unload_job(const char *job, bool editondisk, bool forceload, const
 	close(dbfd);
 	return res;
 }
+#else
+// Loading reads plists through CoreFoundation, which only exists on Apple
+int launchctl_load_job(const char *job, bool editondisk, bool forceload, const char *session_type, const char *domain) {
+  errno = ENOTSUP;
+  return ENOTSUP;
+}
+
+int launchctl_unload_job(const char *job, bool editondisk, bool forceload, const char *session_type, const char *domain) {
+  errno = ENOTSUP;
+  return ENOTSUP;
+}
+#endif
 
 char *launchctl_get_managername() {
   if (geteuid() == 0) {
 		setup_system_context();
 	}
 	char *mgmrname = NULL;
-  vproc_err_t verr = vproc_swap_string(NULL, VPROC_GSK_MGR_NAME, NULL, &mgmrname);
+  vproc_err_t verr = launch_transport_swap_string(NULL, VPROC_GSK_MGR_NAME, NULL, &mgmrname);
   if (verr) {
     return NULL;
   }
@@ -465,7 +491,7 @@ int64_t launchctl_get_manageruid() {
 		setup_system_context();
 	}
   int64_t manager_uid = 0;
-  vproc_err_t verr = vproc_swap_integer(NULL, VPROC_GSK_MGR_UID, NULL, (int64_t *)&manager_uid);
+  vproc_err_t verr = launch_transport_swap_integer(NULL, VPROC_GSK_MGR_UID, NULL, (int64_t *)&manager_uid);
   if (verr) {
     fprintf(stderr, "Unknown job manager\n");
     return -1;
@@ -478,7 +504,7 @@ int launchctl_get_managerpid() {
 		setup_system_context();
 	}
   int64_t manager_pid = 0;
-  vproc_err_t verr = vproc_swap_integer(NULL, VPROC_GSK_MGR_PID, NULL, (int64_t *)&manager_pid);
+  vproc_err_t verr = launch_transport_swap_integer(NULL, VPROC_GSK_MGR_PID, NULL, (int64_t *)&manager_pid);
   if (verr) {
     fprintf(stderr, "Unknown job manager\n");
     return -1;
@@ -491,7 +517,7 @@ int64_t launchctl_getumask() {
 		setup_system_context();
 	}
   int64_t outval;
-  if (vproc_swap_integer(NULL, VPROC_GSK_GLOBAL_UMASK, NULL, &outval) == NULL) {
+  if (launch_transport_swap_integer(NULL, VPROC_GSK_GLOBAL_UMASK, NULL, &outval) == NULL) {
     return outval;
   } else {
     return -1;
@@ -513,7 +539,7 @@ int launchctl_setumask(const char *mask) {
   
   inval = m;
   
-  if (vproc_swap_integer(NULL, VPROC_GSK_GLOBAL_UMASK, &inval, &outval) == NULL) {
+  if (launch_transport_swap_integer(NULL, VPROC_GSK_GLOBAL_UMASK, &inval, &outval) == NULL) {
     return r;
   } else {
     r = errno;
@@ -564,7 +590,7 @@ int launchctl_submit_job(int argc, char *const argv[]) {
   
   launch_data_dict_insert(msg, job, LAUNCH_KEY_SUBMITJOB);
   
-  resp = launch_msg(msg);
+  resp = launch_transport_msg(msg);
   launch_data_free(msg);
   
   if (resp == NULL) {
@@ -584,6 +610,7 @@ int launchctl_submit_job(int argc, char *const argv[]) {
 }
 
 
+#ifdef __APPLE__
 CFTypeRef CFTypeCreateFromLaunchData(launch_data_t obj) {
   CFTypeRef cfObj = NULL;
   
@@ -821,7 +848,7 @@ void readfile(const char *what, struct load_unload_state *lus) {
 	 * <rdar://problem/8297909>
 	 */
 	if (!_launchctl_managername) {
-		if (vproc_swap_string(NULL, VPROC_GSK_MGR_NAME, NULL, &_launchctl_managername)) {
+		if (launch_transport_swap_string(NULL, VPROC_GSK_MGR_NAME, NULL, &_launchctl_managername)) {
 			if (bootstrap_port) {
 				/* This is only an error if we are running with a neutered
 				 * bootstrap port, otherwise we wouldn't expect this operating to
@@ -1131,6 +1158,7 @@ void WriteMyPropertyListToFile(CFPropertyListRef plist, const char *posixfile) {
         CFRelease(fileURL);
     }
 }
+#endif
 
 bool launch_data_array_append(launch_data_t a, launch_data_t o) {
 	size_t offt = launch_data_array_get_count(a);
@@ -1138,6 +1166,7 @@ bool launch_data_array_append(launch_data_t a, launch_data_t o) {
 	return launch_data_array_set_index(a, o, offt);
 }
 
+#ifdef __APPLE__
 static launch_data_t read_plist_file(const char *file, bool editondisk, bool load) {
 	CFPropertyListRef plist = CreateMyPropertyListFromFile(file);
 	launch_data_t r = NULL;
@@ -1617,7 +1646,7 @@ int submit_job_pass(launch_data_t jobs) {
   
 	launch_data_dict_insert(msg, jobs, LAUNCH_KEY_SUBMITJOB);
   
-	resp = launch_msg(msg);
+	resp = launch_transport_msg(msg);
   
 	if (resp) {
 		switch (launch_data_get_type(resp)) {
@@ -1669,9 +1698,12 @@ int submit_job_pass(launch_data_t jobs) {
 	launch_data_free(msg);
   return e;
 }
+#endif
 
-void
-setup_system_context(void)
+static pthread_once_t _launchctl_system_context_once = PTHREAD_ONCE_INIT;
+
+static void
+establish_system_context(void)
 {
 	if (getenv(LAUNCHD_SOCKET_ENV)) {
 		return;
@@ -1689,13 +1721,27 @@ setup_system_context(void)
 	/* Use the system launchd's socket. */
 	setenv("__USE_SYSTEM_LAUNCHD", "1", 0);
   
+#ifdef __APPLE__
 	/* Put ourselves in the system launchd's bootstrap. */
 	mach_port_t rootbs = str2bsport("/");
 	mach_port_deallocate(mach_task_self(), bootstrap_port);
 	task_set_bootstrap_port(mach_task_self(), rootbs);
 	bootstrap_port = rootbs;
+#endif
 }
 
+/*
+ * The bootstrap port and environment belong to the whole task, so the
+ * context is only established once per process. Later calls, from any
+ * thread, return once the first one has finished.
+ */
+void
+setup_system_context(void)
+{
+	pthread_once(&_launchctl_system_context_once, establish_system_context);
+}
+
+#ifdef __APPLE__
 mach_port_t
 str2bsport(const char *s)
 {
@@ -1739,6 +1785,7 @@ str2bsport(const char *s)
   
 	return bport;
 }
+#endif
 
 ssize_t
 name2num(const char *n)
@@ -1771,7 +1818,7 @@ lim2str(rlim_t val, char *buf)
 	if (val == RLIM_INFINITY)
 		strcpy(buf, "unlimited");
 	else
-		sprintf(buf, "%lld", val);
+		sprintf(buf, "%lld", (long long)val);
 	return buf;
 }
 
@@ -36,7 +36,9 @@
 #include <sys/types.h>
 #include <sys/param.h>
 #include <sys/stat.h>
+#ifdef __APPLE__
 #include <sys/sysctl.h>
+#endif
 #include <sys/socket.h>
 #include <launch.h>
 #include "launch_priv.h"
@@ -44,16 +46,23 @@
 #include "vproc_priv.h"
 #include <net/if.h>
 #include <netinet/in.h>
+#ifdef __APPLE__
 #include <netinet/in_var.h>
+#endif
 #include <netdb.h>
 #include <sys/un.h>
+#ifdef __APPLE__
 #include <CoreFoundation/CoreFoundation.h>
+#endif
 #include <dirent.h>
 #include <fnmatch.h>
 #include <glob.h>
 #include <pwd.h>
+#include <sys/resource.h>
+#ifdef __APPLE__
 #include <sys/syslimits.h>
 #include "assumes.h"
+#endif
 #include <errno.h>
 
 #define EALLOAD 144 // Job already loaded
@@ -64,7 +73,11 @@
 #define EJNFOUN 149 // Job not found
 #define EINCMD 150 // Invalid command
 #define EINVARG 151 // Invalid arguments
+#define EMALFORM 155 // Malformed response from launchd
+#define EMAXDEPTH 156 // Response nested deeper than allowed
 
+// compat/launch.h defines it for portable builds
+#ifndef LAUNCH_DATA_PORTABLE
 struct _launch_data {
   uint64_t type;
   union {
@@ -89,6 +102,7 @@ struct _launch_data {
     double float_num;
   };
 };
+#endif
 
 vproc_err_t vproc_swap_complex(vproc_t vp, vproc_gsk_t key, launch_data_t inval, launch_data_t *outval);
 
@@ -97,7 +111,8 @@ vproc_err_t vproc_swap_complex(vproc_t vp, vproc_gsk_t key, launch_data_t inval,
 struct ldtstatus {
   char *label;
   int pid;
-  int status;
+  int status; // exit status when the job exited, otherwise -1
+  int signal; // terminating signal when the job was signaled, otherwise -1
 };
 
 typedef struct ldtstatus *launch_data_status_t;
@@ -122,9 +137,18 @@ struct load_unload_state {
  @discussion Lists the job with the given job label
  @param job
   The job label (ex. com.apple.Dock.agent)
- @return launch_data_t
+ @return launch_data_t, or NULL with errno set (ESRCH when no such job exists)
  */
 launch_data_t launchctl_list_job(const char *job);
+
+/*!
+ @function getjob
+ @discussion Reduces a job dictionary to its label, pid and decoded last exit status
+ @param job
+  A job dictionary as returned by launchd
+ @return launch_data_status_t (free with launch_data_status_free), or NULL
+ */
+launch_data_status_t getjob(launch_data_t job);
 void launch_data_status_free(launch_data_status_t j);
 int launchctl_start_job(const char *job);
 int launchctl_stop_job(const char *job);
@@ -138,6 +162,11 @@ char *launchctl_get_session();
 int launchctl_submit_job(int argc, char *const argv[]);
 int64_t launchctl_getumask();
 int launchctl_setumask(const char *mask);
+/*!
+ @function setup_system_context
+ @discussion Moves the process into the system launchd's bootstrap when running as root.
+  Only the first call does any work; it is safe to call from any thread
+ */
 void setup_system_context(void);
 static const struct {
 	const char *name;
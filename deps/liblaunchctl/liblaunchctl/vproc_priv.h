@@ -26,6 +26,9 @@
  * Last modified on 5/5/2013
  */
 
+#ifndef __VPROC_PRIVATE_H__
+#define __VPROC_PRIVATE_H__
+
 #include <launch.h>
 #include <vproc.h>
 
@@ -79,4 +82,6 @@ vproc_err_t
 _vproc_send_signal_by_label(const char *label, int sig);
 
 vproc_err_t vproc_swap_integer(vproc_t vp, vproc_gsk_t key, int64_t *inval, int64_t *outval);
-const char *vproc_strerror(vproc_err_t r);
\ No newline at end of file
+const char *vproc_strerror(vproc_err_t r);
+
+#endif
@@ -0,0 +1,189 @@
+/*
+ * launchd_standin.c
+ * A stand-in launchd serving the socket transport (launch_socket.h)
+ *
+ * Serves the fake transport's table of jobs (launch_fake.h) to other
+ * processes: GetJob, GetJobs, StartJob, StopJob, RemoveJob, SubmitJob, the
+ * resource limit, resource usage and user environment requests, and the
+ * manager swaps. Every connection gets a thread, so concurrent clients are
+ * served in parallel, each waiting out its own injected latency. ALLJOBS
+ * is encoded once per change to the table and the bytes reused, so listing
+ * 100k jobs costs the server a copy, not a rebuild.
+ *
+ *     launchd-standin [-n jobs] [-s path] [-f spec]
+ *
+ * -f takes a launch_fake.h spec for latency and errors, for example
+ * "latency=exp:2,error=GetJob:EAGAIN:0.01". Prints "listening on <path>"
+ * once clients can connect, then serves until SIGINT or SIGTERM, removing
+ * the socket on the way out.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <launch.h>
+#include "launch_data_arena.h"
+#include "launch_fake.h"
+#include "launch_socket.h"
+
+#define STANDIN_SOCKET "/tmp/launchd-standin.sock"
+
+static const char *socket_path = STANDIN_SOCKET;
+
+#pragma mark Connections
+
+// Answers one request frame with its response frame in out
+static int serve(const struct launch_data_buf *frame, struct launch_data_buf *out) {
+  if (frame->len < LAUNCH_SOCKET_REQUEST_HEAD) {
+    return EBADMSG;
+  }
+  char kind = frame->data[0];
+  int32_t key;
+  memcpy(&key, frame->data + 1, sizeof(key));
+  if (kind != LAUNCH_TRANSPORT_MSG && kind != LAUNCH_TRANSPORT_INTEGER
+      && kind != LAUNCH_TRANSPORT_STRING && kind != LAUNCH_TRANSPORT_COMPLEX) {
+    return EBADMSG;
+  }
+  size_t body = frame->len - LAUNCH_SOCKET_REQUEST_HEAD;
+  launch_data_t request = NULL;
+  if (body) {
+    request = launch_data_decode(frame->data + LAUNCH_SOCKET_REQUEST_HEAD, body, NULL);
+    if (request == NULL) {
+      return EBADMSG;
+    }
+  }
+  int32_t error = 0;
+  int err = launch_socket_frame_start(out, &error, sizeof(error));
+  if (!err) {
+    error = launch_fake_encode(kind, key, request, out);
+    memcpy(out->data + sizeof(uint32_t), &error, sizeof(error));
+  }
+  // A no-op in the connection's arena, which liblaunch does not have
+  if (request) {
+    launch_data_free(request);
+  }
+  return err;
+}
+
+// One thread per connection. Requests and responses are built in an arena
+// reset between round trips
+static void *connection(void *arg) {
+  int fd = (int)(intptr_t)arg;
+  struct launch_data_buf in = { NULL, 0, 0 }, out = { NULL, 0, 0 };
+  launch_data_arena_t arena = launch_data_arena_create(0);
+  launch_data_arena_use(arena);
+  while (launch_socket_recv(fd, &in) == 0) {
+    int err = serve(&in, &out);
+    launch_data_arena_reset(arena);
+    if (err || launch_socket_send(fd, &out) != 0) {
+      break;
+    }
+  }
+  launch_data_arena_use(NULL);
+  launch_data_arena_destroy(arena);
+  launch_data_buf_free(&in);
+  launch_data_buf_free(&out);
+  close(fd);
+  return NULL;
+}
+
+#pragma mark Main
+
+static void quit(int signo) {
+  unlink(socket_path);
+  _exit(0);
+}
+
+static int listen_on(const char *path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  unlink(path);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+    int err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+  }
+  return fd;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [-n jobs] [-s path] [-f spec]\n", argv0);
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  const char *jobs = NULL, *faults = NULL;
+  int c;
+  while ((c = getopt(argc, argv, "n:s:f:")) != -1) {
+    switch (c) {
+      case 'n':
+        jobs = optarg;
+        break;
+      case 's':
+        socket_path = optarg;
+        break;
+      case 'f':
+        faults = optarg;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  // -n is short for a jobs= setting, which a later one in -f overrides
+  char spec[1024];
+  snprintf(spec, sizeof(spec), "%s%s%s%s", jobs ? "jobs=" : "", jobs ? jobs : "",
+    jobs && faults ? "," : "", faults ? faults : "");
+  int err = launch_fake_configure(spec);
+  if (err) {
+    fprintf(stderr, "%s: %s\n", spec, strerror(err));
+    return 1;
+  }
+
+  int lfd = listen_on(socket_path);
+  if (lfd < 0) {
+    fprintf(stderr, "%s: %s\n", socket_path, strerror(errno));
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, quit);
+  signal(SIGTERM, quit);
+  printf("listening on %s\n", socket_path);
+  fflush(stdout);
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  for (;;) {
+    int fd = accept(lfd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      fprintf(stderr, "accept: %s\n", strerror(errno));
+      return 1;
+    }
+    launch_socket_nosigpipe(fd);
+    pthread_t t;
+    if (pthread_create(&t, &attr, connection, (void *)(intptr_t)fd) != 0) {
+      close(fd);
+    }
+  }
+}
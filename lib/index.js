@@ -5,6 +5,7 @@ var ctl     = require('bindings')('bindings')
   , errno   = require('syserrno')
   , util    = require('util')
   , plist   = require('launchd.plist')
+  , Readable = require('stream').Readable
 
 /*!
  * Expose LaunchCTL
@@ -12,6 +13,96 @@ var ctl     = require('bindings')('bindings')
 var LaunchCTL = exports
 
 
+/*!
+ * Whether `arg` is a plain options object (not a RegExp or Array)
+ */
+function isOptions(arg) {
+  return arg !== null && typeof arg === 'object' &&
+    !util.isRegExp(arg) && !Array.isArray(arg)
+}
+
+/*!
+ * Returns `opts` with `Label` added to `opts.fields` (when set) so jobs
+ * can still be matched against a regular expression
+ */
+function withLabel(opts) {
+  if (!Array.isArray(opts.fields) || ~opts.fields.indexOf('Label'))
+    return opts
+  var out = {}
+  for (var key in opts) out[key] = opts[key]
+  out.fields = opts.fields.concat('Label')
+  return out
+}
+
+/*!
+ * Translates a JavaScript RegExp into POSIX extended syntax so labels can
+ * be matched on the threadpool. Returns null for anything whose meaning
+ * would change (lookarounds, back references, lazy quantifiers, escapes
+ * inside brackets, ...); those are only matched in JavaScript
+ */
+var posixEscapes = {
+  d: '[0-9]',
+  w: '[A-Za-z0-9_]',
+  s: '[[:space:]]'
+}
+
+function toPosix(regex) {
+  if (regex.sticky) return null
+  var src = regex.source
+    , out = ''
+    , inClass = false
+
+  for (var i = 0; i < src.length; i++) {
+    var c = src[i]
+      , next = src[i+1]
+    if (c === '\\') {
+      if (inClass || next === undefined) return null
+      if (posixEscapes[next]) out += posixEscapes[next]
+      else if (next === '/' || next === '-') out += next
+      else if (/[.^$|?*+()[\]{}\\]/.test(next)) out += c + next
+      else return null
+      i++
+      continue
+    }
+    if (inClass) {
+      if (c === ']') inClass = false
+      out += c
+      continue
+    }
+    if (c === '[') {
+      inClass = true
+      out += c
+      if (next === '^') out += src[++i]
+      // [] and [^] mean something else to regcomp
+      if (src[i+1] === ']') return null
+      continue
+    }
+    if (c === '(' && next === '?') return null
+    if (/[*+?}]/.test(c) && next === '?') return null
+    if (c === '{' && !/^\{\d+(,\d*)?\}/.test(src.slice(i))) return null
+    if (c === '|' && (!out || /[|(]$/.test(out) || next === undefined ||
+      next === '|' || next === ')')) return null
+    if (c === '(' && next === ')') return null
+    out += c
+  }
+  return inClass ? null : out
+}
+
+/*!
+ * Returns `opts` with a native label filter for `regex` when it can be
+ * translated, always keeping `Label` for the final JavaScript match
+ */
+function regexOptions(regex, opts) {
+  opts = withLabel(opts)
+  var source = toPosix(regex)
+  if (source === null || opts.prefix || opts.glob || opts.regex) return opts
+  var out = {}
+  for (var key in opts) out[key] = opts[key]
+  out.regex = source
+  out.ignoreCase = regex.ignoreCase
+  return out
+}
+
 /*!
  * Expose errno
  */
@@ -51,24 +142,65 @@ LaunchCTL.errorFromErrno = errno.errorForErrno
  *        throw e
  *      }
  *
+ * #### List with every job sharing one shape
+ *
+ *      var res = ctl.listSync({ shaped: true })
+ *
+ * #### List by label prefix or glob, matched before any conversion
+ *
+ *      var res = ctl.listSync({ prefix: 'com.apple.' })
+ *      var res = ctl.listSync({ glob: 'com.apple.*.agent' })
+ *
+ * #### List only a few keys
+ *
+ *      var res = ctl.listSync({ fields: ['Label', 'PID', 'Sockets.Listeners'] })
+ *
+ * Options:
+ *
+ *   - `shaped` Always expose the well known keys (`Label`, `PID`,
+ *     `LastExitStatus`, `Program`, ...) in a fixed order, using `null`
+ *     for missing ones, so every job object shares the same hidden class
+ *   - `lazy` Keep the launchd response native and convert each job
+ *     property the first time it is read. Only applies when listing
+ *     more than one job
+ *   - `serialized` (async only) Encode the response into one buffer on
+ *     the threadpool so the event loop only decodes it
+ *   - `fields` Array of keys to convert, everything else is skipped
+ *     without being read. Nested keys are joined with dots
+ *     (`'Sockets.Listeners'`), so a key that itself contains dots can
+ *     only be selected through its parent. `Label` is always kept when
+ *     filtering by regular expression. Ignored by `lazy`
+ *   - `prefix` Only list jobs whose label starts with this string
+ *   - `glob` Only list jobs whose label matches this `fnmatch(3)` pattern
+ *   - `regex` Only list jobs whose label matches this POSIX extended
+ *     regular expression. A `RegExp` passed as `name` is translated to
+ *     this when possible and still applied in JavaScript afterwards
+ *   - `ignoreCase` Match `prefix`, `glob` and `regex` case insensitively
+ *   - `maxDepth` Deepest nesting of arrays and dictionaries to convert
+ *     (default 64). Deeper responses fail with errno 156
+ *   - `timeout` (async only) Milliseconds after which the callback gets
+ *     `ETIMEDOUT`, see `setExecutorOptions`
+ *
  * @param {String} name The job label or regular expression (optional)
+ * @param {Object} opts Conversion options (optional)
  * @api public
  */
 LaunchCTL.listSync = function() {
   var args = Array.prototype.slice.call(arguments)
+    , opts = isOptions(args[args.length-1]) && args.pop()
     , regex = (util.isRegExp(args[args.length-1])) && args.pop()
     , name = (typeof args[args.length-1] === 'string') && args.pop()
 
+  opts = opts || {}
   if (name) {
-    return ctl.getJobSync(name)
+    return ctl.getJobSync(name, opts)
   } else if (regex) {
-    var results = []
-    var jobs = ctl.getAllJobsSync()
+    var jobs = ctl.getAllJobsSync(regexOptions(regex, opts))
     return jobs.filter(function(job) {
       return job.Label && regex.test(job.Label)
     })
   } else {
-    return ctl.getAllJobsSync()
+    return ctl.getAllJobsSync(opts)
   }
 }
 
@@ -99,7 +231,15 @@ LaunchCTL.listSync = function() {
  *        console.log(jobs)
  *      })
  *
+ * #### List with every job sharing one shape
+ *
+ *      ctl.list({ shaped: true }, function(err, jobs) {
+ *        if (err) throw err
+ *        console.log(jobs)
+ *      })
+ *
  * @param {String} name The job label or regex (optional)
+ * @param {Object} opts Conversion options, see `listSync` (optional)
  * @param {Function} cb function(err, data)
  *
  *
@@ -108,11 +248,13 @@ LaunchCTL.listSync = function() {
 LaunchCTL.list = function() {
   var args = Array.prototype.slice.call(arguments)
     , cb = (typeof args[args.length-1] === 'function') && args.pop()
+    , opts = isOptions(args[args.length-1]) && args.pop()
     , regex = (util.isRegExp(args[args.length-1])) && args.pop()
     , name = (typeof args[args.length-1] === 'string') && args.pop()
 
+  opts = opts || {}
   if (name) {
-    ctl.getJob(name, function(err, data) {
+    ctl.getJob(name, opts, function(err, data) {
       if (err) {
         return cb(err)
       } else {
@@ -121,21 +263,255 @@ LaunchCTL.list = function() {
     })
   } else if (regex) {
     // regex
-    var results = []
-    ctl.getAllJobs(function(err, jobs) {
+    ctl.getAllJobs(regexOptions(regex, opts), function(err, jobs) {
+      if (err) return cb(err)
       jobs = jobs.filter(function(job) {
         return job.Label && regex.test(job.Label)
       })
       return cb(null, jobs)
     })
   } else {
-    return ctl.getAllJobs(function(err, data) {
+    return ctl.getAllJobs(opts, function(err, data) {
       if (err) return cb(err)
       return cb(null, data)
     })
   }
 }
 
+/**
+ * Gets several jobs by label in one request
+ *
+ * All lookups run in a single trip to the executor. Batches of 8 labels
+ * or more are answered from one `ALLJOBS` request instead of one launchd
+ * round trip per label. The result is aligned with `labels`: each entry
+ * is either the job or an `Error` whose `errno` tells why that label
+ * failed (`ESRCH` when there is no such job)
+ *
+ * Examples:
+ *
+ *      ctl.getJobs(['com.apple.Dock.agent', 'com.example.gone'], function(err, jobs) {
+ *        if (err) throw err
+ *        // jobs[0] => { Label: 'com.apple.Dock.agent', ... }
+ *        // jobs[1] => [Error: No such process] with errno 3
+ *      })
+ *
+ * @param {Array} labels Job labels
+ * @param {Object} opts Conversion options, see `listSync` (optional)
+ * @param {Function} cb function(err, jobs)
+ * @api public
+ */
+LaunchCTL.getJobs = function(labels, opts, cb) {
+  if (typeof opts === 'function') cb = opts, opts = {}
+  ctl.getJobs(labels, opts || {}, cb)
+}
+
+/**
+ * Synchronous `getJobs`
+ *
+ * @param {Array} labels Job labels
+ * @param {Object} opts Conversion options, see `listSync` (optional)
+ * @return {Array} A job or an `Error` for every label
+ * @api public
+ */
+LaunchCTL.getJobsSync = function(labels, opts) {
+  return ctl.getJobsSync(labels, opts || {})
+}
+
+/**
+ * `launchctl list` as a readable object stream
+ *
+ * The launchd response is fetched (and filtered) on the threadpool, then
+ * converted at most `batchSize` jobs or `budget` microseconds per turn of
+ * the event loop, only while the consumer keeps reading. The native
+ * response is freed once the last job is read, when the stream is
+ * destroyed, or when an abandoned stream is garbage collected
+ *
+ * Examples:
+ *
+ *      ctl.createListStream({ prefix: 'com.apple.' })
+ *        .on('data', function(job) {
+ *          console.log(job.Label)
+ *        })
+ *        .on('end', function() {
+ *          console.log('done')
+ *        })
+ *
+ * Options (plus any of the `listSync` options except `lazy` and
+ * `serialized`):
+ *
+ *   - `batchSize` Most jobs converted per turn (default 100)
+ *   - `budget` Microseconds after which a batch is cut short (default 1000)
+ *
+ * @param {Object} opts Options (optional)
+ * @return {ListStream}
+ * @api public
+ */
+LaunchCTL.createListStream = function(opts) {
+  return new ListStream(opts)
+}
+
+function ListStream(opts) {
+  opts = opts || {}
+  this._opts = opts
+  this._batchSize = opts.batchSize || 100
+  this._budget = opts.budget || 1000
+  this._cursor = null
+  this._opening = false
+  this._scheduled = false
+  this._closed = false
+  Readable.call(this, { objectMode: true, highWaterMark: this._batchSize })
+}
+util.inherits(ListStream, Readable)
+
+LaunchCTL.ListStream = ListStream
+
+ListStream.prototype._read = function() {
+  var self = this
+  if (self._closed || self._scheduled) return
+  if (!self._cursor) {
+    if (self._opening) return
+    self._opening = true
+    ctl.getAllJobsCursor(self._opts, function(err, cursor) {
+      self._opening = false
+      if (err) return self.emit('error', err)
+      if (self._closed) return cursor.close()
+      self._cursor = cursor
+      self._read()
+    })
+    return
+  }
+  // One batch per turn, so other callbacks run between batches
+  self._scheduled = true
+  setImmediate(function() {
+    self._scheduled = false
+    if (self._closed) return
+    var jobs
+    try {
+      jobs = self._cursor.next(self._batchSize, self._budget)
+    }
+    catch (err) {
+      self._close()
+      return self.emit('error', err)
+    }
+    if (jobs === null) {
+      self._close()
+      return self.push(null)
+    }
+    var more = true
+    for (var i = 0; i < jobs.length; i++) {
+      more = self.push(jobs[i])
+    }
+    if (more) self._read()
+  })
+}
+
+ListStream.prototype._close = function() {
+  this._closed = true
+  if (this._cursor) {
+    this._cursor.close()
+    this._cursor = null
+  }
+}
+
+ListStream.prototype._destroy = function(err, cb) {
+  this._close()
+  cb(err)
+}
+
+if (!Readable.prototype.destroy) {
+  ListStream.prototype.destroy = function() {
+    this._close()
+    this.emit('close')
+  }
+}
+
+/**
+ * Reports jobs added, removed or modified since the previous call
+ *
+ * The previous listing is kept natively as one hash per top level key of
+ * every job. Hashing and comparing run on the threadpool and only added
+ * and modified jobs are converted. The first call reports every job as
+ * added. Calls share one tracker, use `createJobTracker()` for
+ * independent ones. Changing the label filter between calls reports the
+ * jobs it no longer matches as removed
+ *
+ * Examples:
+ *
+ *      setInterval(function() {
+ *        ctl.getJobChanges({ fields: ['Label', 'PID'] }, function(err, res) {
+ *          if (err) throw err
+ *          res.added.forEach(function(job) { ... })
+ *          res.removed.forEach(function(label) { ... })
+ *          res.modified.forEach(function(m) {
+ *            console.log(m.job.Label, 'changed', m.changed)
+ *          })
+ *        })
+ *      }, 1000)
+ *
+ * @param {Object} opts Filter and conversion options, see `listSync` (optional)
+ * @param {Function} cb function(err, { added, removed, modified })
+ * @api public
+ */
+LaunchCTL.getJobChanges = function(opts, cb) {
+  if (typeof opts === 'function') cb = opts, opts = {}
+  if (!defaultTracker) defaultTracker = new ctl.JobTracker()
+  defaultTracker.changes(opts || {}, cb)
+}
+
+var defaultTracker = null
+
+/**
+ * Creates a tracker whose `changes([opts], cb)` works like
+ * `getJobChanges()` but keeps its own previous listing. `reset()` forgets
+ * it, so the next call reports every job as added
+ *
+ * Example:
+ *
+ *     var tracker = ctl.createJobTracker()
+ *     tracker.changes(function(err, res) { ... })
+ *
+ * @return {JobTracker}
+ * @api public
+ */
+LaunchCTL.createJobTracker = function() {
+  return new ctl.JobTracker()
+}
+
+/**
+ * `launchctl list` reduced to columns
+ *
+ * The reduction runs off the main thread. The result holds one array of
+ * labels and `Int32Array` columns that share its indexes. `pid` is -1 for
+ * jobs that are not running, `status` is the last exit status (or -1) and
+ * `signal` the signal that terminated the job (or -1)
+ *
+ * Examples:
+ *
+ *      ctl.listCompact(function(err, jobs) {
+ *        if (err) throw err
+ *        for (var i=0; i<jobs.labels.length; i++) {
+ *          console.log(jobs.labels[i], jobs.pid[i], jobs.status[i])
+ *        }
+ *      })
+ *
+ * @param {Object} opts `timeout` in ms (optional)
+ * @param {Function} cb function(err, jobs)
+ * @api public
+ */
+LaunchCTL.listCompact = function(opts, cb) {
+  if (typeof opts === 'function') cb = opts, opts = {}
+  ctl.getAllJobsCompact(opts || {}, cb)
+}
+
+/**
+ * Synchronous version of `listCompact`
+ *
+ * @api public
+ */
+LaunchCTL.listCompactSync = function() {
+  return ctl.getAllJobsCompactSync()
+}
+
 /**
  * Start job with the given label
  * `launchctl start`
@@ -181,11 +557,13 @@ LaunchCTL.startSync = function(label) {
  *      })
  *
  * @param {String} label The job label
+ * @param {Object} opts `timeout` in ms (optional)
  * @param {Function} cb function(err, res)
  * @api public
  */
-LaunchCTL.start = function(label, cb) {
-  ctl.startStopRemove(label, 1, function(err) {
+LaunchCTL.start = function(label, opts, cb) {
+  if (typeof opts === 'function') cb = opts, opts = {}
+  ctl.startStopRemove(label, 1, opts || {}, function(err) {
     if (err) {
       if (err.msg && err.errno) {
         var e = errno.errorForErrno(err.errno)
@@ -251,11 +629,13 @@ LaunchCTL.stopSync = function(label) {
  * set to true.  It will simply restart the job, not actually stop it
  *
  * @param {String} label The job label
+ * @param {Object} opts `timeout` in ms (optional)
  * @param {Function} cb function(err)
  * @api public
  */
-LaunchCTL.stop = function(label, cb) {
-  ctl.startStopRemove(label, 2, function(err) {
+LaunchCTL.stop = function(label, opts, cb) {
+  if (typeof opts === 'function') cb = opts, opts = {}
+  ctl.startStopRemove(label, 2, opts || {}, function(err) {
     if (err) {
       if (err.msg && err.errno) {
         var e = errno.errorForErrno(err.errno)
@@ -312,11 +692,13 @@ LaunchCTL.removeSync = function(label) {
  *      })
  *
  * @param {String} label The job label
+ * @param {Object} opts `timeout` in ms (optional)
  * @param {Function} cb function(err)
  * @api public
  */
-LaunchCTL.remove = function(label, cb) {
-  ctl.startStopRemove(label, 3, function(err) {
+LaunchCTL.remove = function(label, opts, cb) {
+  if (typeof opts === 'function') cb = opts, opts = {}
+  ctl.startStopRemove(label, 3, opts || {}, function(err) {
     if (err) {
       if (err.msg && err.errno) {
         var e = errno.errorForErrno(err.errno)
@@ -328,6 +710,62 @@ LaunchCTL.remove = function(label, cb) {
   })
 }
 
+/**
+ * Starts every job in `labels`
+ *
+ * Runs entirely on the launchd executor with at most `concurrency`
+ * requests in flight (4 by default). A failing label does not fail the
+ * batch. `res.results` maps each label to its errno, 0 on success, and
+ * `res.latencyMs` maps it to the time its request took. `res.wallMs` is
+ * the time the whole batch took. With `pid: true`, `res.pids` maps each
+ * started label to its PID, at the cost of one extra lookup per label
+ *
+ * Examples:
+ *
+ *      ctl.startMany(['com.example.a', 'com.example.b'], { pid: true }, function(err, res) {
+ *        if (err) throw err
+ *        // res.results => { 'com.example.a': 0, 'com.example.b': 3 }
+ *        // res.pids => { 'com.example.a': 4211 }
+ *      })
+ *
+ * @param {Array} labels The job labels
+ * @param {Object} opts `concurrency` and `pid` (optional)
+ * @param {Function} cb function(err, res)
+ * @api public
+ */
+LaunchCTL.startMany = function(labels, opts, cb) {
+  many(labels, 1, opts, cb)
+}
+
+/**
+ * Stops every job in `labels`, see `startMany`
+ *
+ * @param {Array} labels The job labels
+ * @param {Object} opts `concurrency` (optional)
+ * @param {Function} cb function(err, res)
+ * @api public
+ */
+LaunchCTL.stopMany = function(labels, opts, cb) {
+  many(labels, 2, opts, cb)
+}
+
+/**
+ * Removes every job in `labels`, see `startMany`
+ *
+ * @param {Array} labels The job labels
+ * @param {Object} opts `concurrency` (optional)
+ * @param {Function} cb function(err, res)
+ * @api public
+ */
+LaunchCTL.removeMany = function(labels, opts, cb) {
+  many(labels, 3, opts, cb)
+}
+
+function many(labels, cmd, opts, cb) {
+  if (typeof opts === 'function') cb = opts, opts = {}
+  ctl.startStopRemoveMany(labels, cmd, opts || {}, cb)
+}
+
 /**
  * Loads a job
  * `launchctl load`
@@ -406,7 +844,7 @@ LaunchCTL.loadSync = function() {
  *      })
  *
  * @param {String} path The path to a plist specifying job info
- * @param {Object} opts editondisk, forceload, session_type, domain
+ * @param {Object} opts editondisk, forceload, session_type, domain, timeout
  * @param {Function} cb function(err)
  *
  * @api public
@@ -443,6 +881,9 @@ LaunchCTL.load = function() {
     if (opts.domain) {
       as.push(opts.domain)
     }
+    if (opts.timeout) {
+      as.push({ timeout: opts.timeout })
+    }
   }
   as.push(cb)
   if (as.length < 4) {
@@ -529,7 +970,7 @@ LaunchCTL.unloadSync = function() {
  *      })
  *
  * @param {String} path The path to a plist specifying job info
- * @param {Object} opts editondisk, forceload, session_type, domain
+ * @param {Object} opts editondisk, forceload, session_type, domain, timeout
  * @param {Function} cb function(err)
  *
  * @api public
@@ -566,6 +1007,9 @@ LaunchCTL.unload = function() {
     if (opts.domain) {
       as.push(opts.domain)
     }
+    if (opts.timeout) {
+      as.push({ timeout: opts.timeout })
+    }
   }
   as.push(cb)
   if (as.length < 4) {
@@ -592,7 +1036,7 @@ LaunchCTL.unload = function() {
  *        throw e
  *      }
  *
- * @param {Object} args `label`, `program`, `stderr`, `stdout`, `args` (args must be an array)
+ * @param {Object} args `label`, `program`, `stderr`, `stdout`, `args` (args must be an array), `keepAlive`, `runAtLoad` (start the job as soon as it is submitted)
  * @api public
  */
 LaunchCTL.submitSync = function(args) {
@@ -632,7 +1076,7 @@ LaunchCTL.submitSync = function(args) {
  *        }
  *      })
  *
- * @param {Object} data `label`, `program`, `stderr`, `stdout`, `args` (args must be an array)
+ * @param {Object} data `label`, `program`, `stderr`, `stdout`, `args` (args must be an array), `keepAlive`, `runAtLoad` (start the job as soon as it is submitted)
  * @param {Function} cb function(err)
  * @api public
  */
@@ -645,6 +1089,38 @@ LaunchCTL.submit = function() {
   return ctl.submitJob(data, cb)
 }
 
+/*!
+ * Turns a launchd errno error into the matching system error when there
+ * is one
+ */
+function translate(e) {
+  if (e && e.msg && e.errno) {
+    var err = errno.errorForErrno(e.errno)
+    if (err.errno > 0) return err
+  }
+  return e
+}
+
+/*!
+ * Calls `fn` with `args`, on the executor (with `opts`, if any) when `cb`
+ * is a function and right away otherwise, translating errors either way
+ */
+function control(fn, args, cb, opts) {
+  if (typeof cb === 'function') {
+    if (opts) args = args.concat(opts)
+    return fn.apply(ctl, args.concat(function(err, res) {
+      if (err) return cb(translate(err))
+      cb(null, res)
+    }))
+  }
+  try {
+    return fn.apply(ctl, args)
+  }
+  catch (e) {
+    throw translate(e)
+  }
+}
+
 /**
  * Gets the name of the current manager (session)
  * `launchctl managername`
@@ -654,10 +1130,17 @@ LaunchCTL.submit = function() {
  *      var name = ctl.managername()
  *      // => 'Aqua'
  *
+ *      ctl.managername(function(err, name) {
+ *        // name => 'Aqua'
+ *      })
+ *
+ * @param {Object} opts `timeout` in ms, with a callback (optional)
+ * @param {Function} cb function(err, name) (optional)
  * @api public
  */
-LaunchCTL.managername = function() {
-  return ctl.getManagerName()
+LaunchCTL.managername = function(opts, cb) {
+  if (typeof opts === 'function') cb = opts, opts = null
+  return control(ctl.getManagerName, [], cb, opts)
 }
 
 /**
@@ -669,10 +1152,13 @@ LaunchCTL.managername = function() {
  *      var uid = ctl.manageruid()
  *      // => 501
  *
+ * @param {Object} opts `timeout` in ms, with a callback (optional)
+ * @param {Function} cb function(err, uid) (optional)
  * @api public
  */
-LaunchCTL.manageruid = function() {
-  return ctl.getManagerUID()
+LaunchCTL.manageruid = function(opts, cb) {
+  if (typeof opts === 'function') cb = opts, opts = null
+  return control(ctl.getManagerUID, [], cb, opts)
 }
 
 /**
@@ -684,15 +1170,21 @@ LaunchCTL.manageruid = function() {
  *      var pid = ctl.managerpid()
  *      // => 263
  *
+ * @param {Object} opts `timeout` in ms, with a callback (optional)
+ * @param {Function} cb function(err, pid) (optional)
  * @api public
  */
-LaunchCTL.managerpid = function() {
-  return ctl.getManagerPID()
+LaunchCTL.managerpid = function(opts, cb) {
+  if (typeof opts === 'function') cb = opts, opts = null
+  return control(ctl.getManagerPID, [], cb, opts)
 }
 
 /**
  * Gets/sets the launchd resource limits
  *
+ * With a callback as the last argument the request runs off the event
+ * loop and the result is passed to it instead of being returned
+ *
  * Examples:
  *
  *      var limits = ctl.limit()
@@ -714,6 +1206,10 @@ LaunchCTL.managerpid = function() {
  *      var res = ctl.limit('maxproc')
  *      // => { soft: '1000', hard: '2000' }
  *
+ *      ctl.limit('maxproc', function(err, res) {
+ *        // res => { soft: '1000', hard: '2000' }
+ *      })
+ *
  * Set `maxproc` limit
  *
  *      var res = ctl.limit('maxproc', '1200', '2000')
@@ -722,46 +1218,56 @@ LaunchCTL.managerpid = function() {
  * @param {String} limtype The specific type to get (optional)
  * @param {String|Number} soft The soft limit (optional)
  * @param {String|Number} hard The hard limit (optional)
+ * @param {Object} opts `timeout` in ms, with a callback (optional)
+ * @param {Function} cb function(err, res) (optional)
  * @api public
  */
-LaunchCTL.limit = function(limtype, soft, hard) {
-  var err
-  if (limtype && !soft && !hard) {
-    try {
-      var lims = ctl.getLimitSync()
-      var keys = Object.keys(lims)
-      limtype = limtype.toLowerCase()
-      if (~keys.indexOf(limtype)) {
-        return lims[limtype]
-      } else {
-        err = LaunchCTL.errorFromCode('EINVLIM')
-        throw err
-      }
-    }
-    catch(e) {
-      throw e
+LaunchCTL.limit = function() {
+  var args = Array.prototype.slice.call(arguments)
+    , cb = typeof args[args.length-1] === 'function' && args.pop()
+    , opts = cb && typeof args[args.length-1] === 'object' && args.pop()
+    , limtype = args[0]
+    , soft = args[1]
+    , hard = args[2]
+    , err
+
+  function fail(err) {
+    if (cb) return cb(err)
+    throw err
+  }
+
+  function pick(lims) {
+    if (lims.hasOwnProperty(limtype)) return lims[limtype]
+    return null
+  }
+
+  if (limtype && soft === undefined && hard === undefined) {
+    limtype = limtype.toLowerCase()
+    if (cb) {
+      return control(ctl.getLimit, [], function(err, lims) {
+        if (err) return cb(err)
+        var lim = pick(lims)
+        if (!lim) return cb(LaunchCTL.errorFromCode('EINVLIM'))
+        cb(null, lim)
+      }, opts)
     }
-  } else if (limtype && (soft || hard)) {
+    var lim = pick(control(ctl.getLimitSync, []))
+    if (!lim) throw LaunchCTL.errorFromCode('EINVLIM')
+    return lim
+  } else if (limtype) {
     // We are setting a limit
-    try {
-      if ('number' === typeof soft) {
-        soft = soft.toString()
-      }
-      if (args.length === 2) hard = soft
-      if (limtype === 'maxfiles' && (soft === 'unlimited' || hard === 'unlimited')) {
-        err = LaunchCTL.errorFromCode('EINVLIM')
-        err.msg = 'Invalid limit. The limit for `maxfiles` cannot be set to `unlimited`'
-        throw err
-      }
-      return ctl.setLimitSync(limtype, soft, hard)
+    if (args.length === 2) hard = soft
+    if ('number' === typeof soft) soft = soft.toString()
+    if ('number' === typeof hard) hard = hard.toString()
+    if (limtype === 'maxfiles' && (soft === 'unlimited' || hard === 'unlimited')) {
+      err = LaunchCTL.errorFromCode('EINVLIM')
+      err.msg = 'Invalid limit. The limit for `maxfiles` cannot be set to `unlimited`'
+      return fail(err)
     }
-    catch (e) {
-      throw e
-    }
-  } else {
-    // List all limits
-    return ctl.getLimitSync()
+    return control(cb ? ctl.setLimit : ctl.setLimitSync, [limtype, soft, hard], cb, opts)
   }
+  // List all limits
+  return control(cb ? ctl.getLimit : ctl.getLimitSync, [], cb, opts)
 }
 
 /**
@@ -769,42 +1275,26 @@ LaunchCTL.limit = function(limtype, soft, hard) {
  *
  * @param {String} key The key
  * @param {String} val The value
+ * @param {Object} opts `timeout` in ms, with a callback (optional)
+ * @param {Function} cb function(err) (optional)
  * @api public
  */
-LaunchCTL.setEnvVar = function(key, val) {
-  var res
-  try {
-    res = ctl.setEnvVar(key, val)
-  }
-  catch (e) {
-    if (e.msg && e.errno) {
-      var err = errno.errorForErrno(e.errno)
-      if (err.errno > 0) throw err
-    }
-    throw e
-  }
-  return res
+LaunchCTL.setEnvVar = function(key, val, opts, cb) {
+  if (typeof opts === 'function') cb = opts, opts = null
+  return control(ctl.setEnvVar, [key, val], cb, opts)
 }
 
 /**
  * Unsets a launchd environment variable
  *
  * @param {String} key The key
+ * @param {Object} opts `timeout` in ms, with a callback (optional)
+ * @param {Function} cb function(err) (optional)
  * @api public
  */
-LaunchCTL.unsetEnvVar = function(key) {
-  var res
-  try {
-    res = ctl.unsetEnvVar(key)
-  }
-  catch(e) {
-    if (e.msg && e.errno) {
-      var err = errno.errorForErrno(e.errno)
-      if (err.errno > 0) throw err
-    }
-    throw e
-  }
-  return res
+LaunchCTL.unsetEnvVar = function(key, opts, cb) {
+  if (typeof opts === 'function') cb = opts, opts = null
+  return control(ctl.unsetEnvVar, [key], cb, opts)
 }
 
 /**
@@ -814,41 +1304,43 @@ LaunchCTL.unsetEnvVar = function(key) {
  * If `key` is passed, if the key exists, it will return a string
  * If `key` is passed, but does not exist, it will return false
  *
+ * With a callback the result is passed to it instead
+ *
  * @param {String} key (optional)
+ * @param {Object} opts `timeout` in ms, with a callback (optional)
+ * @param {Function} cb function(err, res) (optional)
  * @api public
  * @returns Object|String|false
  */
-LaunchCTL.getEnvVar = function(key) {
-  if (key) {
-    var res = ctl.getEnv()
-    if (res.hasOwnProperty(key)) {
-      return res[key]
-    } else {
-      return false
-    }
+LaunchCTL.getEnvVar = function(key, opts, cb) {
+  if (typeof key === 'function' || (key && typeof key === 'object')) {
+    cb = opts, opts = key, key = null
+  }
+  if (typeof opts === 'function') cb = opts, opts = null
+  function pick(res) {
+    if (!key) return res
+    return res.hasOwnProperty(key) ? res[key] : false
+  }
+  if (cb) {
+    return control(ctl.getEnv, [], function(err, res) {
+      if (err) return cb(err)
+      cb(null, pick(res))
+    }, opts)
   }
-  return ctl.getEnv()
+  return pick(control(ctl.getEnv, []))
 }
 
 /**
  * Gets rusage for either `self` or `children`
  *
  * @param {String} who Either `self` or `children`
+ * @param {Object} opts `timeout` in ms, with a callback (optional)
+ * @param {Function} cb function(err, usage) (optional)
  * @api public
  */
-LaunchCTL.getRUsage = function(who) {
-  var res
-  try {
-    res = ctl.getRUsage(who)
-  }
-  catch(e) {
-    if (e.msg && e.errno) {
-      var err = errno.errorForErrno(e.errno)
-      if (err.errno > 0) throw err
-    }
-    throw e
-  }
-  return res
+LaunchCTL.getRUsage = function(who, opts, cb) {
+  if (typeof opts === 'function') cb = opts, opts = null
+  return control(ctl.getRUsage, [who], cb, opts)
 }
 
 /**
@@ -860,27 +1352,237 @@ LaunchCTL.getRUsage = function(who) {
  *
  *     var res = ctl.umask()
  *
+ *     ctl.umask(function(err, mask) {})
+ *
  * @param {String} arg The umask (optional)
+ * @param {Object} opts `timeout` in ms, with a callback (optional)
+ * @param {Function} cb function(err, res) (optional)
  * @api public
  */
-LaunchCTL.umask = function(arg) {
-  var res
-  try {
-    if (arg) {
-      res = ctl.umask(arg)
-    } else {
-      res = ctl.umask()
-    }
+LaunchCTL.umask = function(arg, opts, cb) {
+  if (typeof arg === 'function' || (arg && typeof arg === 'object')) {
+    cb = opts, opts = arg, arg = null
   }
-  catch(e) {
-    if (e.msg && e.errno) {
-      var err = errno.errorForErrno(e.errno)
-      if (err.errno > 0) throw err
-    }
-    throw e
-  }
-  return res
+  if (typeof opts === 'function') cb = opts, opts = null
+  return control(ctl.umask, arg ? [arg] : [], cb, opts)
 }
+/**
+ * Gets hit/miss counters for the cache of interned key strings used
+ * when converting launchd responses
+ *
+ * Example:
+ *
+ *     var stats = ctl.keyCacheStats()
+ *     // => { hits: 10240, misses: 42, size: 42 }
+ *
+ * @api public
+ */
+LaunchCTL.keyCacheStats = function() {
+  return ctl.getKeyCacheStats()
+}
+
+/**
+ * Gets counters for the pools of request state reused by async calls,
+ * one per job operation plus the executor's queue items. `created` stays
+ * flat once the pools cover the calls usually in flight
+ *
+ * Example:
+ *
+ *     var stats = ctl.batonPoolStats()
+ *     // => { getJob: { created: 64, reused: 999936, idle: 64 },
+ *     //      getJobs: { created: 0, reused: 0, idle: 0 },
+ *     //      ...
+ *     //      startStopRemove: { created: 1, reused: 3, idle: 1 },
+ *     //      execItems: { created: 64, reused: 999936, idle: 64 } }
+ *
+ * @api public
+ */
+LaunchCTL.batonPoolStats = function() {
+  return ctl.getBatonPoolStats()
+}
+
+/**
+ * Gets hit/miss counters for the cache of compiled label regexes used by
+ * the native `regex` filter
+ *
+ * Example:
+ *
+ *     var stats = ctl.regexCacheStats()
+ *     // => { hits: 9, misses: 1, size: 1 }
+ *
+ * @api public
+ */
+LaunchCTL.regexCacheStats = function() {
+  return ctl.getRegexCacheStats()
+}
+
+/**
+ * Configures the threads that run async launchd requests
+ *
+ * Async calls run on threads owned by this module rather than the libuv
+ * threadpool, so slow launchd round trips never hold up fs, dns or zlib
+ * work. The thread count can also be set with the
+ * `LAUNCHCTL_THREADPOOL_SIZE` environment variable. Once requests have
+ * been made it can only grow. Requests made while `queueSize` requests
+ * are waiting fail with `EAGAIN`
+ *
+ * Every async call also takes a deadline, either per call through a
+ * `timeout` option or for all calls through `timeout` here. Once it passes
+ * the callback gets `ETIMEDOUT` at once. A request that has not started
+ * yet is dropped from the queue; one that is already talking to launchd
+ * runs to completion and its result is thrown away
+ *
+ * Requests are split into lanes served in priority order: `interactive`
+ * (job and manager queries, limits, environment), `mutation` (start, stop,
+ * remove, submit) and `bulk` (load, unload). Each lane has its own queue
+ * of `queueSize`. A lane only takes a thread when enough stay idle for
+ * what the other lanes have `reserved` and are not using; by default one
+ * thread is kept for interactive queries, so no mix of starts, submits
+ * and loads can hold up status polling. Reservations must leave at least
+ * one thread unreserved, and are ignored on a single thread
+ *
+ * Example:
+ *
+ *     ctl.setExecutorOptions({ threads: 4, queueSize: 256 })
+ *
+ * Options:
+ *
+ *   - `threads` Number of threads (default 2)
+ *   - `queueSize` Most requests waiting for a thread (default 1024)
+ *   - `timeout` Default deadline in ms for async calls, 0 for none (default 0)
+ *   - `reserved` Threads kept for each lane, as
+ *     `{ interactive, mutation, bulk }` (default `{ interactive: 1 }`)
+ *
+ * @param {Object} opts
+ * @api public
+ */
+LaunchCTL.setExecutorOptions = function(opts) {
+  ctl.setExecutorOptions(opts)
+}
+
+/**
+ * Chooses where launchd round trips go
+ *
+ * By default every request goes to launchd. With `record`, requests still
+ * go to launchd and each request and its response is also appended to a
+ * capture file. With `replay`, answers come from such a capture and
+ * launchd is never contacted, so conversion and batching can be profiled
+ * against real data on machines without launchd. A replayed request the
+ * capture never saw fails with `ENOENT`. Repeats of a request get its
+ * recorded answers in order, starting over after the last one. With
+ * `supervisor` (Linux only), jobs are submitted to, started, stopped,
+ * removed and listed by a supervisor inside this process, which runs them
+ * as its children and reports `PID` and `LastExitStatus` the way launchd
+ * does. The transport can also be set before the first request through
+ * the `LAUNCHCTL_TRANSPORT` environment variable (`record:<path>`,
+ * `replay:<path>`, `supervisor`, `socket:<path>`, `fake` or
+ * `fake:<spec>`)
+ *
+ * Example:
+ *
+ *     ctl.setTransport({ record: '/tmp/fleet.ldtr' })
+ *     ctl.list(function(err, jobs) {
+ *       ctl.setTransport({ replay: '/tmp/fleet.ldtr' })
+ *       // later calls are answered from the capture
+ *     })
+ *
+ * Options:
+ *
+ *   - `record` Path of the capture to write
+ *   - `replay` Path of the capture to answer from
+ *   - `supervisor` `true` to run jobs in this process
+ *   - `socket` Path of a server's AF_UNIX socket, such as the one
+ *     `build/Release/launchd-standin` listens on
+ *   - `fake` `true`, or a spec such as
+ *     `'jobs=1000,latency=exp:200,error=GetJob:EAGAIN:0.01,seed=7'`, to
+ *     answer from synthetic jobs in this process with injected latency
+ *     (`fixed`, `exp` or `pareto` milliseconds) and errors. See
+ *     `deps/liblaunchctl/liblaunchctl/launch_fake.h`
+ *
+ * Passing none of them goes back to launchd. Jobs started by the
+ * supervisor keep running when it is left
+ *
+ * @param {Object} opts
+ * @api public
+ */
+LaunchCTL.setTransport = function(opts) {
+  ctl.setTransport(opts || {})
+}
+
+/**
+ * Gets the transport in use, `native`, `record`, `replay`, `supervisor`,
+ * `socket` or `fake`
+ *
+ * @api public
+ */
+LaunchCTL.transport = function() {
+  return ctl.getTransport()
+}
+
+/**
+ * Shares launchd round trips between identical concurrent requests
+ *
+ * With coalescing enabled, a `list()` (or `list(name)`) made while an
+ * identical one (same label, options and filter) is in flight joins it,
+ * and every caller receives the same result objects, so they must not be
+ * modified. With `freshMs`, successful results keep answering identical
+ * requests for that many milliseconds
+ *
+ * Example:
+ *
+ *     ctl.setCoalesceOptions({ enabled: true, freshMs: 50 })
+ *
+ * Options:
+ *
+ *   - `enabled` Turn coalescing on or off (default off)
+ *   - `freshMs` How long results are reused after arriving (default 0)
+ *
+ * @param {Object} opts
+ * @api public
+ */
+LaunchCTL.setCoalesceOptions = function(opts) {
+  ctl.setCoalesceOptions(opts)
+}
+
+/**
+ * Gets coalescing counters. `ratio` is the share of requests answered
+ * without their own launchd round trip
+ *
+ * Example:
+ *
+ *     var stats = ctl.coalesceStats()
+ *     // => { requests: 40, launched: 4, joined: 30, fresh: 6, ratio: 0.9 }
+ *
+ * @api public
+ */
+LaunchCTL.coalesceStats = function() {
+  return ctl.getCoalesceStats()
+}
+
+/**
+ * Gets queue depth per lane plus wait and run times per operation type
+ * for the threads running async launchd requests
+ *
+ * Example:
+ *
+ *     var stats = ctl.executorStats()
+ *     // => { threads: 2, queueSize: 1024, depth: 0, peakDepth: 3,
+ *     //      inFlight: 0, timeout: 0, timedOut: 1, cancelled: 1,
+ *     //      lanes: { interactive: { depth: 0, peakDepth: 3, running: 0,
+ *     //      reserved: 1, limit: 2 }, ... },
+ *     //      ops: { getJob: { lane: 'interactive', count: 12, rejected: 0, timedOut: 1,
+ *     //      cancelled: 1, waitMs: 0.01, maxWaitMs: 0.05, runMs: 0.4,
+ *     //      maxRunMs: 1.2 }, ... } }
+ *
+ * `timedOut` counts every deadline that passed, `cancelled` those of
+ * requests dropped before they started
+ *
+ * @api public
+ */
+LaunchCTL.executorStats = function() {
+  return ctl.getExecutorStats()
+}
+
 /**
  * Construct launchctl plist object
  */
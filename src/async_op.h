@@ -0,0 +1,230 @@
+/*
+ * async_op.h
+ * The life cycle shared by every async binding
+ *
+ * AsyncOp<T> is a binding built from a traits type T. It validates and
+ * captures the call's arguments into a pooled T, runs T's work on the
+ * executor and converts the result on the loop thread, then calls back
+ * with (err) or (null, result). T only supplies what differs between
+ * operations:
+ *
+ *   static const exec_op_t op     executor operation (lane and stats)
+ *   bool Capture(args, ctx)       validates and copies the arguments, or
+ *                                 throws and returns false. Initialises
+ *                                 every field Work() and Result() read,
+ *                                 since pooled instances are reused as is
+ *   int Work()                    runs without touching V8, returns errno
+ *   int Result(Local<Value> *)    converts the result, returns errno. An
+ *                                 empty result calls back with (null)
+ *   void Release(int err)         frees what Capture() and Work() left,
+ *                                 err being what the caller is told
+ *
+ * and may hide the defaults of OpTraits, which include a batching hook:
+ *
+ *   size_t Slots()                executor slots the call is spread over.
+ *                                 Work() runs once in each, concurrently,
+ *                                 and Result() once all of them are done
+ *   int SlotDone(int status)      folds in the executor status of one slot
+ *                                 (EAGAIN, ETIMEDOUT, ECANCELED or 0) and
+ *                                 returns what the call fails with
+ *   executor_deadline             false when the executor must not answer
+ *                                 the caller at the deadline, for batches
+ *                                 that report what they got done instead
+ *
+ * Everything is resolved at compile
+ * time, so there is no virtual dispatch per call. Pooling, deadlines and
+ * flights live here once instead of in every binding.
+ *
+ */
+
+#ifndef LAUNCHCTL_ASYNC_OP_H
+#define LAUNCHCTL_ASYNC_OP_H
+
+#include "launchctl.h"
+
+namespace launchctl {
+
+// What Capture() learns about the call besides its own arguments
+struct OpContext {
+  // Empty when the call runs synchronously
+  v8::Local<v8::Function> callback;
+  // Deadline in ms, 0 for the executor default
+  uint64_t timeout;
+  // Set when a shared flight answers the caller instead
+  bool joined;
+};
+
+struct OpTraits {
+  // Whether a call without a trailing callback runs inline and returns
+  // its result (or throws) instead of being rejected
+  static const bool sync_allowed = false;
+
+  // Whether the executor answers the caller with ETIMEDOUT once the
+  // call's deadline passes
+  static const bool executor_deadline = true;
+
+  // Request this one is shared with, see JoinFlight()
+  Flight *flight;
+
+  // One executor slot per call
+  size_t Slots() {
+    return 1;
+  }
+
+  // Any executor status fails the call
+  int SlotDone(int status) {
+    return status;
+  }
+
+  // The error passed to the caller
+  v8::Local<v8::Value> Error(int err) {
+    return LaunchDException(err, strerror(err), NULL);
+  }
+
+  // Copies v into dst, throwing when out of memory
+  template <size_t N>
+  static bool Copy(InlineString<N> *dst, v8::Local<v8::Value> v) {
+    if (dst->Assign(v)) {
+      return true;
+    }
+    NanThrowError(LaunchDException(ENOMEM, strerror(ENOMEM), NULL));
+    return false;
+  }
+};
+
+template <typename T>
+class AsyncOp {
+ public:
+  AsyncOp() : callback(new NanCallback()) {}
+  ~AsyncOp() { delete callback; }
+
+  static NAN_METHOD(Method) {
+    NanScope();
+    v8::Local<v8::Value> last = args.Length() ? args[args.Length()-1] : NanUndefined();
+    if (!last->IsFunction() && !T::sync_allowed) {
+      NanThrowTypeError("Callback must be a function");
+      NanReturnUndefined();
+    }
+
+    OpContext ctx;
+    if (last->IsFunction()) {
+      ctx.callback = v8::Local<v8::Function>::Cast(last);
+    }
+    ctx.timeout = 0;
+    ctx.joined = false;
+
+    AsyncOp *op = pool.Acquire();
+    op->state.flight = NULL;
+    if (!op->state.Capture(args, &ctx)) {
+      pool.Release(op);
+      NanReturnUndefined();
+    }
+    if (ctx.joined) {
+      op->state.Release(0);
+      pool.Release(op);
+      NanReturnUndefined();
+    }
+
+    if (ctx.callback.IsEmpty()) {
+      int err = op->state.Work();
+      v8::Local<v8::Value> res;
+      if (!err) {
+        err = op->state.Result(&res);
+      }
+      v8::Local<v8::Value> e;
+      if (err) {
+        e = op->state.Error(err);
+      }
+      op->state.Release(err);
+      pool.Release(op);
+      if (err) {
+        NanThrowError(e);
+        NanReturnUndefined();
+      }
+      if (res.IsEmpty()) {
+        NanReturnUndefined();
+      }
+      NanReturnValue(res);
+    }
+
+    size_t slots = op->state.Slots();
+    op->requests.resize(slots);
+    op->pending = slots;
+    op->status = 0;
+    op->err = 0;
+    op->callback->SetFunction(ctx.callback);
+    for (size_t i=0; i<slots; i++) {
+      op->requests[i].data = op;
+      QueueWork(&op->requests[i], T::op, Work, AfterWork,
+        T::executor_deadline ? op->callback : NULL, ctx.timeout);
+    }
+    NanReturnUndefined();
+  }
+
+  // { created, reused, idle } of this operation's pool
+  static v8::Local<v8::Object> PoolStats() {
+    return pool.Stats();
+  }
+
+ private:
+  static void Work(uv_work_t *req) {
+    AsyncOp *op = static_cast<AsyncOp *>(req->data);
+    int err = op->state.Work();
+    if (err) {
+      op->err = err;
+    }
+  }
+
+  // The last slot to finish answers the caller
+  static void AfterWork(uv_work_t *req, int status) {
+    NanScope();
+    AsyncOp *op = static_cast<AsyncOp *>(req->data);
+    status = op->state.SlotDone(status);
+    if (status) {
+      op->status = status;
+    }
+    if (--op->pending > 0) {
+      return;
+    }
+    int err = op->status ? op->status : op->err;
+    v8::Local<v8::Value> res;
+    if (!err) {
+      err = op->state.Result(&res);
+    }
+    v8::Local<v8::Value> argv[2] = {
+      NanNull(),
+      res
+    };
+    if (err) {
+      argv[0] = op->state.Error(err);
+    }
+    Flight *flight = op->state.flight;
+    op->state.Release(err);
+    FinishFlight(flight, op->callback, (err || res.IsEmpty()) ? 1 : 2, argv);
+
+    // Drop the caller's function while the op sits idle
+    op->callback->SetFunction(DiscardFunction());
+    pool.Release(op);
+  }
+
+  // One per slot, reused with the pooled op
+  std::vector<uv_work_t> requests;
+  size_t pending;
+  // Executor status of the call, then the errno of its work
+  int status;
+  T state;
+  int err;
+  NanCallback *callback;
+
+  static BatonPool<AsyncOp> pool;
+
+  AsyncOp(const AsyncOp &);
+  AsyncOp &operator=(const AsyncOp &);
+};
+
+template <typename T>
+BatonPool<AsyncOp<T> > AsyncOp<T>::pool(BATON_POOL_MAX);
+
+} // namespace launchctl
+
+#endif
@@ -0,0 +1,283 @@
+/*
+ * changes.cc
+ * Incremental job state tracking
+ *
+ * A JobTracker remembers, per label, a hash of every top level key of each
+ * job seen in the previous ALLJOBS response. Hashing and comparing happen on
+ * the threadpool, so only jobs that were added or modified since the last
+ * call are ever converted to JS values. Unchanged jobs cost one response
+ * walk on the worker and nothing on the event loop.
+ *
+ */
+
+#include <v8.h>
+#include <node.h>
+#include <launch.h>
+#include <string>
+#include <vector>
+#include "launchctl.h"
+#include "async_op.h"
+using namespace node;
+using namespace v8;
+
+namespace launchctl {
+
+// Hash of each top level key of a job, ordered by key
+typedef std::map<std::string, uint64_t> KeyHashes;
+typedef std::map<std::string, KeyHashes> JobHashes;
+
+struct ModifiedJob {
+  launch_data_t job;
+  std::vector<std::string> changed;
+};
+
+static Persistent<FunctionTemplate> tracker_template;
+
+// 64 bit FNV-1a
+static uint64_t HashBytes(const char *p, size_t len) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i=0; i<len; i++) {
+    h ^= (unsigned char)p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// Hashes every top level value of job through its encoding, reusing buf
+static int HashJob(launch_data_t job, size_t maxDepth, struct launch_data_buf *buf, KeyHashes *out) {
+  if (launch_data_get_type(job) != LAUNCH_DATA_DICTIONARY) {
+    return EMALFORM;
+  }
+  for (size_t i=0; i+1<job->_array_cnt; i+=2) {
+    launch_data_t k = job->_array[i];
+    if (k == NULL || launch_data_get_type(k) != LAUNCH_DATA_STRING) {
+      return EMALFORM;
+    }
+    buf->len = 0;
+    int err = launch_data_encode(job->_array[i+1], buf, maxDepth);
+    if (err) {
+      return err;
+    }
+    (*out)[launch_data_get_string(k)] = HashBytes(buf->data, buf->len);
+  }
+  return 0;
+}
+
+// Keys whose hash differs between a and b, or that only one side has
+static void ChangedKeys(const KeyHashes &a, const KeyHashes &b, std::vector<std::string> *out) {
+  KeyHashes::const_iterator i = a.begin(), j = b.begin();
+  while (i != a.end() || j != b.end()) {
+    if (j == b.end() || (i != a.end() && i->first < j->first)) {
+      out->push_back(i->first);
+      ++i;
+    } else if (i == a.end() || j->first < i->first) {
+      out->push_back(j->first);
+      ++j;
+    } else {
+      if (i->second != j->second) {
+        out->push_back(i->first);
+      }
+      ++i;
+      ++j;
+    }
+  }
+}
+
+class JobTracker : public ObjectWrap {
+ public:
+  static void Init(Handle<Object> target);
+
+  // Labels and key hashes from the previous call. Only the worker of the
+  // pending changes() call touches it while busy is set
+  JobHashes snapshot;
+  bool busy;
+
+  // Keeps the tracker alive while a changes() call is in flight
+  void Pin() { Ref(); }
+  void Unpin() { Unref(); }
+
+ private:
+  JobTracker() : busy(false) {}
+
+  static NAN_METHOD(New) {
+    NanScope();
+    JobTracker *tracker = new JobTracker();
+    tracker->Wrap(args.This());
+    NanReturnValue(args.This());
+  }
+
+  // Forgets the previous snapshot, so the next call reports every job as added
+  static NAN_METHOD(Reset) {
+    NanScope();
+    JobTracker *tracker = ObjectWrap::Unwrap<JobTracker>(args.This());
+    if (tracker->busy) {
+      NanThrowError(LaunchDException(EBUSY, NULL, NULL));
+      NanReturnUndefined();
+    }
+    tracker->snapshot.clear();
+    NanReturnUndefined();
+  }
+};
+
+// changes([opts], cb) reports what changed since the previous call
+struct JobChangesOp : OpTraits {
+  static const exec_op_t op = EXEC_OP_JOB_CHANGES;
+
+  JobTracker *tracker;
+  launch_data_t resp;
+  LabelFilter *filter;
+  std::vector<launch_data_t> added;
+  std::vector<std::string> removed;
+  std::vector<ModifiedJob> modified;
+  ConvertOptions opts;
+  // Whether Work() ran, and so may have replaced the snapshot
+  bool ran;
+
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    if (args.Length() < 1 || args.Length() > 2) {
+      NanThrowTypeError("Invalid arguments");
+      return false;
+    }
+
+    tracker = ObjectWrap::Unwrap<JobTracker>(args.This());
+    if (tracker->busy) {
+      NanThrowError(LaunchDException(EBUSY, NULL, NULL));
+      return false;
+    }
+
+    Local<Value> o = args.Length() == 2 ? args[0] : NanUndefined();
+    if (!ParseLabelFilter(o, &filter)) {
+      return false;
+    }
+    resp = NULL;
+    added.clear();
+    removed.clear();
+    modified.clear();
+    ran = false;
+    ParseConvertOptions(o, &opts);
+    ctx->timeout = ParseTimeout(o);
+
+    tracker->Pin();
+    tracker->busy = true;
+    return true;
+  }
+
+  int Work() {
+    ran = true;
+    if (FetchAllJobs(&resp) != NULL || resp == NULL) {
+      return errno ? errno : ESRCH;
+    }
+    if (launch_data_get_type(resp) != LAUNCH_DATA_DICTIONARY) {
+      return EMALFORM;
+    }
+    FilterAllJobs(resp, filter);
+
+    int err = 0;
+    JobHashes next;
+    struct launch_data_buf buf;
+    memset(&buf, 0, sizeof(buf));
+    for (size_t i=0; i+1<resp->_array_cnt; i+=2) {
+      launch_data_t k = resp->_array[i];
+      launch_data_t job = resp->_array[i+1];
+      if (k == NULL || launch_data_get_type(k) != LAUNCH_DATA_STRING) {
+        err = EMALFORM;
+        break;
+      }
+      std::string label(launch_data_get_string(k));
+      KeyHashes &hashes = next[label];
+      err = HashJob(job, opts.maxDepth, &buf, &hashes);
+      if (err) {
+        break;
+      }
+
+      JobHashes::iterator prev = tracker->snapshot.find(label);
+      if (prev == tracker->snapshot.end()) {
+        added.push_back(job);
+        continue;
+      }
+      ModifiedJob m;
+      ChangedKeys(prev->second, hashes, &m.changed);
+      if (!m.changed.empty()) {
+        m.job = job;
+        modified.push_back(m);
+      }
+    }
+    launch_data_buf_free(&buf);
+    if (err) {
+      return err;
+    }
+
+    JobHashes &prev = tracker->snapshot;
+    for (JobHashes::iterator it = prev.begin(); it != prev.end(); ++it) {
+      if (next.find(it->first) == next.end()) {
+        removed.push_back(it->first);
+      }
+    }
+    prev.swap(next);
+    return 0;
+  }
+
+  int Result(Local<Value> *out) {
+    int err = 0;
+    Local<Object> res = NanNew<v8::Object>();
+    Local<Array> a = NanNew<v8::Array>(added.size());
+    for (size_t i=0; i<added.size() && !err; i++) {
+      a->Set(i, ConvertJob(added[i], &opts, &err));
+    }
+    Local<Array> r = NanNew<v8::Array>(removed.size());
+    for (size_t i=0; i<removed.size(); i++) {
+      r->Set(i, NanNew<v8::String>(removed[i].c_str()));
+    }
+    Local<Array> m = NanNew<v8::Array>(modified.size());
+    for (size_t i=0; i<modified.size() && !err; i++) {
+      ModifiedJob &mod = modified[i];
+      Local<Object> entry = NanNew<v8::Object>();
+      Local<Array> changed = NanNew<v8::Array>(mod.changed.size());
+      for (size_t j=0; j<mod.changed.size(); j++) {
+        changed->Set(j, CachedKey(mod.changed[j].c_str()));
+      }
+      entry->Set(NanSymbol("job"), ConvertJob(mod.job, &opts, &err));
+      entry->Set(NanSymbol("changed"), changed);
+      m->Set(i, entry);
+    }
+    res->Set(NanSymbol("added"), a);
+    res->Set(NanSymbol("removed"), r);
+    res->Set(NanSymbol("modified"), m);
+    *out = res;
+    return err;
+  }
+
+  // Runs before the callback, so it may call changes() again
+  void Release(int err) {
+    tracker->busy = false;
+    // The snapshot may already reflect jobs the caller never saw
+    if (err && ran) {
+      tracker->snapshot.clear();
+    }
+    if (resp) {
+      launch_data_free(resp);
+    }
+    // Job pointers into resp must not outlive it in the pool
+    added.clear();
+    modified.clear();
+    tracker->Unpin();
+    FreeConvertOptions(&opts);
+    FreeLabelFilter(filter);
+  }
+};
+
+void JobTracker::Init(Handle<Object> target) {
+  Local<FunctionTemplate> t = NanNew<v8::FunctionTemplate>(New);
+  t->SetClassName(NanSymbol("JobTracker"));
+  t->InstanceTemplate()->SetInternalFieldCount(1);
+  NODE_SET_PROTOTYPE_METHOD(t, "changes", AsyncOp<JobChangesOp>::Method);
+  NODE_SET_PROTOTYPE_METHOD(t, "reset", Reset);
+  NanAssignPersistent(tracker_template, t);
+  target->Set(NanSymbol("JobTracker"), t->GetFunction());
+}
+
+void InitJobTracker(Handle<Object> target) {
+  JobTracker::Init(target);
+}
+
+} // namespace launchctl
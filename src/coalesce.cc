@@ -0,0 +1,241 @@
+/*
+ * coalesce.cc
+ * Single-flight sharing of identical getJob/getAllJobs requests
+ *
+ * While a request is in flight, identical requests (same operation, label,
+ * conversion options and filter) join it instead of asking launchd again,
+ * and every caller receives the same converted result. With a freshness
+ * window, successful results keep being handed out for that many
+ * milliseconds after they arrive. Coalescing is off until enabled with
+ * setCoalesceOptions(), since callers then share result objects.
+ *
+ */
+
+#include <v8.h>
+#include <node.h>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "launchctl.h"
+using namespace node;
+using namespace v8;
+
+namespace launchctl {
+
+struct Flight {
+  std::string key;
+  // Callers that joined after the request was started
+  std::vector<NanCallback *> waiters;
+  bool done;
+  // Loop time (ms) until which result is handed out again
+  uint64_t expires;
+  Persistent<Value> result;
+};
+
+// A fresh result handed to a late caller on the next loop iteration
+struct FreshCall {
+  uv_timer_t timer;
+  NanCallback *callback;
+  Persistent<Value> result;
+};
+
+typedef std::map<std::string, Flight *> FlightMap;
+static FlightMap flights;
+static bool coalesce_enabled = false;
+static uint64_t coalesce_fresh_ms = 0;
+static double coalesce_requests = 0;
+static double coalesce_launched = 0;
+static double coalesce_joined = 0;
+static double coalesce_fresh = 0;
+
+static void AppendFields(std::string *key, const FieldSet *fields) {
+  if (fields == NULL) {
+    return;
+  }
+  *key += fields->all ? "{*" : "{";
+  for (FieldSet::Children::const_iterator it = fields->children.begin();
+       it != fields->children.end(); ++it) {
+    *key += it->first;
+    *key += ',';
+    AppendFields(key, it->second);
+  }
+  *key += '}';
+}
+
+static std::string FlightKey(const char *op, const char *label, const ConvertOptions *opts, const LabelFilter *filter) {
+  char buf[64];
+  std::string key(op);
+  key += '\0';
+  if (label) {
+    key += label;
+  }
+  key += '\0';
+  snprintf(buf, sizeof(buf), "%d%d%d%lu", opts->shaped, opts->lazy,
+    opts->serialized, (unsigned long)opts->maxDepth);
+  key += buf;
+  AppendFields(&key, opts->fields);
+  if (filter) {
+    snprintf(buf, sizeof(buf), "|%d%d:", filter->kind, filter->icase);
+    key += buf;
+    key += filter->pattern;
+  }
+  return key;
+}
+
+static void DisposeFlight(Flight *flight) {
+  flights.erase(flight->key);
+  NanDisposePersistent(flight->result);
+  delete flight;
+}
+
+static void FreshCallClosed(uv_handle_t *handle) {
+  FreshCall *call = static_cast<FreshCall *>(handle->data);
+  NanDisposePersistent(call->result);
+  delete call->callback;
+  delete call;
+}
+
+#if NODE_VERSION_AT_LEAST(0, 11, 0)
+static void FreshCallFire(uv_timer_t *handle) {
+#else
+static void FreshCallFire(uv_timer_t *handle, int status) {
+#endif
+  NanScope();
+  FreshCall *call = static_cast<FreshCall *>(handle->data);
+  Local<Value> argv[2] = {
+    NanNull(),
+    NanNew(call->result)
+  };
+  TryCatch try_catch;
+  call->callback->Call(2, argv);
+  if (try_catch.HasCaught()) {
+    node::FatalException(try_catch);
+  }
+  uv_close((uv_handle_t *)&call->timer, FreshCallClosed);
+}
+
+Flight *JoinFlight(const char *op, const char *label, const ConvertOptions *opts,
+    const LabelFilter *filter, Local<Function> fn, bool *joined) {
+  *joined = false;
+  if (!coalesce_enabled) {
+    return NULL;
+  }
+  coalesce_requests++;
+
+  std::string key = FlightKey(op, label, opts, filter);
+  FlightMap::iterator it = flights.find(key);
+  if (it != flights.end()) {
+    Flight *flight = it->second;
+    if (!flight->done) {
+      flight->waiters.push_back(new NanCallback(fn));
+      coalesce_joined++;
+      *joined = true;
+      return flight;
+    }
+    if (flight->expires > uv_now(uv_default_loop())) {
+      FreshCall *call = new FreshCall;
+      call->callback = new NanCallback(fn);
+      NanAssignPersistent(call->result, NanNew(flight->result));
+      uv_timer_init(uv_default_loop(), &call->timer);
+      call->timer.data = call;
+      uv_timer_start(&call->timer, FreshCallFire, 0, 0);
+      coalesce_fresh++;
+      *joined = true;
+      return flight;
+    }
+    DisposeFlight(flight);
+  }
+
+  // Results nobody asked for again within their window
+  uint64_t now = uv_now(uv_default_loop());
+  std::vector<Flight *> expired;
+  for (FlightMap::iterator e = flights.begin(); e != flights.end(); ++e) {
+    if (e->second->done && e->second->expires <= now) {
+      expired.push_back(e->second);
+    }
+  }
+  for (size_t i=0; i<expired.size(); i++) {
+    DisposeFlight(expired[i]);
+  }
+
+  Flight *flight = new Flight;
+  flight->key = key;
+  flight->done = false;
+  flight->expires = 0;
+  flights[key] = flight;
+  coalesce_launched++;
+  return flight;
+}
+
+void FinishFlight(Flight *flight, NanCallback *callback, int argc, Local<Value> argv[]) {
+  std::vector<NanCallback *> waiters;
+  if (flight) {
+    waiters.swap(flight->waiters);
+    bool ok = argc == 2 && argv[0]->IsNull();
+    if (ok && coalesce_fresh_ms > 0) {
+      flight->done = true;
+      flight->expires = uv_now(uv_default_loop()) + coalesce_fresh_ms;
+      NanAssignPersistent(flight->result, argv[1]);
+    } else {
+      DisposeFlight(flight);
+    }
+  }
+
+  TryCatch try_catch;
+  callback->Call(argc, argv);
+  if (try_catch.HasCaught()) {
+    node::FatalException(try_catch);
+  }
+  for (size_t i=0; i<waiters.size(); i++) {
+    TryCatch try_catch;
+    waiters[i]->Call(argc, argv);
+    if (try_catch.HasCaught()) {
+      node::FatalException(try_catch);
+    }
+    delete waiters[i];
+  }
+}
+
+// setCoalesceOptions({ enabled, freshMs })
+NAN_METHOD(SetCoalesceOptions) {
+  NanScope();
+  if (args.Length() != 1 || !args[0]->IsObject()) {
+    NanThrowTypeError("Options must be an object");
+    NanReturnUndefined();
+  }
+  Local<Object> o = args[0]->ToObject();
+  Local<Value> enabled = o->Get(NanSymbol("enabled"));
+  Local<Value> fresh = o->Get(NanSymbol("freshMs"));
+  if (!enabled->IsUndefined()) {
+    coalesce_enabled = enabled->BooleanValue();
+  }
+  if (fresh->IsNumber()) {
+    coalesce_fresh_ms = fresh->IntegerValue() > 0 ? (uint64_t)fresh->IntegerValue() : 0;
+  }
+
+  // Drop cached results that the new settings no longer allow
+  std::vector<Flight *> stale;
+  for (FlightMap::iterator it = flights.begin(); it != flights.end(); ++it) {
+    if (it->second->done) {
+      stale.push_back(it->second);
+    }
+  }
+  for (size_t i=0; i<stale.size(); i++) {
+    DisposeFlight(stale[i]);
+  }
+  NanReturnUndefined();
+}
+
+NAN_METHOD(GetCoalesceStats) {
+  NanScope();
+  Local<Object> res = NanNew<v8::Object>();
+  res->Set(NanSymbol("requests"), NanNew<v8::Number>(coalesce_requests));
+  res->Set(NanSymbol("launched"), NanNew<v8::Number>(coalesce_launched));
+  res->Set(NanSymbol("joined"), NanNew<v8::Number>(coalesce_joined));
+  res->Set(NanSymbol("fresh"), NanNew<v8::Number>(coalesce_fresh));
+  res->Set(NanSymbol("ratio"), NanNew<v8::Number>(coalesce_requests
+    ? (coalesce_joined + coalesce_fresh) / coalesce_requests : 0));
+  NanReturnValue(res);
+}
+
+} // namespace launchctl
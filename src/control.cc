@@ -0,0 +1,470 @@
+/*
+ * control.cc
+ * Limits, rusage, environment, umask and manager queries
+ *
+ * Each of these is a single launch_msg() or vproc_swap_*() round trip.
+ * Every binding runs synchronously as before, or, when its last argument
+ * is a callback, on the launchd executor so a busy launchd never stalls
+ * the event loop. An options object before the callback may carry a
+ * `timeout` in ms. Both paths share the same request and conversion code:
+ * the request runs without touching V8 and the result is converted
+ * afterwards on the loop thread (see async_op.h).
+ *
+ */
+
+#include <v8.h>
+#include <node.h>
+#include <launch.h>
+#include <vproc.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "launchctl.h"
+#include "async_op.h"
+using namespace node;
+using namespace v8;
+
+namespace launchctl {
+
+typedef enum {
+  CONTROL_GET_LIMITS = 0,
+  CONTROL_SET_LIMIT,
+  CONTROL_RUSAGE,
+  CONTROL_GET_ENV,
+  CONTROL_SET_ENV,
+  CONTROL_UNSET_ENV,
+  CONTROL_GET_UMASK,
+  CONTROL_SET_UMASK,
+  CONTROL_MANAGER_NAME,
+  CONTROL_MANAGER_UID,
+  CONTROL_MANAGER_PID
+} control_op_t;
+
+// Sends msg (taking ownership of it). Returns the response when it has
+// type `want`, otherwise NULL with the error in *err
+static launch_data_t Request(launch_data_t msg, launch_data_type_t want, int *err) {
+  launch_data_t resp = launch_transport_msg(msg);
+  launch_data_free(msg);
+  if (resp == NULL) {
+    *err = errno ? errno : 153;
+    return NULL;
+  }
+  launch_data_type_t type = launch_data_get_type(resp);
+  if (type == want) {
+    return resp;
+  }
+  if (type == LAUNCH_DATA_ERRNO && launch_data_get_errno(resp)) {
+    *err = launch_data_get_errno(resp);
+  } else {
+    *err = 153;
+  }
+  launch_data_free(resp);
+  return NULL;
+}
+
+static int SetLimit(const char *name, const char *soft, const char *hard) {
+  ssize_t which = name2num(name);
+  if (which == -1) {
+    return 152;
+  }
+  rlim_t slim, hlim;
+  if (str2lim(soft, &slim) || str2lim(hard, &hlim)) {
+    return 152;
+  }
+
+  int err = 0;
+  launch_data_t limits = Request(launch_data_new_string(LAUNCH_KEY_GETRESOURCELIMITS),
+    LAUNCH_DATA_OPAQUE, &err);
+  if (limits == NULL) {
+    return err;
+  }
+  struct rlimit *lmts = (struct rlimit *)launch_data_get_opaque(limits);
+  size_t lsz = launch_data_get_opaque_size(limits);
+  if ((size_t)which >= lsz / sizeof(struct rlimit)) {
+    launch_data_free(limits);
+    return 152;
+  }
+  lmts[which].rlim_cur = slim;
+  lmts[which].rlim_max = hlim;
+
+  launch_data_t msg = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+  launch_data_dict_insert(msg, launch_data_new_opaque(lmts, lsz), LAUNCH_KEY_SETRESOURCELIMITS);
+  launch_data_free(limits);
+  launch_data_t resp = Request(msg, LAUNCH_DATA_OPAQUE, &err);
+  if (resp) {
+    launch_data_free(resp);
+  }
+  return err;
+}
+
+static Local<Value> LimitsValue(launch_data_t resp) {
+  NanEscapableScope();
+  char slimstr[100];
+  char hlimstr[100];
+  struct rlimit *lmts = (struct rlimit *)launch_data_get_opaque(resp);
+  size_t lsz = launch_data_get_opaque_size(resp);
+  Local<Object> output = NanNew<v8::Object>();
+  for (size_t i=0; i<(lsz/sizeof(struct rlimit)); i++) {
+    const char *l = num2name((int)i);
+    if (l == NULL) {
+      continue;
+    }
+    Local<Object> inside = NanNew<v8::Object>();
+    inside->Set(CachedKey("soft"), NanNew<v8::String>(lim2str(lmts[i].rlim_cur, slimstr)));
+    inside->Set(CachedKey("hard"), NanNew<v8::String>(lim2str(lmts[i].rlim_max, hlimstr)));
+    output->Set(CachedKey(l), inside);
+  }
+  return NanEscapeScope(output);
+}
+
+static Local<Value> RUsageValue(launch_data_t resp) {
+  NanEscapableScope();
+  struct rusage *rusage = (struct rusage *)launch_data_get_opaque(resp);
+  Local<Object> output = NanNew<v8::Object>();
+  double usertimeused = (double)rusage->ru_utime.tv_sec + (double)rusage->ru_utime.tv_usec / (double)1000000;
+  output->Set(CachedKey("user_time_used"), NanNew<v8::Number>(usertimeused));
+  double systemtimeused = (double)rusage->ru_stime.tv_sec + (double)rusage->ru_stime.tv_usec / (double)1000000;
+  output->Set(CachedKey("system_time_used"), NanNew<v8::Number>(systemtimeused));
+  output->Set(CachedKey("max_resident_set_size"), NanNew<v8::Number>(rusage->ru_maxrss));
+  output->Set(CachedKey("shared_text_memory_size"), NanNew<v8::Number>(rusage->ru_ixrss));
+  output->Set(CachedKey("unshared_data_size"), NanNew<v8::Number>(rusage->ru_idrss));
+  output->Set(CachedKey("unshared_stack_size"), NanNew<v8::Number>(rusage->ru_isrss));
+  output->Set(CachedKey("page_reclaims"), NanNew<v8::Number>(rusage->ru_minflt));
+  output->Set(CachedKey("page_faults"), NanNew<v8::Number>(rusage->ru_majflt));
+  output->Set(CachedKey("swaps"), NanNew<v8::Number>(rusage->ru_nswap));
+  output->Set(CachedKey("block_input_operations"), NanNew<v8::Number>(rusage->ru_inblock));
+  output->Set(CachedKey("block_output_operations"), NanNew<v8::Number>(rusage->ru_oublock));
+  output->Set(CachedKey("messages_sent"), NanNew<v8::Number>(rusage->ru_msgsnd));
+  output->Set(CachedKey("messages_received"), NanNew<v8::Number>(rusage->ru_msgrcv));
+  output->Set(CachedKey("signals_received"), NanNew<v8::Number>(rusage->ru_nsignals));
+  output->Set(CachedKey("voluntary_context_switches"), NanNew<v8::Number>(rusage->ru_nvcsw));
+  output->Set(CachedKey("involuntary_context_switches"), NanNew<v8::Number>(rusage->ru_nivcsw));
+  return NanEscapeScope(output);
+}
+
+// Shared by every control binding. Each binding only differs in how it
+// captures its arguments, see the structs below
+struct ControlOp : OpTraits {
+  static const exec_op_t op = EXEC_OP_CONTROL;
+  static const bool sync_allowed = true;
+
+  control_op_t control;
+  // Limit name, soft and hard limit / env key and value / rusage who / umask
+  InlineString<64> params[3];
+  launch_data_t resp;
+  char *str;
+  int64_t num;
+
+  // Number of arguments before the callback and the { timeout } options
+  // that may precede it, taking the deadline from those options
+  static int Params(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    int argc = args.Length();
+    if (ctx->callback.IsEmpty()) {
+      return argc;
+    }
+    argc--;
+    if (argc > 0 && args[argc-1]->IsObject() && !args[argc-1]->IsFunction()) {
+      ctx->timeout = ParseTimeout(args[argc-1]);
+      argc--;
+    }
+    return argc;
+  }
+
+  // Resets what Work() and Result() read
+  void Begin(control_op_t c) {
+    control = c;
+    resp = NULL;
+    str = NULL;
+    num = 0;
+  }
+
+  // Makes the request without touching V8, so it may run on any thread
+  int Work() {
+    int err = 0;
+    launch_data_t msg, tmp;
+    switch (control) {
+      case CONTROL_GET_LIMITS:
+        if (geteuid() == 0) {
+          setup_system_context();
+        }
+        resp = Request(launch_data_new_string(LAUNCH_KEY_GETRESOURCELIMITS),
+          LAUNCH_DATA_OPAQUE, &err);
+        break;
+      case CONTROL_SET_LIMIT:
+        if (geteuid() == 0) {
+          setup_system_context();
+        }
+        err = SetLimit(params[0].c_str(), params[1].c_str(), params[2].c_str());
+        break;
+      case CONTROL_RUSAGE:
+        msg = launch_data_new_string(strcmp(params[0].c_str(), "self") == 0
+          ? LAUNCH_KEY_GETRUSAGESELF : LAUNCH_KEY_GETRUSAGECHILDREN);
+        resp = Request(msg, LAUNCH_DATA_OPAQUE, &err);
+        break;
+      case CONTROL_GET_ENV:
+        // No environment is reported as 0, not as an error
+        if (launch_transport_swap_complex(NULL, VPROC_GSK_ENVIRONMENT, NULL, &resp) != NULL) {
+          resp = NULL;
+        } else if (launch_data_get_type(resp) != LAUNCH_DATA_DICTIONARY) {
+          launch_data_free(resp);
+          resp = NULL;
+        }
+        break;
+      case CONTROL_SET_ENV:
+      case CONTROL_UNSET_ENV:
+        msg = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+        if (control == CONTROL_SET_ENV) {
+          tmp = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+          launch_data_dict_insert(tmp, launch_data_new_string(params[1].c_str()),
+            params[0].c_str());
+          launch_data_dict_insert(msg, tmp, LAUNCH_KEY_SETUSERENVIRONMENT);
+        } else {
+          launch_data_dict_insert(msg, launch_data_new_string(params[0].c_str()),
+            LAUNCH_KEY_UNSETUSERENVIRONMENT);
+        }
+        tmp = launch_transport_msg(msg);
+        launch_data_free(msg);
+        if (tmp) {
+          launch_data_free(tmp);
+        } else {
+          err = errno ? errno : 153;
+        }
+        break;
+      case CONTROL_GET_UMASK:
+        num = launchctl_getumask();
+        if (num == -1) {
+          err = errno ? errno : 153;
+        }
+        break;
+      case CONTROL_SET_UMASK:
+        err = launchctl_setumask(params[0].c_str());
+        break;
+      case CONTROL_MANAGER_NAME:
+        str = launchctl_get_managername();
+        if (str == NULL) {
+          err = errno ? errno : 153;
+        }
+        break;
+      case CONTROL_MANAGER_UID:
+        num = launchctl_get_manageruid();
+        if (num < 0) {
+          err = errno ? errno : 153;
+        }
+        break;
+      case CONTROL_MANAGER_PID:
+        num = launchctl_get_managerpid();
+        if (num < 0) {
+          err = errno ? errno : 153;
+        }
+        break;
+    }
+    return err;
+  }
+
+  int Result(Local<Value> *out) {
+    int err = 0;
+    switch (control) {
+      case CONTROL_GET_LIMITS:
+        *out = LimitsValue(resp);
+        break;
+      case CONTROL_RUSAGE:
+        *out = RUsageValue(resp);
+        break;
+      case CONTROL_GET_ENV:
+        if (resp == NULL) {
+          *out = NanNew<v8::Number>(0);
+        } else {
+          ConvertOptions opts;
+          DefaultConvertOptions(&opts);
+          *out = GetJobDetail(resp, &opts, &err);
+        }
+        break;
+      case CONTROL_GET_UMASK:
+      case CONTROL_MANAGER_UID:
+      case CONTROL_MANAGER_PID:
+        *out = NanNew<v8::Number>((double)num);
+        break;
+      case CONTROL_MANAGER_NAME:
+        *out = NanNew<v8::String>(str);
+        break;
+      default:
+        *out = NanNew<v8::Number>(0);
+        break;
+    }
+    return err;
+  }
+
+  Local<Value> Error(int err) {
+    return LaunchDException(err, NULL, NULL);
+  }
+
+  void Release(int err) {
+    if (resp) {
+      launch_data_free(resp);
+    }
+    free(str);
+  }
+};
+
+// getLimitSync() / getLimit([opts], cb)
+struct GetLimitOp : ControlOp {
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    Params(args, ctx);
+    Begin(CONTROL_GET_LIMITS);
+    return true;
+  }
+};
+
+// setLimitSync(name, soft, hard) / setLimit(name, soft, hard, [opts], cb)
+struct SetLimitOp : ControlOp {
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    if (Params(args, ctx) < 3) {
+      NanThrowTypeError("Invalid arguments");
+      return false;
+    }
+    if (!args[0]->IsString()) {
+      NanThrowTypeError("Limit name must be a string");
+      return false;
+    }
+    if (!args[1]->IsString()) {
+      NanThrowTypeError("Soft limit must be a string");
+      return false;
+    }
+    if (!args[2]->IsString()) {
+      NanThrowTypeError("Hard limit must be a string");
+      return false;
+    }
+    Begin(CONTROL_SET_LIMIT);
+    for (int i=0; i<3; i++) {
+      if (!Copy(&params[i], args[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// setEnvVar(key, val, [[opts], cb])
+struct SetEnvVarOp : ControlOp {
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    if (Params(args, ctx) != 2) {
+      NanThrowTypeError("Invalid arguments");
+      return false;
+    }
+    if (!args[0]->IsString()) {
+      NanThrowTypeError("Key must be a string");
+      return false;
+    }
+    if (!args[1]->IsString()) {
+      NanThrowTypeError("Value must be a string");
+      return false;
+    }
+    Begin(CONTROL_SET_ENV);
+    return Copy(&params[0], args[0]) && Copy(&params[1], args[1]);
+  }
+};
+
+// unsetEnvVar(key, [[opts], cb])
+struct UnsetEnvVarOp : ControlOp {
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    if (Params(args, ctx) != 1) {
+      NanThrowTypeError("Invalid arguments");
+      return false;
+    }
+    if (!args[0]->IsString()) {
+      NanThrowTypeError("Key must be a string");
+      return false;
+    }
+    Begin(CONTROL_UNSET_ENV);
+    return Copy(&params[0], args[0]);
+  }
+};
+
+// getEnv([[opts], cb])
+struct GetEnvOp : ControlOp {
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    Params(args, ctx);
+    Begin(CONTROL_GET_ENV);
+    return true;
+  }
+};
+
+// getRUsage(who, [[opts], cb])
+struct GetRUsageOp : ControlOp {
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    if (Params(args, ctx) != 1) {
+      NanThrowTypeError("Invalid arguments");
+      return false;
+    }
+    if (!args[0]->IsString()) {
+      NanThrowTypeError("who must be a string containing either `self` or `children`");
+      return false;
+    }
+    Begin(CONTROL_RUSAGE);
+    return Copy(&params[0], args[0]);
+  }
+};
+
+// umask([mask], [[opts], cb]) sets the umask when mask is given, otherwise gets it
+struct UmaskOp : ControlOp {
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    int argc = Params(args, ctx);
+    if (argc > 1) {
+      NanThrowTypeError("Invalid arguments");
+      return false;
+    }
+    if (argc == 0) {
+      Begin(CONTROL_GET_UMASK);
+      return true;
+    }
+    if (!args[0]->IsString()) {
+      NanThrowTypeError("Umask must be a string");
+      return false;
+    }
+    Begin(CONTROL_SET_UMASK);
+    return Copy(&params[0], args[0]);
+  }
+};
+
+// getManagerName([[opts], cb])
+struct GetManagerNameOp : ControlOp {
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    Params(args, ctx);
+    Begin(CONTROL_MANAGER_NAME);
+    return true;
+  }
+};
+
+// getManagerUID([[opts], cb])
+struct GetManagerUIDOp : ControlOp {
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    Params(args, ctx);
+    Begin(CONTROL_MANAGER_UID);
+    return true;
+  }
+};
+
+// getManagerPID([[opts], cb])
+struct GetManagerPIDOp : ControlOp {
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    Params(args, ctx);
+    Begin(CONTROL_MANAGER_PID);
+    return true;
+  }
+};
+
+void InitControl(Handle<Object> target) {
+  NODE_SET_METHOD(target, "getLimit", AsyncOp<GetLimitOp>::Method);
+  NODE_SET_METHOD(target, "getLimitSync", AsyncOp<GetLimitOp>::Method);
+  NODE_SET_METHOD(target, "setLimit", AsyncOp<SetLimitOp>::Method);
+  NODE_SET_METHOD(target, "setLimitSync", AsyncOp<SetLimitOp>::Method);
+  NODE_SET_METHOD(target, "setEnvVar", AsyncOp<SetEnvVarOp>::Method);
+  NODE_SET_METHOD(target, "unsetEnvVar", AsyncOp<UnsetEnvVarOp>::Method);
+  NODE_SET_METHOD(target, "getEnv", AsyncOp<GetEnvOp>::Method);
+  NODE_SET_METHOD(target, "getRUsage", AsyncOp<GetRUsageOp>::Method);
+  NODE_SET_METHOD(target, "umask", AsyncOp<UmaskOp>::Method);
+  NODE_SET_METHOD(target, "getManagerName", AsyncOp<GetManagerNameOp>::Method);
+  NODE_SET_METHOD(target, "getManagerPID", AsyncOp<GetManagerPIDOp>::Method);
+  NODE_SET_METHOD(target, "getManagerUID", AsyncOp<GetManagerUIDOp>::Method);
+}
+
+} // namespace launchctl
@@ -0,0 +1,146 @@
+/*
+ * cursor.cc
+ * Incremental conversion of ALLJOBS responses
+ *
+ * A JobCursor owns a filtered ALLJOBS response and hands its jobs out in
+ * small batches, each bounded by a job count and a time budget, so a large
+ * listing can be spread across several turns of the event loop. The
+ * response is freed as soon as the last job is handed out, when close()
+ * is called, or when the cursor is garbage collected.
+ *
+ */
+
+#include <v8.h>
+#include <node.h>
+#include <launch.h>
+#include "launchctl.h"
+using namespace node;
+using namespace v8;
+
+namespace launchctl {
+
+static Persistent<FunctionTemplate> cursor_template;
+
+class JobCursor : public ObjectWrap {
+ public:
+  static void Init() {
+    Local<FunctionTemplate> t = NanNew<v8::FunctionTemplate>();
+    t->SetClassName(NanSymbol("JobCursor"));
+    t->InstanceTemplate()->SetInternalFieldCount(1);
+    NODE_SET_PROTOTYPE_METHOD(t, "next", Next);
+    NODE_SET_PROTOTYPE_METHOD(t, "close", Close);
+    NODE_SET_PROTOTYPE_METHOD(t, "remaining", Remaining);
+    NanAssignPersistent(cursor_template, t);
+  }
+
+  static Local<Object> New(launch_data_t resp, ConvertOptions *opts) {
+    Local<Object> handle = NanNew(cursor_template)->GetFunction()->NewInstance();
+    JobCursor *cursor = new JobCursor(resp, opts);
+    cursor->Wrap(handle);
+    return handle;
+  }
+
+ private:
+  JobCursor(launch_data_t r, ConvertOptions *o) : resp(r), index(0) {
+    opts = *o;
+    o->fields = NULL;
+    bytes = LaunchDataSize(resp);
+    NanAdjustExternalMemory((int)bytes);
+  }
+
+  ~JobCursor() {
+    Release();
+    FreeConvertOptions(&opts);
+  }
+
+  void Release() {
+    if (resp == NULL) {
+      return;
+    }
+    launch_data_free(resp);
+    resp = NULL;
+    NanAdjustExternalMemory(-(int)bytes);
+  }
+
+  size_t Count() const {
+    return resp ? resp->_array_cnt / 2 : 0;
+  }
+
+  // next(max, budget) converts up to `max` jobs, stopping early once
+  // `budget` microseconds have passed. At least one job is converted per
+  // call. Returns null once every job has been handed out
+  static NAN_METHOD(Next) {
+    NanScope();
+    JobCursor *cursor = ObjectWrap::Unwrap<JobCursor>(args.This());
+    if (cursor->resp == NULL) {
+      NanReturnValue(NanNull());
+    }
+
+    size_t max = args[0]->IsNumber() && args[0]->IntegerValue() > 0
+      ? (size_t)args[0]->IntegerValue() : 100;
+    uint64_t budget = args[1]->IsNumber() && args[1]->IntegerValue() > 0
+      ? (uint64_t)args[1]->IntegerValue() * 1000 : 0;
+
+    size_t left = cursor->Count() - cursor->index;
+    if (max > left) {
+      max = left;
+    }
+
+    uint64_t start = uv_hrtime();
+    Local<Array> out = NanNew<v8::Array>();
+    uint32_t n = 0;
+    int err = 0;
+    while (n < max) {
+      launch_data_t job = cursor->resp->_array[cursor->index * 2 + 1];
+      Local<Value> v = ConvertJob(job, &cursor->opts, &err);
+      if (err) {
+        cursor->Release();
+        NanThrowError(LaunchDException(err, NULL, NULL));
+        NanReturnUndefined();
+      }
+      out->Set(n++, v);
+      cursor->index++;
+      if (budget && uv_hrtime() - start >= budget) {
+        break;
+      }
+    }
+
+    if (cursor->index >= cursor->Count()) {
+      cursor->Release();
+      if (n == 0) {
+        NanReturnValue(NanNull());
+      }
+    }
+    NanReturnValue(out);
+  }
+
+  // Frees the response without waiting for garbage collection
+  static NAN_METHOD(Close) {
+    NanScope();
+    ObjectWrap::Unwrap<JobCursor>(args.This())->Release();
+    NanReturnUndefined();
+  }
+
+  // Number of jobs not handed out yet
+  static NAN_METHOD(Remaining) {
+    NanScope();
+    JobCursor *cursor = ObjectWrap::Unwrap<JobCursor>(args.This());
+    size_t left = cursor->resp ? cursor->Count() - cursor->index : 0;
+    NanReturnValue(NanNew<v8::Number>((double)left));
+  }
+
+  launch_data_t resp;
+  size_t index;
+  size_t bytes;
+  ConvertOptions opts;
+};
+
+void InitJobCursor() {
+  JobCursor::Init();
+}
+
+Local<Object> NewJobCursor(launch_data_t resp, ConvertOptions *opts) {
+  return JobCursor::New(resp, opts);
+}
+
+} // namespace launchctl
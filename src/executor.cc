@@ -0,0 +1,569 @@
+/*
+ * executor.cc
+ * Threads dedicated to launchd requests
+ *
+ * launch_msg() round trips and plist directory scans can block for a long
+ * time. Running them on the shared libuv threadpool would starve fs, dns
+ * and zlib work queued by the rest of the process, so async bindings queue
+ * their work here instead. Finished work is handed back to the default
+ * loop through a single uv_async_t, which only keeps the loop alive while
+ * something is in flight.
+ *
+ * The queue is bounded. Work queued while it is full never runs and its
+ * after callback receives EAGAIN.
+ *
+ * Work queued with a callback and a timeout gets a deadline. When it
+ * passes before the work has started, the work is taken off the queue and
+ * never runs; its after callback receives ETIMEDOUT. When the work is
+ * already running, the callback is answered with ETIMEDOUT right away and
+ * swapped for a no-op. Its after callback still runs once the worker is
+ * done, with ECANCELED, so the late result is only freed.
+ *
+ * Each operation belongs to a lane: interactive queries, mutations or
+ * bulk plist I/O. Idle threads serve the lanes in that order, and every
+ * lane has its own bounded queue. A lane only takes a thread when the idle
+ * threads left still cover what the other lanes have reserved and are not
+ * using, so however mutations and loads are mixed, by default one thread
+ * stays free for status queries. Reservations that would claim every
+ * thread are ignored.
+ *
+ */
+
+#include <v8.h>
+#include <node.h>
+#include <deque>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+#include "launchctl.h"
+using namespace node;
+using namespace v8;
+
+namespace launchctl {
+
+#define EXEC_DEFAULT_THREADS 2
+#define EXEC_DEFAULT_QUEUE 1024
+
+static const char *exec_lane_names[EXEC_LANE_MAX] = {
+  "interactive",
+  "mutation",
+  "bulk"
+};
+
+static const exec_lane_t exec_op_lanes[EXEC_OP_MAX] = {
+  EXEC_LANE_INTERACTIVE, // getJob
+  EXEC_LANE_INTERACTIVE, // getAllJobs
+  EXEC_LANE_INTERACTIVE, // getAllJobsCompact
+  EXEC_LANE_MUTATION,    // startStopRemove
+  EXEC_LANE_BULK,        // loadJob
+  EXEC_LANE_BULK,        // unloadJob
+  EXEC_LANE_MUTATION,    // submitJob
+  EXEC_LANE_INTERACTIVE, // jobChanges
+  EXEC_LANE_INTERACTIVE, // getJobs
+  EXEC_LANE_MUTATION,    // ssrMany
+  EXEC_LANE_INTERACTIVE  // control
+};
+
+static const char *exec_op_names[EXEC_OP_MAX] = {
+  "getJob",
+  "getAllJobs",
+  "getAllJobsCompact",
+  "startStopRemove",
+  "loadJob",
+  "unloadJob",
+  "submitJob",
+  "jobChanges",
+  "getJobs",
+  "ssrMany",
+  "control"
+};
+
+typedef enum {
+  EXEC_PENDING = 0,
+  EXEC_RUNNING,
+  EXEC_FINISHED
+} exec_state_t;
+
+struct ExecItem {
+  uv_work_t *req;
+  exec_op_t op;
+  exec_lane_t lane;
+  exec_work_cb work;
+  exec_after_cb after;
+  uint64_t queued;
+  uint64_t started;
+  uint64_t finished;
+  // Guarded by exec_lock
+  exec_state_t state;
+  int status;
+  // Only set for work with a deadline
+  NanCallback *callback;
+  uv_timer_t *timer;
+  bool expired;
+};
+
+// Times are in nanoseconds
+struct ExecOpStats {
+  double count;
+  double rejected;
+  double timedOut;
+  double cancelled;
+  double wait;
+  double maxWait;
+  double run;
+  double maxRun;
+};
+
+// Guarded by exec_lock
+static uv_mutex_t exec_lock;
+static uv_cond_t exec_cond;
+static std::deque<ExecItem *> exec_pending[EXEC_LANE_MAX];
+static std::vector<ExecItem *> exec_done;
+static size_t exec_running[EXEC_LANE_MAX];
+static size_t exec_reserved[EXEC_LANE_MAX] = { 1, 0, 0 };
+static size_t exec_workers = 0;
+
+// Only touched on the loop thread
+static uv_async_t exec_async;
+static std::vector<uv_thread_t> exec_threads;
+static size_t exec_thread_count = EXEC_DEFAULT_THREADS;
+static size_t exec_queue_max = EXEC_DEFAULT_QUEUE;
+static size_t exec_in_flight = 0;
+static size_t exec_peak_depth[EXEC_LANE_MAX];
+// Deadline (ms) for work queued without one, 0 for none
+static uint64_t exec_default_timeout = 0;
+static bool exec_started = false;
+// Whether setExecutorOptions chose the thread count (over the environment)
+static bool exec_threads_set = false;
+static ExecOpStats exec_stats[EXEC_OP_MAX];
+static BatonPool<ExecItem> exec_items(BATON_POOL_MAX);
+static Persistent<Function> exec_discard;
+
+// Whether reservations leave a thread for the lanes without one. When they
+// claim every thread (one thread and the default reservation) they are
+// ignored, so no lane waits forever. Called with exec_lock held
+static bool Reserving() {
+  size_t total = 0;
+  for (int i=0; i<EXEC_LANE_MAX; i++) {
+    total += exec_reserved[i];
+  }
+  return total < exec_workers;
+}
+
+// Most threads lane may occupy while the others are idle: all of them but
+// those reserved for the other lanes. Called with exec_lock held
+static size_t LaneLimit(int lane) {
+  if (!Reserving()) {
+    return exec_workers;
+  }
+  size_t others = 0;
+  for (int i=0; i<EXEC_LANE_MAX; i++) {
+    if (i != lane) {
+      others += exec_reserved[i];
+    }
+  }
+  return exec_workers - others;
+}
+
+// Whether lane may take another thread: one must be idle, and the idle
+// threads left after it must still cover what the other lanes have
+// reserved but are not using. Called with exec_lock held
+static bool CanAdmit(int lane) {
+  size_t busy = 0, owed = 0;
+  for (int i=0; i<EXEC_LANE_MAX; i++) {
+    busy += exec_running[i];
+    if (i != lane && exec_reserved[i] > exec_running[i]) {
+      owed += exec_reserved[i] - exec_running[i];
+    }
+  }
+  if (busy >= exec_workers) {
+    return false;
+  }
+  return !Reserving() || exec_workers - busy - 1 >= owed;
+}
+
+// The front of the most urgent lane allowed another thread, or NULL.
+// Called with exec_lock held
+static ExecItem *NextItem() {
+  for (int i=0; i<EXEC_LANE_MAX; i++) {
+    if (!exec_pending[i].empty() && CanAdmit(i)) {
+      ExecItem *item = exec_pending[i].front();
+      exec_pending[i].pop_front();
+      return item;
+    }
+  }
+  return NULL;
+}
+
+static void ExecWorker(void *arg) {
+  for (;;) {
+    uv_mutex_lock(&exec_lock);
+    ExecItem *item;
+    while ((item = NextItem()) == NULL) {
+      uv_cond_wait(&exec_cond, &exec_lock);
+    }
+    item->state = EXEC_RUNNING;
+    exec_running[item->lane]++;
+    uv_mutex_unlock(&exec_lock);
+
+    item->started = uv_hrtime();
+    item->work(item->req);
+    item->finished = uv_hrtime();
+
+    uv_mutex_lock(&exec_lock);
+    item->state = EXEC_FINISHED;
+    exec_running[item->lane]--;
+    exec_done.push_back(item);
+    // Work held back by its lane limit may be able to run now
+    uv_cond_broadcast(&exec_cond);
+    uv_mutex_unlock(&exec_lock);
+    uv_async_send(&exec_async);
+  }
+}
+
+static void RecordStats(ExecItem *item) {
+  ExecOpStats *s = &exec_stats[item->op];
+  if (item->status == EAGAIN) {
+    s->rejected++;
+    return;
+  }
+  if (item->status == ETIMEDOUT) {
+    s->cancelled++;
+    return;
+  }
+  double wait = (double)(item->started - item->queued);
+  double run = (double)(item->finished - item->started);
+  s->count++;
+  s->wait += wait;
+  s->run += run;
+  if (wait > s->maxWait) s->maxWait = wait;
+  if (run > s->maxRun) s->maxRun = run;
+}
+
+static void TimerClosed(uv_handle_t *handle) {
+  delete (uv_timer_t *)handle;
+}
+
+static void FinishItem(ExecItem *item) {
+  RecordStats(item);
+  if (item->timer) {
+    uv_timer_stop(item->timer);
+    uv_close((uv_handle_t *)item->timer, TimerClosed);
+  }
+  item->after(item->req, item->expired ? ECANCELED : item->status);
+  exec_items.Release(item);
+  if (--exec_in_flight == 0) {
+    uv_unref((uv_handle_t *)&exec_async);
+  }
+}
+
+static NAN_METHOD(Discard) {
+  NanScope();
+  NanReturnUndefined();
+}
+
+Local<Function> DiscardFunction() {
+  NanEscapableScope();
+  if (exec_discard.IsEmpty()) {
+    NanAssignPersistent(exec_discard, NanNew<v8::FunctionTemplate>(Discard)->GetFunction());
+  }
+  return NanEscapeScope(NanNew(exec_discard));
+}
+
+Local<Object> ExecItemPoolStats() {
+  return exec_items.Stats();
+}
+
+#if NODE_VERSION_AT_LEAST(0, 11, 0)
+static void DeadlinePassed(uv_timer_t *handle) {
+#else
+static void DeadlinePassed(uv_timer_t *handle, int status) {
+#endif
+  NanScope();
+  ExecItem *item = static_cast<ExecItem *>(handle->data);
+  exec_stats[item->op].timedOut++;
+
+  uv_mutex_lock(&exec_lock);
+  if (item->state == EXEC_PENDING) {
+    std::deque<ExecItem *> &pending = exec_pending[item->lane];
+    for (std::deque<ExecItem *>::iterator it = pending.begin(); it != pending.end(); ++it) {
+      if (*it == item) {
+        pending.erase(it);
+        break;
+      }
+    }
+    uv_mutex_unlock(&exec_lock);
+    item->status = ETIMEDOUT;
+    FinishItem(item);
+    return;
+  }
+  uv_mutex_unlock(&exec_lock);
+
+  // Already running (or finished but not handed back yet)
+  item->expired = true;
+  Local<Value> argv[1] = {
+    LaunchDException(ETIMEDOUT, NULL, NULL)
+  };
+  TryCatch try_catch;
+  item->callback->Call(1, argv);
+  if (try_catch.HasCaught()) {
+    node::FatalException(try_catch);
+  }
+  item->callback->SetFunction(DiscardFunction());
+}
+
+// Runs the after callbacks of everything the workers finished
+static NAUV_WORK_CB(ExecComplete) {
+  std::vector<ExecItem *> done;
+  uv_mutex_lock(&exec_lock);
+  done.swap(exec_done);
+  uv_mutex_unlock(&exec_lock);
+
+  for (size_t i=0; i<done.size(); i++) {
+    FinishItem(done[i]);
+  }
+}
+
+static void SpawnWorkers(size_t count) {
+  while (exec_threads.size() < count) {
+    uv_thread_t t;
+    uv_thread_create(&t, ExecWorker, NULL);
+    exec_threads.push_back(t);
+  }
+  uv_mutex_lock(&exec_lock);
+  exec_workers = exec_threads.size();
+  uv_cond_broadcast(&exec_cond);
+  uv_mutex_unlock(&exec_lock);
+}
+
+static void StartExecutor() {
+  const char *env = getenv("LAUNCHCTL_THREADPOOL_SIZE");
+  if (env && atoi(env) > 0 && !exec_threads_set) {
+    exec_thread_count = (size_t)atoi(env);
+  }
+  // setenv() is only safe before our threads exist
+  if (geteuid() == 0) {
+    setup_system_context();
+  }
+  uv_mutex_init(&exec_lock);
+  uv_cond_init(&exec_cond);
+  uv_async_init(uv_default_loop(), &exec_async, ExecComplete);
+  uv_unref((uv_handle_t *)&exec_async);
+  SpawnWorkers(exec_thread_count);
+  exec_started = true;
+}
+
+uint64_t ParseTimeout(Local<Value> opts) {
+  if (!opts->IsObject()) {
+    return 0;
+  }
+  Local<Value> timeout = opts->ToObject()->Get(NanSymbol("timeout"));
+  if (!timeout->IsNumber() || timeout->IntegerValue() <= 0) {
+    return 0;
+  }
+  return (uint64_t)timeout->IntegerValue();
+}
+
+uint64_t ExecTimeout(uint64_t timeout) {
+  return timeout ? timeout : exec_default_timeout;
+}
+
+void QueueWork(uv_work_t *req, exec_op_t op, exec_work_cb work, exec_after_cb after, NanCallback *callback, uint64_t timeout) {
+  if (!exec_started) {
+    StartExecutor();
+  }
+
+  ExecItem *item = exec_items.Acquire();
+  item->req = req;
+  item->op = op;
+  item->lane = exec_op_lanes[op];
+  item->work = work;
+  item->after = after;
+  item->queued = uv_hrtime();
+  item->started = item->finished = item->queued;
+  item->state = EXEC_PENDING;
+  item->status = 0;
+  item->callback = callback;
+  item->timer = NULL;
+  item->expired = false;
+
+  if (exec_in_flight++ == 0) {
+    uv_ref((uv_handle_t *)&exec_async);
+  }
+
+  timeout = ExecTimeout(timeout);
+  if (callback && timeout) {
+    item->timer = new uv_timer_t;
+    uv_timer_init(uv_default_loop(), item->timer);
+    item->timer->data = item;
+    uv_timer_start(item->timer, DeadlinePassed, timeout, 0);
+  }
+
+  uv_mutex_lock(&exec_lock);
+  std::deque<ExecItem *> &pending = exec_pending[item->lane];
+  size_t depth = pending.size();
+  if (depth >= exec_queue_max) {
+    // Rejected work still completes asynchronously, like everything else
+    item->status = EAGAIN;
+    item->state = EXEC_FINISHED;
+    exec_done.push_back(item);
+    uv_mutex_unlock(&exec_lock);
+    uv_async_send(&exec_async);
+    return;
+  }
+  pending.push_back(item);
+  if (depth + 1 > exec_peak_depth[item->lane]) {
+    exec_peak_depth[item->lane] = depth + 1;
+  }
+  uv_cond_signal(&exec_cond);
+  uv_mutex_unlock(&exec_lock);
+}
+
+// setExecutorOptions({ threads, queueSize, timeout, reserved })
+// Threads can only be added once the executor has started
+NAN_METHOD(SetExecutorOptions) {
+  NanScope();
+  if (args.Length() != 1 || !args[0]->IsObject()) {
+    NanThrowTypeError("Options must be an object");
+    NanReturnUndefined();
+  }
+  Local<Object> o = args[0]->ToObject();
+  Local<Value> threads = o->Get(NanSymbol("threads"));
+  Local<Value> queue = o->Get(NanSymbol("queueSize"));
+  Local<Value> timeout = o->Get(NanSymbol("timeout"));
+  Local<Value> reserved = o->Get(NanSymbol("reserved"));
+
+  if (threads->IsNumber()) {
+    int64_t n = threads->IntegerValue();
+    if (n < 1 || n > 128) {
+      NanThrowRangeError("threads must be between 1 and 128");
+      NanReturnUndefined();
+    }
+    if (exec_started && (size_t)n < exec_threads.size()) {
+      NanThrowRangeError("threads cannot be reduced once requests have been made");
+      NanReturnUndefined();
+    }
+    exec_thread_count = (size_t)n;
+    exec_threads_set = true;
+    if (exec_started) {
+      SpawnWorkers(exec_thread_count);
+    }
+  }
+
+  if (queue->IsNumber()) {
+    int64_t n = queue->IntegerValue();
+    if (n < 1) {
+      NanThrowRangeError("queueSize must be positive");
+      NanReturnUndefined();
+    }
+    exec_queue_max = (size_t)n;
+  }
+
+  if (timeout->IsNumber()) {
+    int64_t n = timeout->IntegerValue();
+    if (n < 0) {
+      NanThrowRangeError("timeout must not be negative");
+      NanReturnUndefined();
+    }
+    exec_default_timeout = (uint64_t)n;
+  }
+
+  // reserved: { interactive, mutation, bulk } threads only that lane uses
+  if (reserved->IsObject()) {
+    Local<Object> r = reserved->ToObject();
+    size_t next[EXEC_LANE_MAX];
+    size_t total = 0;
+    for (int i=0; i<EXEC_LANE_MAX; i++) {
+      Local<Value> v = r->Get(NanSymbol(exec_lane_names[i]));
+      int64_t n = v->IsNumber() ? v->IntegerValue() : (int64_t)exec_reserved[i];
+      if (n < 0) {
+        NanThrowRangeError("reserved threads must not be negative");
+        NanReturnUndefined();
+      }
+      next[i] = (size_t)n;
+      total += next[i];
+    }
+    if (total >= exec_thread_count) {
+      NanThrowRangeError("reservations must leave a thread unreserved");
+      NanReturnUndefined();
+    }
+    if (exec_started) {
+      uv_mutex_lock(&exec_lock);
+    }
+    for (int i=0; i<EXEC_LANE_MAX; i++) {
+      exec_reserved[i] = next[i];
+    }
+    if (exec_started) {
+      uv_cond_broadcast(&exec_cond);
+      uv_mutex_unlock(&exec_lock);
+    }
+  }
+  NanReturnUndefined();
+}
+
+NAN_METHOD(GetExecutorStats) {
+  NanScope();
+  size_t depth = 0, peak = 0;
+  size_t lane_depth[EXEC_LANE_MAX] = { 0 };
+  size_t lane_running[EXEC_LANE_MAX] = { 0 };
+  size_t lane_limit[EXEC_LANE_MAX] = { 0 };
+  if (exec_started) {
+    uv_mutex_lock(&exec_lock);
+    for (int i=0; i<EXEC_LANE_MAX; i++) {
+      lane_depth[i] = exec_pending[i].size();
+      lane_running[i] = exec_running[i];
+      lane_limit[i] = LaneLimit(i);
+    }
+    uv_mutex_unlock(&exec_lock);
+  }
+
+  Local<Object> lanes = NanNew<v8::Object>();
+  for (int i=0; i<EXEC_LANE_MAX; i++) {
+    depth += lane_depth[i];
+    if (exec_peak_depth[i] > peak) {
+      peak = exec_peak_depth[i];
+    }
+    Local<Object> lane = NanNew<v8::Object>();
+    lane->Set(NanSymbol("depth"), NanNew<v8::Number>((double)lane_depth[i]));
+    lane->Set(NanSymbol("peakDepth"), NanNew<v8::Number>((double)exec_peak_depth[i]));
+    lane->Set(NanSymbol("running"), NanNew<v8::Number>((double)lane_running[i]));
+    lane->Set(NanSymbol("reserved"), NanNew<v8::Number>((double)exec_reserved[i]));
+    lane->Set(NanSymbol("limit"), NanNew<v8::Number>((double)lane_limit[i]));
+    lanes->Set(NanSymbol(exec_lane_names[i]), lane);
+  }
+
+  Local<Object> res = NanNew<v8::Object>();
+  res->Set(NanSymbol("threads"), NanNew<v8::Number>((double)(exec_started ? exec_threads.size() : exec_thread_count)));
+  res->Set(NanSymbol("queueSize"), NanNew<v8::Number>((double)exec_queue_max));
+  res->Set(NanSymbol("depth"), NanNew<v8::Number>((double)depth));
+  res->Set(NanSymbol("peakDepth"), NanNew<v8::Number>((double)peak));
+  res->Set(NanSymbol("inFlight"), NanNew<v8::Number>((double)exec_in_flight));
+  res->Set(NanSymbol("timeout"), NanNew<v8::Number>((double)exec_default_timeout));
+
+  double timedOut = 0, cancelled = 0;
+
+  Local<Object> ops = NanNew<v8::Object>();
+  for (int i=0; i<EXEC_OP_MAX; i++) {
+    ExecOpStats *s = &exec_stats[i];
+    Local<Object> op = NanNew<v8::Object>();
+    op->Set(NanSymbol("lane"), NanSymbol(exec_lane_names[exec_op_lanes[i]]));
+    op->Set(NanSymbol("count"), NanNew<v8::Number>(s->count));
+    op->Set(NanSymbol("rejected"), NanNew<v8::Number>(s->rejected));
+    op->Set(NanSymbol("timedOut"), NanNew<v8::Number>(s->timedOut));
+    op->Set(NanSymbol("cancelled"), NanNew<v8::Number>(s->cancelled));
+    timedOut += s->timedOut;
+    cancelled += s->cancelled;
+    op->Set(NanSymbol("waitMs"), NanNew<v8::Number>(s->count ? s->wait / s->count / 1e6 : 0));
+    op->Set(NanSymbol("maxWaitMs"), NanNew<v8::Number>(s->maxWait / 1e6));
+    op->Set(NanSymbol("runMs"), NanNew<v8::Number>(s->count ? s->run / s->count / 1e6 : 0));
+    op->Set(NanSymbol("maxRunMs"), NanNew<v8::Number>(s->maxRun / 1e6));
+    ops->Set(NanSymbol(exec_op_names[i]), op);
+  }
+  res->Set(NanSymbol("timedOut"), NanNew<v8::Number>(timedOut));
+  res->Set(NanSymbol("cancelled"), NanNew<v8::Number>(cancelled));
+  res->Set(NanSymbol("lanes"), lanes);
+  res->Set(NanSymbol("ops"), ops);
+  NanReturnValue(res);
+}
+
+} // namespace launchctl
@@ -0,0 +1,145 @@
+/*
+ * filter.cc
+ * Label filters applied to ALLJOBS responses before conversion
+ *
+ * Filters are built on the main thread and only read afterwards, so the
+ * threadpool can match labels without touching V8. Compiled regular
+ * expressions are cached by pattern and flags, since callers tend to list
+ * with the same expression over and over.
+ *
+ */
+
+#include <v8.h>
+#include <node.h>
+#include <launch.h>
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string>
+#include "launchctl.h"
+using namespace node;
+using namespace v8;
+
+namespace launchctl {
+
+#define REGEX_CACHE_MAX 64
+
+// Cached regexes are never freed, so workers may keep using them freely
+typedef std::map<std::string, regex_t *> RegexCache;
+static RegexCache regex_cache;
+static double regex_cache_hits = 0;
+static double regex_cache_misses = 0;
+
+// Returns a compiled regex for pattern, or NULL with the regcomp message
+// in errbuf. *owned is set when the cache is full and the caller must free
+// the result
+static regex_t *CompileRegex(const char *pattern, int cflags, bool *owned, char *errbuf, size_t errlen) {
+  std::string key(pattern);
+  key += (cflags & REG_ICASE) ? "/i" : "/";
+  *owned = false;
+
+  RegexCache::iterator it = regex_cache.find(key);
+  if (it != regex_cache.end()) {
+    regex_cache_hits++;
+    return it->second;
+  }
+  regex_cache_misses++;
+
+  regex_t *re = new regex_t;
+  int err = regcomp(re, pattern, cflags | REG_EXTENDED | REG_NOSUB);
+  if (err) {
+    regerror(err, re, errbuf, errlen);
+    delete re;
+    return NULL;
+  }
+  if (regex_cache.size() < REGEX_CACHE_MAX) {
+    regex_cache.insert(std::make_pair(key, re));
+  } else {
+    *owned = true;
+  }
+  return re;
+}
+
+LabelFilter *NewLabelFilter(label_filter_kind_t kind, const char *pattern, bool icase, char *errbuf, size_t errlen) {
+  LabelFilter *filter = new LabelFilter;
+  filter->kind = kind;
+  filter->pattern = strdup(pattern);
+  filter->len = strlen(pattern);
+  filter->icase = icase;
+  filter->re = NULL;
+  filter->owned = false;
+
+  if (kind == LABEL_FILTER_REGEX) {
+    filter->re = CompileRegex(pattern, icase ? REG_ICASE : 0, &filter->owned, errbuf, errlen);
+    if (filter->re == NULL) {
+      FreeLabelFilter(filter);
+      return NULL;
+    }
+  }
+  return filter;
+}
+
+void FreeLabelFilter(LabelFilter *filter) {
+  if (filter == NULL) {
+    return;
+  }
+  if (filter->owned) {
+    regfree(filter->re);
+    delete filter->re;
+  }
+  free(filter->pattern);
+  delete filter;
+}
+
+bool LabelFilterMatch(const LabelFilter *filter, const char *label) {
+  switch (filter->kind) {
+    case LABEL_FILTER_PREFIX:
+      return filter->icase
+        ? strncasecmp(label, filter->pattern, filter->len) == 0
+        : strncmp(label, filter->pattern, filter->len) == 0;
+    case LABEL_FILTER_GLOB:
+      return fnmatch(filter->pattern, label, filter->icase ? FNM_CASEFOLD : 0) == 0;
+    case LABEL_FILTER_REGEX:
+      return regexec(filter->re, label, 0, NULL, 0) == 0;
+  }
+  return false;
+}
+
+// Drops every job whose label does not match from an ALLJOBS response.
+// The dictionary is compacted in place and the dropped jobs are freed,
+// so conversion only ever sees the matching ones
+void FilterAllJobs(launch_data_t resp, const LabelFilter *filter) {
+  if (filter == NULL || launch_data_get_type(resp) != LAUNCH_DATA_DICTIONARY) {
+    return;
+  }
+  size_t count = resp->_array_cnt;
+  size_t kept = 0;
+  for (size_t i=0; i+1<count; i+=2) {
+    launch_data_t key = resp->_array[i];
+    launch_data_t job = resp->_array[i+1];
+    if (key != NULL && launch_data_get_type(key) == LAUNCH_DATA_STRING &&
+        LabelFilterMatch(filter, launch_data_get_string(key))) {
+      resp->_array[kept] = key;
+      resp->_array[kept+1] = job;
+      kept += 2;
+    } else {
+      if (key) launch_data_free(key);
+      if (job) launch_data_free(job);
+    }
+  }
+  if (count % 2) {
+    // Keep a trailing odd slot so conversion still reports EMALFORM
+    resp->_array[kept++] = resp->_array[count-1];
+  }
+  resp->_array_cnt = kept;
+}
+
+NAN_METHOD(GetRegexCacheStats) {
+  NanScope();
+  Local<Object> res = NanNew<v8::Object>();
+  res->Set(NanSymbol("size"), NanNew<v8::Number>((double)regex_cache.size()));
+  res->Set(NanSymbol("hits"), NanNew<v8::Number>(regex_cache_hits));
+  res->Set(NanSymbol("misses"), NanNew<v8::Number>(regex_cache_misses));
+  NanReturnValue(res);
+}
+
+} // namespace launchctl
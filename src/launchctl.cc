@@ -62,8 +62,13 @@
 #include <node.h>
 #include <launch.h>
 #include <vproc.h>
+#ifdef __APPLE__
 #include <NSSystemDirectories.h>
+#endif
+#include <map>
+#include <vector>
 #include "launchctl.h"
+#include "async_op.h"
 using namespace node;
 using namespace v8;
 
@@ -80,21 +85,66 @@ namespace launchctl {
 #define N_NUMBER(x) NanNew<v8::Number>(x)
 #define N_NULL NanNew<v8::Primitive>(NanNull())
 
-#define ERROR_CB(baton, s) { \
-	Local<Value> e = LaunchDException(baton->err, strerror(baton->err), s); \
-	Local<Value> argv[1]; \
-	argv[0] = e; \
-	TryCatch try_catch; \
-	baton->callback->Call(1, argv); \
-	if (try_catch.HasCaught()) { \
-		node::FatalException(try_catch); \
-	} \
-}
-
 static Persistent<String> errno_symbol;
 static Persistent<String> code_symbol;
 static Persistent<String> errmsg_symbol;
 
+// Well known job keys, in the order shaped job objects expose them
+static const char *job_template_keys[] = {
+  LAUNCH_JOBKEY_LABEL,
+  LAUNCH_JOBKEY_PID,
+  LAUNCH_JOBKEY_LASTEXITSTATUS,
+  LAUNCH_JOBKEY_PROGRAM,
+  LAUNCH_JOBKEY_PROGRAMARGUMENTS,
+  LAUNCH_JOBKEY_ONDEMAND,
+  LAUNCH_JOBKEY_LIMITLOADTOSESSIONTYPE,
+  LAUNCH_JOBKEY_TIMEOUT,
+  LAUNCH_JOBKEY_STANDARDOUTPATH,
+  LAUNCH_JOBKEY_STANDARDERRORPATH,
+  LAUNCH_JOBKEY_MACHSERVICES,
+  LAUNCH_JOBKEY_SOCKETS
+};
+
+static const size_t job_template_keys_cnt = sizeof job_template_keys / sizeof job_template_keys[0];
+
+static Persistent<ObjectTemplate> job_template;
+
+// Internalized strings for dictionary keys and fixed field names, shared by
+// every conversion. Node runs a single isolate, so one cache per process is
+// one cache per isolate
+struct KeyCacheCompare {
+  bool operator()(const char *a, const char *b) const {
+    return strcmp(a, b) < 0;
+  }
+};
+
+typedef std::map<const char *, Persistent<String> *, KeyCacheCompare> KeyCache;
+
+// Keys such as MachServices names are unique per job, so stop growing at some point
+#define KEY_CACHE_MAX 1024
+
+static KeyCache key_cache;
+static double key_cache_hits = 0;
+static double key_cache_misses = 0;
+
+// Largest number of live handles seen while converting with _trackHandles
+static int peak_handles = 0;
+
+static void SampleHandles() {
+#if NODE_VERSION_AT_LEAST(0, 11, 0)
+  int n = HandleScope::NumberOfHandles(Isolate::GetCurrent());
+#else
+  int n = HandleScope::NumberOfHandles();
+#endif
+  if (n > peak_handles) {
+    peak_handles = n;
+  }
+}
+
+// When count is non-zero, ALLJOBS and single job requests are answered
+// with synthetic jobs
+static SyntheticShape synthetic_shape = { 0, 0, 0 };
+
 // Taken from https://github.com/joyent/node/blob/master/src/node.cc
 // hack alert! copy of ErrnoException, tuned for launchctl errors
 
@@ -140,6 +190,12 @@ Local<Value> LaunchDException(int errorno, const char *code, const char *msg) {
 		case 154:
 			msg = "Invalid umask";
 			break;
+		case EMALFORM:
+			msg = "Malformed response from launchd";
+			break;
+		case EMAXDEPTH:
+			msg = "Response nested deeper than maxDepth";
+			break;
 		default:
 			msg = strerror(errorno);
 			break;
@@ -169,975 +225,1397 @@ Local<Value> LaunchDException(int errorno, const char *code, const char *msg) {
   return obj;
 }
 
-Local<Value> GetJobDetail(launch_data_t obj, const char *key) {
-  size_t i, c;
-  if (obj == NULL) {
-    return N_NULL;
-  }
+// Returns the internalized string for `key`, creating it on first use
+Local<String> CachedKey(const char *key) {
+  KeyCache::iterator it = key_cache.find(key);
+  if (it != key_cache.end()) {
+    key_cache_hits++;
+    return NanNew(*it->second);
+  }
+  key_cache_misses++;
+  Local<String> s = NanSymbol(key);
+  if (key_cache.size() < KEY_CACHE_MAX) {
+    Persistent<String> *p = new Persistent<String>();
+    NanAssignPersistent(*p, s);
+    key_cache.insert(std::make_pair((const char *)strdup(key), p));
+  }
+  return s;
+}
+
+// Converts a leaf (anything but an array or dictionary)
+static Local<Value> ConvertScalar(launch_data_t obj) {
   switch (launch_data_get_type(obj)) {
-	  case LAUNCH_DATA_STRING:
-	  {
-      Local<Value> y = N_STRING(launch_data_get_string(obj));
-      return y;
-	  }
-	    break;
-	  case LAUNCH_DATA_INTEGER:
-	  {
-      Local<Value> y = N_NUMBER(launch_data_get_integer(obj));
-      return y;
-	  }
-	    break;
-	  case LAUNCH_DATA_REAL:
-	  {
-      Local<Value> y = N_NUMBER(launch_data_get_real(obj));
-      return y;
-	  }
-      break;
-	  case LAUNCH_DATA_BOOL:
-	  {
-      Local<Value> y = launch_data_get_bool(obj) ? N_NUMBER(1) : N_NUMBER(0);
-      return y;
-	  }
-      break;
-	  case LAUNCH_DATA_ARRAY:
-	  {
-      c = launch_data_array_get_count(obj);
-      Local<Array> a = NanNew<v8::Array>(c);
-      for (i=0; i<c; i++) {
-        Local<Value> y = GetJobDetail(launch_data_array_get_index(obj, i), NULL);
-        a->Set(N_NUMBER(i), y);
-      }
-      return a;
-	  }
-      break;
-	  case LAUNCH_DATA_DICTIONARY:
-	  {
-      size_t count = obj->_array_cnt;
-      Local<Object> q = NanNew<v8::Object>();
-      for (i=0; i<count; i +=2) {
-        launch_data_t d = obj->_array[i+1];
-        const char *t = obj->_array[i]->string;
-        Local<Value> v = GetJobDetail(d, t);
-        q->Set(N_STRING(t), v);
-      }
-      return q;
-	  }
-      break;
-	  case LAUNCH_DATA_FD:
-	  {
-      Local<Value> s = N_STRING("file-descriptor-object");
-      return s;
-	  }
-      break;
-	  case LAUNCH_DATA_MACHPORT:
-	  {
-      Local<Value> s = N_STRING("mach-port-object");
-      return s;
-	  }
-      break;
-	  default:
-      printf("Unknown type\n");
+    case LAUNCH_DATA_STRING:
+      return N_STRING(launch_data_get_string(obj));
+    case LAUNCH_DATA_INTEGER:
+      return N_NUMBER(launch_data_get_integer(obj));
+    case LAUNCH_DATA_REAL:
+      return N_NUMBER(launch_data_get_real(obj));
+    case LAUNCH_DATA_BOOL:
+      return launch_data_get_bool(obj) ? N_NUMBER(1) : N_NUMBER(0);
+    case LAUNCH_DATA_FD:
+      return N_STRING("file-descriptor-object");
+    case LAUNCH_DATA_MACHPORT:
+      return N_STRING("mach-port-object");
+    default:
       return N_NUMBER(0);
-      break;
   }
+}
 
-  return N_NUMBER(0);
+static inline bool IsContainer(launch_data_t obj) {
+  launch_data_type_t type = launch_data_get_type(obj);
+  return type == LAUNCH_DATA_ARRAY || type == LAUNCH_DATA_DICTIONARY;
 }
 
-// Gets a single job matching job label
-NAN_METHOD(GetJobSync) {
-  NanScope();
-  launch_data_t result = NULL;
-  if (args.Length() != 1) {
-    THROW_BAD_ARGS
+static Local<Object> NewShapedJob() {
+  if (job_template.IsEmpty()) {
+    Local<ObjectTemplate> t = NanNew<v8::ObjectTemplate>();
+    for (size_t i=0; i<job_template_keys_cnt; i++) {
+      t->Set(CachedKey(job_template_keys[i]), NanNull());
+    }
+    NanAssignPersistent(job_template, t);
   }
+  return NanNew(job_template)->NewInstance();
+}
 
-  if (!args[0]->IsString()) {
-    TYPE_ERROR("Job label must be a string")
+// Creates the (empty) JS container for an array or dictionary
+static Local<Object> NewContainer(launch_data_t obj, bool job, const ConvertOptions *opts) {
+  if (launch_data_get_type(obj) == LAUNCH_DATA_ARRAY) {
+    return NanNew<v8::Array>(obj->_array_cnt);
   }
-
-  String::Utf8Value job(args[0]);
-
-  const char* label = *job;
-  result = launchctl_list_job(label);
-  if (result == NULL) {
-    Local<Value> e = LaunchDException(errno, strerror(errno), NULL);
-    NanThrowError(e);
+  if (job && opts->shaped) {
+    return NewShapedJob();
   }
-  Local<Value> res = GetJobDetail(result, NULL);
-  if (result)
-    launch_data_free(result);
-  NanReturnValue(res);
+  return NanNew<v8::Object>();
 }
 
-// Get Job Worker
-void GetJobWork(uv_work_t* req) {
-  GetJobBaton *baton = static_cast<GetJobBaton *>(req->data);
-  baton->resp = launchctl_list_job(baton->label);
-  if (baton->resp == NULL) {
-    baton->err = errno;
+FieldSet::~FieldSet() {
+  for (Children::iterator it = children.begin(); it != children.end(); ++it) {
+    free((void *)it->first);
+    delete it->second;
   }
 }
 
-// Get Job Callback
-void GetJobAfterWork(uv_work_t *req) {
-  NanScope();
-  GetJobBaton *baton = static_cast<GetJobBaton *>(req->data);
-  if (!baton->err) {
-    Local<Value> res = GetJobDetail(baton->resp, NULL);
-    if (res == N_NULL) {
-      // No such process
-      Local<Value> s = LaunchDException(3, strerror(3), NULL);
-      Local<Value> argv[] = {
-        s
-      };
-      TryCatch try_catch;
-      baton->callback->Call(2, argv);
-      if (try_catch.HasCaught()) {
-        node::FatalException(try_catch);
-      }
-    } else {
-      Local<Value> argv[2] = {
-        N_NULL,
-        res
-      };
-      if (baton->resp)
-        launch_data_free(baton->resp);
-      TryCatch try_catch;
-      baton->callback->Call(2, argv);
-      if (try_catch.HasCaught()) {
-        node::FatalException(try_catch);
-      }
-    }
-  } else {
-    Local<Value> s = LaunchDException(baton->err, strerror(baton->err), NULL);
-    Local<Value> argv[] = {
-      s
-    };
-    if (baton->resp)
-      launch_data_free(baton->resp);
-    TryCatch try_catch;
-    baton->callback->Call(1, argv);
-    if (try_catch.HasCaught()) {
-      node::FatalException(try_catch);
-    }
-  }
-  delete req;
+FieldSet *FieldSet::Add(const char *key, size_t len) {
+  char *k = strndup(key, len);
+  Children::iterator it = children.find(k);
+  if (it != children.end()) {
+    free(k);
+    return it->second;
+  }
+  FieldSet *child = new FieldSet();
+  children.insert(std::make_pair((const char *)k, child));
+  return child;
 }
 
-// Get Job by name
-NAN_METHOD(GetJob) {
-  NanScope();
-  if (args.Length() != 2) {
-    NanThrowError(Exception::Error(N_STRING("Invalid args")));
+// Whether `key` is selected by `fields`. *sub receives the selection for
+// the value under it, NULL when everything below is wanted
+static bool SelectField(const FieldSet *fields, const char *key, const FieldSet **sub) {
+  *sub = NULL;
+  if (fields == NULL) {
+    return true;
   }
-
-  if (!args[0]->IsString()) {
-    NanThrowError(Exception::TypeError(N_STRING("Job must be a string")));
+  FieldSet::Children::const_iterator it = fields->children.find(key);
+  if (it == fields->children.end()) {
+    return false;
+  }
+  if (!it->second->all) {
+    *sub = it->second;
   }
+  return true;
+}
 
-  if (!args[1]->IsFunction()) {
-    NanThrowError(Exception::TypeError(N_STRING("Callback must be a function")));
+struct ConvertFrame {
+  launch_data_t data;
+  Local<Object> target;
+  size_t index;
+  // Selected keys of this container (arrays pass theirs to every element)
+  const FieldSet *fields;
+};
+
+// Converts a launch_data_t tree without recursing on the native stack
+// Nested arrays and dictionaries are walked with an explicit stack that is
+// bounded by opts->maxDepth. A container that is already on the stack
+// (a cycle), a dictionary with an odd number of slots or a non string key,
+// and NULL children all make the conversion fail with *err set
+// In shaped mode a root dictionary is instantiated from job_template, so the
+// well known keys always exist (null when launchd omits them) in a fixed
+// order and every job shares the same hidden class
+// With opts->fields set, dictionary entries that are not selected are
+// skipped before their key or value is touched
+static Local<Value> ConvertTree(launch_data_t root, const ConvertOptions *opts, bool job, int *err) {
+  *err = 0;
+  if (root == NULL) {
+    return N_NULL;
+  }
+  if (!IsContainer(root)) {
+    return ConvertScalar(root);
   }
 
-  String::Utf8Value job(args[0]);
-  const char* label = *job;
+  std::vector<ConvertFrame> stack;
+  stack.reserve(16);
+  ConvertFrame top = { root, NewContainer(root, job, opts), 0, opts->fields };
+  Local<Object> result = top.target;
+  stack.push_back(top);
 
-  GetJobBaton *baton = new GetJobBaton;
+  while (!stack.empty()) {
+    ConvertFrame &f = stack.back();
+    bool dict = launch_data_get_type(f.data) == LAUNCH_DATA_DICTIONARY;
+    size_t count = f.data->_array_cnt;
+    if (f.index >= count) {
+      stack.pop_back();
+      continue;
+    }
 
-  baton->request.data = baton;
-  baton->label = label;
-  baton->err = 0;
-  baton->resp = NULL;
-  baton->callback = new NanCallback(Local<Function>::Cast(args[1]));
-  uv_queue_work(uv_default_loop(), &baton->request, GetJobWork, (uv_after_work_cb)GetJobAfterWork);
+    launch_data_t child;
+    Local<Value> key;
+    const FieldSet *fields = f.fields;
+    if (dict) {
+      launch_data_t k = f.data->_array[f.index];
+      if (f.index + 1 >= count || k == NULL ||
+          launch_data_get_type(k) != LAUNCH_DATA_STRING) {
+        *err = EMALFORM;
+        return Local<Value>();
+      }
+      f.index += 2;
+      if (!SelectField(f.fields, k->string, &fields)) {
+        continue;
+      }
+      key = CachedKey(k->string);
+      child = f.data->_array[f.index - 1];
+    } else {
+      key = N_NUMBER(f.index);
+      child = f.data->_array[f.index];
+      f.index++;
+    }
 
-  NanReturnUndefined();
-}
+    if (child == NULL) {
+      *err = EMALFORM;
+      return Local<Value>();
+    }
 
+    if (!IsContainer(child)) {
+      f.target->Set(key, ConvertScalar(child));
+      continue;
+    }
 
-// Gets all jobs
-NAN_METHOD(GetAllJobsSync) {
-  NanScope();
-	launch_data_t resp = NULL;
-	if (geteuid() == 0) {
-		setup_system_context();
-	}
-	if (vproc_swap_complex(NULL, VPROC_GSK_ALLJOBS, NULL, &resp) == NULL) {
-		int count = (int)resp->_array_cnt;
-		if (LAUNCH_DATA_DICTIONARY != resp->type) {
-			if (resp != NULL) {
-				launch_data_free(resp);
-			}
-			NanReturnValue(N_NULL);
-		}
-		Local<Array> output = NanNew<v8::Array>(count/2);
-
-		int a = 0;
-		for (int i=0; i<count; i+=2) {
-			launch_data_t job = resp->_array[i+1];
-			Local<Value> res = GetJobDetail(job, NULL);
-			output->Set(N_NUMBER(a), res);
-			a++;
-		}
+    if (stack.size() >= opts->maxDepth) {
+      *err = EMAXDEPTH;
+      return Local<Value>();
+    }
+    for (size_t i=0; i<stack.size(); i++) {
+      if (stack[i].data == child) {
+        *err = EMALFORM;
+        return Local<Value>();
+      }
+    }
 
-		NanReturnValue(output);
-	}
+    // f may move once the stack grows, so set the child before pushing
+    ConvertFrame next = { child, NewContainer(child, false, opts), 0, fields };
+    f.target->Set(key, next.target);
+    stack.push_back(next);
+  }
 
-	NanReturnValue(N_NULL);
+  return result;
 }
 
-// Get All Jobs Worker
-void GetAllJobsWork(uv_work_t* req) {
-  GetAllJobsBaton *baton = static_cast<GetAllJobsBaton *>(req->data);
-	baton->resp = NULL;
-	if (geteuid() == 0) {
-		setup_system_context();
-	}
-	if (vproc_swap_complex(NULL, VPROC_GSK_ALLJOBS, NULL, &baton->resp) == NULL) {
-		baton->count = (int)baton->resp->_array_cnt;
-	}
+Local<Value> GetJobDetail(launch_data_t obj, const ConvertOptions *opts, int *err) {
+  return ConvertTree(obj, opts, false, err);
 }
 
-// Get All Jobs Callback
-void GetAllJobsAfterWork(uv_work_t* req) {
-	NanScope();
-	GetAllJobsBaton *baton = static_cast<GetAllJobsBaton *>(req->data);
-	if (baton->resp == NULL) {
-		baton->err = errno;
-	}
-
-	if (!baton->err) {
-		int count = baton->count;
-		Local<Array> output = NanNew<v8::Array>(count/2);
-		int a = 0;
-		for (int i=0; i<count; i+=2) {
-			launch_data_t j = baton->resp->_array[i+1];
-			Local<Value> res = GetJobDetail(j, NULL);
-			output->Set(N_NUMBER(a), res);
-			a++;
-		}
-		Local<Value> argv[2] = {
-			N_NULL,
-			output
-		};
-
-		if (baton->resp) {
-			launch_data_free(baton->resp);
-		}
-		TryCatch try_catch;
-		baton->callback->Call(2, argv);
-		if (try_catch.HasCaught()) {
-			node::FatalException(try_catch);
-		}
-	} else {
-		Local<Value> e = LaunchDException(baton->err, strerror(baton->err), NULL);
-		Local<Value> argv[1] = {
-			e
-		};
-		TryCatch try_catch;
-		baton->callback->Call(1, argv);
-		if (try_catch.HasCaught()) {
-			node::FatalException(try_catch);
-		}
-	}
-
-	delete req;
+void DefaultConvertOptions(ConvertOptions *opts) {
+  opts->shaped = false;
+  opts->lazy = false;
+  opts->serialized = false;
+  opts->maxDepth = CONVERT_MAX_DEPTH;
+  opts->trackHandles = false;
+  opts->fields = NULL;
 }
 
-// Get all jobs
-NAN_METHOD(GetAllJobs) {
-  NanScope();
-  if (args.Length() != 1) {
-    THROW_BAD_ARGS;
-  }
-
-  if (!args[0]->IsFunction()) {
-    TYPE_ERROR("Callback must be a function");
-  }
-
-  GetAllJobsBaton *baton = new GetAllJobsBaton;
-  baton->request.data = baton;
-  baton->err = 0;
-  baton->callback = new NanCallback(Local<Function>::Cast(args[0]));
-
-  uv_queue_work(uv_default_loop(), &baton->request, GetAllJobsWork, (uv_after_work_cb)GetAllJobsAfterWork);
-
-  NanReturnUndefined();
+void FreeConvertOptions(ConvertOptions *opts) {
+  delete opts->fields;
+  opts->fields = NULL;
 }
 
-NAN_METHOD(GetManagerName) {
-  NanScope();
-  char * mgmr = launchctl_get_managername();
-  if (mgmr == NULL) {
-    Local<Value> e = LaunchDException(errno, strerror(errno), "Unable to get manager name");
-    NanThrowError(e);
+// Builds a FieldSet from an array of key paths like "Sockets.Listeners"
+// Entries that are not strings are ignored
+static FieldSet *ParseFields(Local<Value> v) {
+  if (!v->IsArray()) {
+    return NULL;
+  }
+  Local<Array> list = Local<Array>::Cast(v);
+  FieldSet *root = new FieldSet();
+  for (uint32_t i=0; i<list->Length(); i++) {
+    Local<Value> item = list->Get(i);
+    if (!item->IsString()) {
+      continue;
+    }
+    String::Utf8Value path(item);
+    FieldSet *node = root;
+    const char *p = *path;
+    while (*p) {
+      const char *dot = strchr(p, '.');
+      size_t len = dot ? (size_t)(dot - p) : strlen(p);
+      node = node->Add(p, len);
+      if (!dot) {
+        node->all = true;
+        break;
+      }
+      p = dot + 1;
+    }
   }
-  Local<Value> r = N_STRING(mgmr);
-  free(mgmr);
-  NanReturnValue(r);
+  return root;
 }
 
-NAN_METHOD(GetManagerUID) {
-  NanScope();
-  int u = launchctl_get_manageruid();
-  if (u < 0) {
-    Local<Value> e = LaunchDException(errno, strerror(errno), "Unable to get manager uid");
-    NanThrowError(e);
-  }
-  Local<Value> r = N_NUMBER(u);
-  NanReturnValue(r);
+void ParseConvertOptions(Local<Value> v, ConvertOptions *opts) {
+  DefaultConvertOptions(opts);
+  if (!v->IsObject()) {
+    return;
+  }
+  Local<Object> o = v->ToObject();
+  opts->shaped = o->Get(NanSymbol("shaped"))->BooleanValue();
+  opts->lazy = o->Get(NanSymbol("lazy"))->BooleanValue();
+  opts->serialized = o->Get(NanSymbol("serialized"))->BooleanValue();
+  Local<Value> depth = o->Get(NanSymbol("maxDepth"));
+  if (depth->IsNumber() && depth->IntegerValue() > 0) {
+    opts->maxDepth = (size_t)depth->IntegerValue();
+  }
+  opts->trackHandles = o->Get(NanSymbol("_trackHandles"))->BooleanValue();
+  opts->fields = ParseFields(o->Get(NanSymbol("fields")));
 }
 
-NAN_METHOD(GetManagerPID) {
-  NanScope();
-  int p = launchctl_get_managerpid();
-  if (p < 0) {
-    Local<Value> e = LaunchDException(errno, strerror(errno), "Unable to get manager uid");
-    NanThrowError(e);
+// Converts a single job inside its own handle scope, so only the finished
+// job survives instead of every intermediate handle created on the way
+Local<Value> ConvertJob(launch_data_t job, const ConvertOptions *opts, int *err) {
+  NanEscapableScope();
+  Local<Value> res = ConvertTree(job, opts, true, err);
+  if (opts->trackHandles) {
+    SampleHandles();
+  }
+  if (*err) {
+    return NanEscapeScope(N_NULL);
   }
-  Local<Value> r = N_NUMBER(p);
-  NanReturnValue(r);
+  return NanEscapeScope(res);
 }
 
-NAN_METHOD(StartStopRemoveSync) {
-  NanScope();
-  if (args.Length() != 2) {
-    THROW_BAD_ARGS;
+// Converts a VPROC_GSK_ALLJOBS response into an array of jobs
+Local<Value> ConvertAllJobs(launch_data_t resp, const ConvertOptions *opts, int *err) {
+  *err = 0;
+  if (resp == NULL || launch_data_get_type(resp) != LAUNCH_DATA_DICTIONARY) {
+    *err = EMALFORM;
+    return Local<Value>();
+  }
+  if (opts->trackHandles) {
+    peak_handles = 0;
+  }
+  size_t count = resp->_array_cnt;
+  Local<Array> output = NanNew<v8::Array>(count/2);
+  for (size_t i=0; i+1<count; i+=2) {
+    Local<Value> job = ConvertJob(resp->_array[i+1], opts, err);
+    if (*err) {
+      return Local<Value>();
+    }
+    output->Set(i/2, job);
   }
+  return output;
+}
 
-  if (!args[0]->IsString()) {
-    TYPE_ERROR("Job label must be a string");
+// Reads values written by launch_data_encode
+struct EncodedReader {
+  const char *p;
+  const char *end;
+  bool ok;
+
+  template <typename T> T Read() {
+    T v;
+    if ((size_t)(end - p) < sizeof(T)) {
+      ok = false;
+      memset(&v, 0, sizeof(T));
+      return v;
+    }
+    memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return v;
   }
 
-  if (!args[1]->IsInt32()) {
-    TYPE_ERROR("Command must be an integer");
+  void Skip(size_t n) {
+    if ((size_t)(end - p) < n) {
+      ok = false;
+      p = end;
+    } else {
+      p += n;
+    }
   }
 
-  String::Utf8Value job(args[0]);
-
-  const char* label = *job;
-
-  node_launchctl_action_t cmd_v = (node_launchctl_action_t)args[1]->Int32Value();
-  int result = 0;
-  switch (cmd_v) {
-    case NODE_LAUNCHCTL_CMD_START:
-      result = launchctl_start_job(label);
-      break;
-    case NODE_LAUNCHCTL_CMD_STOP:
-      result = launchctl_stop_job(label);
-      break;
-    case NODE_LAUNCHCTL_CMD_REMOVE:
-      result = launchctl_remove_job(label);
-      break;
-    default:
-      NanThrowError(LaunchDException(150, "EINCMD", "Invalid command"));
-      break;
-  }
-  if (result != 0) {
-    NanThrowError(LaunchDException(result, NULL, NULL));
+  // Strings are NUL terminated inside the buffer, so they are used in place
+  const char *String() {
+    uint32_t len = Read<uint32_t>();
+    if (!ok || (size_t)(end - p) < (size_t)len + 1 || p[len] != '\0') {
+      ok = false;
+      return "";
+    }
+    const char *s = p;
+    p += len + 1;
+    return s;
+  }
+};
+
+struct DecodeFrame {
+  Local<Object> target;
+  bool dict;
+  uint32_t count;
+  uint32_t index;
+  const FieldSet *fields;
+};
+
+struct SkipFrame {
+  bool dict;
+  uint32_t remaining;
+};
+
+// Steps over one encoded value and everything nested in it, failing the
+// reader when it nests deeper than maxDepth
+static void SkipValue(EncodedReader *r, size_t maxDepth) {
+  std::vector<SkipFrame> stack;
+  SkipFrame top = { false, 1 };
+  stack.push_back(top);
+  while (r->ok && !stack.empty()) {
+    SkipFrame &f = stack.back();
+    if (f.remaining == 0) {
+      stack.pop_back();
+      continue;
+    }
+    f.remaining--;
+    if (f.dict) {
+      r->String();
+    }
+    SkipFrame next;
+    char tag = r->Read<char>();
+    switch (tag) {
+      case LD_TAG_STRING:
+        r->String();
+        break;
+      case LD_TAG_INTEGER:
+        r->Skip(sizeof(int64_t));
+        break;
+      case LD_TAG_REAL:
+        r->Skip(sizeof(double));
+        break;
+      case LD_TAG_BOOL:
+        r->Skip(sizeof(uint8_t));
+        break;
+      case LD_TAG_ERRNO:
+        r->Skip(sizeof(int32_t));
+        break;
+      case LD_TAG_OPAQUE:
+        r->Skip(r->Read<uint32_t>());
+        break;
+      case LD_TAG_FD:
+      case LD_TAG_MACHPORT:
+        break;
+      case LD_TAG_ARRAY:
+      case LD_TAG_DICTIONARY:
+        next.dict = tag == LD_TAG_DICTIONARY;
+        next.remaining = r->Read<uint32_t>();
+        if (stack.size() > maxDepth) {
+          r->ok = false;
+          break;
+        }
+        stack.push_back(next);
+        break;
+      default:
+        r->ok = false;
+        break;
+    }
   }
-  NanReturnValue(N_NUMBER(result));
 }
 
-void StartStopRemoveWork(uv_work_t *req) {
-  SSRBaton *baton = static_cast<SSRBaton *>(req->data);
-  int result = 0;
-  switch (baton->action) {
-    case NODE_LAUNCHCTL_CMD_START:
-      result = launchctl_start_job(baton->label);
-      break;
-    case NODE_LAUNCHCTL_CMD_STOP:
-      result = launchctl_stop_job(baton->label);
-      break;
-    case NODE_LAUNCHCTL_CMD_REMOVE:
-      result = launchctl_remove_job(baton->label);
-      break;
+// Reads the payload of a value tagged `tag`. Arrays and dictionaries come
+// back empty, with *frame describing the children that follow
+static Local<Value> DecodeValue(EncodedReader *r, char tag, bool job, const ConvertOptions *opts, DecodeFrame *frame, bool *container) {
+  *container = false;
+  switch (tag) {
+    case LD_TAG_STRING:
+      return N_STRING(r->String());
+    case LD_TAG_INTEGER:
+      return N_NUMBER((double)r->Read<int64_t>());
+    case LD_TAG_REAL:
+      return N_NUMBER(r->Read<double>());
+    case LD_TAG_BOOL:
+      return N_NUMBER(r->Read<uint8_t>() ? 1 : 0);
+    case LD_TAG_FD:
+      return N_STRING("file-descriptor-object");
+    case LD_TAG_MACHPORT:
+      return N_STRING("mach-port-object");
+    case LD_TAG_ERRNO:
+      r->Read<int32_t>();
+      return N_NUMBER(0);
+    case LD_TAG_OPAQUE:
+      r->Skip(r->Read<uint32_t>());
+      return N_NUMBER(0);
+    case LD_TAG_ARRAY:
+      *container = true;
+      frame->dict = false;
+      frame->count = r->Read<uint32_t>();
+      frame->index = 0;
+      frame->target = NanNew<v8::Array>(r->ok ? frame->count : 0);
+      return frame->target;
+    case LD_TAG_DICTIONARY:
+      *container = true;
+      frame->dict = true;
+      frame->count = r->Read<uint32_t>();
+      frame->index = 0;
+      frame->target = (job && opts->shaped) ? NewShapedJob() : NanNew<v8::Object>();
+      return frame->target;
     default:
-      break;
-  }
-  if (result != 0) {
-    // Failed for some reason
-    baton->err = result;
-  } else {
-    // If we are starting, start getting list_job...
-    if (baton->action == NODE_LAUNCHCTL_CMD_START) {
-      baton->job = launchctl_list_job(baton->label);
-      if (baton->job == NULL) {
-        // Error
-        baton->err = errno;
-      }
-    }
+      r->ok = false;
+      return N_NULL;
   }
 }
 
-void StartStopRemoveAfterWork(uv_work_t *req) {
-  NanScope();
-  SSRBaton *baton = static_cast<SSRBaton *>(req->data);
-
-  if (!baton->err) {
-    if (baton->action == NODE_LAUNCHCTL_CMD_START) {
-      Local<Value> res = GetJobDetail(baton->job, NULL);
-      Local<Value> argv[2] = {
-        N_NULL,
-        res
-      };
-      launch_data_free(baton->job);
-      TryCatch try_catch;
-      baton->callback->Call(2, argv);
-      if (try_catch.HasCaught()) {
-        node::FatalException(try_catch);
-      }
-    } else {
-      Local<Value> argv[2] = {
-        N_NULL,
-        N_NUMBER(1)
-      };
-      TryCatch try_catch;
-      baton->callback->Call(2, argv);
-      if (try_catch.HasCaught()) {
-        node::FatalException(try_catch);
-      }
+// Decodes one encoded value with an explicit stack, like ConvertTree
+static Local<Value> DecodeTree(EncodedReader *r, const ConvertOptions *opts, bool job, int *err) {
+  *err = 0;
+  std::vector<DecodeFrame> stack;
+  DecodeFrame frame;
+  bool container;
+  Local<Value> result = DecodeValue(r, r->Read<char>(), job, opts, &frame, &container);
+  if (container) {
+    frame.fields = opts->fields;
+    stack.push_back(frame);
+  }
+
+  while (r->ok && !stack.empty()) {
+    DecodeFrame &f = stack.back();
+    if (f.index >= f.count) {
+      stack.pop_back();
+      continue;
     }
-  } else {
-    // We have an error
-    Local<Value> s;
-    if (baton->err == 9) {
-      // Bad file descriptor
-      // Typically throws No such process
-      s = LaunchDException(baton->err, strerror(baton->err), "No such process");
+    f.index++;
+    Local<Value> key;
+    const FieldSet *fields = f.fields;
+    if (f.dict) {
+      const char *k = r->String();
+      if (!SelectField(f.fields, k, &fields)) {
+        SkipValue(r, opts->maxDepth);
+        continue;
+      }
+      key = CachedKey(k);
     } else {
-      s = LaunchDException(baton->err, strerror(baton->err), NULL);
+      key = N_NUMBER(f.index - 1);
     }
-    Local<Value> argv[1] = {
-      s
-    };
-
-    TryCatch try_catch;
-    baton->callback->Call(1, argv);
-    if (try_catch.HasCaught()) {
-      node::FatalException(try_catch);
+    Local<Object> target = f.target;
+    Local<Value> v = DecodeValue(r, r->Read<char>(), false, opts, &frame, &container);
+    target->Set(key, v);
+    if (container) {
+      if (stack.size() >= opts->maxDepth) {
+        *err = EMAXDEPTH;
+        return Local<Value>();
+      }
+      frame.fields = fields;
+      stack.push_back(frame);
     }
   }
 
-  delete req;
-
+  if (!r->ok) {
+    *err = EMALFORM;
+    return Local<Value>();
+  }
+  return result;
 }
 
-NAN_METHOD(StartStopRemove) {
-  NanScope();
-  if (args.Length() != 3) {
-    THROW_BAD_ARGS;
+static Local<Value> DecodeJob(EncodedReader *r, const ConvertOptions *opts, int *err) {
+  NanEscapableScope();
+  Local<Value> res = DecodeTree(r, opts, true, err);
+  if (*err) {
+    return NanEscapeScope(N_NULL);
   }
+  return NanEscapeScope(res);
+}
 
-  if (!args[0]->IsString()) {
-    TYPE_ERROR("Job label must be a string");
+// Decodes an ALLJOBS response encoded on the threadpool into an array of jobs
+Local<Value> DecodeAllJobs(const char *data, size_t len, const ConvertOptions *opts, int *err) {
+  EncodedReader r = { data, data + len, true };
+  *err = 0;
+  if (r.Read<char>() != LD_TAG_DICTIONARY) {
+    *err = EMALFORM;
+    return Local<Value>();
+  }
+  uint32_t count = r.Read<uint32_t>();
+  if (!r.ok) {
+    *err = EMALFORM;
+    return Local<Value>();
+  }
+  Local<Array> output = NanNew<v8::Array>(count);
+  for (uint32_t i=0; i<count; i++) {
+    r.String();
+    Local<Value> job = DecodeJob(&r, opts, err);
+    if (*err) {
+      return Local<Value>();
+    }
+    output->Set(i, job);
   }
+  return output;
+}
 
-  if (!args[1]->IsInt32()) {
-    TYPE_ERROR("Command must be an integer");
+// Reads the label filter out of getAllJobs options
+// { prefix: 'com.apple.' }, { glob: 'com.apple.*.agent' } or
+// { regex: '^com\\.apple\\.', ignoreCase: true }, the regex being POSIX
+// extended syntax. Returns false after throwing when the regex is invalid
+bool ParseLabelFilter(Local<Value> v, LabelFilter **filter) {
+  *filter = NULL;
+  if (!v->IsObject()) {
+    return true;
+  }
+  Local<Object> o = v->ToObject();
+  bool icase = o->Get(NanSymbol("ignoreCase"))->BooleanValue();
+  static const struct {
+    const char *name;
+    label_filter_kind_t kind;
+  } kinds[] = {
+    { "prefix", LABEL_FILTER_PREFIX },
+    { "glob", LABEL_FILTER_GLOB },
+    { "regex", LABEL_FILTER_REGEX }
+  };
+  for (size_t i=0; i<sizeof kinds / sizeof kinds[0]; i++) {
+    Local<Value> pattern = o->Get(NanSymbol(kinds[i].name));
+    if (!pattern->IsString()) {
+      continue;
+    }
+    char msg[256];
+    String::Utf8Value p(pattern);
+    *filter = NewLabelFilter(kinds[i].kind, *p, icase, msg, sizeof(msg));
+    if (*filter == NULL) {
+      NanThrowError(Exception::SyntaxError(N_STRING(msg)));
+      return false;
+    }
+    return true;
   }
+  return true;
+}
 
-  if (!args[2]->IsFunction()) {
-    TYPE_ERROR("Callback must be a function");
+// Asks launchd for every job it knows about
+vproc_err_t FetchAllJobs(launch_data_t *resp) {
+  if (synthetic_shape.count > 0) {
+    *resp = SyntheticAllJobs(&synthetic_shape);
+    return NULL;
   }
+  if (geteuid() == 0) {
+    setup_system_context();
+  }
+  return launch_transport_swap_complex(NULL, VPROC_GSK_ALLJOBS, NULL, resp);
+}
 
-  String::Utf8Value job(args[0]);
-
-  const char* label = *job;
-
-  node_launchctl_action_t cmd_v = (node_launchctl_action_t)args[1]->Int32Value();
-
-  SSRBaton *baton = new SSRBaton;
-  baton->request.data = baton;
-  baton->label = label;
-  baton->action = cmd_v;
-  baton->err = 0;
-  baton->callback = new NanCallback(Local<Function>::Cast(args[2]));
-  uv_queue_work(uv_default_loop(), &baton->request, StartStopRemoveWork, (uv_after_work_cb)StartStopRemoveAfterWork);
-  NanReturnUndefined();
+// Asks launchd for a single job
+static launch_data_t FetchJob(const char *label) {
+  if (synthetic_shape.count > 0) {
+    return SyntheticListJob(label, &synthetic_shape);
+  }
+  return launchctl_list_job(label);
 }
 
-NAN_METHOD(LoadJobSync) {
+// Gets a single job matching job label
+NAN_METHOD(GetJobSync) {
   NanScope();
-  // Job, editondisk, forceload, session_type, domain
-  if (args.Length() < 3) {
-    THROW_BAD_ARGS;
+  launch_data_t result = NULL;
+  if (args.Length() < 1 || args.Length() > 2) {
+    THROW_BAD_ARGS
   }
 
   if (!args[0]->IsString()) {
-    TYPE_ERROR("Job path must be a string");
+    TYPE_ERROR("Job label must be a string")
   }
 
   String::Utf8Value job(args[0]);
-  const char *jobpath = *job;
-
-  if (!args[1]->IsBoolean()) {
-    TYPE_ERROR("Edit On Disk must be a bool");
-  }
 
-  bool editondisk = (args[1]->ToBoolean() == NanTrue()) ? true : false;
-  if (!args[2]->IsBoolean()) {
-    TYPE_ERROR("Force Load must be a bool");
+  const char* label = *job;
+  result = FetchJob(label);
+  if (result == NULL) {
+    Local<Value> e = LaunchDException(errno, strerror(errno), NULL);
+    NanThrowError(e);
+    NanReturnUndefined();
+  }
+  ConvertOptions opts;
+  ParseConvertOptions(args[1], &opts);
+  int err;
+  Local<Value> res = ConvertJob(result, &opts, &err);
+  FreeConvertOptions(&opts);
+  launch_data_free(result);
+  if (err) {
+    NanThrowError(LaunchDException(err, NULL, NULL));
+    NanReturnUndefined();
   }
+  NanReturnValue(res);
+}
 
-  bool forceload = (args[2]->ToBoolean() == NanTrue()) ? true : false;
+// getJob(label, [opts], cb)
+struct GetJobOp : OpTraits {
+  static const exec_op_t op = EXEC_OP_GET_JOB;
+  InlineString<64> label;
+  launch_data_t resp;
+  ConvertOptions opts;
+
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    if (args.Length() < 2 || args.Length() > 3) {
+      NanThrowError(Exception::Error(N_STRING("Invalid args")));
+      return false;
+    }
 
-  const char *session_type = NULL;
-  const char *domain = NULL;
+    if (!args[0]->IsString()) {
+      NanThrowError(Exception::TypeError(N_STRING("Job must be a string")));
+      return false;
+    }
 
-  if (args.Length() == 4 || args.Length() == 5) {
-    if (!args[3]->IsString() || !args[3]->IsNull()) {
-      TYPE_ERROR("Session type must be a string");
-    } else {
-      String::Utf8Value sesstype(args[3]);
-      session_type = *sesstype;
+    if (!Copy(&label, args[0])) {
+      return false;
     }
+    Local<Value> o = args.Length() == 3 ? args[1] : NanUndefined();
+    resp = NULL;
+    ParseConvertOptions(o, &opts);
+
+    // A deadline is per caller, so those calls never share a flight
+    ctx->timeout = ParseTimeout(o);
+    if (!ExecTimeout(ctx->timeout)) {
+      flight = JoinFlight("getJob", label.c_str(), &opts, NULL, ctx->callback, &ctx->joined);
+    }
+    return true;
   }
 
-  if (args.Length() == 5) {
-    if (!args[4]->IsString()) {
-      TYPE_ERROR("Domain must be a string");
-    } else {
-      String::Utf8Value dm(args[4]);
-      domain = *dm;
+  int Work() {
+    resp = FetchJob(label.c_str());
+    return resp == NULL ? errno : 0;
+  }
+
+  int Result(Local<Value> *out) {
+    int err = 0;
+    *out = ConvertJob(resp, &opts, &err);
+    if (!err && (*out)->IsNull()) {
+      // No such process
+      return 3;
     }
+    return err;
   }
 
-  int result = launchctl_load_job(jobpath, editondisk, forceload, session_type, domain);
-  if (result != 0) {
-    NanThrowError(LaunchDException(errno, strerror(errno), NULL));
+  void Release(int) {
+    if (resp) {
+      launch_data_free(resp);
+    }
+    FreeConvertOptions(&opts);
   }
-  NanReturnValue(N_NUMBER(result));
-}
+};
 
-void LoadJobWorker(uv_work_t *req) {
-  LoadJobBaton *baton = static_cast<LoadJobBaton *>(req->data);
-  int res = launchctl_load_job(baton->path, baton->editondisk, baton->forceload, baton->session_type, baton->domain);
-  baton->err = res;
-}
 
-void LoadJobAfterWork(uv_work_t *req) {
-	NanScope();
-  LoadJobBaton *baton = static_cast<LoadJobBaton *>(req->data);
-  if (baton->err == 0) {
-    // Success
-    // TODO:
-    // Since we are loading the job, lets see if we can (at this point) get the job's details :]
-    // This will take reading the plist and getting the label
-    Local<Value> argv[] = {
-      N_NULL,
-      N_NUMBER(0)
-    };
-    TryCatch try_catch;
-    baton->callback->Call(2, argv);
-    if (try_catch.HasCaught()) {
-      node::FatalException(try_catch);
+// From this many labels on, getJobs answers from one ALLJOBS request
+// instead of one launch_msg round trip per label
+#define GET_JOBS_SNAPSHOT_MIN 8
+
+// Looks up every label, filling jobs and errs index by index. Returns the
+// container owning every job found (NULL when there is none)
+static launch_data_t ListJobs(const std::vector<std::string> &labels, std::vector<launch_data_t> *jobs, std::vector<int> *errs) {
+  jobs->assign(labels.size(), (launch_data_t)NULL);
+  errs->assign(labels.size(), 0);
+
+  if (labels.size() >= GET_JOBS_SNAPSHOT_MIN) {
+    launch_data_t resp = NULL;
+    if (FetchAllJobs(&resp) != NULL || resp == NULL ||
+        launch_data_get_type(resp) != LAUNCH_DATA_DICTIONARY) {
+      int e = errno ? errno : ESRCH;
+      if (resp) {
+        launch_data_free(resp);
+      }
+      errs->assign(labels.size(), e);
+      return NULL;
     }
-  } else {
-    // Some kind of error
-    Local<Value> e;
-    if (baton->err == 17) {
-      e = LaunchDException(baton->err, strerror(baton->err), "Job already loaded");
-    } else {
-      e = LaunchDException(baton->err, strerror(baton->err), NULL);
+    std::map<const char *, launch_data_t, KeyCacheCompare> index;
+    for (size_t i=0; i+1<resp->_array_cnt; i+=2) {
+      launch_data_t k = resp->_array[i];
+      if (k && launch_data_get_type(k) == LAUNCH_DATA_STRING) {
+        index[launch_data_get_string(k)] = resp->_array[i+1];
+      }
     }
-    Local<Value> argv[1] = {
-      e
-    };
-    TryCatch try_catch;
-    baton->callback->Call(1, argv);
-    if (try_catch.HasCaught()) {
-      node::FatalException(try_catch);
+    for (size_t i=0; i<labels.size(); i++) {
+      std::map<const char *, launch_data_t, KeyCacheCompare>::iterator it = index.find(labels[i].c_str());
+      if (it == index.end() || launch_data_get_type(it->second) != LAUNCH_DATA_DICTIONARY) {
+        (*errs)[i] = ESRCH;
+      } else {
+        (*jobs)[i] = it->second;
+      }
     }
+    return resp;
   }
-}
 
-NAN_METHOD(LoadJob) {
-  NanScope();
-  // Job, editondisk, forceload, session_type, domain
-  if (args.Length() < 4) {
-    THROW_BAD_ARGS;
+  launch_data_t all = launch_data_alloc(LAUNCH_DATA_ARRAY);
+  size_t found = 0;
+  for (size_t i=0; i<labels.size(); i++) {
+    launch_data_t job = FetchJob(labels[i].c_str());
+    if (job == NULL) {
+      (*errs)[i] = errno ? errno : ESRCH;
+      continue;
+    }
+    launch_data_array_set_index(all, job, found++);
+    (*jobs)[i] = job;
   }
+  return all;
+}
 
-  if (!args[0]->IsString()) {
-    TYPE_ERROR("Job path must be a string");
+// Builds the getJobs result: a job object or an error for every label
+static Local<Array> ConvertJobs(const std::vector<launch_data_t> &jobs, const std::vector<int> &errs, const ConvertOptions *opts) {
+  Local<Array> out = NanNew<v8::Array>(jobs.size());
+  for (size_t i=0; i<jobs.size(); i++) {
+    int err = errs[i];
+    Local<Value> v;
+    if (!err) {
+      v = ConvertJob(jobs[i], opts, &err);
+    }
+    if (err) {
+      v = LaunchDException(err, strerror(err), NULL);
+    }
+    out->Set(i, v);
   }
+  return out;
+}
 
-  String::Utf8Value job(args[0]);
-  char *jobpath = *job;
-
-  if (!args[1]->IsBoolean()) {
-    TYPE_ERROR("Edit On Disk must be a bool");
+// Copies an array of job labels, returning false if it is not one
+static bool ParseLabels(Local<Value> v, std::vector<std::string> *labels) {
+  if (!v->IsArray()) {
+    return false;
+  }
+  Local<Array> list = Local<Array>::Cast(v);
+  labels->reserve(list->Length());
+  for (uint32_t i=0; i<list->Length(); i++) {
+    Local<Value> label = list->Get(i);
+    if (!label->IsString()) {
+      return false;
+    }
+    String::Utf8Value s(label);
+    labels->push_back(std::string(*s));
   }
+  return true;
+}
 
-  bool editondisk = (args[1]->ToBoolean() == NanTrue()) ? true : false;
-  if (!args[2]->IsBoolean()) {
-    TYPE_ERROR("Force Load must be a bool");
+// Gets several jobs by label
+NAN_METHOD(GetJobsSync) {
+  NanScope();
+  if (args.Length() < 1 || args.Length() > 2) {
+    THROW_BAD_ARGS
+    NanReturnUndefined();
+  }
+  std::vector<std::string> labels;
+  if (!ParseLabels(args[0], &labels)) {
+    TYPE_ERROR("Labels must be an array of strings")
+    NanReturnUndefined();
+  }
+
+  std::vector<launch_data_t> jobs;
+  std::vector<int> errs;
+  launch_data_t resp = ListJobs(labels, &jobs, &errs);
+  ConvertOptions opts;
+  ParseConvertOptions(args[1], &opts);
+  Local<Array> res = ConvertJobs(jobs, errs, &opts);
+  FreeConvertOptions(&opts);
+  if (resp) {
+    launch_data_free(resp);
   }
+  NanReturnValue(res);
+}
 
-  bool forceload = (args[2]->ToBoolean() == NanTrue()) ? true : false;
+// getJobs(labels, [opts], cb) looks up several jobs in one executor hop
+struct GetJobsOp : OpTraits {
+  static const exec_op_t op = EXEC_OP_GET_JOBS;
+  std::vector<std::string> labels;
+  // Aligned with labels, a job (owned by resp) or an errno per label
+  std::vector<launch_data_t> jobs;
+  std::vector<int> errs;
+  launch_data_t resp;
+  ConvertOptions opts;
+
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    if (args.Length() < 2 || args.Length() > 3) {
+      THROW_BAD_ARGS
+      return false;
+    }
 
-  char *session_type = NULL;
-  char *domain = NULL;
+    labels.clear();
+    if (!ParseLabels(args[0], &labels)) {
+      TYPE_ERROR("Labels must be an array of strings")
+      return false;
+    }
+    Local<Value> o = args.Length() == 3 ? args[1] : NanUndefined();
+    resp = NULL;
+    ParseConvertOptions(o, &opts);
+    ctx->timeout = ParseTimeout(o);
+    return true;
+  }
 
-  LoadJobBaton *baton = new LoadJobBaton;
-  baton->request.data = baton;
-  baton->path = strdup(jobpath);
-  baton->editondisk = editondisk;
-  baton->forceload = forceload;
+  int Work() {
+    resp = ListJobs(labels, &jobs, &errs);
+    return 0;
+  }
 
-  if (!args[args.Length()-1]->IsFunction()) {
-    TYPE_ERROR("Callback must be a function");
+  int Result(Local<Value> *out) {
+    *out = ConvertJobs(jobs, errs, &opts);
+    return 0;
   }
-  baton->callback = new NanCallback(Local<Function>::Cast(args[args.Length()-1]));
-  if (args.Length() == 4) {
-    baton->session_type = NULL;
-    baton->domain = NULL;
-  } else if (args.Length() == 5) {
-    if (!args[3]->IsString()) {
-      TYPE_ERROR("Session type must be a string");
-    } else {
-      String::Utf8Value sesstype(args[3]);
-      session_type = *sesstype;
-      baton->session_type = strdup(session_type);
-    }
-  } else if (args.Length() == 6) {
-    if (!args[3]->IsString()) {
-      TYPE_ERROR("Session type must be a string");
-    } else {
-      String::Utf8Value sesstype(args[3]);
-      session_type = *sesstype;
-      baton->session_type = strdup(session_type);
-    }
 
-    if (!args[4]->IsString()) {
-      TYPE_ERROR("Domain must be a string");
-    } else {
-      String::Utf8Value dm(args[4]);
-      domain = *dm;
-      baton->domain = strdup(domain);
+  void Release(int) {
+    if (resp) {
+      launch_data_free(resp);
     }
+    FreeConvertOptions(&opts);
   }
+};
 
-  uv_queue_work(uv_default_loop(), &baton->request, LoadJobWorker, (uv_after_work_cb)LoadJobAfterWork);
-  NanReturnUndefined();
-}
 
-NAN_METHOD(SubmitJobSync) {
-	NanScope();
-	if (args.Length() != 1) {
+// Gets all jobs
+NAN_METHOD(GetAllJobsSync) {
+  NanScope();
+	launch_data_t resp = NULL;
+	if (args.Length() > 1) {
 		THROW_BAD_ARGS;
 	}
-	int r = 0;
-	if (!args[0]->IsObject()) {
-		TYPE_ERROR("Argument must be an object");
+	LabelFilter *filter;
+	if (!ParseLabelFilter(args[0], &filter)) {
+		NanReturnUndefined();
 	}
-	Local<Object> obj = args[0]->ToObject();
-
-	Local<String> label_key = NanSymbol("label");
-	Local<String> program_key = NanSymbol("program");
-	Local<String> stderr_key = NanSymbol("stderr");
-	Local<String> stdout_key = NanSymbol("stdout");
-	Local<String> args_key = NanSymbol("args");
-
-	if (geteuid() == 0) {
-		setup_system_context();
-	}
-
-	launch_data_t msg = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
-	launch_data_t job = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
-	launch_data_t resp, largv = launch_data_alloc(LAUNCH_DATA_ARRAY);
-	if (obj->Has(label_key)) {
-		if (!obj->Get(label_key)->IsString()) {
-			TYPE_ERROR("Label must be a string");
+	if (FetchAllJobs(&resp) == NULL) {
+		if (LAUNCH_DATA_DICTIONARY != resp->type) {
+			if (resp != NULL) {
+				launch_data_free(resp);
+			}
+			FreeLabelFilter(filter);
+			NanReturnValue(N_NULL);
 		}
-		String::Utf8Value labelS(obj->Get(label_key));
-		const char *label = strdup(*labelS);
-		launch_data_dict_insert(job, launch_data_new_string(label), LAUNCH_JOBKEY_LABEL);
-	}
-
-	if (obj->Has(program_key)) {
-		if (!obj->Get(program_key)->IsString()) {
-			TYPE_ERROR("Program must be a string");
+		FilterAllJobs(resp, filter);
+		FreeLabelFilter(filter);
+		ConvertOptions opts;
+		ParseConvertOptions(args[0], &opts);
+		if (opts.lazy) {
+			FreeConvertOptions(&opts);
+			NanReturnValue(LazyAllJobs(resp));
 		}
-		String::Utf8Value progS(obj->Get(program_key));
-		const char *prog = strdup(*progS);
-		launch_data_dict_insert(job, launch_data_new_string(prog), LAUNCH_JOBKEY_PROGRAM);
-	}
-
-	if (obj->Has(stderr_key)) {
-		if (!obj->Get(stderr_key)->IsString()) {
-			TYPE_ERROR("stderr must be a string");
+		int err;
+		Local<Value> output = ConvertAllJobs(resp, &opts, &err);
+		FreeConvertOptions(&opts);
+		launch_data_free(resp);
+		if (err) {
+			NanThrowError(LaunchDException(err, NULL, NULL));
+			NanReturnUndefined();
 		}
-		String::Utf8Value stderrS(obj->Get(stderr_key));
-		const char *stde = strdup(*stderrS);
-		launch_data_dict_insert(job, launch_data_new_string(stde), LAUNCH_JOBKEY_STANDARDERRORPATH);
+		NanReturnValue(output);
 	}
 
-	if (obj->Has(stdout_key)) {
-		if (!obj->Get(stdout_key)->IsString()) {
-			TYPE_ERROR("stdout must be a string");
-		}
-		String::Utf8Value stdoutS(obj->Get(stdout_key));
-		const char *stdo = strdup(*stdoutS);
-		launch_data_dict_insert(job, launch_data_new_string(stdo), LAUNCH_JOBKEY_STANDARDOUTPATH);
-	}
+	FreeLabelFilter(filter);
+	NanReturnValue(N_NULL);
+}
 
-	if (obj->Has(args_key)) {
-		if (!obj->Get(args_key)->IsArray()) {
-			TYPE_ERROR("args must be an array");
-		}
-		Local<Array> argsArray = Local<Array>::Cast(obj->Get(args_key));
-		int32_t num = argsArray->Length();
-		int32_t i = 0;
-		for (i = 0; i < num; i++) {
-			String::Utf8Value vS(argsArray->Get(N_NUMBER(i)));
-			const char *v = strdup(*vS);
-			size_t offt = launch_data_array_get_count(largv);
-			launch_data_array_set_index(largv, launch_data_new_string(v), offt);
-		}
-		launch_data_dict_insert(job, largv, LAUNCH_JOBKEY_PROGRAMARGUMENTS);
-	}
+// Get All Jobs Worker
+// Fetches and filters every job for getAllJobs and getAllJobsCursor,
+// both called as ([opts], cb)
+struct AllJobsOp : OpTraits {
+  static const exec_op_t op = EXEC_OP_GET_ALL_JOBS;
+  launch_data_t resp;
+  struct launch_data_buf buf;
+  ConvertOptions opts;
+  LabelFilter *filter;
+
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    if (args.Length() < 1 || args.Length() > 2) {
+      THROW_BAD_ARGS;
+      return false;
+    }
 
-	launch_data_dict_insert(msg, job, LAUNCH_KEY_SUBMITJOB);
+    Local<Value> o = args.Length() == 2 ? args[0] : NanUndefined();
+    if (!ParseLabelFilter(o, &filter)) {
+      return false;
+    }
+    resp = NULL;
+    memset(&buf, 0, sizeof(buf));
+    ParseConvertOptions(o, &opts);
+    ctx->timeout = ParseTimeout(o);
+    return true;
+  }
 
-	resp = launch_msg(msg);
-	launch_data_free(msg);
+  int Work() {
+    if (FetchAllJobs(&resp) != NULL || resp == NULL) {
+      resp = NULL;
+      return errno ? errno : ESRCH;
+    }
+    FilterAllJobs(resp, filter);
+    if (!opts.serialized) {
+      return 0;
+    }
+    // Walk the tree here so the loop only has to decode one flat buffer
+    int err = launch_data_encode(resp, &buf, opts.maxDepth);
+    launch_data_free(resp);
+    resp = NULL;
+    return err;
+  }
 
-	if (resp == NULL) {
-		r = errno;
-		NanReturnValue(N_NUMBER(r));
-	} else if (launch_data_get_type(resp) == LAUNCH_DATA_ERRNO) {
-		errno = launch_data_get_errno(resp);
-		if (errno) {
-			r = errno;
-		}
-	} else {
-		r = 0;
-	}
-	launch_data_free(resp);
-	NanReturnValue(N_NUMBER(r));
-}
+  void Release(int) {
+    if (resp) {
+      launch_data_free(resp);
+    }
+    launch_data_buf_free(&buf);
+    FreeConvertOptions(&opts);
+    FreeLabelFilter(filter);
+  }
+};
 
-void SubmitJobWorker(uv_work_t *req) {
-	SubmitJobBaton *baton = static_cast<SubmitJobBaton *>(req->data);
-	if (geteuid() == 0) {
-		setup_system_context();
-	}
-	launch_data_t msg = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
-	launch_data_dict_insert(msg, baton->job, LAUNCH_KEY_SUBMITJOB);
-	baton->resp = launch_msg(msg);
-	launch_data_free(msg);
-}
+struct GetAllJobsOp : AllJobsOp {
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    if (!AllJobsOp::Capture(args, ctx)) {
+      return false;
+    }
+    if (!ExecTimeout(ctx->timeout)) {
+      flight = JoinFlight("getAllJobs", NULL, &opts, filter, ctx->callback, &ctx->joined);
+    }
+    return true;
+  }
 
-void SubmitJobAfterWork(uv_work_t *req) {
-	NanScope();
-	SubmitJobBaton *baton = static_cast<SubmitJobBaton *>(req->data);
-	if (baton->resp == NULL) {
-		baton->err = errno;
-	} else if (launch_data_get_type(baton->resp) == LAUNCH_DATA_ERRNO) {
-		errno = launch_data_get_errno(baton->resp);
-		if (errno) {
-			baton->err = errno;
-		}
-	} else {
-		baton->err = 0;
-	}
+  int Result(Local<Value> *out) {
+    int err = 0;
+    if (opts.serialized) {
+      *out = DecodeAllJobs(buf.data, buf.len, &opts, &err);
+    } else if (opts.lazy) {
+      *out = LazyAllJobs(resp);
+      resp = NULL;
+    } else {
+      *out = ConvertAllJobs(resp, &opts, &err);
+    }
+    return err;
+  }
+};
 
-	if (!baton->err) {
-		Local<Value> argv[1];
-		argv[0] = N_NULL;
-		if (baton->resp) {
-			launch_data_free(baton->resp);
-		}
-		TryCatch try_catch;
-		baton->callback->Call(1, argv);
-		if (try_catch.HasCaught()) {
-			node::FatalException(try_catch);
-		}
-	} else {
-		if (baton->resp) {
-			launch_data_free(baton->resp);
-		}
-		ERROR_CB(baton, NULL);
-	}
+// Hands the filtered response to a cursor that converts it a batch at a time
+struct GetAllJobsCursorOp : AllJobsOp {
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    if (!AllJobsOp::Capture(args, ctx)) {
+      return false;
+    }
+    opts.serialized = false;
+    opts.lazy = false;
+    return true;
+  }
 
-	delete req;
+  int Result(Local<Value> *out) {
+    if (launch_data_get_type(resp) != LAUNCH_DATA_DICTIONARY) {
+      return EMALFORM;
+    }
+    *out = NewJobCursor(resp, &opts);
+    resp = NULL;
+    return 0;
+  }
+};
+
+// Fetches every job and reduces each one with getjob()
+// Runs entirely without V8, so it is safe on the threadpool
+int CompactAllJobs(launch_data_status_t **jobs, size_t *count) {
+  launch_data_t resp = NULL;
+  *jobs = NULL;
+  *count = 0;
+  if (FetchAllJobs(&resp) != NULL || resp == NULL) {
+    return errno ? errno : ESRCH;
+  }
+  if (launch_data_get_type(resp) != LAUNCH_DATA_DICTIONARY) {
+    launch_data_free(resp);
+    return 153;
+  }
+  size_t n = resp->_array_cnt / 2;
+  launch_data_status_t *out = (launch_data_status_t *)calloc(n ? n : 1, sizeof(launch_data_status_t));
+  if (out == NULL) {
+    launch_data_free(resp);
+    return ENOMEM;
+  }
+  size_t a = 0;
+  for (size_t i=0; i<n; i++) {
+    launch_data_status_t st = getjob(resp->_array[i*2+1]);
+    if (st) {
+      out[a++] = st;
+    }
+  }
+  launch_data_free(resp);
+  *jobs = out;
+  *count = a;
+  return 0;
 }
 
-NAN_METHOD(SubmitJob) {
-	NanScope();
-	if (args.Length() != 2) {
-		THROW_BAD_ARGS;
-	}
-	if (!args[0]->IsObject()) {
-		TYPE_ERROR("Argument must be an object");
-	}
-
-	if (!args[1]->IsFunction()) {
-		fprintf(stderr, "args[1] is not a function\n");
-		TYPE_ERROR("Callback must be a function");
-	}
-
-	Local<Object> obj = args[0]->ToObject();
+// Creates an Int32Array and hands back its backing store
+Local<Object> NewInt32Array(size_t length, int32_t **data) {
+  Local<Function> ctor = NanGetCurrentContext()->Global()->Get(NanSymbol("Int32Array")).As<Function>();
+  Local<Value> argv[1] = {
+    N_NUMBER(length)
+  };
+  Local<Object> arr = ctor->NewInstance(1, argv);
+  *data = static_cast<int32_t *>(arr->GetIndexedPropertiesExternalArrayData());
+  return arr;
+}
 
-	Local<String> label_key = NanSymbol("label");
-	Local<String> program_key = NanSymbol("program");
-	Local<String> stderr_key = NanSymbol("stderr");
-	Local<String> stdout_key = NanSymbol("stdout");
-	Local<String> args_key = NanSymbol("args");
-	SubmitJobBaton *baton = new SubmitJobBaton;
-	baton->request.data = baton;
-	baton->callback = new NanCallback(Local<Function>::Cast(args[args.Length()-1]));
+// Builds { labels, pid, status, signal } and frees the reduced jobs
+Local<Object> CompactJobsToObject(launch_data_status_t *jobs, size_t count) {
+  int32_t *pids, *statuses, *signals;
+  Local<Array> labels = NanNew<v8::Array>(count);
+  Local<Object> pid = NewInt32Array(count, &pids);
+  Local<Object> status = NewInt32Array(count, &statuses);
+  Local<Object> signal = NewInt32Array(count, &signals);
+  for (size_t i=0; i<count; i++) {
+    labels->Set(i, N_STRING(jobs[i]->label));
+    pids[i] = jobs[i]->pid;
+    statuses[i] = jobs[i]->status;
+    signals[i] = jobs[i]->signal;
+    launch_data_status_free(jobs[i]);
+  }
+  free(jobs);
+
+  Local<Object> output = NanNew<v8::Object>();
+  output->Set(CachedKey("labels"), labels);
+  output->Set(CachedKey("pid"), pid);
+  output->Set(CachedKey("status"), status);
+  output->Set(CachedKey("signal"), signal);
+  return output;
+}
 
+NAN_METHOD(GetAllJobsCompactSync) {
+  NanScope();
+  launch_data_status_t *jobs;
+  size_t count;
+  int r = CompactAllJobs(&jobs, &count);
+  if (r != 0) {
+    NanThrowError(LaunchDException(r, strerror(r), NULL));
+    NanReturnUndefined();
+  }
+  NanReturnValue(CompactJobsToObject(jobs, count));
+}
 
-	baton->job = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
-	baton->largv = launch_data_alloc(LAUNCH_DATA_ARRAY);
-	if (obj->Has(label_key)) {
-		if (!obj->Get(label_key)->IsString()) {
-			TYPE_ERROR("Label must be a string");
-		}
-		String::Utf8Value labelS(obj->Get(label_key));
-		const char *label = strdup(*labelS);
-		launch_data_dict_insert(baton->job, launch_data_new_string(label), LAUNCH_JOBKEY_LABEL);
-	}
+// getAllJobsCompact([opts], cb) lists label, pid and decoded exit status
+// of every job as columns
+struct GetAllJobsCompactOp : OpTraits {
+  static const exec_op_t op = EXEC_OP_GET_ALL_JOBS_COMPACT;
+  launch_data_status_t *jobs;
+  size_t count;
+
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    if (args.Length() < 1 || args.Length() > 2) {
+      THROW_BAD_ARGS;
+      return false;
+    }
+    jobs = NULL;
+    count = 0;
+    ctx->timeout = ParseTimeout(args.Length() == 2 ? args[0] : NanUndefined());
+    return true;
+  }
 
-	if (obj->Has(program_key)) {
-		if (!obj->Get(program_key)->IsString()) {
-			TYPE_ERROR("Program must be a string");
-		}
-		String::Utf8Value progS(obj->Get(program_key));
-		const char *prog = strdup(*progS);
-		launch_data_dict_insert(baton->job, launch_data_new_string(prog), LAUNCH_JOBKEY_PROGRAM);
-	}
+  int Work() {
+    return CompactAllJobs(&jobs, &count);
+  }
 
-	if (obj->Has(stderr_key)) {
-		if (!obj->Get(stderr_key)->IsString()) {
-			TYPE_ERROR("stderr must be a string");
-		}
-		String::Utf8Value stderrS(obj->Get(stderr_key));
-		const char *stde = strdup(*stderrS);
-		launch_data_dict_insert(baton->job, launch_data_new_string(stde), LAUNCH_JOBKEY_STANDARDERRORPATH);
-	}
+  int Result(Local<Value> *out) {
+    *out = CompactJobsToObject(jobs, count);
+    jobs = NULL;
+    return 0;
+  }
 
-	if (obj->Has(stdout_key)) {
-		if (!obj->Get(stdout_key)->IsString()) {
-			TYPE_ERROR("stdout must be a string");
-		}
-		String::Utf8Value stdoutS(obj->Get(stdout_key));
-		const char *stdo = strdup(*stdoutS);
-		launch_data_dict_insert(baton->job, launch_data_new_string(stdo), LAUNCH_JOBKEY_STANDARDOUTPATH);
-	}
+  void Release(int) {
+    if (jobs == NULL) {
+      return;
+    }
+    for (size_t i=0; i<count; i++) {
+      launch_data_status_free(jobs[i]);
+    }
+    free(jobs);
+  }
+};
 
-	if (obj->Has(args_key)) {
-		if (!obj->Get(args_key)->IsArray()) {
-			TYPE_ERROR("args must be an array");
-		}
-		Local<Array> argsArray = Local<Array>::Cast(obj->Get(args_key));
-		int32_t num = argsArray->Length();
-		int32_t i = 0;
-		for (i = 0; i < num; i++) {
-			String::Utf8Value vS(argsArray->Get(N_NUMBER(i)));
-			const char *v = strdup(*vS);
-			size_t offt = launch_data_array_get_count(baton->largv);
-			launch_data_array_set_index(baton->largv, launch_data_new_string(v), offt);
-		}
-		launch_data_dict_insert(baton->job, baton->largv, LAUNCH_JOBKEY_PROGRAMARGUMENTS);
-	}
-	uv_queue_work(uv_default_loop(), &baton->request, SubmitJobWorker, (uv_after_work_cb)SubmitJobAfterWork);
-	NanReturnUndefined();
-}
-NAN_METHOD(UnloadJobSync) {
+NAN_METHOD(StartStopRemoveSync) {
   NanScope();
-  // Job, editondisk, forceload, session_type, domain
-  if (args.Length() < 3) {
+  if (args.Length() != 2) {
     THROW_BAD_ARGS;
   }
 
   if (!args[0]->IsString()) {
-    TYPE_ERROR("Job path must be a string");
+    TYPE_ERROR("Job label must be a string");
+  }
+
+  if (!args[1]->IsInt32()) {
+    TYPE_ERROR("Command must be an integer");
   }
 
   String::Utf8Value job(args[0]);
-  const char *jobpath = *job;
 
-  if (!args[1]->IsBoolean()) {
-    TYPE_ERROR("Edit On Disk must be a bool");
+  const char* label = *job;
+
+  node_launchctl_action_t cmd_v = (node_launchctl_action_t)args[1]->Int32Value();
+  int result = 0;
+  switch (cmd_v) {
+    case NODE_LAUNCHCTL_CMD_START:
+      result = launchctl_start_job(label);
+      break;
+    case NODE_LAUNCHCTL_CMD_STOP:
+      result = launchctl_stop_job(label);
+      break;
+    case NODE_LAUNCHCTL_CMD_REMOVE:
+      result = launchctl_remove_job(label);
+      break;
+    default:
+      NanThrowError(LaunchDException(150, "EINCMD", "Invalid command"));
+      break;
   }
+  if (result != 0) {
+    NanThrowError(LaunchDException(result, NULL, NULL));
+  }
+  NanReturnValue(N_NUMBER(result));
+}
 
-  bool editondisk = (args[1]->ToBoolean() == NanTrue()) ? true : false;
-  if (!args[2]->IsBoolean()) {
-    TYPE_ERROR("Force Load must be a bool");
+static int RunAction(node_launchctl_action_t action, const char *label) {
+  switch (action) {
+    case NODE_LAUNCHCTL_CMD_START:
+      return launchctl_start_job(label);
+    case NODE_LAUNCHCTL_CMD_STOP:
+      return launchctl_stop_job(label);
+    case NODE_LAUNCHCTL_CMD_REMOVE:
+      return launchctl_remove_job(label);
   }
+  return EINVAL;
+}
 
-  bool forceload = (args[2]->ToBoolean() == NanTrue()) ? true : false;
+// startStopRemove(label, cmd, [opts], cb). A started job is reported back
+struct StartStopRemoveOp : OpTraits {
+  static const exec_op_t op = EXEC_OP_START_STOP_REMOVE;
+  InlineString<64> label;
+  node_launchctl_action_t action;
+  launch_data_t job;
+
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    if (args.Length() < 3 || args.Length() > 4) {
+      THROW_BAD_ARGS;
+      return false;
+    }
 
-  const char *session_type = NULL;
-  const char *domain = NULL;
+    if (!args[0]->IsString()) {
+      TYPE_ERROR("Job label must be a string");
+      return false;
+    }
 
-  if (args.Length() == 4 || args.Length() == 5) {
-    if (!args[3]->IsString() || !args[3]->IsNull()) {
-      TYPE_ERROR("Session type must be a string");
-    } else {
-      String::Utf8Value sesstype(args[3]);
-      session_type = *sesstype;
+    if (!args[1]->IsInt32()) {
+      TYPE_ERROR("Command must be an integer");
+      return false;
+    }
+
+    if (!Copy(&label, args[0])) {
+      return false;
     }
+    action = (node_launchctl_action_t)args[1]->Int32Value();
+    job = NULL;
+    ctx->timeout = ParseTimeout(args.Length() == 4 ? args[2] : NanUndefined());
+    return true;
   }
 
-  if (args.Length() == 5) {
-    if (!args[4]->IsString()) {
-      TYPE_ERROR("Domain must be a string");
-    } else {
-      String::Utf8Value dm(args[4]);
-      domain = *dm;
+  int Work() {
+    int err = RunAction(action, label.c_str());
+    if (err || action != NODE_LAUNCHCTL_CMD_START) {
+      return err;
     }
+    job = launchctl_list_job(label.c_str());
+    return job == NULL ? (errno ? errno : ESRCH) : 0;
   }
 
-  int result = launchctl_unload_job(jobpath, editondisk, forceload, session_type, domain);
-  if (result != 0) {
-    NanThrowError(LaunchDException(errno, strerror(errno), NULL));
+  int Result(Local<Value> *out) {
+    if (action != NODE_LAUNCHCTL_CMD_START) {
+      *out = N_NUMBER(1);
+      return 0;
+    }
+    ConvertOptions opts;
+    int err = 0;
+    DefaultConvertOptions(&opts);
+    *out = GetJobDetail(job, &opts, &err);
+    if (err) {
+      *out = N_NULL;
+    }
+    return 0;
   }
-  NanReturnValue(N_NUMBER(result));
-}
 
+  Local<Value> Error(int err) {
+    // Bad file descriptor, typically meaning no such process
+    return LaunchDException(err, strerror(err), err == 9 ? "No such process" : NULL);
+  }
 
-void UnloadJobWorker(uv_work_t *req) {
-  UnloadJobBaton *baton = static_cast<UnloadJobBaton *>(req->data);
-  int res = launchctl_unload_job(baton->path, baton->editondisk, baton->forceload, baton->session_type, baton->domain);
-  baton->err = res;
-}
+  void Release(int) {
+    if (job) {
+      launch_data_free(job);
+    }
+  }
+};
+
+#define SSR_MANY_CONCURRENCY 4
+
+// startStopRemoveMany(labels, action, { concurrency, pid, timeout }, cb)
+// Runs action against every label using at most `concurrency` executor
+// slots. Failures are reported per label, never through err
+struct SSRManyOp : OpTraits {
+  static const exec_op_t op = EXEC_OP_SSR_MANY;
+  // Past the deadline slots stop claiming labels, and the labels left
+  // over are reported as ETIMEDOUT with the rest
+  static const bool executor_deadline = false;
+
+  std::vector<std::string> labels;
+  // Aligned with labels
+  std::vector<int> errs;
+  std::vector<long long> pids;
+  std::vector<uint64_t> latency;
+  node_launchctl_action_t action;
+  bool pid;
+  uv_mutex_t lock;
+  size_t next;
+  size_t slots;
+  // Executor status of a slot that never ran, if any
+  int status;
+  uint64_t started;
+  // uv_hrtime() after which no more labels are claimed, 0 for none
+  uint64_t deadline;
+
+  SSRManyOp() {
+    uv_mutex_init(&lock);
+  }
+
+  ~SSRManyOp() {
+    uv_mutex_destroy(&lock);
+  }
+
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    if (args.Length() != 4) {
+      THROW_BAD_ARGS;
+      return false;
+    }
 
-void UnloadJobAfterWork(uv_work_t *req) {
-	NanScope();
-  UnloadJobBaton *baton = static_cast<UnloadJobBaton *>(req->data);
-  if (baton->err == 0) {
-    Local<Value> argv[2] = {
-      N_NULL,
-      N_NUMBER(0)
-    };
-    TryCatch try_catch;
-    baton->callback->Call(2, argv);
-    if (try_catch.HasCaught()) {
-      node::FatalException(try_catch);
+    labels.clear();
+    if (!ParseLabels(args[0], &labels)) {
+      TYPE_ERROR("Labels must be an array of strings");
+      return false;
     }
-  } else {
-    // Some kind of error
-    Local<Value> e = LaunchDException(baton->err, strerror(baton->err), NULL);
-    Local<Value> argv[1] = {
-      e
-    };
-    TryCatch try_catch;
-    baton->callback->Call(1, argv);
-    if (try_catch.HasCaught()) {
-      node::FatalException(try_catch);
+
+    if (!args[1]->IsInt32()) {
+      TYPE_ERROR("Command must be an integer");
+      return false;
+    }
+    int a = args[1]->Int32Value();
+    if (a < NODE_LAUNCHCTL_CMD_START || a > NODE_LAUNCHCTL_CMD_REMOVE) {
+      NanThrowError(LaunchDException(150, "EINCMD", "Invalid command"));
+      return false;
     }
+
+    slots = SSR_MANY_CONCURRENCY;
+    pid = false;
+    if (args[2]->IsObject()) {
+      Local<Object> o = args[2]->ToObject();
+      Local<Value> c = o->Get(NanSymbol("concurrency"));
+      if (c->IsNumber()) {
+        if (c->IntegerValue() < 1) {
+          NanThrowRangeError("concurrency must be positive");
+          return false;
+        }
+        slots = (size_t)c->IntegerValue();
+      }
+      pid = o->Get(NanSymbol("pid"))->BooleanValue();
+    }
+    if (slots > labels.size()) {
+      slots = labels.size() ? labels.size() : 1;
+    }
+
+    action = (node_launchctl_action_t)a;
+    pid = pid && action == NODE_LAUNCHCTL_CMD_START;
+    errs.assign(labels.size(), 0);
+    pids.assign(labels.size(), 0);
+    latency.assign(labels.size(), 0);
+    next = 0;
+    status = 0;
+    ctx->timeout = ParseTimeout(args[2]);
+    uint64_t timeout = ExecTimeout(ctx->timeout);
+    started = uv_hrtime();
+    deadline = timeout ? started + timeout * 1000000 : 0;
+    return true;
   }
-}
-NAN_METHOD(UnloadJob) {
+
+  size_t Slots() {
+    return slots;
+  }
+
+  // A rejected slot fails only the labels nobody claimed
+  int SlotDone(int s) {
+    if (s) {
+      status = s;
+    }
+    return 0;
+  }
+
+  // Claims labels until the batch is drained. The post-start lookup is
+  // only made when the caller asked for PIDs
+  int Work() {
+    for (;;) {
+      // Past the deadline the caller gets what is done, so stop making changes
+      if (deadline && uv_hrtime() >= deadline) {
+        return 0;
+      }
+      uv_mutex_lock(&lock);
+      size_t i = next++;
+      uv_mutex_unlock(&lock);
+      if (i >= labels.size()) {
+        return 0;
+      }
+
+      uint64_t start = uv_hrtime();
+      const char *label = labels[i].c_str();
+      int err = RunAction(action, label);
+      if (!err && pid) {
+        launch_data_t job = launchctl_list_job(label);
+        if (job) {
+          launch_data_t p = launch_data_dict_lookup(job, LAUNCH_JOBKEY_PID);
+          if (p && launch_data_get_type(p) == LAUNCH_DATA_INTEGER) {
+            pids[i] = launch_data_get_integer(p);
+          }
+          launch_data_free(job);
+        }
+      }
+      errs[i] = err;
+      latency[i] = uv_hrtime() - start;
+    }
+  }
+
+  int Result(Local<Value> *out) {
+    // Labels left over because every slot was rejected or timed out
+    for (size_t i=next; i<labels.size(); i++) {
+      errs[i] = status ? status : ETIMEDOUT;
+    }
+
+    Local<Object> results = NanNew<v8::Object>();
+    Local<Object> lat = NanNew<v8::Object>();
+    Local<Object> pidmap = NanNew<v8::Object>();
+    for (size_t i=0; i<labels.size(); i++) {
+      Local<String> label = NanNew<v8::String>(labels[i].c_str());
+      results->Set(label, NanNew<v8::Integer>(errs[i]));
+      lat->Set(label, NanNew<v8::Number>((double)latency[i] / 1e6));
+      if (pid && !errs[i] && pids[i] > 0) {
+        pidmap->Set(label, NanNew<v8::Number>((double)pids[i]));
+      }
+    }
+    Local<Object> res = NanNew<v8::Object>();
+    res->Set(NanSymbol("results"), results);
+    if (pid) {
+      res->Set(NanSymbol("pids"), pidmap);
+    }
+    res->Set(NanSymbol("latencyMs"), lat);
+    res->Set(NanSymbol("wallMs"), NanNew<v8::Number>((double)(uv_hrtime() - started) / 1e6));
+    *out = res;
+    return 0;
+  }
+
+  void Release(int) {
+    labels.clear();
+  }
+};
+
+NAN_METHOD(LoadJobSync) {
   NanScope();
   // Job, editondisk, forceload, session_type, domain
-  if (args.Length() < 4) {
+  if (args.Length() < 3) {
     THROW_BAD_ARGS;
   }
 
@@ -1146,7 +1624,7 @@ NAN_METHOD(UnloadJob) {
   }
 
   String::Utf8Value job(args[0]);
-  char *jobpath = *job;
+  const char *jobpath = *job;
 
   if (!args[1]->IsBoolean()) {
     TYPE_ERROR("Edit On Disk must be a bool");
@@ -1159,405 +1637,474 @@ NAN_METHOD(UnloadJob) {
 
   bool forceload = (args[2]->ToBoolean() == NanTrue()) ? true : false;
 
-  char *session_type = NULL;
-  char *domain = NULL;
+  // Copied out, so they outlive the blocks that check them
+  InlineString<32> session_type;
+  InlineString<32> domain;
 
-  UnloadJobBaton *baton = new UnloadJobBaton;
-  baton->request.data = baton;
-  baton->path = strdup(jobpath);
-  baton->editondisk = editondisk;
-  baton->forceload = forceload;
-
-  if (!args[args.Length()-1]->IsFunction()) {
-    TYPE_ERROR("Callback must be a function");
-  }
-  baton->callback = new NanCallback(Local<Function>::Cast(args[args.Length()-1]));
-  if (args.Length() == 4) {
-    baton->session_type = NULL;
-    baton->domain = NULL;
-  } else if (args.Length() == 5) {
-    if (!args[3]->IsString()) {
-      TYPE_ERROR("Session type must be a string");
-    } else {
-      String::Utf8Value sesstype(args[3]);
-      session_type = *sesstype;
-      baton->session_type = strdup(session_type);
-    }
-  } else if (args.Length() == 6) {
-    if (!args[3]->IsString()) {
+  if (args.Length() == 4 || args.Length() == 5) {
+    if (!args[3]->IsString() && !args[3]->IsNull()) {
       TYPE_ERROR("Session type must be a string");
-    } else {
-      String::Utf8Value sesstype(args[3]);
-      session_type = *sesstype;
-      baton->session_type = strdup(session_type);
+      NanReturnUndefined();
+    } else if (args[3]->IsString()) {
+      session_type.Assign(args[3]);
     }
+  }
 
+  if (args.Length() == 5) {
     if (!args[4]->IsString()) {
       TYPE_ERROR("Domain must be a string");
+      NanReturnUndefined();
     } else {
-      String::Utf8Value dm(args[4]);
-      domain = *dm;
-      baton->domain = strdup(domain);
+      domain.Assign(args[4]);
     }
   }
 
-  uv_queue_work(uv_default_loop(), &baton->request, UnloadJobWorker, (uv_after_work_cb)UnloadJobAfterWork);
-  NanReturnUndefined();
-}
-
-NAN_METHOD(GetLimitSync) {
-  NanScope();
-	char slimstr[100];
-	char hlimstr[100];
-	struct rlimit *lmts = NULL;
-	launch_data_t resp, msg;
-	int r = 0;
-	size_t i, lsz = -1;
-  if (geteuid() == 0) {
-		setup_system_context();
-	}
-	msg = launch_data_new_string(LAUNCH_KEY_GETRESOURCELIMITS);
-	resp = launch_msg(msg);
-	launch_data_free(msg);
-	if (resp == NULL) {
-		r = errno;
-		Local<Value> e = LaunchDException(r, strerror(r), NULL);
-		NanThrowError(e);
-	} else if (launch_data_get_type(resp) == LAUNCH_DATA_OPAQUE) {
-		lmts = (struct rlimit *)launch_data_get_opaque(resp);
-		lsz = launch_data_get_opaque_size(resp);
-		Local<Object> output = NanNew<v8::Object>();
-		for (i = 0; i<(lsz/sizeof(struct rlimit)); i++) {
-			const char *l = num2name((int)i);
-			Local<Object> inside = NanNew<v8::Object>();
-			inside->Set(N_STRING("soft"), N_STRING(lim2str(lmts[i].rlim_cur, slimstr)));
-			inside->Set(N_STRING("hard"), N_STRING(lim2str(lmts[i].rlim_max, hlimstr)));
-			output->Set(N_STRING(l), inside);
-		}
-		launch_data_free(resp);
-		NanReturnValue(output);
-	} else if (launch_data_get_type(resp) == LAUNCH_DATA_STRING) {
-		Local<Value> e = LaunchDException(1000, launch_data_get_string(resp), NULL);
-		launch_data_free(resp);
-		NanThrowError(e);
-	}
-  Local<Value> e = LaunchDException(errno, strerror(errno), NULL);
-  NanThrowError(e);
-  NanReturnValue(N_NUMBER(errno));
+  int result = launchctl_load_job(jobpath, editondisk, forceload, session_type.c_str(), domain.c_str());
+  if (result != 0) {
+    NanThrowError(LaunchDException(errno, strerror(errno), NULL));
+  }
+  NanReturnValue(N_NUMBER(result));
 }
 
-NAN_METHOD(SetLimitSync) {
-  NanScope();
-  if (geteuid() == 0) {
-    setup_system_context();
-  }
-  if (args.Length() < 2) {
-    THROW_BAD_ARGS;
-  }
+// loadJob(path, editondisk, forceload, [session_type, [domain]], [opts], cb)
+struct LoadJobOp : OpTraits {
+  static const exec_op_t op = EXEC_OP_LOAD_JOB;
+  InlineString<256> path;
+  bool editondisk;
+  bool forceload;
+  InlineString<32> session_type;
+  InlineString<32> domain;
+
+  bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+    // Job, editondisk, forceload, session_type, domain, options
+    int argc = args.Length();
+    if (argc > 4 && args[argc-2]->IsObject() && !args[argc-2]->IsFunction()) {
+      ctx->timeout = ParseTimeout(args[argc-2]);
+      argc--;
+    }
+    if (argc < 4 || argc > 6) {
+      THROW_BAD_ARGS;
+      return false;
+    }
 
-  if (!args[0]->IsString()) {
-    TYPE_ERROR("Limit name must be a string");
-  }
+    if (!args[0]->IsString()) {
+      TYPE_ERROR("Job path must be a string");
+      return false;
+    }
 
-  String::Utf8Value nameS(args[0]);
-  const char *name = *nameS;
+    if (!args[1]->IsBoolean()) {
+      TYPE_ERROR("Edit On Disk must be a bool");
+      return false;
+    }
 
-  if (!args[1]->IsString()) {
-    TYPE_ERROR("Soft limit must be a string");
-  }
+    if (!args[2]->IsBoolean()) {
+      TYPE_ERROR("Force Load must be a bool");
+      return false;
+    }
 
-  String::Utf8Value softS(args[1]);
-  const char *soft = *softS;
+    if (argc > 4 && !args[3]->IsString()) {
+      TYPE_ERROR("Session type must be a string");
+      return false;
+    }
 
+    if (argc > 5 && !args[4]->IsString()) {
+      TYPE_ERROR("Domain must be a string");
+      return false;
+    }
 
-  if (!args[2]->IsString()) {
-    TYPE_ERROR("Hard limit must be a string");
+    editondisk = args[1]->BooleanValue();
+    forceload = args[2]->BooleanValue();
+    session_type.Clear();
+    domain.Clear();
+    return Copy(&path, args[0])
+      && (argc < 5 || Copy(&session_type, args[3]))
+      && (argc < 6 || Copy(&domain, args[4]));
   }
 
-  String::Utf8Value hardS(args[2]);
-  const char *hard = *hardS;
-
-
-  struct rlimit *lmts = NULL;
-  launch_data_t resp, msg, tmp, resp1 = NULL;
-  int r = 0;
-  size_t lsz = -1;
-  ssize_t which = 0;
-  rlim_t slim = -1, hlim = -1;
-  if (-1 == (which = name2num(name))) {
-    fprintf(stderr, "Unable to find name2num\n");
-    Local<Value> e = LaunchDException(152, "EINVLIM", NULL);
-    NanThrowError(e);
+  int Work() {
+    return launchctl_load_job(path.c_str(), editondisk, forceload,
+      session_type.c_str(), domain.c_str());
   }
-  msg = launch_data_new_string(LAUNCH_KEY_GETRESOURCELIMITS);
-  resp = launch_msg(msg);
-  launch_data_free(msg);
-  if (resp == NULL) {
-    r = errno;
-    Local<Value> e = LaunchDException(r, strerror(r), NULL);
-    NanThrowError(e);
-  } else if (launch_data_get_type(resp) == LAUNCH_DATA_OPAQUE) {
-    lmts = (struct rlimit *)launch_data_get_opaque(resp);
-    lsz = launch_data_get_opaque_size(resp);
-  } else if (launch_data_get_type(resp) == LAUNCH_DATA_STRING) {
-    Local<Value> e = LaunchDException(153, "EUNKRES", launch_data_get_string(resp));
-    launch_data_free(resp);
-    NanThrowError(e);
-  } else {
-    Local<Value> e = LaunchDException(errno, strerror(errno), NULL);
-    NanThrowError(e);
-  }
-  resp1 = resp;
 
-  if (str2lim(soft, &slim)) {
-    Local<Value> e = LaunchDException(152, "EINVLIM", "Invalid soft limit");
-    NanThrowError(e);
+  int Result(Local<Value> *out) {
+    *out = N_NUMBER(0);
+    return 0;
   }
-  if (str2lim(hard, &hlim)) {
-    Local<Value> e = LaunchDException(152, "EINVLIM", "Invalid hard limit");
-    NanThrowError(e);
+
+  Local<Value> Error(int err) {
+    return LaunchDException(err, strerror(err), err == 17 ? "Job already loaded" : NULL);
   }
 
-  lmts[which].rlim_cur = slim;
-  lmts[which].rlim_max = hlim;
+  void Release(int) {}
+};
 
-  msg = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
-  tmp = launch_data_new_opaque(lmts, lsz);
-  launch_data_dict_insert(msg, tmp, LAUNCH_KEY_SETRESOURCELIMITS);
-  resp = launch_msg(msg);
-  launch_data_free(msg);
+// unloadJob(path, editondisk, forceload, [session_type, [domain]], [opts], cb)
+struct UnloadJobOp : LoadJobOp {
+  static const exec_op_t op = EXEC_OP_UNLOAD_JOB;
 
-  if (resp == NULL) {
-    Local<Value> e = LaunchDException(errno, strerror(errno), NULL);
-    NanThrowError(e);
-  } else if (launch_data_get_type(resp) == LAUNCH_DATA_STRING) {
-    Local<Value> e = LaunchDException(153, "EUNKRES", launch_data_get_string(resp));
-    NanThrowError(e);
-  } else if (launch_data_get_type(resp) != LAUNCH_DATA_OPAQUE) {
-    Local<Value> e = LaunchDException(153, "EUNKRES", "Unknown response from launchd");
-    NanThrowError(e);
+  int Work() {
+    return launchctl_unload_job(path.c_str(), editondisk, forceload,
+      session_type.c_str(), domain.c_str());
   }
 
-  launch_data_free(resp);
-  launch_data_free(resp1);
-
-  NanReturnValue(N_NUMBER(0));
-}
+  Local<Value> Error(int err) {
+    return OpTraits::Error(err);
+  }
+};
 
-NAN_METHOD(SetEnvVar) {
-	NanScope();
+// Builds the job described by obj ({ label, program, stderr, stdout,
+// args, keepAlive, runAtLoad }), or throws and returns NULL
+static launch_data_t NewSubmitJob(Local<Object> obj) {
+	static const struct {
+		const char *name;
+		const char *key;
+		const char *error;
+	} strings[] = {
+		{ "label", LAUNCH_JOBKEY_LABEL, "Label must be a string" },
+		{ "program", LAUNCH_JOBKEY_PROGRAM, "Program must be a string" },
+		{ "stderr", LAUNCH_JOBKEY_STANDARDERRORPATH, "stderr must be a string" },
+		{ "stdout", LAUNCH_JOBKEY_STANDARDOUTPATH, "stdout must be a string" }
+	};
 
-	if (args.Length() != 2) {
-		THROW_BAD_ARGS;
+	launch_data_t job = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+	for (size_t i=0; i<sizeof(strings)/sizeof(strings[0]); i++) {
+		Local<String> name = NanSymbol(strings[i].name);
+		if (!obj->Has(name)) {
+			continue;
+		}
+		Local<Value> v = obj->Get(name);
+		if (!v->IsString()) {
+			launch_data_free(job);
+			TYPE_ERROR(strings[i].error);
+			return NULL;
+		}
+		String::Utf8Value str(v);
+		launch_data_dict_insert(job, launch_data_new_string(*str), strings[i].key);
 	}
 
-	if (!args[0]->IsString()) {
-		TYPE_ERROR("Key must be a string");
+	Local<String> args_key = NanSymbol("args");
+	if (obj->Has(args_key)) {
+		if (!obj->Get(args_key)->IsArray()) {
+			launch_data_free(job);
+			TYPE_ERROR("args must be an array");
+			return NULL;
+		}
+		Local<Array> list = Local<Array>::Cast(obj->Get(args_key));
+		launch_data_t largv = launch_data_alloc(LAUNCH_DATA_ARRAY);
+		for (uint32_t i=0; i<list->Length(); i++) {
+			String::Utf8Value str(list->Get(i));
+			launch_data_array_set_index(largv, launch_data_new_string(*str), i);
+		}
+		launch_data_dict_insert(job, largv, LAUNCH_JOBKEY_PROGRAMARGUMENTS);
 	}
 
-	if (!args[1]->IsString()) {
-		TYPE_ERROR("Value must be a string");
+	static const struct {
+		const char *name;
+		const char *key;
+		const char *error;
+	} booleans[] = {
+		{ "keepAlive", LAUNCH_JOBKEY_KEEPALIVE, "keepAlive must be a boolean" },
+		{ "runAtLoad", LAUNCH_JOBKEY_RUNATLOAD, "runAtLoad must be a boolean" }
+	};
+
+	for (size_t i=0; i<sizeof(booleans)/sizeof(booleans[0]); i++) {
+		Local<String> name = NanSymbol(booleans[i].name);
+		if (!obj->Has(name)) {
+			continue;
+		}
+		Local<Value> v = obj->Get(name);
+		if (!v->IsBoolean()) {
+			launch_data_free(job);
+			TYPE_ERROR(booleans[i].error);
+			return NULL;
+		}
+		launch_data_dict_insert(job, launch_data_new_bool(v->BooleanValue()), booleans[i].key);
 	}
+	return job;
+}
 
-	String::Utf8Value keyS(args[0]);
-	String::Utf8Value valS(args[1]);
-	const char *key = *keyS;
-	const char *val = *valS;
-
-	launch_data_t resp, tmp, tmpv, msg;
-
-	msg = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
-	tmp = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
-	int r = 0;
-	tmpv = launch_data_new_string(val);
-	launch_data_dict_insert(tmp, tmpv, key);
-	launch_data_dict_insert(msg, tmp, LAUNCH_KEY_SETUSERENVIRONMENT);
-
-	resp = launch_msg(msg);
+// Hands job (and its ownership) to launchd. Returns the errno
+static int SendSubmitJob(launch_data_t job) {
+	if (geteuid() == 0) {
+		setup_system_context();
+	}
+	launch_data_t msg = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+	launch_data_dict_insert(msg, job, LAUNCH_KEY_SUBMITJOB);
+	launch_data_t resp = launch_transport_msg(msg);
 	launch_data_free(msg);
-
-	if (resp) {
-		launch_data_free(resp);
-	} else {
-		r = errno;
-		Local<Value> e = LaunchDException(errno, strerror(errno), NULL);
-		NanThrowError(e);
+	if (resp == NULL) {
+		return errno;
 	}
-	NanReturnValue(N_NUMBER(r));
+	int err = 0;
+	if (launch_data_get_type(resp) == LAUNCH_DATA_ERRNO) {
+		err = launch_data_get_errno(resp);
+	}
+	launch_data_free(resp);
+	return err;
 }
 
-NAN_METHOD(UnsetEnvVar) {
+NAN_METHOD(SubmitJobSync) {
 	NanScope();
-	int r = 0;
-
 	if (args.Length() != 1) {
 		THROW_BAD_ARGS;
+		NanReturnUndefined();
 	}
-
-	if (!args[0]->IsString()) {
-		TYPE_ERROR("Key must be a string");
+	if (!args[0]->IsObject()) {
+		TYPE_ERROR("Argument must be an object");
+		NanReturnUndefined();
 	}
+	launch_data_t job = NewSubmitJob(args[0]->ToObject());
+	if (job == NULL) {
+		NanReturnUndefined();
+	}
+	NanReturnValue(N_NUMBER(SendSubmitJob(job)));
+}
 
+// submitJob(job, cb)
+struct SubmitJobOp : OpTraits {
+	static const exec_op_t op = EXEC_OP_SUBMIT_JOB;
+	// Ours until Work() hands it to launchd
+	launch_data_t job;
+	// Holds job's nodes, reused while the op stays pooled. NULL (plain
+	// malloc) with Apple's liblaunch
+	launch_data_arena_t arena;
+
+	SubmitJobOp() : arena(launch_data_arena_create(4096)) {}
+	~SubmitJobOp() { launch_data_arena_destroy(arena); }
+
+	bool Capture(_NAN_METHOD_ARGS_TYPE args, OpContext *ctx) {
+		if (args.Length() != 2) {
+			THROW_BAD_ARGS;
+			return false;
+		}
+		if (!args[0]->IsObject()) {
+			TYPE_ERROR("Argument must be an object");
+			return false;
+		}
+		Local<Object> obj = args[0]->ToObject();
+		// The previous job has been released, drop its nodes at once
+		launch_data_arena_reset(arena);
+		launch_data_arena_t prev = launch_data_arena_use(arena);
+		job = NewSubmitJob(obj);
+		launch_data_arena_use(prev);
+		if (job == NULL) {
+			return false;
+		}
+		ctx->timeout = ParseTimeout(obj);
+		return true;
+	}
 
-	String::Utf8Value keyS(args[0]);
-	const char *key = *keyS;
-
-	launch_data_t resp, tmp, msg;
-	msg = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
-	tmp = launch_data_new_string(key);
-	launch_data_dict_insert(msg, tmp, LAUNCH_KEY_UNSETUSERENVIRONMENT);
-
-	resp = launch_msg(msg);
-	launch_data_free(msg);
+	int Work() {
+		launch_data_t j = job;
+		job = NULL;
+		return SendSubmitJob(j);
+	}
 
-	if (resp) {
-		launch_data_free(resp);
-	} else {
-		r = errno;
-		Local<Value> e = LaunchDException(errno, strerror(errno), NULL);
-		NanThrowError(e);
+	// Calls back with (null) alone
+	int Result(Local<Value> *) {
+		return 0;
 	}
 
-	NanReturnValue(N_NUMBER(r));
-}
+	// A no-op for arena nodes, the next Capture() resets the arena
+	void Release(int) {
+		if (job) {
+			launch_data_free(job);
+		}
+	}
+};
 
-NAN_METHOD(GetRUsage) {
+NAN_METHOD(UnloadJobSync) {
   NanScope();
-  int r = 0;
-  launch_data_t resp, msg;
-  if (args.Length() != 1) {
+  // Job, editondisk, forceload, session_type, domain
+  if (args.Length() < 3) {
     THROW_BAD_ARGS;
   }
 
   if (!args[0]->IsString()) {
-    TYPE_ERROR("who must be a string containing either `self` or `children`");
+    TYPE_ERROR("Job path must be a string");
   }
-  String::Utf8Value whoS(args[0]);
-  const char *who = *whoS;
 
-  if (!strcmp(who, "self")) {
-    msg = launch_data_new_string(LAUNCH_KEY_GETRUSAGESELF);
-  } else {
-    msg = launch_data_new_string(LAUNCH_KEY_GETRUSAGECHILDREN);
+  String::Utf8Value job(args[0]);
+  const char *jobpath = *job;
+
+  if (!args[1]->IsBoolean()) {
+    TYPE_ERROR("Edit On Disk must be a bool");
   }
-  resp = launch_msg(msg);
-  launch_data_free(msg);
 
-  if (resp == NULL) {
-    Local<Value> e = LaunchDException(errno, strerror(errno), NULL);
-    NanThrowError(e);
-  } else if (launch_data_get_type(resp) == LAUNCH_DATA_ERRNO) {
-    r = launch_data_get_errno(resp);
-    Local<Value> e = LaunchDException(r, strerror(r), NULL);
-    NanThrowError(e);
-  } else if (launch_data_get_type(resp) == LAUNCH_DATA_OPAQUE){
-    struct rusage *rusage = (struct rusage *)launch_data_get_opaque(resp);
-    Local<Object> output = NanNew<v8::Object>();
-    double usertimeused = (double)rusage->ru_utime.tv_sec + (double)rusage->ru_utime.tv_usec / (double)1000000;
-    output->Set(N_STRING("user_time_used"), N_NUMBER(usertimeused));
-    double systemtimeused = (double)rusage->ru_stime.tv_sec + (double)rusage->ru_stime.tv_usec / (double)1000000;
-    output->Set(N_STRING("system_time_used"), N_NUMBER(systemtimeused));
-
-    output->Set(N_STRING("max_resident_set_size"), N_NUMBER(rusage->ru_maxrss));
-    output->Set(N_STRING("shared_text_memory_size"), N_NUMBER(rusage->ru_ixrss));
-    output->Set(N_STRING("unshared_data_size"), N_NUMBER(rusage->ru_idrss));
-    output->Set(N_STRING("unshared_stack_size"), N_NUMBER(rusage->ru_isrss));
-    output->Set(N_STRING("page_reclaims"), N_NUMBER(rusage->ru_minflt));
-    output->Set(N_STRING("page_faults"), N_NUMBER(rusage->ru_majflt));
-    output->Set(N_STRING("swaps"), N_NUMBER(rusage->ru_nswap));
-    output->Set(N_STRING("block_input_operations"), N_NUMBER(rusage->ru_inblock));
-    output->Set(N_STRING("block_output_operations"), N_NUMBER(rusage->ru_oublock));
-    output->Set(N_STRING("messages_sent"), N_NUMBER(rusage->ru_msgsnd));
-    output->Set(N_STRING("messages_received"), N_NUMBER(rusage->ru_msgrcv));
-    output->Set(N_STRING("signals_received"), N_NUMBER(rusage->ru_nsignals));
-    output->Set(N_STRING("voluntary_context_switches"), N_NUMBER(rusage->ru_nvcsw));
-    output->Set(N_STRING("involuntary_context_switches"), N_NUMBER(rusage->ru_nivcsw));
-    launch_data_free(resp);
-    NanReturnValue(output);
+  bool editondisk = (args[1]->ToBoolean() == NanTrue()) ? true : false;
+  if (!args[2]->IsBoolean()) {
+    TYPE_ERROR("Force Load must be a bool");
   }
-  Local<Value> e = LaunchDException(153, "EUNKRES", "Unknown response from launchd");
-  NanThrowError(e);
-  NanReturnValue(N_NUMBER(153));
+
+  bool forceload = (args[2]->ToBoolean() == NanTrue()) ? true : false;
+
+  // Copied out, so they outlive the blocks that check them
+  InlineString<32> session_type;
+  InlineString<32> domain;
+
+  if (args.Length() == 4 || args.Length() == 5) {
+    if (!args[3]->IsString() && !args[3]->IsNull()) {
+      TYPE_ERROR("Session type must be a string");
+      NanReturnUndefined();
+    } else if (args[3]->IsString()) {
+      session_type.Assign(args[3]);
+    }
+  }
+
+  if (args.Length() == 5) {
+    if (!args[4]->IsString()) {
+      TYPE_ERROR("Domain must be a string");
+      NanReturnUndefined();
+    } else {
+      domain.Assign(args[4]);
+    }
+  }
+
+  int result = launchctl_unload_job(jobpath, editondisk, forceload, session_type.c_str(), domain.c_str());
+  if (result != 0) {
+    NanThrowError(LaunchDException(errno, strerror(errno), NULL));
+  }
+  NanReturnValue(N_NUMBER(result));
 }
 
-NAN_METHOD(Umask) {
+
+// Reports the peak handle count of the last conversion run with _trackHandles
+NAN_METHOD(GetConversionStats) {
   NanScope();
+  Local<Object> output = NanNew<v8::Object>();
+  output->Set(NanSymbol("peakHandles"), N_NUMBER(peak_handles));
+  NanReturnValue(output);
+}
 
+// Reports how effective the key string cache is
+NAN_METHOD(GetKeyCacheStats) {
+  NanScope();
+  Local<Object> output = NanNew<v8::Object>();
+  output->Set(NanSymbol("hits"), N_NUMBER(key_cache_hits));
+  output->Set(NanSymbol("misses"), N_NUMBER(key_cache_misses));
+  output->Set(NanSymbol("size"), N_NUMBER(key_cache.size()));
+  NanReturnValue(output);
+}
 
-  if (args.Length() > 1) {
-    THROW_BAD_ARGS;
-  }
+// Reports how often async calls reused a pooled baton instead of allocating
+NAN_METHOD(GetBatonPoolStats) {
+  NanScope();
+  Local<Object> output = NanNew<v8::Object>();
+  output->Set(NanSymbol("getJob"), AsyncOp<GetJobOp>::PoolStats());
+  output->Set(NanSymbol("getJobs"), AsyncOp<GetJobsOp>::PoolStats());
+  output->Set(NanSymbol("getAllJobs"), AsyncOp<GetAllJobsOp>::PoolStats());
+  output->Set(NanSymbol("getAllJobsCursor"), AsyncOp<GetAllJobsCursorOp>::PoolStats());
+  output->Set(NanSymbol("getAllJobsCompact"), AsyncOp<GetAllJobsCompactOp>::PoolStats());
+  output->Set(NanSymbol("startStopRemove"), AsyncOp<StartStopRemoveOp>::PoolStats());
+  output->Set(NanSymbol("startStopRemoveMany"), AsyncOp<SSRManyOp>::PoolStats());
+  output->Set(NanSymbol("loadJob"), AsyncOp<LoadJobOp>::PoolStats());
+  output->Set(NanSymbol("unloadJob"), AsyncOp<UnloadJobOp>::PoolStats());
+  output->Set(NanSymbol("submitJob"), AsyncOp<SubmitJobOp>::PoolStats());
+  output->Set(NanSymbol("execItems"), ExecItemPoolStats());
+  NanReturnValue(output);
+}
 
-  if (args.Length() == 1) {
-    // Set
-    if (!args[0]->IsString()) {
-      TYPE_ERROR("Umask must be a string");
-    }
-    String::Utf8Value umaskS(args[0]);
-		const char *u = *umaskS;
-		int res = launchctl_setumask(u);
-		if (res != 0) {
-			Local<Value> e = LaunchDException(res, strerror(res), NULL);
-			NanThrowError(e);
-		}
-    NanReturnValue(N_NUMBER(res));
+// setTransport({ record: path } | { replay: path } | { supervisor: true } |
+// { socket: path } | { fake: true | spec } | {}), see launch_transport.h
+NAN_METHOD(SetTransport) {
+  NanScope();
+  if (args.Length() != 1 || !args[0]->IsObject()) {
+    THROW_BAD_ARGS;
+    NanReturnUndefined();
+  }
+  Local<Object> o = args[0]->ToObject();
+  Local<Value> record = o->Get(NanSymbol("record"));
+  Local<Value> replay = o->Get(NanSymbol("replay"));
+  Local<Value> socket = o->Get(NanSymbol("socket"));
+  Local<Value> fake = o->Get(NanSymbol("fake"));
+  int err = 0;
+  if (o->Get(NanSymbol("supervisor"))->BooleanValue()) {
+    err = launch_transport_supervise();
+  } else if (fake->IsString()) {
+    String::Utf8Value spec(fake);
+    err = launch_transport_fake(*spec);
+  } else if (fake->IsTrue()) {
+    err = launch_transport_fake(NULL);
+  } else if (record->IsString()) {
+    String::Utf8Value path(record);
+    err = launch_transport_record(*path);
+  } else if (replay->IsString()) {
+    String::Utf8Value path(replay);
+    err = launch_transport_replay(*path);
+  } else if (socket->IsString()) {
+    String::Utf8Value path(socket);
+    err = launch_transport_connect(*path);
+  } else if (record->IsUndefined() && replay->IsUndefined() && socket->IsUndefined()) {
+    launch_transport_set(NULL);
   } else {
-    // Get
-		int64_t res = launchctl_getumask();
-		if (res == -1) {
-			Local<Value> e = LaunchDException(errno, strerror(errno), NULL);
-			NanThrowError(e);
-		}
-    NanReturnValue(N_NUMBER(res));
+    TYPE_ERROR("Capture and socket paths must be strings");
+    NanReturnUndefined();
+  }
+  if (err) {
+    NanThrowError(LaunchDException(err, strerror(err), NULL));
   }
+  NanReturnUndefined();
 }
 
-NAN_METHOD(GetEnv) {
-	NanScope();
-	launch_data_t resp;
+NAN_METHOD(GetTransport) {
+  NanScope();
+  NanReturnValue(N_STRING(launch_transport_name()));
+}
 
-	if (vproc_swap_complex(NULL, VPROC_GSK_ENVIRONMENT, NULL, &resp) == NULL) {
-		size_t i;
-		if (LAUNCH_DATA_DICTIONARY != resp->type) {
-			NanReturnValue(N_NUMBER(0));
-		}
-		Local<Object> output = NanNew<v8::Object>();
-		for (i=0; i<resp->_array_cnt; i+=2) {
-			launch_data_t d = resp->_array[i+1];
-			const char *k = resp->_array[i]->string;
-			output->Set(N_STRING(k), N_STRING(launch_data_get_string(d)));
-		}
-		launch_data_free(resp);
-		NanReturnValue(output);
-	} else {
-		NanReturnValue(N_NUMBER(0));
-	}
+// Makes ALLJOBS and single job requests return `count` synthetic jobs
+// labelled com.synthetic.job.<n> (0 restores launchd)
+// An optional { depth, width } object adds nested and wide dictionaries
+NAN_METHOD(SetSyntheticJobs) {
+  NanScope();
+  if (args.Length() < 1 || !args[0]->IsNumber()) {
+    THROW_BAD_ARGS;
+  }
+  synthetic_shape.count = (size_t)args[0]->IntegerValue();
+  synthetic_shape.depth = 0;
+  synthetic_shape.width = 0;
+  if (args.Length() > 1 && args[1]->IsObject()) {
+    Local<Object> o = args[1]->ToObject();
+    synthetic_shape.depth = (size_t)o->Get(NanSymbol("depth"))->IntegerValue();
+    synthetic_shape.width = (size_t)o->Get(NanSymbol("width"))->IntegerValue();
+  }
+  NanReturnUndefined();
 }
 
 void InitLaunchctl(Handle<Object> target) {
   NanScope();
-  NODE_SET_METHOD(target, "getJob", GetJob);
+  InitLazyJobs();
+  InitJobCursor();
+  InitJobTracker(target);
+  InitControl(target);
+  NODE_SET_METHOD(target, "getJob", AsyncOp<GetJobOp>::Method);
   NODE_SET_METHOD(target, "getJobSync", GetJobSync);
-  NODE_SET_METHOD(target, "getAllJobs", GetAllJobs);
+  NODE_SET_METHOD(target, "getJobs", AsyncOp<GetJobsOp>::Method);
+  NODE_SET_METHOD(target, "getJobsSync", GetJobsSync);
+  NODE_SET_METHOD(target, "getAllJobs", AsyncOp<GetAllJobsOp>::Method);
   NODE_SET_METHOD(target, "getAllJobsSync", GetAllJobsSync);
-  NODE_SET_METHOD(target, "getManagerName", GetManagerName);
-  NODE_SET_METHOD(target, "getManagerPID", GetManagerPID);
-  NODE_SET_METHOD(target, "getManagerUID", GetManagerUID);
-  NODE_SET_METHOD(target, "startStopRemove", StartStopRemove);
+  NODE_SET_METHOD(target, "getAllJobsCursor", AsyncOp<GetAllJobsCursorOp>::Method);
+  NODE_SET_METHOD(target, "getAllJobsCompact", AsyncOp<GetAllJobsCompactOp>::Method);
+  NODE_SET_METHOD(target, "getAllJobsCompactSync", GetAllJobsCompactSync);
+  NODE_SET_METHOD(target, "startStopRemove", AsyncOp<StartStopRemoveOp>::Method);
   NODE_SET_METHOD(target, "startStopRemoveSync", StartStopRemoveSync);
-  NODE_SET_METHOD(target, "loadJob", LoadJob);
+  NODE_SET_METHOD(target, "startStopRemoveMany", AsyncOp<SSRManyOp>::Method);
+  NODE_SET_METHOD(target, "loadJob", AsyncOp<LoadJobOp>::Method);
   NODE_SET_METHOD(target, "loadJobSync", LoadJobSync);
-  NODE_SET_METHOD(target, "unloadJob", UnloadJob);
+  NODE_SET_METHOD(target, "unloadJob", AsyncOp<UnloadJobOp>::Method);
   NODE_SET_METHOD(target, "unloadJobSync", UnloadJobSync);
-	NODE_SET_METHOD(target, "submitJob", SubmitJob);
+	NODE_SET_METHOD(target, "submitJob", AsyncOp<SubmitJobOp>::Method);
 	NODE_SET_METHOD(target, "submitJobSync", SubmitJobSync);
-	NODE_SET_METHOD(target, "getLimitSync", GetLimitSync);
-	NODE_SET_METHOD(target, "setLimitSync", SetLimitSync);
-	NODE_SET_METHOD(target, "setEnvVar", SetEnvVar);
-	NODE_SET_METHOD(target, "unsetEnvVar", UnsetEnvVar);
-	NODE_SET_METHOD(target, "getEnv", GetEnv);
-	NODE_SET_METHOD(target, "getRUsage", GetRUsage);
-  NODE_SET_METHOD(target, "umask", Umask);
+  NODE_SET_METHOD(target, "getKeyCacheStats", GetKeyCacheStats);
+  NODE_SET_METHOD(target, "getRegexCacheStats", GetRegexCacheStats);
+  NODE_SET_METHOD(target, "getBatonPoolStats", GetBatonPoolStats);
+  NODE_SET_METHOD(target, "setExecutorOptions", SetExecutorOptions);
+  NODE_SET_METHOD(target, "getExecutorStats", GetExecutorStats);
+  NODE_SET_METHOD(target, "setCoalesceOptions", SetCoalesceOptions);
+  NODE_SET_METHOD(target, "getCoalesceStats", GetCoalesceStats);
+  NODE_SET_METHOD(target, "setTransport", SetTransport);
+  NODE_SET_METHOD(target, "getTransport", GetTransport);
+  NODE_SET_METHOD(target, "_setSyntheticJobs", SetSyntheticJobs);
+  NODE_SET_METHOD(target, "_conversionStats", GetConversionStats);
 }
 
 //NODE_MODULE(launchctl, init);
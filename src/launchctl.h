@@ -30,14 +30,28 @@
  *
  */
 
+#ifndef LAUNCHCTL_H
+#define LAUNCHCTL_H
+
 #include <v8.h>
 #include <node.h>
 #include "nan.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <string.h>
 extern "C" {
 #include <liblaunchctl.h>
+#include <launch_data_codec.h>
+#include <launch_transport.h>
+#include <launch_data_arena.h>
 #include <errno.h>
+#include <regex.h>
+#ifdef __APPLE__
 #include <mach/mach.h>
+#endif
 }
+#include "pool.h"
 
 namespace launchctl {
 
@@ -47,61 +61,172 @@ typedef enum {
   NODE_LAUNCHCTL_CMD_REMOVE
 } node_launchctl_action_t;
 
-struct GetAllJobsBaton {
-  uv_work_t request;
-  launch_data_t resp;
-  int err;
-	int count;
-  NanCallback *callback;
-};
+// Default bound on array/dictionary nesting during conversion
+#define CONVERT_MAX_DEPTH 64
 
-struct GetJobBaton {
-  uv_work_t request;
-  const char *label;
-  launch_data_t resp;
-  int err;
-  NanCallback *callback;
-};
+// Keys selected by the `fields` option, one level of nesting per node
+// A node that ends a path (`all`) selects the whole subtree below its key
+struct FieldSet {
+  struct Compare {
+    bool operator()(const char *a, const char *b) const {
+      return strcmp(a, b) < 0;
+    }
+  };
+  typedef std::map<const char *, FieldSet *, Compare> Children;
+  Children children;
+  bool all;
 
-struct SSRBaton {
-  uv_work_t request;
-  const char *label;
-  launch_data_t job;
-  int err;
-  node_launchctl_action_t action;
-  NanCallback *callback;
+  FieldSet() : all(false) {}
+  ~FieldSet();
+  // Adds the first `len` bytes of key, returning the (possibly existing) child
+  FieldSet *Add(const char *key, size_t len);
 };
 
-struct LoadJobBaton {
-  uv_work_t request;
-  char *path;
-  bool editondisk;
-  bool forceload;
-  char *session_type;
-  char *domain;
-  int err;
-  NanCallback *callback;
+// Options controlling how launch_data_t job dictionaries become JS objects
+struct ConvertOptions {
+  // Build job objects from a shared template so every job has one shape
+  bool shaped;
+  // Keep the response native and convert job properties on first access
+  bool lazy;
+  // Encode the response on the worker and decode it in one pass on the loop
+  bool serialized;
+  // Deepest nesting of arrays/dictionaries accepted before failing
+  size_t maxDepth;
+  // Record the peak number of live handles (benchmarks only)
+  bool trackHandles;
+  // Keys to convert, NULL for all of them. Owned by the options
+  FieldSet *fields;
 };
 
+v8::Local<v8::Value> LaunchDException(int errorno, const char *code, const char *msg);
+void DefaultConvertOptions(ConvertOptions *opts);
+void ParseConvertOptions(v8::Local<v8::Value> v, ConvertOptions *opts);
+void FreeConvertOptions(ConvertOptions *opts);
+// Returns an empty handle and sets *err when the tree is malformed or too deep
+v8::Local<v8::Value> GetJobDetail(launch_data_t obj, const ConvertOptions *opts, int *err);
+v8::Local<v8::String> CachedKey(const char *key);
+
+// Converts one job dictionary inside its own handle scope
+v8::Local<v8::Value> ConvertJob(launch_data_t job, const ConvertOptions *opts, int *err);
+
+// Wraps an ALLJOBS response (taking ownership of it) in lazily converted jobs
+v8::Local<v8::Array> LazyAllJobs(launch_data_t resp);
+void InitLazyJobs();
+size_t LaunchDataSize(launch_data_t obj);
+
+// Wraps an ALLJOBS response in a cursor converting a batch of jobs per
+// call. Takes ownership of resp and of the FieldSet in opts
+v8::Local<v8::Object> NewJobCursor(launch_data_t resp, ConvertOptions *opts);
+void InitJobCursor();
 
-struct UnloadJobBaton {
-  uv_work_t request;
-  char *path;
-  bool editondisk;
-  bool forceload;
-  char *session_type;
-  char *domain;
-  int err;
-  NanCallback *callback;
+// Exposes the JobTracker constructor used by getJobChanges
+void InitJobTracker(v8::Handle<v8::Object> target);
+
+// Exposes the limit, rusage, environment, umask and manager bindings
+void InitControl(v8::Handle<v8::Object> target);
+
+typedef enum {
+  LABEL_FILTER_PREFIX = 1,
+  LABEL_FILTER_GLOB,
+  LABEL_FILTER_REGEX
+} label_filter_kind_t;
+
+// Label filter applied to ALLJOBS responses on the threadpool
+struct LabelFilter {
+  label_filter_kind_t kind;
+  char *pattern;
+  size_t len;
+  bool icase;
+  // Compiled POSIX extended regex (LABEL_FILTER_REGEX), shared via a cache
+  regex_t *re;
+  // Whether re belongs to this filter rather than the cache
+  bool owned;
 };
 
-struct SubmitJobBaton {
-	uv_work_t request;
-	launch_data_t	job;
-	launch_data_t resp;
-	launch_data_t	largv;
-	int err;
-  NanCallback *callback;
+// Returns NULL with a message in errbuf when a regex does not compile
+LabelFilter *NewLabelFilter(label_filter_kind_t kind, const char *pattern, bool icase, char *errbuf, size_t errlen);
+void FreeLabelFilter(LabelFilter *filter);
+bool LabelFilterMatch(const LabelFilter *filter, const char *label);
+// Removes (and frees) the jobs of an ALLJOBS response not matching filter
+void FilterAllJobs(launch_data_t resp, const LabelFilter *filter);
+// Reads prefix/glob/regex from options, throwing and returning false on error
+bool ParseLabelFilter(v8::Local<v8::Value> v, LabelFilter **filter);
+
+// Asks launchd (or the synthetic backend) for every job
+vproc_err_t FetchAllJobs(launch_data_t *resp);
+NAN_METHOD(GetRegexCacheStats);
+
+// Operation types the executor keeps separate statistics for
+typedef enum {
+  EXEC_OP_GET_JOB = 0,
+  EXEC_OP_GET_ALL_JOBS,
+  EXEC_OP_GET_ALL_JOBS_COMPACT,
+  EXEC_OP_START_STOP_REMOVE,
+  EXEC_OP_LOAD_JOB,
+  EXEC_OP_UNLOAD_JOB,
+  EXEC_OP_SUBMIT_JOB,
+  EXEC_OP_JOB_CHANGES,
+  EXEC_OP_GET_JOBS,
+  EXEC_OP_SSR_MANY,
+  EXEC_OP_CONTROL,
+  EXEC_OP_MAX
+} exec_op_t;
+
+// Priority classes, most urgent first (see executor.cc)
+typedef enum {
+  EXEC_LANE_INTERACTIVE = 0,
+  EXEC_LANE_MUTATION,
+  EXEC_LANE_BULK,
+  EXEC_LANE_MAX
+} exec_lane_t;
+
+typedef void (*exec_work_cb)(uv_work_t *req);
+// status is 0, EAGAIN when the queue was full and the work never ran,
+// ETIMEDOUT when the deadline passed before it ran, or ECANCELED when the
+// deadline passed while it ran (callback then only discards its arguments)
+typedef void (*exec_after_cb)(uv_work_t *req, int status);
+
+// Runs work on the executor threads, then after on the default loop.
+// With a callback, the work gets a deadline of timeout ms (or the default
+// set through setExecutorOptions), after which callback gets ETIMEDOUT
+void QueueWork(uv_work_t *req, exec_op_t op, exec_work_cb work, exec_after_cb after,
+  NanCallback *callback = NULL, uint64_t timeout = 0);
+// The `timeout` option in ms, 0 when unset
+uint64_t ParseTimeout(v8::Local<v8::Value> opts);
+// timeout, or the default deadline when it is 0
+uint64_t ExecTimeout(uint64_t timeout);
+// A shared no-op, set on callbacks whose caller must not be called again
+v8::Local<v8::Function> DiscardFunction();
+// { created, reused, idle } of the executor's work items
+v8::Local<v8::Object> ExecItemPoolStats();
+NAN_METHOD(SetExecutorOptions);
+NAN_METHOD(GetExecutorStats);
+
+// Requests sharing one in-flight launchd round trip (see coalesce.cc)
+struct Flight;
+// Returns NULL when coalescing is off. Sets *joined when an identical
+// request (same op, label, options and filter) or a fresh result will
+// call fn, otherwise returns a new flight the caller has to finish
+Flight *JoinFlight(const char *op, const char *label, const ConvertOptions *opts,
+  const LabelFilter *filter, v8::Local<v8::Function> fn, bool *joined);
+// Calls back callback and everyone who joined flight (which may be NULL)
+void FinishFlight(Flight *flight, NanCallback *callback, int argc, v8::Local<v8::Value> argv[]);
+NAN_METHOD(SetCoalesceOptions);
+NAN_METHOD(GetCoalesceStats);
+
+// Shape of the synthetic ALLJOBS responses used by the benchmarks
+struct SyntheticShape {
+  size_t count; // number of jobs
+  size_t depth; // extra nesting under each job's "Nested" key
+  size_t width; // entries in each job's "Wide" dictionary
 };
 
+// Builds a synthetic VPROC_GSK_ALLJOBS style response
+launch_data_t SyntheticAllJobs(const SyntheticShape *shape);
+// Stands in for launchctl_list_job(): the synthetic job labelled label,
+// or NULL with errno set to ESRCH
+launch_data_t SyntheticListJob(const char *label, const SyntheticShape *shape);
+
 } // namespace launchctl
+
+#endif
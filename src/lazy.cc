@@ -0,0 +1,188 @@
+/*
+ * lazy.cc
+ * Lazily converted jobs for getAllJobs
+ *
+ * The ALLJOBS response stays native inside a JobSnapshot wrapper. Every job
+ * is a small handle pointing at its dictionary inside that response, and its
+ * properties are converted through named property interceptors the first time
+ * they are read. The response is freed once the wrapper and every job handle
+ * referencing it have been garbage collected.
+ *
+ */
+
+#include <v8.h>
+#include <node.h>
+#include <launch.h>
+#include "launchctl.h"
+using namespace node;
+using namespace v8;
+
+namespace launchctl {
+
+#if NODE_VERSION_AT_LEAST(0, 11, 0)
+#define NOT_INTERCEPTED(type) return
+#else
+#define NOT_INTERCEPTED(type) return Handle<type>()
+#endif
+
+// Internal fields of a lazy job handle
+enum {
+  LAZY_JOB_DATA = 0,     // launch_data_t of the job dictionary
+  LAZY_JOB_SNAPSHOT,     // JobSnapshot wrapper keeping the response alive
+  LAZY_JOB_CACHE,        // Object holding already converted properties
+  LAZY_JOB_FIELDS
+};
+
+static Persistent<ObjectTemplate> snapshot_template;
+static Persistent<ObjectTemplate> lazy_job_template;
+
+// Approximates the memory held by a launch_data_t tree
+size_t LaunchDataSize(launch_data_t obj) {
+  size_t size = sizeof(struct _launch_data);
+  switch (launch_data_get_type(obj)) {
+    case LAUNCH_DATA_STRING:
+      size += obj->string_len + 1;
+      break;
+    case LAUNCH_DATA_OPAQUE:
+      size += obj->opaque_size;
+      break;
+    case LAUNCH_DATA_ARRAY:
+    case LAUNCH_DATA_DICTIONARY:
+      size += obj->_array_cnt * sizeof(launch_data_t);
+      for (size_t i=0; i<obj->_array_cnt; i++) {
+        size += LaunchDataSize(obj->_array[i]);
+      }
+      break;
+    default:
+      break;
+  }
+  return size;
+}
+
+class JobSnapshot : public ObjectWrap {
+ public:
+  static Local<Object> New(launch_data_t resp) {
+    Local<Object> handle = NanNew(snapshot_template)->NewInstance();
+    JobSnapshot *snapshot = new JobSnapshot(resp);
+    snapshot->Wrap(handle);
+    return handle;
+  }
+
+ private:
+  explicit JobSnapshot(launch_data_t r) : resp(r) {
+    bytes = LaunchDataSize(resp);
+    NanAdjustExternalMemory((int)bytes);
+  }
+
+  ~JobSnapshot() {
+    launch_data_free(resp);
+    NanAdjustExternalMemory(-(int)bytes);
+  }
+
+  launch_data_t resp;
+  size_t bytes;
+};
+
+static launch_data_t LazyJobData(Local<Object> self) {
+  return static_cast<launch_data_t>(NanGetInternalFieldPointer(self, LAZY_JOB_DATA));
+}
+
+static Local<Object> LazyJobCache(Local<Object> self) {
+  Local<Value> cache = self->GetInternalField(LAZY_JOB_CACHE);
+  if (cache->IsObject()) {
+    return cache.As<Object>();
+  }
+  Local<Object> c = NanNew<v8::Object>();
+  self->SetInternalField(LAZY_JOB_CACHE, c);
+  return c;
+}
+
+static NAN_PROPERTY_GETTER(LazyJobGetter) {
+  NanScope();
+  Local<Object> self = args.Holder();
+  Local<Object> cache = LazyJobCache(self);
+  if (cache->HasOwnProperty(property)) {
+    NanReturnValue(cache->Get(property));
+  }
+
+  String::Utf8Value key(property);
+  launch_data_t d = launch_data_dict_lookup(LazyJobData(self), *key);
+  if (d == NULL) {
+    NOT_INTERCEPTED(Value);
+  }
+  ConvertOptions opts;
+  int err;
+  DefaultConvertOptions(&opts);
+  Local<Value> value = GetJobDetail(d, &opts, &err);
+  if (err) {
+    NanThrowError(LaunchDException(err, NULL, NULL));
+    NanReturnUndefined();
+  }
+  cache->Set(property, value);
+  NanReturnValue(value);
+}
+
+// Assignments land in the cache so they shadow the launchd value
+static NAN_PROPERTY_SETTER(LazyJobSetter) {
+  NanScope();
+  LazyJobCache(args.Holder())->Set(property, value);
+  NanReturnValue(value);
+}
+
+static NAN_PROPERTY_QUERY(LazyJobQuery) {
+  NanScope();
+  Local<Object> self = args.Holder();
+  String::Utf8Value key(property);
+  if (launch_data_dict_lookup(LazyJobData(self), *key) == NULL &&
+      !LazyJobCache(self)->HasOwnProperty(property)) {
+    NOT_INTERCEPTED(Integer);
+  }
+  NanReturnValue(NanNew<v8::Integer>(None));
+}
+
+static NAN_PROPERTY_ENUMERATOR(LazyJobEnumerator) {
+  NanScope();
+  launch_data_t job = LazyJobData(args.Holder());
+  size_t count = job->_array_cnt;
+  Local<Array> keys = NanNew<v8::Array>(count/2);
+  for (size_t i=0; i<count; i+=2) {
+    keys->Set(i/2, CachedKey(job->_array[i]->string));
+  }
+  NanReturnValue(keys);
+}
+
+void InitLazyJobs() {
+  Local<ObjectTemplate> s = NanNew<v8::ObjectTemplate>();
+  s->SetInternalFieldCount(1);
+  NanAssignPersistent(snapshot_template, s);
+
+  Local<ObjectTemplate> j = NanNew<v8::ObjectTemplate>();
+  j->SetInternalFieldCount(LAZY_JOB_FIELDS);
+  j->SetNamedPropertyHandler(LazyJobGetter, LazyJobSetter, LazyJobQuery, 0, LazyJobEnumerator);
+  NanAssignPersistent(lazy_job_template, j);
+}
+
+Local<Array> LazyAllJobs(launch_data_t resp) {
+  ConvertOptions opts;
+  int err;
+  DefaultConvertOptions(&opts);
+  Local<Object> snapshot = JobSnapshot::New(resp);
+  Local<ObjectTemplate> t = NanNew(lazy_job_template);
+  size_t count = resp->_array_cnt;
+  Local<Array> output = NanNew<v8::Array>(count/2);
+  for (size_t i=0; i<count; i+=2) {
+    launch_data_t job = resp->_array[i+1];
+    if (launch_data_get_type(job) != LAUNCH_DATA_DICTIONARY) {
+      Local<Value> v = GetJobDetail(job, &opts, &err);
+      output->Set(i/2, err ? Local<Value>(NanNull()) : v);
+      continue;
+    }
+    Local<Object> handle = t->NewInstance();
+    NanSetInternalFieldPointer(handle, LAZY_JOB_DATA, job);
+    handle->SetInternalField(LAZY_JOB_SNAPSHOT, snapshot);
+    output->Set(i/2, handle);
+  }
+  return output;
+}
+
+} // namespace launchctl
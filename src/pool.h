@@ -0,0 +1,150 @@
+/*
+ * pool.h
+ * Reusable batons and owned strings for async bindings
+ *
+ * Pools are only touched on the loop thread: batons are acquired when a
+ * call is made and released from its after callback, so no locking is
+ * needed. Once a pool has grown to the number of calls usually in flight,
+ * steady-state calls allocate nothing for their batons.
+ *
+ */
+
+#ifndef LAUNCHCTL_POOL_H
+#define LAUNCHCTL_POOL_H
+
+#include <v8.h>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include "nan.h"
+
+namespace launchctl {
+
+// Most idle batons kept per pool, the rest are deleted on release
+#define BATON_POOL_MAX 256
+
+// A NUL terminated string owned by its holder. Strings shorter than N
+// bytes live inline, longer ones in a heap buffer that is kept (and
+// reused) until the holder is destroyed. An unset string reads as NULL
+template <size_t N>
+class InlineString {
+ public:
+  InlineString() : heap_(NULL), cap_(0), ptr_(NULL) {
+    buf_[0] = '\0';
+  }
+
+  ~InlineString() {
+    free(heap_);
+  }
+
+  // Copies v as UTF-8, without the temporary String::Utf8Value allocates.
+  // Returns false (leaving the string unset) when out of memory
+  bool Assign(v8::Local<v8::Value> v) {
+    v8::Local<v8::String> s = v->ToString();
+    size_t len = (size_t)s->Utf8Length();
+    char *dst = Reserve(len + 1);
+    ptr_ = dst;
+    if (dst == NULL) {
+      return false;
+    }
+    s->WriteUtf8(dst, (int)len + 1);
+    dst[len] = '\0';
+    return true;
+  }
+
+  bool Assign(const char *s) {
+    size_t len = strlen(s);
+    char *dst = Reserve(len + 1);
+    ptr_ = dst;
+    if (dst == NULL) {
+      return false;
+    }
+    memcpy(dst, s, len + 1);
+    return true;
+  }
+
+  void Clear() {
+    ptr_ = NULL;
+  }
+
+  const char *c_str() const {
+    return ptr_;
+  }
+
+ private:
+  // Storage for size bytes, NULL when the heap is exhausted
+  char *Reserve(size_t size) {
+    if (size <= N) {
+      return buf_;
+    }
+    if (size > cap_) {
+      char *grown = static_cast<char *>(realloc(heap_, size));
+      if (grown == NULL) {
+        return NULL;
+      }
+      heap_ = grown;
+      cap_ = size;
+    }
+    return heap_;
+  }
+
+  char buf_[N];
+  char *heap_;
+  size_t cap_;
+  const char *ptr_;
+
+  InlineString(const InlineString &);
+  InlineString &operator=(const InlineString &);
+};
+
+// A free list of T. Acquire() hands out an idle T (or a new one) as is,
+// so callers reset whatever state they rely on
+template <typename T>
+class BatonPool {
+ public:
+  explicit BatonPool(size_t max) : max_(max), created_(0), reused_(0) {
+    idle_.reserve(max);
+  }
+
+  T *Acquire() {
+    if (idle_.empty()) {
+      created_++;
+      return new T();
+    }
+    T *t = idle_.back();
+    idle_.pop_back();
+    reused_++;
+    return t;
+  }
+
+  void Release(T *t) {
+    if (idle_.size() < max_) {
+      idle_.push_back(t);
+    } else {
+      delete t;
+    }
+  }
+
+  // { created, reused, idle }
+  v8::Local<v8::Object> Stats() const {
+    NanEscapableScope();
+    v8::Local<v8::Object> res = NanNew<v8::Object>();
+    res->Set(NanSymbol("created"), NanNew<v8::Number>(created_));
+    res->Set(NanSymbol("reused"), NanNew<v8::Number>(reused_));
+    res->Set(NanSymbol("idle"), NanNew<v8::Number>((double)idle_.size()));
+    return NanEscapeScope(res);
+  }
+
+ private:
+  std::vector<T *> idle_;
+  size_t max_;
+  double created_;
+  double reused_;
+
+  BatonPool(const BatonPool &);
+  BatonPool &operator=(const BatonPool &);
+};
+
+} // namespace launchctl
+
+#endif
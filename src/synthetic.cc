@@ -0,0 +1,114 @@
+/*
+ * synthetic.cc
+ * Builds launch_data_t trees that look like real launchd responses
+ * so conversion paths can be benchmarked without thousands of real jobs
+ *
+ */
+
+#include <v8.h>
+#include <node.h>
+#include <launch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "launchctl.h"
+
+namespace launchctl {
+
+// Builds a chain of `depth` nested dictionaries
+static launch_data_t SyntheticNested(size_t depth) {
+  launch_data_t root = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+  launch_data_t cur = root;
+  for (size_t d=1; d<depth; d++) {
+    launch_data_t next = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+    launch_data_dict_insert(cur, launch_data_new_integer((long long)d), "Level");
+    launch_data_dict_insert(cur, next, "Child");
+    cur = next;
+  }
+  return root;
+}
+
+// Builds a dictionary with `width` string entries
+static launch_data_t SyntheticWide(size_t width) {
+  char key[64];
+  launch_data_t dict = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+  for (size_t w=0; w<width; w++) {
+    snprintf(key, sizeof(key), "KEY_%zu", w);
+    launch_data_dict_insert(dict, launch_data_new_string(key), key);
+  }
+  return dict;
+}
+
+// Builds a single job dictionary resembling what launchd returns for
+// a loaded LaunchAgent. Roughly one in three jobs is running (has a PID),
+// the rest carry a LastExitStatus. Every fourth job registers MachServices
+static launch_data_t SyntheticJob(size_t i, const SyntheticShape *shape) {
+  char buf[128];
+  launch_data_t job = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+
+  snprintf(buf, sizeof(buf), "com.synthetic.job.%zu", i);
+  launch_data_dict_insert(job, launch_data_new_string(buf), LAUNCH_JOBKEY_LABEL);
+  launch_data_dict_insert(job, launch_data_new_string("Aqua"), LAUNCH_JOBKEY_LIMITLOADTOSESSIONTYPE);
+  launch_data_dict_insert(job, launch_data_new_bool(i % 2 == 0), LAUNCH_JOBKEY_ONDEMAND);
+  launch_data_dict_insert(job, launch_data_new_integer(30), LAUNCH_JOBKEY_TIMEOUT);
+
+  if (i % 3 == 0) {
+    launch_data_dict_insert(job, launch_data_new_integer(1000 + (long long)i), LAUNCH_JOBKEY_PID);
+  } else {
+    launch_data_dict_insert(job, launch_data_new_integer((long long)(i % 7) << 8), LAUNCH_JOBKEY_LASTEXITSTATUS);
+  }
+
+  snprintf(buf, sizeof(buf), "/usr/local/libexec/synthetic-%zu", i);
+  launch_data_dict_insert(job, launch_data_new_string(buf), LAUNCH_JOBKEY_PROGRAM);
+
+  launch_data_t largv = launch_data_alloc(LAUNCH_DATA_ARRAY);
+  launch_data_array_set_index(largv, launch_data_new_string(buf), 0);
+  launch_data_array_set_index(largv, launch_data_new_string("--verbose"), 1);
+  launch_data_array_set_index(largv, launch_data_new_string("--foreground"), 2);
+  launch_data_dict_insert(job, largv, LAUNCH_JOBKEY_PROGRAMARGUMENTS);
+
+  if (i % 4 == 0) {
+    launch_data_t mach = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+    snprintf(buf, sizeof(buf), "com.synthetic.job.%zu.xpc", i);
+    launch_data_dict_insert(mach, launch_data_new_machport(MACH_PORT_NULL), buf);
+    launch_data_dict_insert(job, mach, LAUNCH_JOBKEY_MACHSERVICES);
+  }
+
+  if (shape->depth > 0) {
+    launch_data_dict_insert(job, SyntheticNested(shape->depth), "Nested");
+  }
+
+  if (shape->width > 0) {
+    launch_data_dict_insert(job, SyntheticWide(shape->width), "Wide");
+  }
+
+  return job;
+}
+
+launch_data_t SyntheticAllJobs(const SyntheticShape *shape) {
+  launch_data_t resp = launch_data_alloc(LAUNCH_DATA_DICTIONARY);
+  for (size_t i=0; i<shape->count; i++) {
+    launch_data_t job = SyntheticJob(i, shape);
+    launch_data_t label = launch_data_dict_lookup(job, LAUNCH_JOBKEY_LABEL);
+    launch_data_dict_insert(resp, job, launch_data_get_string(label));
+  }
+  return resp;
+}
+
+launch_data_t SyntheticListJob(const char *label, const SyntheticShape *shape) {
+  static const char prefix[] = "com.synthetic.job.";
+  size_t plen = sizeof(prefix) - 1;
+  if (strncmp(label, prefix, plen) == 0) {
+    const char *digits = label + plen;
+    char *end;
+    unsigned long i = strtoul(digits, &end, 10);
+    if (end != digits && *end == '\0' && i < shape->count) {
+      return SyntheticJob(i, shape);
+    }
+  }
+  errno = ESRCH;
+  return NULL;
+}
+
+} // namespace launchctl
@@ -9,3 +9,11 @@ test('getEnvVar', function(t) {
   t.ok(res.HOME, 'should have HOME')
   t.end()
 })
+
+test('getEnvVar - async', function(t) {
+  ctl.getEnvVar('PATH', function(err, path) {
+    t.equal(err, null, 'Error does not exist')
+    t.type(path, 'string', 'should be a string')
+    t.end()
+  })
+})
@@ -0,0 +1,195 @@
+var test = require('tap').test
+  , ctl = require('../lib')
+  , binding = require('bindings')('bindings')
+
+test('executorStats', function(t) {
+  var before = ctl.executorStats()
+  t.type(before.threads, 'number', 'threads should be a number')
+  t.type(before.ops.getAllJobs, 'object', 'getAllJobs should have stats')
+  ctl.list(function(err) {
+    t.equal(err, null, 'Error does not exist')
+    var after = ctl.executorStats()
+    t.equal(after.ops.getAllJobs.count, before.ops.getAllJobs.count + 1,
+      'request should be counted')
+    t.type(after.ops.getAllJobs.runMs, 'number', 'runMs should be a number')
+    t.equal(after.inFlight, 0, 'nothing should be in flight')
+    t.end()
+  })
+})
+
+test('setExecutorOptions - queue full', function(t) {
+  var EAGAIN = require('constants').EAGAIN
+  ctl.setExecutorOptions({ queueSize: 1 })
+  var pending = 100
+    , rejected = 0
+  for (var i = 0; i < 100; i++) {
+    ctl.list(function(err) {
+      if (err) {
+        t.equal(err.errno, EAGAIN, 'should fail with EAGAIN')
+        rejected++
+      }
+      if (--pending === 0) {
+        t.ok(rejected > 0, 'some requests should be rejected')
+        ctl.setExecutorOptions({ queueSize: 1024 })
+        t.end()
+      }
+    })
+  }
+})
+
+test('setExecutorOptions - invalid', function(t) {
+  t.throws(function() {
+    ctl.setExecutorOptions({ threads: 0 })
+  }, 'should throw on zero threads')
+  t.end()
+})
+
+test('setCoalesceOptions', function(t) {
+  ctl.setCoalesceOptions({ enabled: true })
+  var before = ctl.coalesceStats()
+    , pending = 5
+    , results = []
+  for (var i = 0; i < 5; i++) {
+    ctl.list(function(err, jobs) {
+      t.equal(err, null, 'Error does not exist')
+      results.push(jobs)
+      if (--pending) return
+      var after = ctl.coalesceStats()
+      t.equal(after.requests - before.requests, 5, 'every request is counted')
+      t.ok(after.joined > before.joined, 'requests should be joined')
+      t.equal(results[0], results[4], 'joined callers share the result')
+      ctl.setCoalesceOptions({ enabled: false })
+      t.end()
+    })
+  }
+})
+
+test('setCoalesceOptions - freshMs', function(t) {
+  ctl.setCoalesceOptions({ enabled: true, freshMs: 10000 })
+  ctl.list({ fields: ['Label'] }, function(err, first) {
+    t.equal(err, null, 'Error does not exist')
+    var before = ctl.coalesceStats()
+    ctl.list({ fields: ['Label'] }, function(err, second) {
+      t.equal(err, null, 'Error does not exist')
+      t.equal(second, first, 'fresh result is reused')
+      t.equal(ctl.coalesceStats().fresh, before.fresh + 1, 'fresh hit counted')
+      ctl.setCoalesceOptions({ enabled: false, freshMs: 0 })
+      t.end()
+    })
+  })
+})
+
+test('timeout', function(t) {
+  var ETIMEDOUT = require('constants').ETIMEDOUT
+  binding._setSyntheticJobs(50000)
+  ctl.setExecutorOptions({ threads: 2 })
+  var before = ctl.executorStats()
+    , pending = 4
+    , timedOut = 0
+  function done(err) {
+    if (err) {
+      t.equal(err.errno, ETIMEDOUT, 'should fail with ETIMEDOUT')
+      timedOut++
+    }
+    if (--pending) return
+    var after = ctl.executorStats()
+    t.equal(timedOut, 4, 'every call should time out')
+    t.equal(after.timedOut - before.timedOut, 4, 'deadlines are counted')
+    t.ok(after.cancelled > before.cancelled, 'queued work is cancelled')
+    binding._setSyntheticJobs(0)
+    // Late results are only freed
+    setTimeout(function() {
+      t.equal(ctl.executorStats().inFlight, 0, 'nothing should be in flight')
+      t.end()
+    }, 500)
+  }
+  for (var i = 0; i < 4; i++) {
+    ctl.list({ timeout: 1 }, done)
+  }
+})
+
+test('setExecutorOptions - default timeout', function(t) {
+  ctl.setExecutorOptions({ timeout: 60000 })
+  t.equal(ctl.executorStats().timeout, 60000, 'default is reported')
+  ctl.list(function(err) {
+    t.equal(err, null, 'Error does not exist')
+    ctl.setExecutorOptions({ timeout: 0 })
+    t.end()
+  })
+})
+
+test('setExecutorOptions - reserved lanes', function(t) {
+  ctl.setExecutorOptions({ reserved: { interactive: 1, mutation: 0, bulk: 0 } })
+  var stats = ctl.executorStats()
+  t.equal(stats.ops.getJob.lane, 'interactive', 'getJob is interactive')
+  t.equal(stats.ops.startStopRemove.lane, 'mutation', 'start is a mutation')
+  t.equal(stats.ops.loadJob.lane, 'bulk', 'load is bulk')
+  t.equal(stats.lanes.interactive.reserved, 1, 'reservation is reported')
+  t.equal(stats.lanes.bulk.limit, stats.threads - 1,
+    'bulk leaves the reserved thread alone')
+  t.throws(function() {
+    ctl.setExecutorOptions({ reserved: { bulk: stats.threads + 1 } })
+  }, RangeError)
+  t.end()
+})
+
+test('setExecutorOptions - reserved lanes under mixed load', function(t) {
+  // Every round trip takes 100ms, loads included
+  ctl.setTransport({ fake: 'jobs=5,latency=fixed:100' })
+  ctl.setExecutorOptions({ threads: 2, reserved: { interactive: 1 } })
+  var pending = 8
+    , queried = false
+  function done() {
+    if (--pending) return
+    t.ok(queried, 'query should finish before the burst')
+    ctl.setTransport({})
+    t.end()
+  }
+  for (var i = 0; i < 4; i++) {
+    ctl.start('com.synthetic.job.' + i, done)
+    ctl.load('/fasdfasdf/asdfasdfasdf', done)
+  }
+  setTimeout(function() {
+    var lanes = ctl.executorStats().lanes
+    t.equal(lanes.mutation.running + lanes.bulk.running, 1,
+      'mutations and loads together leave the reserved thread alone')
+    ctl.list('com.synthetic.job.0', function(err, job) {
+      t.equal(err, null, 'Error does not exist')
+      t.equal(job.Label, 'com.synthetic.job.0')
+      t.ok(pending > 4, 'query should not wait for the burst')
+      queried = true
+    })
+    setTimeout(function() {
+      t.equal(ctl.executorStats().lanes.interactive.running, 1,
+        'query should run alongside the burst')
+    }, 20)
+  }, 20)
+})
+
+test('timeout - load, listCompact and control calls', function(t) {
+  var ETIMEDOUT = require('constants').ETIMEDOUT
+  ctl.setTransport({ fake: 'jobs=5,latency=fixed:300' })
+  var start = Date.now()
+    , pending = 3
+  function done() {
+    if (--pending) return
+    t.ok(Date.now() - start < 300, 'callbacks should not wait for launchd')
+    // Late results are only freed
+    setTimeout(function() {
+      ctl.setTransport({})
+      t.end()
+    }, 400)
+  }
+  ctl.load('/fasdfasdf/asdfasdfasdf', { timeout: 20 }, function(err) {
+    t.equal(err.errno, ETIMEDOUT, 'load should time out')
+    done()
+  })
+  ctl.listCompact({ timeout: 20 }, function(err) {
+    t.equal(err.errno, ETIMEDOUT, 'listCompact should time out')
+    done()
+  })
+  ctl.getEnvVar({ timeout: 20 }, function(err) {
+    t.type(err, Error, 'getEnvVar should time out')
+    done()
+  })
+})
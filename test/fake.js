@@ -0,0 +1,61 @@
+var test = require('tap').test
+  , ctl = require('../lib')
+
+test('setTransport - fake', function(t) {
+  ctl.setTransport({ fake: 'jobs=5' })
+  t.equal(ctl.transport(), 'fake', 'should be on the fake')
+  ctl.list(function(err, jobs) {
+    t.equal(err, null, 'Error does not exist')
+    t.equal(jobs.length, 5, 'should list the synthetic jobs')
+    t.end()
+  })
+})
+
+test('fake - start and stop', function(t) {
+  var label = 'com.synthetic.job.1'
+  ctl.start(label, function(err) {
+    t.equal(err, null, 'Error does not exist')
+    t.type(ctl.listSync(label).PID, 'number', 'should be running')
+    ctl.stop(label, function(err) {
+      t.equal(err, null, 'Error does not exist')
+      t.equal(ctl.listSync(label).LastExitStatus, 15, 'should report SIGTERM')
+      t.end()
+    })
+  })
+})
+
+test('fake - injected errors', function(t) {
+  var EAGAIN = require('constants').EAGAIN
+  ctl.setTransport({ fake: 'jobs=5,error=GetJob:EAGAIN:1,fail=StartJob:ETIMEDOUT:1' })
+  ctl.list('com.synthetic.job.0', function(err) {
+    t.type(err, Error, 'Error does exist')
+    t.equal(err.errno, EAGAIN, 'should fail with EAGAIN')
+    ctl.start('com.synthetic.job.0', function(err) {
+      t.type(err, Error, 'Error does exist')
+      ctl.list(function(err, jobs) {
+        t.equal(err, null, 'other requests should succeed')
+        t.equal(jobs.length, 5)
+        t.end()
+      })
+    })
+  })
+})
+
+test('fake - injected latency', function(t) {
+  ctl.setTransport({ fake: 'jobs=5,latency=fixed:50' })
+  var start = Date.now()
+  ctl.list('com.synthetic.job.0', function(err) {
+    t.equal(err, null, 'Error does not exist')
+    t.ok(Date.now() - start >= 45, 'should wait out the latency')
+    t.end()
+  })
+})
+
+test('fake - bad spec', function(t) {
+  t.throws(function() {
+    ctl.setTransport({ fake: 'latency=sometimes' })
+  }, 'should throw on a spec that does not parse')
+  ctl.setTransport({})
+  t.equal(ctl.transport(), 'native', 'should be back on launchd')
+  t.end()
+})
@@ -38,3 +38,24 @@ test('limit - set maxfiles to unlimited', function(t) {
     t.end()
   }
 })
+
+test('limit - async', function(t) {
+  ctl.limit(function(err, lims) {
+    t.equal(err, null, 'Error does not exist')
+    t.type(lims, 'object', 'should be an object')
+    t.ok(lims.maxfiles, 'should have maxfiles')
+    ctl.limit('maxproc', function(err, lim) {
+      t.equal(err, null, 'Error does not exist')
+      t.ok(lim.soft, 'should have soft')
+      t.ok(lim.hard, 'should have hard')
+      t.end()
+    })
+  })
+})
+
+test('limit - async invalid type', function(t) {
+  ctl.limit('notalimit', function(err) {
+    t.type(err, Error, 'should have error')
+    t.end()
+  })
+})
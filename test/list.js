@@ -1,5 +1,6 @@
 var test = require('tap').test
   , ctl = require('../lib')
+  , binding = require('bindings')('bindings')
 
 test('list', function(t) {
   ctl.list(function(err, data) {
@@ -40,3 +41,232 @@ test('listSync - regex', function(t) {
   })
   t.end()
 })
+
+test('listSync - shaped', function(t) {
+  var keys = ['Label', 'PID', 'LastExitStatus', 'Program', 'ProgramArguments',
+    'OnDemand', 'LimitLoadToSessionType', 'TimeOut', 'StandardOutPath',
+    'StandardErrorPath', 'MachServices', 'Sockets']
+  var jobs = ctl.listSync({ shaped: true })
+  t.type(jobs, Array, 'jobs should be an array')
+  jobs.forEach(function(job) {
+    t.deepEqual(Object.keys(job).slice(0, keys.length), keys, 'well known keys come first')
+  })
+  t.end()
+})
+
+test('keyCacheStats', function(t) {
+  ctl.listSync()
+  var before = ctl.keyCacheStats()
+  ctl.listSync()
+  var after = ctl.keyCacheStats()
+  t.type(after.hits, 'number', 'hits should be a number')
+  t.type(after.misses, 'number', 'misses should be a number')
+  t.ok(after.hits > before.hits, 'second listing should hit the cache')
+  t.end()
+})
+
+test('list - lazy', function(t) {
+  ctl.list({ lazy: true }, function(err, jobs) {
+    t.equal(err, null, 'Error does not exist')
+    t.type(jobs, Array, 'jobs should be an array')
+    jobs.forEach(function(job) {
+      t.type(job.Label, 'string', 'Label should be converted on access')
+      t.ok(~Object.keys(job).indexOf('Label'), 'keys should be enumerable')
+    })
+    t.end()
+  })
+})
+
+test('listCompact', function(t) {
+  ctl.listCompact(function(err, jobs) {
+    t.equal(err, null, 'Error does not exist')
+    t.type(jobs.labels, Array, 'labels should be an array')
+    t.type(jobs.pid, Int32Array, 'pid should be an Int32Array')
+    t.type(jobs.status, Int32Array, 'status should be an Int32Array')
+    t.type(jobs.signal, Int32Array, 'signal should be an Int32Array')
+    t.equal(jobs.pid.length, jobs.labels.length, 'columns should line up')
+    t.end()
+  })
+})
+
+test('listSync - maxDepth', function(t) {
+  try {
+    ctl.listSync({ maxDepth: 1 })
+    t.ok(false, 'should not be reached')
+  }
+  catch (err) {
+    t.type(err, Error, 'Error does exist')
+    t.equal(err.errno, 156, 'should fail on nesting')
+  }
+  t.end()
+})
+
+test('listSync - fields', function(t) {
+  var jobs = ctl.listSync({ fields: ['Label', 'PID'] })
+  t.type(jobs, Array, 'jobs should be an array')
+  jobs.forEach(function(job) {
+    Object.keys(job).forEach(function(key) {
+      t.ok(key === 'Label' || key === 'PID', 'only selected keys exist')
+    })
+  })
+  t.end()
+})
+
+test('list - regex with fields', function(t) {
+  ctl.list(/com.apple.(.*)/, { fields: ['PID'] }, function(err, jobs) {
+    t.equal(err, null, 'Error does not exist')
+    jobs.forEach(function(job) {
+      t.type(job.Label, 'string', 'Label is kept for matching')
+    })
+    t.end()
+  })
+})
+
+test('listSync - prefix and glob', function(t) {
+  var all = ctl.listSync({ fields: ['Label'] })
+  var prefixed = ctl.listSync({ prefix: 'com.apple.' })
+  var globbed = ctl.listSync({ glob: 'com.apple.*' })
+  var expected = all.filter(function(job) {
+    return job.Label.indexOf('com.apple.') === 0
+  })
+  t.equal(prefixed.length, expected.length, 'prefix matches like indexOf')
+  t.equal(globbed.length, expected.length, 'glob matches like indexOf')
+  t.end()
+})
+
+test('listSync - regex is matched natively', function(t) {
+  var before = ctl.regexCacheStats()
+  var first = ctl.listSync(/^com\.apple\./)
+  var second = ctl.listSync(/^com\.apple\./)
+  var after = ctl.regexCacheStats()
+  t.equal(first.length, second.length, 'same jobs both times')
+  t.ok(after.hits > before.hits, 'compiled regex is reused')
+  t.end()
+})
+
+test('listSync - regex JavaScript only syntax', function(t) {
+  var jobs = ctl.listSync(/^com\.apple\.(?!Dock)/)
+  jobs.forEach(function(job) {
+    t.ok(/^com\.apple\.(?!Dock)/.test(job.Label), 'job matches')
+  })
+  t.end()
+})
+
+test('listSync - invalid native regex', function(t) {
+  try {
+    ctl.listSync({ regex: '(' })
+    t.ok(false, 'should not be reached')
+  }
+  catch (err) {
+    t.type(err, SyntaxError, 'SyntaxError does exist')
+  }
+  t.end()
+})
+
+test('list - serialized', function(t) {
+  // Synthetic jobs keep both listings on the same snapshot, with nested
+  // and wide dictionaries for the encoding to get through
+  binding._setSyntheticJobs(50, { depth: 4, width: 8 })
+  ctl.list(function(err, plain) {
+    t.equal(err, null, 'Error does not exist')
+    ctl.list({ serialized: true }, function(err, jobs) {
+      t.equal(err, null, 'Error does not exist')
+      t.type(jobs, Array, 'jobs should be an array')
+      t.equal(jobs.length, 50, 'every job should be decoded')
+      t.deepEqual(jobs, plain, 'decoded jobs should match the plain listing')
+      binding._setSyntheticJobs(0)
+      t.end()
+    })
+  })
+})
+
+test('createListStream', function(t) {
+  var expected = ctl.listSync().length
+    , seen = 0
+  ctl.createListStream({ batchSize: 10 })
+    .on('data', function(job) {
+      seen++
+      t.type(job.Label, 'string', 'Job should have Label')
+    })
+    .on('error', function(err) {
+      t.ok(false, err.message)
+    })
+    .on('end', function() {
+      t.equal(seen, expected, 'every job is streamed')
+      t.end()
+    })
+})
+
+test('createListStream - destroy', function(t) {
+  var stream = ctl.createListStream({ batchSize: 1 })
+  stream.once('data', function() {
+    stream.destroy()
+    t.equal(stream._cursor, null, 'cursor is closed')
+    t.end()
+  })
+})
+
+test('getJobChanges', function(t) {
+  var tracker = ctl.createJobTracker()
+  tracker.changes(function(err, first) {
+    t.equal(err, null, 'Error does not exist')
+    t.ok(first.added.length > 0, 'first call reports jobs as added')
+    t.equal(first.removed.length, 0, 'nothing removed')
+    tracker.changes(function(err, second) {
+      t.equal(err, null, 'Error does not exist')
+      t.type(second.added, Array, 'added should be an array')
+      t.type(second.removed, Array, 'removed should be an array')
+      second.modified.forEach(function(m) {
+        t.type(m.job.Label, 'string', 'modified job has a Label')
+        t.ok(m.changed.length > 0, 'modified job lists changed keys')
+      })
+      t.end()
+    })
+  })
+})
+
+test('getJobs', function(t) {
+  var labels = ctl.listSync({ fields: ['Label'] }).slice(0, 3).map(function(job) {
+    return job.Label
+  })
+  labels.push('com.node-launchctl.does-not-exist')
+  ctl.getJobs(labels, function(err, jobs) {
+    t.equal(err, null, 'Error does not exist')
+    t.equal(jobs.length, labels.length, 'result is aligned with labels')
+    for (var i = 0; i < labels.length - 1; i++) {
+      t.equal(jobs[i].Label, labels[i], 'job matches its label')
+    }
+    t.type(jobs[labels.length - 1], Error, 'missing job is an Error')
+    t.equal(jobs[labels.length - 1].errno, 3, 'missing job is ESRCH')
+    t.end()
+  })
+})
+
+test('getJobsSync - snapshot batch', function(t) {
+  var labels = ctl.listSync({ fields: ['Label'] }).slice(0, 20).map(function(job) {
+    return job.Label
+  })
+  labels.push('com.node-launchctl.does-not-exist')
+  var jobs = ctl.getJobsSync(labels, { fields: ['Label', 'PID'] })
+  t.equal(jobs.length, labels.length, 'result is aligned with labels')
+  t.type(jobs[labels.length - 1], Error, 'missing job is an Error')
+  t.equal(jobs[0].Label, labels[0], 'job matches its label')
+  t.end()
+})
+
+test('getJobs - synthetic, small and large batches', function(t) {
+  binding._setSyntheticJobs(20)
+  var small = ['com.synthetic.job.1', 'com.synthetic.job.2']
+    , large = []
+  for (var i = 0; i < 10; i++) large.push('com.synthetic.job.' + i)
+  ctl.getJobs(small, function(err, jobs) {
+    t.equal(err, null, 'Error does not exist')
+    t.equal(jobs[0].Label, small[0], 'small batch sees synthetic jobs')
+    ctl.getJobs(large, function(err, jobs) {
+      t.equal(err, null, 'Error does not exist')
+      t.equal(jobs[9].Label, large[9], 'large batch sees synthetic jobs')
+      binding._setSyntheticJobs(0)
+      t.end()
+    })
+  })
+})
@@ -19,3 +19,19 @@ test('managerpid', function(t) {
   t.type(pid, 'number', 'should be a number')
   t.end()
 })
+
+test('managerpid - async', function(t) {
+  ctl.managerpid(function(err, pid) {
+    t.equal(err, null, 'Error does not exist')
+    t.equal(pid, ctl.managerpid(), 'should match the sync result')
+    t.end()
+  })
+})
+
+test('umask - async', function(t) {
+  ctl.umask(function(err, mask) {
+    t.equal(err, null, 'Error does not exist')
+    t.equal(mask, ctl.umask(), 'should match the sync result')
+    t.end()
+  })
+})
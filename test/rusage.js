@@ -15,3 +15,12 @@ test('getRUsage', function(t) {
   })
   t.end()
 })
+
+test('getRUsage - async', function(t) {
+  ctl.getRUsage('children', function(err, usage) {
+    t.equal(err, null, 'Error does not exist')
+    t.type(usage, 'object', 'should be an object')
+    t.notEqual(usage.user_time_used, undefined, 'should have user_time_used')
+    t.end()
+  })
+})
@@ -0,0 +1,60 @@
+var test = require('tap').test
+  , ctl = require('../lib')
+  , binding = require('bindings')('bindings')
+
+// Async getJob calls against the synthetic backend. Once the baton pools
+// are warm, RSS should level off. SOAK_CALLS overrides the call count
+var CALLS = +process.env.SOAK_CALLS || 1000000
+  , CONCURRENCY = 64
+  , WARMUP = Math.floor(CALLS / 10)
+  , MAX_GROWTH = 32 * 1024 * 1024
+
+test('soak - getJob', function(t) {
+  binding._setSyntheticJobs(CONCURRENCY)
+  var started = 0
+    , finished = 0
+    , failed = 0
+    , warm
+
+  function next() {
+    if (started === CALLS) return
+    var label = 'com.synthetic.job.' + (started++ % CONCURRENCY)
+    ctl.list(label, done)
+  }
+
+  function done(err, job) {
+    if (err || !job) failed++
+    if (++finished === WARMUP) {
+      gc()
+      warm = {
+        rss: process.memoryUsage().rss,
+        pools: ctl.batonPoolStats()
+      }
+    }
+    if (finished === CALLS) return end()
+    next()
+  }
+
+  function end() {
+    gc()
+    var rss = process.memoryUsage().rss
+      , pools = ctl.batonPoolStats()
+    binding._setSyntheticJobs(0)
+    t.equal(failed, 0, 'every call should succeed')
+    t.equal(pools.getJob.created, warm.pools.getJob.created,
+      'no getJob batons allocated after warm up')
+    t.equal(pools.execItems.created, warm.pools.execItems.created,
+      'no work items allocated after warm up')
+    // A callback starts its replacement before its own baton is released
+    t.ok(pools.getJob.created <= CONCURRENCY + 1, 'pool bounded by concurrency')
+    t.ok(rss - warm.rss < MAX_GROWTH, 'RSS grew by ' +
+      ((rss - warm.rss) / 1048576).toFixed(1) + ' MB')
+    t.end()
+  }
+
+  function gc() {
+    if (global.gc) global.gc()
+  }
+
+  for (var i = 0; i < CONCURRENCY; i++) next()
+})
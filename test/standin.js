@@ -0,0 +1,59 @@
+var test = require('tap').test
+  , ctl = require('../lib')
+  , spawn = require('child_process').spawn
+  , os = require('os')
+  , path = require('path')
+  , sock = path.join(os.tmpdir(), 'launchctl-standin-' + process.pid + '.sock')
+  , bin = path.join(__dirname, '..', 'build', 'Release', 'launchd-standin')
+  , server
+
+test('setTransport - socket', function(t) {
+  server = spawn(bin, ['-n', '10', '-s', sock], { stdio: ['ignore', 'pipe', 'inherit'] })
+  server.stdout.once('data', function() {
+    ctl.setTransport({ socket: sock })
+    t.equal(ctl.transport(), 'socket', 'should be on the socket')
+    ctl.list(function(err, jobs) {
+      t.equal(err, null, 'Error does not exist')
+      t.equal(jobs.length, 10, 'should list the synthetic jobs')
+      t.end()
+    })
+  })
+})
+
+test('socket - start and stop', function(t) {
+  var label = 'com.synthetic.job.1'
+  ctl.start(label, function(err) {
+    t.equal(err, null, 'Error does not exist')
+    t.type(ctl.listSync(label).PID, 'number', 'should be running')
+    ctl.stop(label, function(err) {
+      t.equal(err, null, 'Error does not exist')
+      var job = ctl.listSync(label)
+      t.equal(job.PID, undefined, 'should have stopped')
+      t.equal(job.LastExitStatus, 15, 'should report SIGTERM')
+      t.end()
+    })
+  })
+})
+
+test('socket - unknown job', function(t) {
+  ctl.list('com.thisisafakejob.test', function(err) {
+    t.type(err, Error, 'Error does exist')
+    t.equal(err.errno, 3, 'should fail with ESRCH')
+    t.end()
+  })
+})
+
+test('socket - server gone', function(t) {
+  server.kill()
+  server.on('exit', function() {
+    ctl.list(function(err) {
+      t.type(err, Error, 'Error does exist')
+      ctl.setTransport({})
+      t.equal(ctl.transport(), 'native', 'should be back on launchd')
+      t.throws(function() {
+        ctl.setTransport({ socket: sock })
+      }, 'should throw without a server')
+      t.end()
+    })
+  })
+})
@@ -46,3 +46,56 @@ test('stopSync - non existent job', function(t) {
     t.end()
   }
 })
+
+test('startMany - non existent jobs', function(t) {
+  var labels = ['com.thisisafakejob.test', 'com.thisisafakejob.test2']
+  ctl.startMany(labels, { concurrency: 2, pid: true }, function(err, res) {
+    t.equal(err, null, 'Error does not exist')
+    labels.forEach(function(label) {
+      t.ok(res.results[label] !== 0, 'label reports its errno')
+      t.type(res.latencyMs[label], 'number', 'latency is reported')
+    })
+    t.deepEqual(res.pids, {}, 'no pids for failed starts')
+    t.type(res.wallMs, 'number', 'wall time is reported')
+    t.end()
+  })
+})
+
+test('stopMany - empty', function(t) {
+  ctl.stopMany([], function(err, res) {
+    t.equal(err, null, 'Error does not exist')
+    t.deepEqual(res.results, {}, 'no results')
+    t.equal(res.pids, undefined, 'pids only reported for start')
+    t.end()
+  })
+})
+
+test('removeMany - invalid concurrency', function(t) {
+  t.throws(function() {
+    ctl.removeMany(['com.thisisafakejob.test'], { concurrency: 0 }, function() {})
+  }, RangeError)
+  t.end()
+})
+
+test('startMany - timeout reports per label', function(t) {
+  var ETIMEDOUT = require('constants').ETIMEDOUT
+    , labels = []
+  for (var i = 0; i < 8; i++) labels.push('com.synthetic.job.' + i)
+  // Every round trip takes 100ms, so the deadline passes mid batch
+  ctl.setTransport({ fake: 'jobs=8,latency=fixed:100' })
+  ctl.startMany(labels, { concurrency: 2, timeout: 150 }, function(err, res) {
+    t.equal(err, null, 'Error does not exist')
+    var started = 0
+      , timedOut = 0
+    labels.forEach(function(label) {
+      t.type(res.results[label], 'number', 'every label is reported')
+      if (res.results[label] === 0) started++
+      if (res.results[label] === ETIMEDOUT) timedOut++
+    })
+    t.ok(started > 0, 'labels claimed before the deadline finish')
+    t.ok(timedOut > 0, 'labels left over time out')
+    t.equal(started + timedOut, labels.length, 'nothing else fails')
+    ctl.setTransport({})
+    t.end()
+  })
+})
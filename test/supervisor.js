@@ -0,0 +1,80 @@
+var test = require('tap').test
+  , ctl = require('../lib')
+  , label = 'com.node-launchctl.supervised.' + process.pid
+
+// The supervisor needs epoll and pidfds
+if (process.platform !== 'linux') return
+
+test('setTransport - supervisor', function(t) {
+  ctl.setTransport({ supervisor: true })
+  t.equal(ctl.transport(), 'supervisor', 'should be supervising')
+  t.end()
+})
+
+test('supervisor - submit and exit status', function(t) {
+  ctl.submit({
+      label: label
+    , program: '/bin/sh'
+    , args: ['sh', '-c', 'exit 3']
+    , runAtLoad: true
+  }, function(err) {
+    t.equal(err, null, 'Error does not exist')
+    setTimeout(function() {
+      ctl.list(label, function(err, job) {
+        t.equal(err, null, 'Error does not exist')
+        t.equal(job.Label, label, 'should be the submitted job')
+        t.equal(job.PID, undefined, 'should not be running')
+        t.equal(job.LastExitStatus, 3 << 8, 'should report the wait status')
+        t.end()
+      })
+    }, 200)
+  })
+})
+
+test('supervisor - start and stop', function(t) {
+  ctl.remove(label, function(err) {
+    t.equal(err, null, 'Error does not exist')
+    ctl.submit({
+        label: label
+      , program: '/bin/sleep'
+      , args: ['sleep', '30']
+      , keepAlive: false
+    }, function(err) {
+      t.equal(err, null, 'Error does not exist')
+      ctl.start(label, function(err) {
+        t.equal(err, null, 'Error does not exist')
+        var job = ctl.listSync(label)
+        t.type(job.PID, 'number', 'should be running')
+        ctl.list(function(err, jobs) {
+          t.equal(err, null, 'Error does not exist')
+          t.ok(jobs.some(function(j) { return j.Label === label }), 'should be listed')
+          ctl.stop(label, function(err) {
+            t.equal(err, null, 'Error does not exist')
+            setTimeout(function() {
+              var job = ctl.listSync(label)
+              t.equal(job.PID, undefined, 'should have exited')
+              t.equal(job.LastExitStatus, 15, 'should have been sent SIGTERM')
+              t.end()
+            }, 200)
+          })
+        })
+      })
+    })
+  })
+})
+
+test('supervisor - unknown and duplicate jobs', function(t) {
+  ctl.start('com.thisisafakejob.test', function(err) {
+    t.type(err, Error, 'Error does exist')
+    t.equal(err.message, 'No such process')
+    ctl.submit({ label: label, program: '/bin/true' }, function(err) {
+      t.type(err, Error, 'Error does exist')
+      t.equal(err.errno, 17, 'should fail with EEXIST')
+      ctl.remove(label, function(err) {
+        t.equal(err, null, 'Error does not exist')
+        ctl.setTransport({})
+        t.end()
+      })
+    })
+  })
+})
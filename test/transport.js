@@ -0,0 +1,43 @@
+var test = require('tap').test
+  , ctl = require('../lib')
+  , fs = require('fs')
+  , os = require('os')
+  , path = require('path')
+  , capture = path.join(os.tmpdir(), 'launchctl-transport-' + process.pid + '.ldtr')
+
+test('setTransport - record and replay', function(t) {
+  ctl.setTransport({ record: capture })
+  t.equal(ctl.transport(), 'record', 'should be recording')
+  ctl.list(function(err, recorded) {
+    t.equal(err, null, 'Error does not exist')
+    var name = ctl.managername()
+    ctl.setTransport({ replay: capture })
+    t.equal(ctl.transport(), 'replay', 'should be replaying')
+    ctl.list(function(err, replayed) {
+      t.equal(err, null, 'Error does not exist')
+      t.deepEqual(replayed, recorded, 'jobs should match the capture')
+      t.equal(ctl.managername(), name, 'manager name should match the capture')
+      t.end()
+    })
+  })
+})
+
+test('setTransport - request missing from the capture', function(t) {
+  ctl.list('com.node-launchctl.not-captured', function(err) {
+    t.ok(err, 'Error exists')
+    t.equal(err.errno, 2, 'should fail with ENOENT')
+    ctl.setTransport({})
+    t.equal(ctl.transport(), 'native', 'should be back on launchd')
+    t.end()
+  })
+})
+
+test('setTransport - not a capture', function(t) {
+  fs.writeFileSync(capture, 'not a capture')
+  t.throws(function() {
+    ctl.setTransport({ replay: capture })
+  }, 'should throw on a malformed capture')
+  t.equal(ctl.transport(), 'native', 'should stay on launchd')
+  fs.unlinkSync(capture)
+  t.end()
+})